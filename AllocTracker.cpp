@@ -0,0 +1,151 @@
+#include "AllocTracker.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // Plain data only: these are touched from operator new, before any
+    // dynamic initialization could run
+    thread_local AllocTracker::Counts counts;
+    thread_local const char* guardedRegion = nullptr;
+    thread_local bool reporting = false;
+    std::atomic<bool> strict{ false };
+
+    void noteAllocation(size_t size)
+    {
+        counts.allocations++;
+        counts.bytes += size;
+        if (guardedRegion && !reporting && strict.load(std::memory_order_relaxed))
+        {
+            reporting = true;
+            // stderr is unbuffered, so this does not allocate
+            std::fprintf(stderr, "Strict allocation mode: %zu byte allocation in %s\n", size, guardedRegion);
+            std::abort();
+        }
+    }
+
+    void* allocate(size_t size)
+    {
+        noteAllocation(size);
+        void* p = std::malloc(size ? size : 1);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+#ifdef __cpp_aligned_new
+    // Over-aligned new and delete only exist from C++17
+    void* allocateAligned(size_t size, std::align_val_t alignment)
+    {
+        noteAllocation(size);
+        size_t a = (size_t)alignment;
+#ifdef _WIN32
+        void* p = _aligned_malloc(size ? size : 1, a);
+#else
+        void* p = nullptr;
+        if (posix_memalign(&p, a < sizeof(void*) ? sizeof(void*) : a, size ? size : 1) != 0)
+            p = nullptr;
+#endif
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+#endif
+
+    void release(void* p)
+    {
+        if (!p)
+            return;
+        counts.frees++;
+        std::free(p);
+    }
+
+#ifdef __cpp_aligned_new
+    void releaseAligned(void* p)
+    {
+        if (!p)
+            return;
+        counts.frees++;
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+#endif
+}
+
+AllocTracker::Counts AllocTracker::thread()
+{
+    return counts;
+}
+
+void AllocTracker::setStrict(bool on)
+{
+    strict.store(on, std::memory_order_relaxed);
+}
+
+bool AllocTracker::isStrict()
+{
+    return strict.load(std::memory_order_relaxed);
+}
+
+AllocTracker::Guard::Guard(const char* region, bool active) : previous(guardedRegion), active(active)
+{
+    if (active)
+        guardedRegion = region;
+}
+
+void AllocTracker::Guard::end()
+{
+    if (active)
+        guardedRegion = previous;
+    active = false;
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try { return allocate(size); }
+    catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try { return allocate(size); }
+    catch (...) { return nullptr; }
+}
+
+#ifdef __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t a) { return allocateAligned(size, a); }
+void* operator new[](size_t size, std::align_val_t a) { return allocateAligned(size, a); }
+void* operator new(size_t size, std::align_val_t a, const std::nothrow_t&) noexcept
+{
+    try { return allocateAligned(size, a); }
+    catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, std::align_val_t a, const std::nothrow_t&) noexcept
+{
+    try { return allocateAligned(size, a); }
+    catch (...) { return nullptr; }
+}
+#endif
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+#ifdef __cpp_aligned_new
+void operator delete(void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(p); }
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+
+// Counts heap allocations per thread by replacing the global operator new
+// and delete (AllocTracker.cpp). Snapshots taken around a phase give its
+// allocation count and bytes. In strict mode an allocation made inside a
+// Guard is reported and aborts the process, which pins down anything that
+// allocates in a loop meant to be allocation free.
+namespace AllocTracker
+{
+    struct Counts
+    {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+        uint64_t frees = 0;
+
+        Counts operator-(const Counts& o) const
+        {
+            return { allocations - o.allocations, bytes - o.bytes, frees - o.frees };
+        }
+    };
+
+    // Running totals for the calling thread
+    Counts thread();
+
+    void setStrict(bool strict);
+    bool isStrict();
+
+    // Marks a region of the calling thread that must not allocate while strict
+    struct Guard
+    {
+        Guard(const char* region, bool active = true);
+        ~Guard() { end(); }
+        // Lifts the guard before the end of its scope
+        void end();
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        const char* previous;
+        bool active;
+    };
+}
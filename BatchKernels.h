@@ -0,0 +1,67 @@
+#pragma once
+#include "Ensemble.h"
+#include "Cpu.h"
+#include "Spectrum.h"
+
+// The batch step kernels are compiled once per instruction set level
+// (BatchKernelsSSE2.cpp, BatchKernelsAVX2.cpp, BatchKernelsAVX512.cpp from
+// the shared body in BatchKernels.inl); Batch::stepSingles, stepDoubles,
+// stepDrivens and stepElastics call the build for Cpu::active(), as does
+// Spectrum::welch for the batch FFT.
+namespace Batch
+{
+    struct Kernels
+    {
+        void (*singlesFloat)(const SingleColumnsT<float>&, size_t, size_t, float, float, float, size_t);
+        void (*singlesDouble)(const SingleColumnsT<double>&, size_t, size_t, double, double, double, size_t);
+        void (*doublesFloat)(const DoubleColumnsT<float>&, size_t, size_t, float, float, float, size_t);
+        void (*doublesDouble)(const DoubleColumnsT<double>&, size_t, size_t, double, double, double, size_t);
+        void (*drivensFloat)(const DrivenColumnsT<float>&, size_t, size_t, float, float, float, size_t);
+        void (*drivensDouble)(const DrivenColumnsT<double>&, size_t, size_t, double, double, double, size_t);
+        void (*elasticsFloat)(const ElasticColumnsT<float>&, size_t, size_t, float, float, float, size_t);
+        void (*elasticsDouble)(const ElasticColumnsT<double>&, size_t, size_t, double, double, double, size_t);
+        // Spectrum::welch with its scale worked out
+        void (*welch)(const Spectrum::Plan&, const float*, size_t, size_t, size_t, float, float*, float*);
+
+        void stepSingles(const SingleColumnsT<float>& c, size_t begin, size_t end, float damping, float g, float dt, size_t steps) const
+        {
+            singlesFloat(c, begin, end, damping, g, dt, steps);
+        }
+        void stepSingles(const SingleColumnsT<double>& c, size_t begin, size_t end, double damping, double g, double dt, size_t steps) const
+        {
+            singlesDouble(c, begin, end, damping, g, dt, steps);
+        }
+        void stepDoubles(const DoubleColumnsT<float>& c, size_t begin, size_t end, float damping, float g, float dt, size_t steps) const
+        {
+            doublesFloat(c, begin, end, damping, g, dt, steps);
+        }
+        void stepDoubles(const DoubleColumnsT<double>& c, size_t begin, size_t end, double damping, double g, double dt, size_t steps) const
+        {
+            doublesDouble(c, begin, end, damping, g, dt, steps);
+        }
+        void stepDrivens(const DrivenColumnsT<float>& c, size_t begin, size_t end, float damping, float g, float dt, size_t steps) const
+        {
+            drivensFloat(c, begin, end, damping, g, dt, steps);
+        }
+        void stepDrivens(const DrivenColumnsT<double>& c, size_t begin, size_t end, double damping, double g, double dt, size_t steps) const
+        {
+            drivensDouble(c, begin, end, damping, g, dt, steps);
+        }
+        void stepElastics(const ElasticColumnsT<float>& c, size_t begin, size_t end, float damping, float g, float dt, size_t steps) const
+        {
+            elasticsFloat(c, begin, end, damping, g, dt, steps);
+        }
+        void stepElastics(const ElasticColumnsT<double>& c, size_t begin, size_t end, double damping, double g, double dt, size_t steps) const
+        {
+            elasticsDouble(c, begin, end, damping, g, dt, steps);
+        }
+    };
+
+    // Null when the compiler cannot target the level, e.g. off x86
+    const Kernels* kernelsSSE2();
+    const Kernels* kernelsAVX2();
+    const Kernels* kernelsAVX512();
+
+    // The build for a level, falling back to the next lower one available
+    const Kernels& kernels(Cpu::Level level);
+}
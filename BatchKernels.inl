@@ -0,0 +1,392 @@
+// Body of the batch step and spectrum kernels. Each BatchKernels<ISA>.cpp
+// includes this and Physics.h inside its own namespace after setting the
+// target, so every build, down to the inlined equations of motion, gets its
+// own symbols and the linker cannot fold one level's code into another's.
+
+template <typename Real>
+void stepSingles(const SingleColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        if (c.frozen[i])
+            continue;
+        Real theta = c.theta[i], omega = c.omega[i];
+        const Real L = c.L[i];
+        for (size_t n = 0; n < steps; ++n)
+            Physics::stepSingle(theta, omega, L, damping, g, dt);
+        c.theta[i] = theta;
+        c.omega[i] = omega;
+    }
+}
+
+// Steps a pendulum that may go stiff: every StiffCheck-th step goes through
+// stepDoubleAuto, whose Jacobian measures the actual stiffness, and those
+// within a factor of four of the limit run the steps up to the next check
+// through it as well
+template <typename Real>
+void stepDoubleChecked(Real& theta1, Real& theta2, Real& omega1, Real& omega2,
+                       Real m1, Real m2, Real L1, Real L2, Real damping, Real g, Real dt, size_t steps)
+{
+    const size_t StiffCheck = 8;
+    const Real Margin = (Real)(Physics::StiffLimit / 4);
+    for (size_t n = 0; n < steps;)
+    {
+        bool close = Physics::stepDoubleAuto(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, dt) > Margin;
+        size_t next = n + StiffCheck < steps ? n + StiffCheck : steps;
+        if (close)
+            for (++n; n < next; ++n)
+                Physics::stepDoubleAuto(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, dt);
+        else
+            for (++n; n < next; ++n)
+                Physics::stepDouble(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, dt);
+    }
+}
+
+// Most pendulums can never go stiff at this dt, which canStiffenDouble shows
+// once per call. It runs for a block of pendulums at a time, a loop that
+// vectorizes, and those pendulums run plain semi-implicit Euler; only the
+// rest pay for the checks and the Rosenbrock path.
+template <typename Real>
+void stepDoubles(const DoubleColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps)
+{
+    const size_t Block = 64;
+    const Real Limit = (Real)Physics::StiffLimit;
+    for (size_t first = begin; first < end; first += Block)
+    {
+        const size_t count = end - first < Block ? end - first : Block;
+        // Local pointers, since stores to the flags could alias the column pointers
+        const Real *t1 = c.theta1 + first, *t2 = c.theta2 + first, *w1 = c.omega1 + first, *w2 = c.omega2 + first;
+        const Real *pm1 = c.m1 + first, *pm2 = c.m2 + first, *pL1 = c.L1 + first, *pL2 = c.L2 + first;
+        uint8_t risky[Block];
+        for (size_t j = 0; j < count; ++j)
+            risky[j] = Physics::canStiffenDouble(t1[j], t2[j], w1[j], w2[j], pm1[j], pm2[j], pL1[j], pL2[j], damping, g, dt, Limit);
+
+        for (size_t j = 0; j < count; ++j)
+        {
+            size_t i = first + j;
+            if (c.frozen[i])
+                continue;
+            Real theta1 = c.theta1[i], theta2 = c.theta2[i];
+            Real omega1 = c.omega1[i], omega2 = c.omega2[i];
+            const Real m1 = c.m1[i], m2 = c.m2[i], L1 = c.L1[i], L2 = c.L2[i];
+            if (risky[j])
+                stepDoubleChecked(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, dt, steps);
+            else
+                for (size_t n = 0; n < steps; ++n)
+                    Physics::stepDouble(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, dt);
+            c.theta1[i] = theta1;
+            c.theta2[i] = theta2;
+            c.omega1[i] = omega1;
+            c.omega2[i] = omega2;
+        }
+    }
+}
+
+// Each step waits on the sine of the last, so pendulums are stepped in
+// groups whose independent chains the CPU can overlap
+template <typename Real>
+void stepDrivens(const DrivenColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps)
+{
+    const size_t Lanes = 8;
+    size_t lane[Lanes];
+    for (size_t i = begin; i < end;)
+    {
+        size_t n = 0;
+        for (; i < end && n < Lanes; ++i)
+            if (!c.frozen[i])
+                lane[n++] = i;
+        Real theta[Lanes], omega[Lanes], phase[Lanes], L[Lanes], amplitude[Lanes], frequency[Lanes];
+        for (size_t k = 0; k < n; ++k)
+        {
+            theta[k] = c.theta[lane[k]];
+            omega[k] = c.omega[lane[k]];
+            phase[k] = c.phase[lane[k]];
+            L[k] = c.L[lane[k]];
+            amplitude[k] = c.amplitude[lane[k]];
+            frequency[k] = c.frequency[lane[k]];
+        }
+        for (size_t s = 0; s < steps; ++s)
+            for (size_t k = 0; k < n; ++k)
+                Physics::stepDriven(theta[k], omega[k], phase[k], L[k], damping, g, amplitude[k], frequency[k], dt);
+        for (size_t k = 0; k < n; ++k)
+        {
+            c.theta[lane[k]] = theta[k];
+            c.omega[lane[k]] = omega[k];
+            c.phase[lane[k]] = phase[k];
+        }
+    }
+}
+
+// Pendulums are gathered into blocks of local columns, skipping frozen ones,
+// and the step loop runs across each block, so the branch-free stepElastic
+// vectorizes over pendulums at this build's width
+template <typename Real>
+void stepElastics(const ElasticColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps)
+{
+    const size_t Block = 64;
+    size_t index[Block];
+    for (size_t i = begin; i < end;)
+    {
+        size_t n = 0;
+        for (; i < end && n < Block; ++i)
+            if (!c.frozen[i])
+                index[n++] = i;
+        alignas(64) Real theta[Block], omega[Block], r[Block], vr[Block], m[Block], L[Block], k[Block];
+        for (size_t j = 0; j < n; ++j)
+        {
+            theta[j] = c.theta[index[j]];
+            omega[j] = c.omega[index[j]];
+            r[j] = c.r[index[j]];
+            vr[j] = c.vr[index[j]];
+            m[j] = c.m[index[j]];
+            L[j] = c.L[index[j]];
+            k[j] = c.k[index[j]];
+        }
+        for (size_t s = 0; s < steps; ++s)
+            for (size_t j = 0; j < n; ++j)
+                Physics::stepElastic(theta[j], omega[j], r[j], vr[j], m[j], L[j], k[j], damping, g, dt);
+        for (size_t j = 0; j < n; ++j)
+        {
+            c.theta[index[j]] = theta[j];
+            c.omega[index[j]] = omega[j];
+            c.r[index[j]] = r[j];
+            c.vr[index[j]] = vr[j];
+        }
+    }
+}
+
+// Spectrum kernels. A block of width lanes keeps point j of every lane's
+// transform in the width floats from j * width, so a radix pass works on
+// runs of span * width consecutive floats and vectorizes across lanes and
+// points alike. A pass reads one buffer and writes the other, which
+// __restrict tells the compiler so the loops need no alias checks.
+void fftPass2(const Spectrum::Plan& plan, const Spectrum::Plan::Pass& pass, const float* __restrict xr,
+              const float* __restrict xi, float* __restrict yr, float* __restrict yi, size_t width)
+{
+    const size_t run = pass.span * width, runs = pass.runs;
+    const float* tr = plan.twiddleRe.data() + pass.twiddle;
+    const float* ti = plan.twiddleIm.data() + pass.twiddle;
+    for (size_t j = 0; j < runs; ++j)
+    {
+        const float w1r = tr[j], w1i = ti[j];
+        const size_t a0 = j * run, a1 = (j + runs) * run, b0 = 2 * j * run, b1 = b0 + run;
+        for (size_t i = 0; i < run; ++i)
+        {
+            float pr = xr[a0 + i], pi = xi[a0 + i], qr = xr[a1 + i], qi = xi[a1 + i];
+            float dr = pr - qr, di = pi - qi;
+            yr[b0 + i] = pr + qr;
+            yi[b0 + i] = pi + qi;
+            yr[b1 + i] = dr * w1r - di * w1i;
+            yi[b1 + i] = dr * w1i + di * w1r;
+        }
+    }
+}
+
+void fftPass3(const Spectrum::Plan& plan, const Spectrum::Plan::Pass& pass, const float* __restrict xr,
+              const float* __restrict xi, float* __restrict yr, float* __restrict yi, size_t width)
+{
+    const float S = 0.866025404f; // sin(2 pi / 3)
+    const size_t run = pass.span * width, runs = pass.runs;
+    const float* tr = plan.twiddleRe.data() + pass.twiddle;
+    const float* ti = plan.twiddleIm.data() + pass.twiddle;
+    for (size_t j = 0; j < runs; ++j)
+    {
+        const float w1r = tr[2 * j], w1i = ti[2 * j], w2r = tr[2 * j + 1], w2i = ti[2 * j + 1];
+        const size_t a0 = j * run, a1 = (j + runs) * run, a2 = (j + 2 * runs) * run;
+        const size_t b0 = 3 * j * run, b1 = b0 + run, b2 = b1 + run;
+        for (size_t i = 0; i < run; ++i)
+        {
+            float sr = xr[a1 + i] + xr[a2 + i], si = xi[a1 + i] + xi[a2 + i];
+            float dr = xr[a1 + i] - xr[a2 + i], di = xi[a1 + i] - xi[a2 + i];
+            float mr = xr[a0 + i] - 0.5f * sr, mi = xi[a0 + i] - 0.5f * si;
+            // -i sin(2 pi / 3) (a1 - a2)
+            float rr = S * di, ri = -S * dr;
+            yr[b0 + i] = xr[a0 + i] + sr;
+            yi[b0 + i] = xi[a0 + i] + si;
+            float c1r = mr + rr, c1i = mi + ri, c2r = mr - rr, c2i = mi - ri;
+            yr[b1 + i] = c1r * w1r - c1i * w1i;
+            yi[b1 + i] = c1r * w1i + c1i * w1r;
+            yr[b2 + i] = c2r * w2r - c2i * w2i;
+            yi[b2 + i] = c2r * w2i + c2i * w2r;
+        }
+    }
+}
+
+void fftPass4(const Spectrum::Plan& plan, const Spectrum::Plan::Pass& pass, const float* __restrict xr,
+              const float* __restrict xi, float* __restrict yr, float* __restrict yi, size_t width)
+{
+    const size_t run = pass.span * width, runs = pass.runs;
+    const float* tr = plan.twiddleRe.data() + pass.twiddle;
+    const float* ti = plan.twiddleIm.data() + pass.twiddle;
+    for (size_t j = 0; j < runs; ++j)
+    {
+        const float w1r = tr[3 * j], w1i = ti[3 * j], w2r = tr[3 * j + 1], w2i = ti[3 * j + 1];
+        const float w3r = tr[3 * j + 2], w3i = ti[3 * j + 2];
+        const size_t a0 = j * run, a1 = (j + runs) * run, a2 = (j + 2 * runs) * run, a3 = (j + 3 * runs) * run;
+        const size_t b0 = 4 * j * run, b1 = b0 + run, b2 = b1 + run, b3 = b2 + run;
+        for (size_t i = 0; i < run; ++i)
+        {
+            float t0r = xr[a0 + i] + xr[a2 + i], t0i = xi[a0 + i] + xi[a2 + i];
+            float t1r = xr[a0 + i] - xr[a2 + i], t1i = xi[a0 + i] - xi[a2 + i];
+            float t2r = xr[a1 + i] + xr[a3 + i], t2i = xi[a1 + i] + xi[a3 + i];
+            float t3r = xr[a1 + i] - xr[a3 + i], t3i = xi[a1 + i] - xi[a3 + i];
+            // t1 -+ i t3 for outputs 1 and 3
+            float c1r = t1r + t3i, c1i = t1i - t3r, c2r = t0r - t2r, c2i = t0i - t2i;
+            float c3r = t1r - t3i, c3i = t1i + t3r;
+            yr[b0 + i] = t0r + t2r;
+            yi[b0 + i] = t0i + t2i;
+            yr[b1 + i] = c1r * w1r - c1i * w1i;
+            yi[b1 + i] = c1r * w1i + c1i * w1r;
+            yr[b2 + i] = c2r * w2r - c2i * w2i;
+            yi[b2 + i] = c2r * w2i + c2i * w2r;
+            yr[b3 + i] = c3r * w3r - c3i * w3i;
+            yi[b3 + i] = c3r * w3i + c3i * w3r;
+        }
+    }
+}
+
+void fftPass5(const Spectrum::Plan& plan, const Spectrum::Plan::Pass& pass, const float* __restrict xr,
+              const float* __restrict xi, float* __restrict yr, float* __restrict yi, size_t width)
+{
+    // cos and sin of 2 pi / 5 and 4 pi / 5
+    const float C1 = 0.309016994f, C2 = -0.809016994f, S1 = 0.951056516f, S2 = 0.587785252f;
+    const size_t run = pass.span * width, runs = pass.runs;
+    const float* tr = plan.twiddleRe.data() + pass.twiddle;
+    const float* ti = plan.twiddleIm.data() + pass.twiddle;
+    for (size_t j = 0; j < runs; ++j)
+    {
+        float wr[4], wi[4];
+        for (int u = 0; u < 4; ++u)
+        {
+            wr[u] = tr[4 * j + u];
+            wi[u] = ti[4 * j + u];
+        }
+        const size_t a0 = j * run, a1 = (j + runs) * run, a2 = (j + 2 * runs) * run, a3 = (j + 3 * runs) * run,
+                     a4 = (j + 4 * runs) * run;
+        const size_t b0 = 5 * j * run, b1 = b0 + run, b2 = b1 + run, b3 = b2 + run, b4 = b3 + run;
+        for (size_t i = 0; i < run; ++i)
+        {
+            float s1r = xr[a1 + i] + xr[a4 + i], s1i = xi[a1 + i] + xi[a4 + i];
+            float s2r = xr[a2 + i] + xr[a3 + i], s2i = xi[a2 + i] + xi[a3 + i];
+            float d1r = xr[a1 + i] - xr[a4 + i], d1i = xi[a1 + i] - xi[a4 + i];
+            float d2r = xr[a2 + i] - xr[a3 + i], d2i = xi[a2 + i] - xi[a3 + i];
+            float m1r = xr[a0 + i] + C1 * s1r + C2 * s2r, m1i = xi[a0 + i] + C1 * s1i + C2 * s2i;
+            float m2r = xr[a0 + i] + C2 * s1r + C1 * s2r, m2i = xi[a0 + i] + C2 * s1i + C1 * s2i;
+            // -i (S1 d1 + S2 d2) and -i (S2 d1 - S1 d2)
+            float r1r = S1 * d1i + S2 * d2i, r1i = -(S1 * d1r + S2 * d2r);
+            float r2r = S2 * d1i - S1 * d2i, r2i = -(S2 * d1r - S1 * d2r);
+            float c1r = m1r + r1r, c1i = m1i + r1i, c4r = m1r - r1r, c4i = m1i - r1i;
+            float c2r = m2r + r2r, c2i = m2i + r2i, c3r = m2r - r2r, c3i = m2i - r2i;
+            yr[b0 + i] = xr[a0 + i] + s1r + s2r;
+            yi[b0 + i] = xi[a0 + i] + s1i + s2i;
+            yr[b1 + i] = c1r * wr[0] - c1i * wi[0];
+            yi[b1 + i] = c1r * wi[0] + c1i * wr[0];
+            yr[b2 + i] = c2r * wr[1] - c2i * wi[1];
+            yi[b2 + i] = c2r * wi[1] + c2i * wr[1];
+            yr[b3 + i] = c3r * wr[2] - c3i * wi[2];
+            yi[b3 + i] = c3r * wi[2] + c3i * wr[2];
+            yr[b4 + i] = c4r * wr[3] - c4i * wi[3];
+            yi[b4 + i] = c4r * wi[3] + c4i * wr[3];
+        }
+    }
+}
+
+// Welch averages, LaneBlock lanes at a time. Each segment is detrended and
+// windowed, its even and odd samples packed as one complex series of half
+// the length, and the split after the passes recovers the real transform.
+void welch(const Spectrum::Plan& plan, const float* series, size_t stride, size_t lanes, size_t segments, float scale,
+           float* power, float* work)
+{
+    const size_t Block = Spectrum::LaneBlock;
+    const size_t n = plan.length, half = n / 2, bins = plan.bins(), hop = Spectrum::hop(n);
+    const float* window = plan.window.data();
+    const double middle = 0.5 * (double)(n - 1), spread = (double)n * ((double)n * n - 1.0) / 12.0;
+    float* buffers[4] = { work, work + half * Block, work + 2 * half * Block, work + 3 * half * Block };
+
+    for (size_t first = 0; first < lanes; first += Block)
+    {
+        const size_t width = lanes - first < Block ? lanes - first : Block;
+        for (size_t k = 0; k < bins; ++k)
+            for (size_t l = 0; l < width; ++l)
+                power[k * stride + first + l] = 0.0f;
+
+        for (size_t s = 0; s < segments; ++s)
+        {
+            const float* x = series + s * hop * stride + first;
+            // Least squares line through the segment, from sums about its middle
+            double sum[Block] = {}, moment[Block] = {};
+            for (size_t t = 0; t < n; ++t)
+                for (size_t l = 0; l < width; ++l)
+                {
+                    sum[l] += x[t * stride + l];
+                    moment[l] += ((double)t - middle) * x[t * stride + l];
+                }
+            float level[Block], slope[Block];
+            for (size_t l = 0; l < width; ++l)
+            {
+                slope[l] = (float)(moment[l] / spread);
+                level[l] = (float)(sum[l] / n - middle * moment[l] / spread);
+            }
+
+            float *zr = buffers[0], *zi = buffers[1], *yr = buffers[2], *yi = buffers[3];
+            for (size_t j = 0; j < half; ++j)
+            {
+                const float* even = x + 2 * j * stride;
+                const float* odd = even + stride;
+                const float we = window[2 * j], wo = window[2 * j + 1];
+                for (size_t l = 0; l < width; ++l)
+                {
+                    zr[j * width + l] = we * (even[l] - level[l] - slope[l] * (float)(2 * j));
+                    zi[j * width + l] = wo * (odd[l] - level[l] - slope[l] * (float)(2 * j + 1));
+                }
+            }
+
+            for (const Spectrum::Plan::Pass& pass : plan.passes)
+            {
+                switch (pass.radix)
+                {
+                case 2: fftPass2(plan, pass, zr, zi, yr, yi, width); break;
+                case 3: fftPass3(plan, pass, zr, zi, yr, yi, width); break;
+                case 4: fftPass4(plan, pass, zr, zi, yr, yi, width); break;
+                default: fftPass5(plan, pass, zr, zi, yr, yi, width); break;
+                }
+                float* t = zr;
+                zr = yr;
+                yr = t;
+                t = zi;
+                zi = yi;
+                yi = t;
+            }
+
+            // X[k] = (Z[k] + conj Z[half - k]) / 2 + exp(-2 pi i k / n) (Z[k] - conj Z[half - k]) / 2i
+            for (size_t k = 0; k <= half; ++k)
+            {
+                const float* pr = zr + (k % half) * width;
+                const float* pi = zi + (k % half) * width;
+                const float* qr = zr + ((half - k) % half) * width;
+                const float* qi = zi + ((half - k) % half) * width;
+                const float wr = plan.splitRe[k], wi = plan.splitIm[k];
+                // One-sided: every bin but DC and Nyquist stands for its mirror too
+                const float weight = k == 0 || k == half ? 1.0f : 2.0f;
+                float* out = power + k * stride + first;
+                for (size_t l = 0; l < width; ++l)
+                {
+                    float er = 0.5f * (pr[l] + qr[l]), ei = 0.5f * (pi[l] - qi[l]);
+                    float orr = 0.5f * (pi[l] + qi[l]), oi = -0.5f * (pr[l] - qr[l]);
+                    float re = er + wr * orr - wi * oi, im = ei + wr * oi + wi * orr;
+                    out[l] += weight * (re * re + im * im);
+                }
+            }
+        }
+
+        for (size_t k = 0; k < bins; ++k)
+            for (size_t l = 0; l < width; ++l)
+                power[k * stride + first + l] *= scale;
+    }
+}
+
+const Batch::Kernels kernels = {
+    stepSingles<float>, stepSingles<double>, stepDoubles<float>, stepDoubles<double>,
+    stepDrivens<float>, stepDrivens<double>, stepElastics<float>, stepElastics<double>,
+    welch
+};
@@ -0,0 +1,35 @@
+// Batch kernels built for AVX2 with FMA. MSVC compiles this file with /arch:AVX2
+// (set per file in the project); GCC and Clang take the target below.
+#include "BatchKernels.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+namespace Avx2
+{
+#include "Physics.h"
+#include "BatchKernels.inl"
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const Batch::Kernels* Batch::kernelsAVX2()
+{
+    return &Avx2::kernels;
+}
+#else
+const Batch::Kernels* Batch::kernelsAVX2()
+{
+    return nullptr;
+}
+#endif
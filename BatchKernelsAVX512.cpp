@@ -0,0 +1,35 @@
+// Batch kernels built for AVX-512 (F, DQ, BW, VL). MSVC compiles this file with /arch:AVX512
+// (set per file in the project); GCC and Clang take the target below.
+#include "BatchKernels.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma")
+#endif
+
+namespace Avx512
+{
+#include "Physics.h"
+#include "BatchKernels.inl"
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const Batch::Kernels* Batch::kernelsAVX512()
+{
+    return &Avx512::kernels;
+}
+#else
+const Batch::Kernels* Batch::kernelsAVX512()
+{
+    return nullptr;
+}
+#endif
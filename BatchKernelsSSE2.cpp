@@ -0,0 +1,15 @@
+// Batch kernels built for the baseline target: SSE2 on x86-64, whatever the
+// compiler defaults to elsewhere. Always available.
+#include "BatchKernels.h"
+#include <cmath>
+
+namespace Baseline
+{
+#include "Physics.h"
+#include "BatchKernels.inl"
+}
+
+const Batch::Kernels* Batch::kernelsSSE2()
+{
+    return &Baseline::kernels;
+}
@@ -0,0 +1,338 @@
+// Accuracy versus cost for the pendulum integrators.
+//
+// Every integrator, timestep and precision is run on a set of standard single
+// and double pendulum cases without damping. Each run reports:
+//   energy_drift    max |E(t) - E(0)| over the run, relative to the energy
+//                   scale (m1 + m2) g L1 + m2 g L2
+//   divergence      max distance of the bob from a long double RK4 reference
+//                   at a much smaller timestep, relative to the total length
+//                   (MSVC's long double is double, which still leaves the
+//                   reference well below the errors being measured)
+//   reversal_error  distance of the bob from its start after integrating
+//                   forward, flipping the velocities and integrating back
+//   cpu_ms          best-of-reps wall time to integrate the horizon
+// and flags the runs on the error/cost Pareto front of each metric. With
+// --target the cheapest run per case meeting that error is summarized on
+// stderr. A run that blows up reports infinite errors. The auto integrator
+// is Physics::stepDoubleAuto: Euler, with the Rosenbrock path for stiff steps.
+//
+//   AccuracyBench [--horizon=5] [--reps=3] [--target=1e-3]
+//                 [--metric=divergence|energy|reversal] [--filter=substring]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Physics.h"
+
+namespace
+{
+    const long double Gravity = 9.81L;
+    const long double SampleInterval = 0.01L;
+
+    enum Method { Euler, RK2, RK4, Auto };
+    const char* methodName(Method m)
+    {
+        return m == Euler ? "euler" : m == RK2 ? "rk2" : m == RK4 ? "rk4" : "auto";
+    }
+
+    struct Case
+    {
+        const char* name;
+        bool isDouble;
+        long double theta1, theta2, omega1, omega2;
+        long double m1, m2, L1, L2;
+    };
+
+    const Case Cases[] = {
+        { "single-small", false, 0.3L, 0, 0, 0, 1, 0, 1, 0 },
+        { "single-large", false, 3.0L, 0, 0, 0, 1, 0, 1, 0 },
+        { "double-regular", true, 0.2L, 0.3L, 0, 0, 1, 1, 1, 1 },
+        { "double-chaotic", true, 2.0L, 2.5L, 0, 0, 1, 1, 1, 1 },
+        // Light upper bob under a heavy lower one: stiff whenever the links straighten
+        { "double-stiff", true, 0.5L, 1.0L, 0, 0, 0.1L, 1000, 0.1L, 2 },
+    };
+
+    template <typename Real>
+    struct State
+    {
+        Real theta1, theta2, omega1, omega2;
+    };
+
+    template <typename Real>
+    void advance(const Case& c, Method method, Real dt, size_t steps, State<Real>& s)
+    {
+        const Real g = (Real)Gravity, m1 = (Real)c.m1, m2 = (Real)c.m2, L1 = (Real)c.L1, L2 = (Real)c.L2;
+        const Real damping = 0;
+        if (!c.isDouble)
+        {
+            for (size_t n = 0; n < steps; ++n)
+            {
+                // A single pendulum is never stiff, so auto is Euler
+                if (method == Euler || method == Auto)
+                    Physics::stepSingle(s.theta1, s.omega1, L1, damping, g, dt);
+                else if (method == RK2)
+                    Physics::stepSingleRK2(s.theta1, s.omega1, L1, damping, g, dt);
+                else
+                    Physics::stepSingleRK4(s.theta1, s.omega1, L1, damping, g, dt);
+            }
+            return;
+        }
+        for (size_t n = 0; n < steps; ++n)
+        {
+            if (method == Euler)
+                Physics::stepDouble(s.theta1, s.theta2, s.omega1, s.omega2, m1, m2, L1, L2, damping, g, dt);
+            else if (method == RK2)
+                Physics::stepDoubleRK2(s.theta1, s.theta2, s.omega1, s.omega2, m1, m2, L1, L2, damping, g, dt);
+            else if (method == RK4)
+                Physics::stepDoubleRK4(s.theta1, s.theta2, s.omega1, s.omega2, m1, m2, L1, L2, damping, g, dt);
+            else
+                Physics::stepDoubleAuto(s.theta1, s.theta2, s.omega1, s.omega2, m1, m2, L1, L2, damping, g, dt);
+        }
+    }
+
+    template <typename Real>
+    long double energy(const Case& c, const State<Real>& s)
+    {
+        if (!c.isDouble)
+            return Physics::energySingle<long double>(s.theta1, s.omega1, c.m1, c.L1, Gravity);
+        return Physics::energyDouble<long double>(s.theta1, s.theta2, s.omega1, s.omega2, c.m1, c.m2, c.L1, c.L2, Gravity);
+    }
+
+    // Bob position, which unlike the angles does not jump when they wrap
+    template <typename Real>
+    void bob(const Case& c, const State<Real>& s, long double& x, long double& y)
+    {
+        x = c.L1 * std::sin((long double)s.theta1);
+        y = -c.L1 * std::cos((long double)s.theta1);
+        if (c.isDouble)
+        {
+            x += c.L2 * std::sin((long double)s.theta2);
+            y -= c.L2 * std::cos((long double)s.theta2);
+        }
+    }
+
+    template <typename Real>
+    long double distance(const Case& c, const State<Real>& a, const State<long double>& b)
+    {
+        long double ax, ay, bx, by;
+        bob(c, a, ax, ay);
+        bob(c, b, bx, by);
+        return std::hypot(ax - bx, ay - by) / (c.L1 + c.L2);
+    }
+
+    template <typename Real>
+    State<Real> initial(const Case& c)
+    {
+        return { (Real)c.theta1, (Real)c.theta2, (Real)c.omega1, (Real)c.omega2 };
+    }
+
+    // Reference states at every sample time
+    std::vector<State<long double>> reference(const Case& c, size_t samples, long double dt)
+    {
+        std::vector<State<long double>> out;
+        State<long double> s = initial<long double>(c);
+        const size_t per = (size_t)std::llround(SampleInterval / dt);
+        out.push_back(s);
+        for (size_t i = 0; i < samples; ++i)
+        {
+            advance(c, RK4, dt, per, s);
+            out.push_back(s);
+        }
+        return out;
+    }
+
+    struct Result
+    {
+        const Case* c;
+        Method method;
+        const char* precision;
+        double dt;
+        size_t steps;
+        double cpuMs, energyDrift, divergence, reversal;
+        bool pareto[3];
+    };
+
+    template <typename Real>
+    Result measure(const Case& c, Method method, double dt, size_t samples, int reps,
+                   const std::vector<State<long double>>& ref)
+    {
+        Result r = {};
+        r.c = &c;
+        r.method = method;
+        r.precision = sizeof(Real) == sizeof(float) ? "float" : "double";
+        r.dt = dt;
+        const size_t per = (size_t)std::llround((double)SampleInterval / dt);
+        r.steps = per * samples;
+
+        // Error along the trajectory
+        const long double scale = ((c.m1 + c.m2) * c.L1 + c.m2 * c.L2) * Gravity;
+        State<Real> s = initial<Real>(c);
+        const long double e0 = energy(c, s);
+        for (size_t i = 1; i <= samples; ++i)
+        {
+            advance(c, method, (Real)dt, per, s);
+            double drift = (double)(std::fabs(energy(c, s) - e0) / scale);
+            if (!std::isfinite(drift))
+            {
+                r.energyDrift = r.divergence = INFINITY;
+                break;
+            }
+            r.energyDrift = std::max(r.energyDrift, drift);
+            r.divergence = std::max(r.divergence, (double)distance(c, s, ref[i]));
+        }
+
+        // Time reversal: flip the velocities and run the same number of steps back
+        s.omega1 = -s.omega1;
+        s.omega2 = -s.omega2;
+        advance(c, method, (Real)dt, r.steps, s);
+        r.reversal = (double)distance(c, s, ref[0]);
+        if (!std::isfinite(r.reversal) || !std::isfinite(r.divergence))
+            r.reversal = INFINITY;
+
+        r.cpuMs = INFINITY;
+        for (int k = 0; k < reps; ++k)
+        {
+            State<Real> t = initial<Real>(c);
+            auto t0 = std::chrono::steady_clock::now();
+            advance(c, method, (Real)dt, r.steps, t);
+            auto t1 = std::chrono::steady_clock::now();
+            // Keep the result alive so the loop is not optimized away
+            volatile Real sink = t.theta1 + t.theta2;
+            (void)sink;
+            r.cpuMs = std::min(r.cpuMs, std::chrono::duration<double, std::milli>(t1 - t0).count());
+        }
+        return r;
+    }
+
+    double metric(const Result& r, int m)
+    {
+        return m == 0 ? r.divergence : m == 1 ? r.energyDrift : r.reversal;
+    }
+
+    // A run is on the front when no other run of the same case is at least as
+    // accurate and at least as cheap, and strictly better in one of the two.
+    void markPareto(std::vector<Result>& results)
+    {
+        for (Result& a : results)
+        {
+            for (int m = 0; m < 3; ++m)
+            {
+                a.pareto[m] = true;
+                for (const Result& b : results)
+                {
+                    if (b.c != a.c || &a == &b)
+                        continue;
+                    bool noWorse = metric(b, m) <= metric(a, m) && b.cpuMs <= a.cpuMs;
+                    bool better = metric(b, m) < metric(a, m) || b.cpuMs < a.cpuMs;
+                    if (noWorse && better)
+                    {
+                        a.pareto[m] = false;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    double horizon = 5.0;
+    int reps = 3;
+    double target = 0.0;
+    int targetMetric = 0;
+    std::string filter;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        try
+        {
+            if (arg.compare(0, 10, "--horizon=") == 0)
+                horizon = std::max((double)SampleInterval, std::stod(arg.substr(10)));
+            else if (arg.compare(0, 7, "--reps=") == 0)
+                reps = std::max(1, std::stoi(arg.substr(7)));
+            else if (arg.compare(0, 9, "--target=") == 0)
+                target = std::stod(arg.substr(9));
+            else if (arg == "--metric=divergence")
+                targetMetric = 0;
+            else if (arg == "--metric=energy")
+                targetMetric = 1;
+            else if (arg == "--metric=reversal")
+                targetMetric = 2;
+            else if (arg.compare(0, 9, "--filter=") == 0)
+                filter = arg.substr(9);
+            else
+            {
+                std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+                return 1;
+            }
+        }
+        catch (const std::exception&)
+        {
+            std::fprintf(stderr, "Bad value in %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    const double timesteps[] = { 1e-2, 5e-3, 2e-3, 1e-3, 5e-4, 2e-4, 1e-4 };
+    const Method methods[] = { Euler, RK2, RK4, Auto };
+    const long double refDt = 1e-5L;
+    const size_t samples = (size_t)std::llround(horizon / (double)SampleInterval);
+
+    std::vector<Result> results;
+    for (const Case& c : Cases)
+    {
+        if (!filter.empty() && std::string(c.name).find(filter) == std::string::npos)
+            continue;
+
+        std::vector<State<long double>> ref = reference(c, samples, refDt);
+        // Halving the reference step shows how far the reference itself can be trusted
+        std::vector<State<long double>> check = reference(c, samples, refDt / 2);
+        long double refError = 0;
+        for (size_t i = 0; i < ref.size(); ++i)
+            refError = std::max(refError, distance(c, check[i], ref[i]));
+        std::fprintf(stderr, "%s: reference error %.3Lg over %.2f s\n", c.name, refError, horizon);
+
+        for (Method m : methods)
+        {
+            for (double dt : timesteps)
+            {
+                results.push_back(measure<float>(c, m, dt, samples, reps, ref));
+                results.push_back(measure<double>(c, m, dt, samples, reps, ref));
+            }
+        }
+    }
+    markPareto(results);
+
+    std::printf("case,integrator,precision,dt,steps,cpu_ms,energy_drift,divergence,reversal_error,"
+                "pareto_divergence,pareto_energy,pareto_reversal\n");
+    for (const Result& r : results)
+    {
+        std::printf("%s,%s,%s,%g,%zu,%.4f,%.4e,%.4e,%.4e,%d,%d,%d\n",
+                    r.c->name, methodName(r.method), r.precision, r.dt, r.steps, r.cpuMs,
+                    r.energyDrift, r.divergence, r.reversal, r.pareto[0], r.pareto[1], r.pareto[2]);
+    }
+
+    if (target > 0.0)
+    {
+        const char* metricName = targetMetric == 0 ? "divergence" : targetMetric == 1 ? "energy drift" : "reversal error";
+        for (const Case& c : Cases)
+        {
+            const Result* best = nullptr;
+            for (const Result& r : results)
+                if (r.c == &c && metric(r, targetMetric) <= target && (!best || r.cpuMs < best->cpuMs))
+                    best = &r;
+            if (best)
+                std::fprintf(stderr, "%s: cheapest with %s <= %g is %s/%s dt=%g (%.3f ms)\n", c.name, metricName,
+                             target, methodName(best->method), best->precision, best->dt, best->cpuMs);
+            else if (std::any_of(results.begin(), results.end(), [&](const Result& r) { return r.c == &c; }))
+                std::fprintf(stderr, "%s: no run reaches %s <= %g\n", c.name, metricName, target);
+        }
+    }
+    return 0;
+}
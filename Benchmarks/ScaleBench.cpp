@@ -0,0 +1,442 @@
+// End-to-end scaling benchmark for the frame pipeline.
+//
+// Each frame steps an ensemble of double pendulums with the batch kernel,
+// samples their trails, generates line-strip vertices for every rod and
+// trail, and rasterizes them into a hidden OpenGL window. The first three
+// stages are split across a thread pool; rasterization stays on the thread
+// that owns the context, as in the app. Bobs are not drawn.
+//
+// Strong scaling keeps the ensemble fixed and adds threads; weak scaling
+// grows the ensemble with the thread count. Efficiency is the one-thread
+// time over threads times the measured time (strong) or over the measured
+// time (weak). Sizes step by 10x from --min to --max; configurations whose
+// estimated memory exceeds --memory-mb are skipped with a note on stderr.
+// Results are CSV on stdout.
+//
+//   ScaleBench [--min=1000] [--max=10000000] [--threads=1,2,4,...]
+//              [--mode=strong|weak|both] [--frames=20] [--warmup=3]
+//              [--trail=64] [--trail-every=1] [--memory-mb=8192] [--no-render]
+//              [--isa=sse2|avx2|avx512]
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Cpu.h"
+#include "Ensemble.h"
+#include "ThreadPool.h"
+#include "Trail.h"
+
+namespace
+{
+    const float Damping = 0.05f;
+    const float Gravity = 9.807f;
+    // The app's fixed physics step and trail sample interval at 60 Hz
+    const float Dt = 0.001f;
+    const size_t StepsPerSample = 10;
+    const size_t SamplesPerFrame = 2;
+    const int Width = 1280, Height = 720;
+
+    struct Options
+    {
+        size_t minSize = 1000;
+        size_t maxSize = 10000000;
+        std::vector<size_t> threads;
+        bool strong = true;
+        bool weak = true;
+        int frames = 20;
+        int warmup = 3;
+        size_t trail = 64;
+        size_t trailEvery = 1;
+        size_t memoryMb = 8192;
+        bool render = true;
+    };
+
+    struct Timing
+    {
+        double frame = 0, simulate = 0, vertices = 0, raster = 0;
+        size_t vertexCount = 0;
+    };
+
+    // Per-worker vertex output: one line strip per rod pair and trail
+    struct Strips
+    {
+        std::vector<std::pair<float, float>> xy;
+        std::vector<GLint> first;
+        std::vector<GLsizei> count;
+        std::vector<std::pair<float, float>> scratch;
+    };
+
+    struct Workload
+    {
+        Ensemble ensemble;
+        DoubleColumns columns;
+        std::vector<TrailHistory> trails;
+        std::vector<Strips> strips;
+        size_t trailEvery = 1;
+
+        Workload(size_t n, const Options& o, ThreadPool& pool)
+        {
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+            ensemble.reserve(0, n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                // Lay the pivots out on a grid so the strips cover the viewport
+                float px = -1.6f + 3.2f * (float)(i % 64) / 63.0f;
+                float py = 0.8f - 1.6f * (float)(i / 64 % 36) / 35.0f;
+                ensemble.addDouble(angle(rng), angle(rng), 0.0f, 0.0f, 1.0f, 1.0f, 0.03f, 0.02f, px, py);
+            }
+            columns = ensemble.doubles();
+            trailEvery = o.trailEvery;
+            trails.resize((n + trailEvery - 1) / trailEvery);
+            size_t samples = o.trail;
+            pool.forRanges(trails.size(), [&](size_t begin, size_t end) {
+                for (size_t t = begin; t < end; ++t)
+                    trails[t].setMaxSamples(samples);
+            });
+            strips.resize(pool.size());
+        }
+
+        void simulate(size_t begin, size_t end)
+        {
+            const DoubleColumns& c = columns;
+            for (size_t s = 0; s < SamplesPerFrame; ++s)
+            {
+                Batch::stepDoubles(c, begin, end, Damping, Gravity, Dt, StepsPerSample);
+                for (size_t i = (begin + trailEvery - 1) / trailEvery * trailEvery; i < end; i += trailEvery)
+                {
+                    float x2 = c.px[i] + c.L1[i] * std::sin(c.theta1[i]) + c.L2[i] * std::sin(c.theta2[i]);
+                    float y2 = c.py[i] - c.L1[i] * std::cos(c.theta1[i]) - c.L2[i] * std::cos(c.theta2[i]);
+                    trails[i / trailEvery].push(x2, y2, c.px[i], c.py[i], c.L1[i] + c.L2[i]);
+                }
+            }
+        }
+
+        void buildVertices(size_t worker, size_t begin, size_t end)
+        {
+            const DoubleColumns& c = columns;
+            Strips& out = strips[worker];
+            out.xy.clear();
+            out.first.clear();
+            out.count.clear();
+            const float pixelSize = 2.0f / Height;
+            for (size_t i = begin; i < end; ++i)
+            {
+                float x1 = c.px[i] + c.L1[i] * std::sin(c.theta1[i]);
+                float y1 = c.py[i] - c.L1[i] * std::cos(c.theta1[i]);
+                out.first.push_back((GLint)out.xy.size());
+                out.count.push_back(3);
+                out.xy.emplace_back(c.px[i], c.py[i]);
+                out.xy.emplace_back(x1, y1);
+                out.xy.emplace_back(x1 + c.L2[i] * std::sin(c.theta2[i]), y1 - c.L2[i] * std::cos(c.theta2[i]));
+
+                if (i % trailEvery)
+                    continue;
+                size_t points = trails[i / trailEvery].collect(pixelSize, out.scratch);
+                if (points < 2)
+                    continue;
+                out.first.push_back((GLint)out.xy.size());
+                out.count.push_back((GLsizei)points);
+                out.xy.insert(out.xy.end(), out.scratch.begin(), out.scratch.end());
+            }
+        }
+
+        void rasterize()
+        {
+            glClear(GL_COLOR_BUFFER_BIT);
+            glEnableClientState(GL_VERTEX_ARRAY);
+            for (const Strips& s : strips)
+            {
+                if (s.xy.empty())
+                    continue;
+                glVertexPointer(2, GL_FLOAT, sizeof(s.xy[0]), s.xy.data());
+                for (size_t k = 0; k < s.first.size(); ++k)
+                    glDrawArrays(GL_LINE_STRIP, s.first[k], s.count[k]);
+            }
+            glDisableClientState(GL_VERTEX_ARRAY);
+            glFinish();
+        }
+    };
+
+    double msSince(std::chrono::steady_clock::time_point t0)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    // Median stage times over the measured frames
+    Timing runFrames(Workload& w, ThreadPool& pool, const Options& o, bool render)
+    {
+        std::vector<Timing> frames;
+        for (int f = 0; f < o.warmup + o.frames; ++f)
+        {
+            Timing t;
+            auto t0 = std::chrono::steady_clock::now();
+            pool.forRanges(w.columns.count, [&](size_t begin, size_t end) { w.simulate(begin, end); });
+            t.simulate = msSince(t0);
+
+            auto t1 = std::chrono::steady_clock::now();
+            pool.run([&](size_t worker, size_t workers) {
+                size_t n = w.columns.count;
+                w.buildVertices(worker, n * worker / workers, n * (worker + 1) / workers);
+            });
+            t.vertices = msSince(t1);
+
+            if (render)
+            {
+                auto t2 = std::chrono::steady_clock::now();
+                w.rasterize();
+                t.raster = msSince(t2);
+            }
+            t.frame = msSince(t0);
+            for (const Strips& s : w.strips)
+                t.vertexCount += s.xy.size();
+            if (f >= o.warmup)
+                frames.push_back(t);
+        }
+
+        auto median = [&](double Timing::*field) {
+            std::vector<double> v;
+            for (const Timing& t : frames)
+                v.push_back(t.*field);
+            std::sort(v.begin(), v.end());
+            return v.size() % 2 ? v[v.size() / 2] : 0.5 * (v[v.size() / 2 - 1] + v[v.size() / 2]);
+        };
+        Timing m;
+        m.frame = median(&Timing::frame);
+        m.simulate = median(&Timing::simulate);
+        m.vertices = median(&Timing::vertices);
+        m.raster = median(&Timing::raster);
+        m.vertexCount = frames.back().vertexCount;
+        return m;
+    }
+
+    size_t estimateBytes(size_t n, const Options& o)
+    {
+        TrailHistory probe;
+        probe.setMaxSamples(o.trail);
+        size_t trails = (n + o.trailEvery - 1) / o.trailEvery;
+        size_t perTrail = sizeof(TrailHistory) + probe.memoryBytes();
+        size_t vertices = 3 * n + trails * o.trail;
+        // Ten float columns and the frozen flags, then one vertex buffer copy plus its scratch
+        return n * (10 * sizeof(float) + 1) + trails * perTrail + vertices * 2 * sizeof(std::pair<float, float>);
+    }
+
+    bool parseList(const char* text, std::vector<size_t>& out)
+    {
+        out.clear();
+        std::string s = text;
+        size_t pos = 0;
+        while (pos <= s.size())
+        {
+            size_t comma = s.find(',', pos);
+            if (comma == std::string::npos)
+                comma = s.size();
+            size_t v = std::stoull(s.substr(pos, comma - pos));
+            if (v == 0)
+                return false;
+            out.push_back(v);
+            pos = comma + 1;
+        }
+        return !out.empty();
+    }
+
+    bool parse(int argc, char** argv, Options& o)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](const char* key) -> const char* {
+                size_t len = std::strlen(key);
+                return arg.compare(0, len, key) == 0 ? arg.c_str() + len : nullptr;
+            };
+            try
+            {
+                if (const char* v = value("--min="))
+                    o.minSize = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--max="))
+                    o.maxSize = std::stoull(v);
+                else if (const char* v = value("--threads="))
+                {
+                    if (!parseList(v, o.threads))
+                    {
+                        std::fprintf(stderr, "Bad thread list %s\n", v);
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--mode="))
+                {
+                    std::string mode = v;
+                    o.strong = mode == "strong" || mode == "both";
+                    o.weak = mode == "weak" || mode == "both";
+                    if (!o.strong && !o.weak)
+                    {
+                        std::fprintf(stderr, "Unknown mode %s\n", v);
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--frames="))
+                    o.frames = std::max(1, std::stoi(v));
+                else if (const char* v = value("--warmup="))
+                    o.warmup = std::max(0, std::stoi(v));
+                else if (const char* v = value("--trail="))
+                    o.trail = std::max<size_t>(2, std::stoull(v));
+                else if (const char* v = value("--trail-every="))
+                    o.trailEvery = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--memory-mb="))
+                    o.memoryMb = std::stoull(v);
+                else if (const char* v = value("--isa="))
+                {
+                    std::string error;
+                    if (!Cpu::setLevel(v, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (arg == "--no-render")
+                    o.render = false;
+                else
+                {
+                    std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::fprintf(stderr, "Bad value in %s\n", arg.c_str());
+                return false;
+            }
+        }
+        if (o.threads.empty())
+        {
+            size_t hw = ThreadPool::hardwareThreads();
+            for (size_t t = 2; t < hw; t *= 2)
+                o.threads.push_back(t);
+            o.threads.push_back(hw);
+        }
+        // Efficiency is measured against one thread
+        o.threads.push_back(1);
+        std::sort(o.threads.begin(), o.threads.end());
+        o.threads.erase(std::unique(o.threads.begin(), o.threads.end()), o.threads.end());
+        return true;
+    }
+
+    GLFWwindow* openContext()
+    {
+        if (!glfwInit())
+            return nullptr;
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        GLFWwindow* window = glfwCreateWindow(Width, Height, "ScaleBench", nullptr, nullptr);
+        if (!window)
+        {
+            glfwTerminate();
+            return nullptr;
+        }
+        glfwMakeContextCurrent(window);
+        glewInit();
+        glViewport(0, 0, Width, Height);
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        glOrtho(-(double)Width / Height, (double)Width / Height, -1.0, 1.0, -1, 1);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        glColor3f(0.2f, 0.7f, 0.2f);
+        return window;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+        return 1;
+    std::fprintf(stderr, "Kernels: %s\n", Cpu::report().c_str());
+
+    GLFWwindow* window = options.render ? openContext() : nullptr;
+    if (options.render && !window)
+        std::fprintf(stderr, "No OpenGL context, rasterization is not measured\n");
+
+    std::printf("mode,pendulums,threads,frames,frame_ms,simulate_ms,vertices_ms,raster_ms,"
+                "vertices,mpendulums_per_sec,speedup,efficiency\n");
+
+    // One-thread frame times by ensemble size, the baseline for both modes
+    std::vector<std::pair<size_t, double>> baseline;
+    auto baselineFor = [&](size_t n) {
+        for (auto& b : baseline)
+            if (b.first == n)
+                return b.second;
+        return 0.0;
+    };
+
+    auto measure = [&](const char* mode, size_t n, size_t threads, double reference) {
+        size_t bytes = estimateBytes(n, options);
+        if (bytes > options.memoryMb << 20)
+        {
+            std::fprintf(stderr, "Skipping %s %zu pendulums: about %zu MB needed, raise --memory-mb or --trail-every\n",
+                         mode, n, bytes >> 20);
+            return 0.0;
+        }
+        ThreadPool pool(threads);
+        Workload workload(n, options, pool);
+        Timing t = runFrames(workload, pool, options, window != nullptr);
+        if (threads == 1)
+            baseline.emplace_back(n, t.frame);
+        double speedup = reference > 0.0 ? reference / t.frame : 1.0;
+        double efficiency = std::strcmp(mode, "strong") == 0 ? speedup / threads : speedup;
+        if (std::strcmp(mode, "weak") == 0)
+            speedup *= threads;
+        std::printf("%s,%zu,%zu,%d,%.3f,%.3f,%.3f,%.3f,%zu,%.3f,%.3f,%.3f\n",
+                    mode, n, threads, options.frames, t.frame, t.simulate, t.vertices, t.raster,
+                    t.vertexCount, n / (t.frame * 1e3), speedup, efficiency);
+        std::fflush(stdout);
+        return t.frame;
+    };
+
+    std::vector<size_t> sizes;
+    for (size_t n = options.minSize; n <= options.maxSize; n *= 10)
+        sizes.push_back(n);
+
+    if (options.strong)
+    {
+        for (size_t n : sizes)
+        {
+            double reference = 0.0;
+            for (size_t threads : options.threads)
+            {
+                double t = measure("strong", n, threads, reference);
+                if (threads == 1)
+                    reference = t;
+            }
+        }
+    }
+
+    if (options.weak)
+    {
+        // Each base size is the work of one thread; the ensemble grows with the pool
+        for (size_t base : sizes)
+        {
+            double reference = baselineFor(base);
+            for (size_t threads : options.threads)
+            {
+                if (base * threads > options.maxSize)
+                    break;
+                double t = measure("weak", base * threads, threads, reference);
+                if (threads == 1 && reference == 0.0)
+                    reference = t;
+            }
+        }
+    }
+
+    if (window)
+        glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,360 @@
+// Microbenchmarks for the pendulum step kernels.
+//
+// Measures nanoseconds per pendulum-step for the object path used by the GUI
+// (virtual update per pendulum per step) and the batch kernels, for both
+// pendulum kinds, in float and double, over ensembles from L1-resident to
+// DRAM-resident, plus the IMEX batch kernel for stiff elastic pendulums.
+// Results are CSV on stdout (or JSON with --json). The batch kernels run on
+// the build CPUID picks unless --isa forces a lower one.
+//
+//   StepBench [--min=256] [--max=4194304] [--reps=7] [--warmup=1]
+//             [--work=20000000] [--filter=substring] [--json]
+//             [--isa=sse2|avx2|avx512]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "Cpu.h"
+#include "Ensemble.h"
+#include "Pendulums.h"
+
+namespace
+{
+    const float Damping = 0.05f;
+    const float Gravity = 9.807f;
+    const float Dt = 0.001f;
+
+    struct Options
+    {
+        size_t minSize = 256;
+        size_t maxSize = 4u << 20;
+        int reps = 7;
+        int warmup = 1;
+        double work = 2e7;
+        std::string filter;
+        bool json = false;
+    };
+
+    // One benchmark case: prepares an ensemble of n pendulums and returns a
+    // function that advances all of them by the given number of steps.
+    struct Case
+    {
+        const char* kind;
+        const char* precision;
+        const char* path;
+        const char* integrator;
+        size_t bytesPerPendulum;
+        std::function<std::function<void(size_t)>(size_t)> prepare;
+    };
+
+    template <typename Real>
+    struct SingleStore
+    {
+        std::vector<Real> theta, omega, m, L, px, py;
+        std::vector<uint8_t> frozen;
+        SingleColumnsT<Real> columns;
+
+        explicit SingleStore(size_t n)
+        {
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+            for (size_t i = 0; i < n; ++i)
+            {
+                theta.push_back(angle(rng));
+                omega.push_back(0);
+                m.push_back(1);
+                L.push_back((Real)0.5);
+                px.push_back(0);
+                py.push_back(0);
+                frozen.push_back(0);
+            }
+            columns = { n, theta.data(), omega.data(), m.data(), L.data(), px.data(), py.data(), frozen.data() };
+        }
+    };
+
+    template <typename Real>
+    struct DoubleStore
+    {
+        std::vector<Real> theta1, theta2, omega1, omega2, m1, m2, L1, L2, px, py;
+        std::vector<uint8_t> frozen;
+        DoubleColumnsT<Real> columns;
+
+        explicit DoubleStore(size_t n)
+        {
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+            for (size_t i = 0; i < n; ++i)
+            {
+                theta1.push_back(angle(rng));
+                theta2.push_back(angle(rng));
+                omega1.push_back(0);
+                omega2.push_back(0);
+                m1.push_back(1);
+                m2.push_back(1);
+                L1.push_back((Real)0.6);
+                L2.push_back((Real)0.4);
+                px.push_back(0);
+                py.push_back(0);
+                frozen.push_back(0);
+            }
+            columns = { n, theta1.data(), theta2.data(), omega1.data(), omega2.data(),
+                        m1.data(), m2.data(), L1.data(), L2.data(), px.data(), py.data(), frozen.data() };
+        }
+    };
+
+    // Springs of 10^4 N/m on unit masses, stiff enough that explicit Euler
+    // would need steps well under a millisecond
+    template <typename Real>
+    struct ElasticStore
+    {
+        std::vector<Real> theta, omega, r, vr, m, L, k, px, py;
+        std::vector<uint8_t> frozen;
+        ElasticColumnsT<Real> columns;
+
+        explicit ElasticStore(size_t n)
+        {
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+            for (size_t i = 0; i < n; ++i)
+            {
+                theta.push_back(angle(rng));
+                omega.push_back(0);
+                r.push_back((Real)0.5);
+                vr.push_back(0);
+                m.push_back(1);
+                L.push_back((Real)0.5);
+                k.push_back((Real)1e4);
+                px.push_back(0);
+                py.push_back(0);
+                frozen.push_back(0);
+            }
+            columns = { n, theta.data(), omega.data(), r.data(), vr.data(), m.data(), L.data(), k.data(),
+                        px.data(), py.data(), frozen.data() };
+        }
+    };
+
+    std::vector<std::shared_ptr<PendulumLike>> makeObjects(size_t n, bool doubles)
+    {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+        std::vector<std::shared_ptr<PendulumLike>> v;
+        v.reserve(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (doubles)
+                v.push_back(std::make_shared<DPendulum>(angle(rng), angle(rng), 1.0f, 1.0f, 0.6f, 0.4f));
+            else
+                v.push_back(std::make_shared<SPendulum>(angle(rng), 1.0f, 0.5f));
+        }
+        return v;
+    }
+
+    template <typename Real>
+    Case singleBatch(const char* precision, bool fused)
+    {
+        return { "single", precision, fused ? "batch-fused" : "batch", "euler", 6 * sizeof(Real) + 1,
+                 [fused](size_t n) {
+                     auto store = std::make_shared<SingleStore<Real>>(n);
+                     return std::function<void(size_t)>([store, fused](size_t steps) {
+                         const auto& c = store->columns;
+                         if (fused)
+                             Batch::stepSingles<Real>(c, 0, c.count, (Real)Damping, (Real)Gravity, (Real)Dt, steps);
+                         else
+                             for (size_t s = 0; s < steps; ++s)
+                                 Batch::stepSingles<Real>(c, 0, c.count, (Real)Damping, (Real)Gravity, (Real)Dt, 1);
+                     });
+                 } };
+    }
+
+    template <typename Real>
+    Case doubleBatch(const char* precision, bool fused)
+    {
+        return { "double", precision, fused ? "batch-fused" : "batch", "auto", 10 * sizeof(Real) + 1,
+                 [fused](size_t n) {
+                     auto store = std::make_shared<DoubleStore<Real>>(n);
+                     return std::function<void(size_t)>([store, fused](size_t steps) {
+                         const auto& c = store->columns;
+                         if (fused)
+                             Batch::stepDoubles<Real>(c, 0, c.count, (Real)Damping, (Real)Gravity, (Real)Dt, steps);
+                         else
+                             for (size_t s = 0; s < steps; ++s)
+                                 Batch::stepDoubles<Real>(c, 0, c.count, (Real)Damping, (Real)Gravity, (Real)Dt, 1);
+                     });
+                 } };
+    }
+
+    template <typename Real>
+    Case elasticBatch(const char* precision)
+    {
+        return { "elastic", precision, "batch-fused", "imex", 9 * sizeof(Real) + 1,
+                 [](size_t n) {
+                     auto store = std::make_shared<ElasticStore<Real>>(n);
+                     return std::function<void(size_t)>([store](size_t steps) {
+                         const auto& c = store->columns;
+                         Batch::stepElastics<Real>(c, 0, c.count, (Real)Damping, (Real)Gravity, (Real)Dt, steps);
+                     });
+                 } };
+    }
+
+    Case objects(bool doubles)
+    {
+        return { doubles ? "double" : "single", "float", "object", doubles ? "auto" : "euler",
+                 doubles ? sizeof(DPendulum) : sizeof(SPendulum),
+                 [doubles](size_t n) {
+                     auto v = std::make_shared<std::vector<std::shared_ptr<PendulumLike>>>(makeObjects(n, doubles));
+                     return std::function<void(size_t)>([v](size_t steps) {
+                         for (size_t s = 0; s < steps; ++s)
+                             for (auto& p : *v)
+                                 p->update(Damping, Gravity, Dt);
+                     });
+                 } };
+    }
+
+    struct Stats
+    {
+        double mean, stddev, min, median;
+    };
+
+    Stats summarize(std::vector<double> v)
+    {
+        Stats s = {};
+        for (double x : v)
+            s.mean += x;
+        s.mean /= v.size();
+        for (double x : v)
+            s.stddev += (x - s.mean) * (x - s.mean);
+        s.stddev = v.size() > 1 ? std::sqrt(s.stddev / (v.size() - 1)) : 0.0;
+        std::sort(v.begin(), v.end());
+        s.min = v.front();
+        s.median = v.size() % 2 ? v[v.size() / 2] : 0.5 * (v[v.size() / 2 - 1] + v[v.size() / 2]);
+        return s;
+    }
+
+    bool parse(int argc, char** argv, Options& o)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](const char* key) -> const char* {
+                size_t len = std::strlen(key);
+                return arg.compare(0, len, key) == 0 ? arg.c_str() + len : nullptr;
+            };
+            try
+            {
+                if (const char* v = value("--min="))
+                    o.minSize = std::stoull(v);
+                else if (const char* v = value("--max="))
+                    o.maxSize = std::stoull(v);
+                else if (const char* v = value("--reps="))
+                    o.reps = std::max(1, std::stoi(v));
+                else if (const char* v = value("--warmup="))
+                    o.warmup = std::max(0, std::stoi(v));
+                else if (const char* v = value("--work="))
+                    o.work = std::stod(v);
+                else if (const char* v = value("--filter="))
+                    o.filter = v;
+                else if (const char* v = value("--isa="))
+                {
+                    std::string error;
+                    if (!Cpu::setLevel(v, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (arg == "--json")
+                    o.json = true;
+                else
+                {
+                    std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::fprintf(stderr, "Bad value in %s\n", arg.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+        return 1;
+    std::fprintf(stderr, "Kernels: %s\n", Cpu::report().c_str());
+
+    std::vector<Case> cases = {
+        objects(false), objects(true),
+        singleBatch<float>("float", false), singleBatch<double>("double", false),
+        doubleBatch<float>("float", false), doubleBatch<double>("double", false),
+        singleBatch<float>("float", true), singleBatch<double>("double", true),
+        doubleBatch<float>("float", true), doubleBatch<double>("double", true),
+        elasticBatch<float>("float"), elasticBatch<double>("double"),
+    };
+
+    if (options.json)
+        std::printf("[\n");
+    else
+        std::printf("kind,precision,path,integrator,pendulums,working_set_bytes,steps,reps,"
+                    "ns_per_step_mean,ns_per_step_stddev,ns_per_step_min,ns_per_step_median,msteps_per_sec\n");
+
+    bool first = true;
+    for (const Case& c : cases)
+    {
+        std::string name = std::string(c.kind) + "/" + c.precision + "/" + c.path + "/" + c.integrator;
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+            continue;
+
+        for (size_t n = options.minSize; n <= options.maxSize; n *= 4)
+        {
+            // Keep the work per repetition roughly constant across sizes
+            size_t steps = std::max<size_t>(1, (size_t)(options.work / n));
+            auto run = c.prepare(n);
+            for (int w = 0; w < options.warmup; ++w)
+                run(steps);
+
+            std::vector<double> ns;
+            for (int r = 0; r < options.reps; ++r)
+            {
+                auto t0 = std::chrono::steady_clock::now();
+                run(steps);
+                auto t1 = std::chrono::steady_clock::now();
+                ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / ((double)n * steps));
+            }
+            Stats s = summarize(ns);
+
+            if (options.json)
+            {
+                std::printf("%s  {\"kind\": \"%s\", \"precision\": \"%s\", \"path\": \"%s\", \"integrator\": \"%s\", "
+                            "\"pendulums\": %zu, \"working_set_bytes\": %zu, \"steps\": %zu, \"reps\": %d, "
+                            "\"ns_per_step_mean\": %.4f, \"ns_per_step_stddev\": %.4f, \"ns_per_step_min\": %.4f, "
+                            "\"ns_per_step_median\": %.4f, \"msteps_per_sec\": %.3f}",
+                            first ? "" : ",\n", c.kind, c.precision, c.path, c.integrator, n, n * c.bytesPerPendulum,
+                            steps, options.reps, s.mean, s.stddev, s.min, s.median, 1e3 / s.mean);
+            }
+            else
+            {
+                std::printf("%s,%s,%s,%s,%zu,%zu,%zu,%d,%.4f,%.4f,%.4f,%.4f,%.3f\n",
+                            c.kind, c.precision, c.path, c.integrator, n, n * c.bytesPerPendulum,
+                            steps, options.reps, s.mean, s.stddev, s.min, s.median, 1e3 / s.mean);
+            }
+            std::fflush(stdout);
+            first = false;
+        }
+    }
+
+    if (options.json)
+        std::printf("\n]\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "Bifurcation.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include "Ensemble.h"
+#include "ImageFile.h"
+#include "Physics.h"
+#include "Trace.h"
+
+double Bifurcation::Diagram::amplitude(size_t column) const
+{
+    const Options& o = options;
+    if (o.columns < 2)
+        return o.amplitudeMin;
+    return o.amplitudeMin + (o.amplitudeMax - o.amplitudeMin) * column / (o.columns - 1);
+}
+
+Bifurcation::Diagram Bifurcation::run(const Options& options, ThreadPool& pool)
+{
+    TRACE_ZONE("Bifurcation diagram");
+    Diagram diagram;
+    diagram.options = options;
+    Options& o = diagram.options;
+    o.columns = std::max<size_t>(o.columns, 1);
+    o.starts = std::max<size_t>(o.starts, 1);
+    o.samples = std::max<size_t>(o.samples, 1);
+    o.stepsPerPeriod = std::max<size_t>(o.stepsPerPeriod, 1);
+
+    const size_t count = o.columns * o.starts;
+    Ensemble ensemble;
+    ensemble.reserve(0, 0, count);
+    for (size_t c = 0; c < o.columns; ++c)
+    {
+        float amplitude = (float)diagram.amplitude(c);
+        for (size_t k = 0; k < o.starts; ++k)
+        {
+            float theta = Physics::wrapAngle(o.theta0 + (float)(2.0 * M_PI * k / o.starts));
+            ensemble.addDriven(theta, o.omega0, 1.0f, o.L, amplitude, o.frequency);
+        }
+    }
+    DrivenColumns columns = ensemble.drivens();
+    diagram.theta.resize(count * o.samples);
+    diagram.omega.resize(count * o.samples);
+
+    // A whole number of steps per period puts every strobe at the same drive phase
+    const float dt = (float)(2.0 * M_PI / o.frequency / o.stepsPerPeriod);
+    pool.forRanges(count, [&](size_t begin, size_t end) {
+        TRACE_ZONE("Bifurcation range");
+        Batch::stepDrivens(columns, begin, end, o.damping, o.g, dt, o.transient * o.stepsPerPeriod);
+        for (size_t s = 0; s < o.samples; ++s)
+        {
+            Batch::stepDrivens(columns, begin, end, o.damping, o.g, dt, o.stepsPerPeriod);
+            for (size_t i = begin; i < end; ++i)
+            {
+                diagram.theta[i * o.samples + s] = columns.theta[i];
+                diagram.omega[i * o.samples + s] = columns.omega[i];
+            }
+        }
+    });
+    return diagram;
+}
+
+bool Bifurcation::writeImage(const Diagram& diagram, Variable variable, size_t height, const std::string& path,
+                             std::string& error)
+{
+    const std::vector<float>& values = variable == Theta ? diagram.theta : diagram.omega;
+    const size_t width = diagram.options.columns, per = diagram.perColumn();
+    height = std::max<size_t>(height, 2);
+
+    // Angles span the circle, velocities what the pendulums reached
+    float low = -(float)M_PI, high = (float)M_PI;
+    if (variable == Omega && !values.empty())
+    {
+        auto range = std::minmax_element(values.begin(), values.end());
+        float margin = std::max(1e-3f, (*range.second - *range.first) * 0.02f);
+        low = *range.first - margin;
+        high = *range.second + margin;
+    }
+
+    std::vector<uint32_t> counts(width * height, 0);
+    const float scale = (height - 1) / (high - low);
+    for (size_t c = 0; c < width; ++c)
+        for (size_t i = 0; i < per; ++i)
+        {
+            float v = values[c * per + i];
+            if (!(v >= low && v <= high))
+                continue;
+            size_t row = height - 1 - (size_t)((v - low) * scale + 0.5f);
+            ++counts[row * width + c];
+        }
+    std::vector<uint8_t> pixels;
+    ImageFile::logScale(counts.data(), counts.size(), pixels);
+    return ImageFile::writePgm(path, width, height, pixels.data(), error);
+}
+
+bool Bifurcation::writeCsv(const Diagram& diagram, const std::string& path, std::string& error)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+    {
+        error = "Cannot create " + path;
+        return false;
+    }
+    const Options& o = diagram.options;
+    out << "amplitude,start,sample,theta,omega\n";
+    char line[128];
+    for (size_t c = 0; c < o.columns; ++c)
+    {
+        double amplitude = diagram.amplitude(c);
+        for (size_t k = 0; k < o.starts; ++k)
+            for (size_t s = 0; s < o.samples; ++s)
+            {
+                size_t i = (c * o.starts + k) * o.samples + s;
+                std::snprintf(line, sizeof(line), "%.9g,%zu,%zu,%.7g,%.7g\n", amplitude, k, s, diagram.theta[i],
+                              diagram.omega[i]);
+                out << line;
+            }
+    }
+    if (!out)
+    {
+        error = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
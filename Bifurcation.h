@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "ThreadPool.h"
+
+// Bifurcation diagrams of the driven damped pendulum. Every column of the
+// diagram is one drive amplitude; its pendulums run on the batch kernels
+// (Batch::stepDrivens) through a transient that is thrown away, then are
+// strobed once per drive period. Columns are independent, so they are
+// spread over the thread pool in contiguous ranges.
+namespace Bifurcation
+{
+    enum Variable
+    {
+        Theta, Omega
+    };
+
+    // Defaults are the classic diagram in natural units: g/L = 1, damping
+    // 0.5, drive frequency 2/3 and amplitudes across the route to chaos.
+    struct Options
+    {
+        double amplitudeMin = 0.9, amplitudeMax = 1.5;
+        size_t columns = 4000;
+        // Starting angles per column, spread over the circle from theta0, so
+        // coexisting attractors all show up
+        size_t starts = 1;
+        float theta0 = 0.2f, omega0 = 0.0f;
+        float frequency = 2.0f / 3.0f;
+        float damping = 0.5f, g = 1.0f, L = 1.0f;
+        size_t stepsPerPeriod = 200;
+        // Drive periods discarded, then strobed
+        size_t transient = 300;
+        size_t samples = 200;
+    };
+
+    struct Diagram
+    {
+        Options options;
+        // Strobed states, column by column, each column starts x samples
+        std::vector<float> theta, omega;
+
+        size_t perColumn() const { return options.starts * options.samples; }
+        double amplitude(size_t column) const;
+    };
+
+    Diagram run(const Options& options, ThreadPool& pool);
+
+    // One pixel column per diagram column, the variable from bottom to top,
+    // log-scaled hit counts
+    bool writeImage(const Diagram& diagram, Variable variable, size_t height, const std::string& path,
+                    std::string& error);
+    // amplitude,start,sample,theta,omega rows
+    bool writeCsv(const Diagram& diagram, const std::string& path, std::string& error);
+}
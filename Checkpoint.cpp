@@ -0,0 +1,256 @@
+#include "Checkpoint.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char Magic[8] = { 'P', 'E', 'N', 'D', 'C', 'K', 'P', '1' };
+
+    uint64_t checksum(const uint8_t* data, size_t size)
+    {
+        uint64_t h = 1469598103934665603ull;
+        for (size_t i = 0; i < size; ++i)
+            h = (h ^ data[i]) * 1099511628211ull;
+        return h;
+    }
+
+#ifdef _WIN32
+
+    uint64_t fileSize(std::FILE* file)
+    {
+        __int64 size = _filelengthi64(_fileno(file));
+        return size < 0 ? 0 : (uint64_t)size;
+    }
+
+    bool writeDurably(const std::string& path, const Checkpoint::Header& header, const std::vector<uint8_t>& payload,
+                      std::string& error)
+    {
+        std::string temporary = path + ".tmp";
+        HANDLE file = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            error = "Cannot create " + temporary;
+            return false;
+        }
+        bool ok = true;
+        auto put = [&](const void* data, size_t size) {
+            const uint8_t* p = static_cast<const uint8_t*>(data);
+            while (ok && size)
+            {
+                DWORD chunk = (DWORD)std::min<size_t>(size, 1u << 30), done = 0;
+                ok = WriteFile(file, p, chunk, &done, nullptr) && done == chunk;
+                p += chunk;
+                size -= chunk;
+            }
+        };
+        put(&header, sizeof(header));
+        put(payload.data(), payload.size());
+        ok = ok && FlushFileBuffers(file);
+        CloseHandle(file);
+        if (!ok || !MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            DeleteFileA(temporary.c_str());
+            error = "Failed writing " + path;
+            return false;
+        }
+        return true;
+    }
+
+#else
+
+    uint64_t fileSize(std::FILE* file)
+    {
+        struct stat st;
+        return fstat(fileno(file), &st) == 0 ? (uint64_t)st.st_size : 0;
+    }
+
+    bool writeDurably(const std::string& path, const Checkpoint::Header& header, const std::vector<uint8_t>& payload,
+                      std::string& error)
+    {
+        std::string temporary = path + ".tmp";
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            error = "Cannot create " + temporary;
+            return false;
+        }
+        bool ok = true;
+        auto put = [&](const void* data, size_t size) {
+            const uint8_t* p = static_cast<const uint8_t*>(data);
+            while (ok && size)
+            {
+                ssize_t n = ::write(fd, p, size);
+                ok = n > 0;
+                if (ok)
+                {
+                    p += n;
+                    size -= (size_t)n;
+                }
+            }
+        };
+        put(&header, sizeof(header));
+        put(payload.data(), payload.size());
+        // The data has to be on disk before the rename makes it the checkpoint
+        ok = ok && fsync(fd) == 0;
+        ok = ::close(fd) == 0 && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            ::unlink(temporary.c_str());
+            error = "Failed writing " + path;
+            return false;
+        }
+
+        // And the rename itself survives a crash once the directory is synced
+        size_t slash = path.rfind('/');
+        std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        int dir = ::open(directory.c_str(), O_RDONLY);
+        if (dir >= 0)
+        {
+            fsync(dir);
+            ::close(dir);
+        }
+        return true;
+    }
+
+#endif
+}
+
+bool Checkpoint::writeFile(const std::string& path, const std::vector<uint8_t>& payload, std::string& error)
+{
+    TRACE_ZONE("Write checkpoint");
+    Header header = {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.headerSize = sizeof(Header);
+    header.payloadBytes = payload.size();
+    header.checksum = checksum(payload.data(), payload.size());
+    return writeDurably(path, header, payload, error);
+}
+
+bool Checkpoint::readFile(const std::string& path, std::vector<uint8_t>& payload, std::string& error)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        error = "Cannot open " + path;
+        return false;
+    }
+    Header header = {};
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.magic, Magic, sizeof(Magic)) == 0;
+    if (!ok)
+    {
+        std::fclose(file);
+        error = path + " is not a checkpoint";
+        return false;
+    }
+    if (header.version != Version || header.headerSize != sizeof(Header))
+    {
+        std::fclose(file);
+        error = path + " has unsupported checkpoint version " + std::to_string(header.version);
+        return false;
+    }
+    // A corrupt size must not become a huge allocation before the read fails
+    const uint64_t size = fileSize(file);
+    if (size < sizeof(header) || header.payloadBytes > size - sizeof(header))
+    {
+        std::fclose(file);
+        error = path + " is truncated or corrupt";
+        return false;
+    }
+    payload.resize((size_t)header.payloadBytes);
+    ok = payload.empty() || std::fread(payload.data(), payload.size(), 1, file) == 1;
+    std::fclose(file);
+    if (!ok || checksum(payload.data(), payload.size()) != header.checksum)
+    {
+        error = path + " is truncated or corrupt";
+        return false;
+    }
+    return true;
+}
+
+Checkpoint::BackgroundWriter::BackgroundWriter()
+{
+    thread = std::thread(&BackgroundWriter::run, this);
+}
+
+Checkpoint::BackgroundWriter::~BackgroundWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+bool Checkpoint::BackgroundWriter::submit(const std::string& target, std::vector<uint8_t>& snapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending)
+            return false;
+        buffer.swap(snapshot);
+        path = target;
+        pending = true;
+    }
+    wake.notify_all();
+    return true;
+}
+
+void Checkpoint::BackgroundWriter::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [&] { return !pending; });
+}
+
+bool Checkpoint::BackgroundWriter::busy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending;
+}
+
+uint64_t Checkpoint::BackgroundWriter::written()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+}
+
+std::string Checkpoint::BackgroundWriter::lastError()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return error;
+}
+
+void Checkpoint::BackgroundWriter::run()
+{
+    TRACE_THREAD("Checkpoint writer");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [&] { return pending || stopping; });
+        if (!pending)
+            return;
+        // The buffer and path are ours until pending is cleared
+        lock.unlock();
+        std::string message;
+        bool ok = writeFile(path, buffer, message);
+        lock.lock();
+        if (ok)
+            ++count;
+        else
+            error = message;
+        pending = false;
+        idle.notify_all();
+    }
+}
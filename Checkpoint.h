@@ -0,0 +1,149 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Checkpoints of a run's full state for restarting after pre-emption.
+//
+// The simulation serializes its state into a byte buffer, which costs a
+// copy proportional to the state and nothing more, and hands the buffer to
+// a background thread that checksums it and writes it to disk. The file is
+// written under a temporary name, synced and renamed over the previous
+// checkpoint, so the path always holds one complete checkpoint. Reading it
+// back restores the state bit for bit.
+namespace Checkpoint
+{
+    const uint32_t Version = 1;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t payloadBytes;
+        // FNV-1a over the payload
+        uint64_t checksum;
+    };
+
+    // Appends plain values and arrays to a buffer. clear() keeps the
+    // capacity, so taking the same snapshot again does not allocate.
+    class Writer
+    {
+    public:
+        explicit Writer(std::vector<uint8_t>& out) : out(out) {}
+
+        void bytes(const void* data, size_t size)
+        {
+            size_t at = out.size();
+            out.resize(at + size);
+            if (size)
+                std::memcpy(out.data() + at, data, size);
+        }
+
+        template <typename T>
+        void pod(const T& value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "plain data only");
+            bytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        void array(const std::vector<T>& values)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "plain data only");
+            pod<uint64_t>(values.size());
+            bytes(values.data(), values.size() * sizeof(T));
+        }
+
+    private:
+        std::vector<uint8_t>& out;
+    };
+
+    // Reads back what a Writer wrote. Running past the end leaves the
+    // values untouched and makes ok() false.
+    class Reader
+    {
+    public:
+        Reader(const uint8_t* data, size_t size) : at(data), end(data + size) {}
+
+        bool bytes(void* data, size_t size)
+        {
+            if (!good || (size_t)(end - at) < size)
+                return good = false;
+            if (size)
+                std::memcpy(data, at, size);
+            at += size;
+            return true;
+        }
+
+        template <typename T>
+        bool pod(T& value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "plain data only");
+            return bytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        bool array(std::vector<T>& values)
+        {
+            uint64_t count = 0;
+            if (!pod(count) || count > (uint64_t)(end - at) / sizeof(T))
+                return good = false;
+            values.resize((size_t)count);
+            return bytes(values.data(), values.size() * sizeof(T));
+        }
+
+        bool ok() const { return good; }
+        bool atEnd() const { return at == end; }
+
+    private:
+        const uint8_t* at;
+        const uint8_t* end;
+        bool good = true;
+    };
+
+    // Writes payload to path through a temporary file and a rename.
+    bool writeFile(const std::string& path, const std::vector<uint8_t>& payload, std::string& error);
+    // Reads and verifies a checkpoint, returning its payload.
+    bool readFile(const std::string& path, std::vector<uint8_t>& payload, std::string& error);
+
+    // Writes checkpoints on its own thread, one at a time.
+    class BackgroundWriter
+    {
+    public:
+        BackgroundWriter();
+        ~BackgroundWriter();
+        BackgroundWriter(const BackgroundWriter&) = delete;
+        BackgroundWriter& operator=(const BackgroundWriter&) = delete;
+
+        // Takes the snapshot by swapping buffers with it, handing back the
+        // one written last time for reuse. Returns false and leaves the
+        // snapshot alone while the previous checkpoint is still being written.
+        bool submit(const std::string& path, std::vector<uint8_t>& snapshot);
+        // Blocks until nothing is being written.
+        void wait();
+        bool busy();
+        // Checkpoints written so far, and the last failure if any
+        uint64_t written();
+        std::string lastError();
+
+    private:
+        void run();
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake, idle;
+        std::vector<uint8_t> buffer;
+        std::string path;
+        std::string error;
+        uint64_t count = 0;
+        bool pending = false;
+        bool stopping = false;
+    };
+}
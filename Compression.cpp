@@ -0,0 +1,185 @@
+#include "Compression.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const int HashBits = 14;
+    const size_t MinMatch = 4;
+    // The format requires the last 5 bytes to be literals and matches to start 12 bytes before the end
+    const size_t LastLiterals = 5;
+    const size_t MatchStartMargin = 12;
+
+    uint32_t read32(const uint8_t* p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    uint32_t hash(uint32_t v) { return (v * 2654435761u) >> (32 - HashBits); }
+
+    bool writeLength(uint8_t*& op, const uint8_t* end, size_t length)
+    {
+        while (length >= 255)
+        {
+            if (op >= end)
+                return false;
+            *op++ = 255;
+            length -= 255;
+        }
+        if (op >= end)
+            return false;
+        *op++ = (uint8_t)length;
+        return true;
+    }
+
+    bool emitSequence(uint8_t*& op, const uint8_t* end, const uint8_t* literals, size_t literalLength,
+                      size_t offset, size_t matchLength)
+    {
+        if (op >= end)
+            return false;
+        uint8_t* token = op++;
+        *token = (uint8_t)((literalLength >= 15 ? 15 : literalLength) << 4);
+        if (literalLength >= 15 && !writeLength(op, end, literalLength - 15))
+            return false;
+        if ((size_t)(end - op) < literalLength)
+            return false;
+        std::memcpy(op, literals, literalLength);
+        op += literalLength;
+
+        if (matchLength == 0)
+            return true;
+        if (end - op < 2)
+            return false;
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        size_t code = matchLength - MinMatch;
+        *token |= (uint8_t)(code >= 15 ? 15 : code);
+        return code < 15 || writeLength(op, end, code - 15);
+    }
+}
+
+size_t Compression::compressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t Compression::compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity)
+{
+    thread_local std::vector<int64_t> table;
+    table.assign((size_t)1 << HashBits, -1);
+
+    uint8_t* op = dst;
+    const uint8_t* end = dst + capacity;
+    size_t ip = 0, anchor = 0;
+
+    if (size > MatchStartMargin)
+    {
+        const size_t matchLimit = size - LastLiterals;
+        const size_t startLimit = size - MatchStartMargin;
+        while (ip < startLimit)
+        {
+            uint32_t seq = read32(src + ip);
+            uint32_t h = hash(seq);
+            int64_t ref = table[h];
+            table[h] = (int64_t)ip;
+
+            if (ref < 0 || ip - (size_t)ref > 65535 || read32(src + ref) != seq)
+            {
+                ip++;
+                continue;
+            }
+
+            size_t length = MinMatch;
+            while (ip + length < matchLimit && src[ref + length] == src[ip + length])
+                length++;
+
+            if (!emitSequence(op, end, src + anchor, ip - anchor, ip - (size_t)ref, length))
+                return 0;
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    if (!emitSequence(op, end, src + anchor, size - anchor, 0, 0))
+        return 0;
+    return (size_t)(op - dst);
+}
+
+bool Compression::decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t decodedSize)
+{
+    const uint8_t* ip = src;
+    const uint8_t* const ipEnd = src + size;
+    size_t op = 0;
+
+    while (ip < ipEnd)
+    {
+        uint8_t token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= ipEnd)
+                    return false;
+                b = *ip++;
+                literalLength += b;
+            } while (b == 255);
+        }
+        if ((size_t)(ipEnd - ip) < literalLength || decodedSize - op < literalLength)
+            return false;
+        std::memcpy(dst + op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == ipEnd)
+            break;
+
+        if (ipEnd - ip < 2)
+            return false;
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op)
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15)
+        {
+            uint8_t b;
+            do
+            {
+                if (ip >= ipEnd)
+                    return false;
+                b = *ip++;
+                matchLength += b;
+            } while (b == 255);
+        }
+        matchLength += MinMatch;
+        if (decodedSize - op < matchLength)
+            return false;
+
+        // Byte by byte, the match may overlap the bytes it produces
+        const uint8_t* match = dst + op - offset;
+        for (size_t i = 0; i < matchLength; ++i)
+            dst[op + i] = match[i];
+        op += matchLength;
+    }
+    return op == decodedSize;
+}
+
+void Compression::shuffle(const uint8_t* src, size_t count, size_t elementSize, uint8_t* dst)
+{
+    for (size_t b = 0; b < elementSize; ++b)
+        for (size_t i = 0; i < count; ++i)
+            dst[b * count + i] = src[i * elementSize + b];
+}
+
+void Compression::unshuffle(const uint8_t* src, size_t count, size_t elementSize, uint8_t* dst)
+{
+    for (size_t b = 0; b < elementSize; ++b)
+        for (size_t i = 0; i < count; ++i)
+            dst[i * elementSize + b] = src[b * count + i];
+}
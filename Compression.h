@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Small LZ4 block-format codec and a byte shuffle that groups the bytes of
+// fixed-size elements into planes, which makes float columns compressible.
+namespace Compression
+{
+    size_t compressBound(size_t size);
+    // Returns the compressed size, or 0 if dst is too small.
+    size_t compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+    // Returns false unless the stream decodes to exactly size bytes.
+    bool decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t decodedSize);
+
+    void shuffle(const uint8_t* src, size_t count, size_t elementSize, uint8_t* dst);
+    void unshuffle(const uint8_t* src, size_t count, size_t elementSize, uint8_t* dst);
+}
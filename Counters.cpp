@@ -0,0 +1,222 @@
+#include "Counters.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fstream>
+#endif
+
+namespace
+{
+#ifdef __linux__
+    int openEvent(uint32_t type, uint64_t config, int leader)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = leader < 0 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+    }
+
+    bool isIntel()
+    {
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line))
+            if (line.compare(0, 9, "vendor_id") == 0)
+                return line.find("GenuineIntel") != std::string::npos;
+        return false;
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+bool PerfCounters::open(std::string& error)
+{
+    close();
+#ifdef __linux__
+    struct Wanted
+    {
+        int event;
+        uint32_t type;
+        uint64_t config;
+        double weight;
+    };
+    const Wanted general[] = {
+        { Cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1.0 },
+        { Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 1.0 },
+        { CacheReferences, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, 1.0 },
+        { CacheMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 1.0 },
+        { Branches, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, 1.0 },
+        { BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 1.0 },
+    };
+    // FP_ARITH_INST_RETIRED (event 0xC7), weighted by the lanes each instruction works on
+    const Wanted flops[] = {
+        { Flops, PERF_TYPE_RAW, 0x01c7, 1.0 },  // scalar double
+        { Flops, PERF_TYPE_RAW, 0x02c7, 1.0 },  // scalar single
+        { Flops, PERF_TYPE_RAW, 0x04c7, 2.0 },  // 128-bit packed double
+        { Flops, PERF_TYPE_RAW, 0x08c7, 4.0 },  // 128-bit packed single
+        { Flops, PERF_TYPE_RAW, 0x10c7, 4.0 },  // 256-bit packed double
+        { Flops, PERF_TYPE_RAW, 0x20c7, 8.0 },  // 256-bit packed single
+        { Flops, PERF_TYPE_RAW, 0x40c7, 8.0 },  // 512-bit packed double
+        { Flops, PERF_TYPE_RAW, 0x80c7, 16.0 }, // 512-bit packed single
+    };
+    static_assert(sizeof(flops) / sizeof(flops[0]) <= 2 * GroupEvents, "FLOP events need more groups");
+
+    // Returns false if any event failed to open
+    auto build = [](Group& group, const Wanted* wanted, size_t count) {
+        bool all = true;
+        for (size_t i = 0; i < count; ++i)
+        {
+            int leader = group.fds.empty() ? -1 : group.fds[0];
+            int fd = openEvent(wanted[i].type, wanted[i].config, leader);
+            if (fd < 0)
+            {
+                // Without a leader there is no group at all
+                if (leader < 0)
+                    return false;
+                all = false;
+                continue;
+            }
+            group.fds.push_back(fd);
+            group.events.push_back(wanted[i].event);
+            group.weights.push_back(wanted[i].weight);
+        }
+        return all;
+    };
+
+    build(groups[0], general, sizeof(general) / sizeof(general[0]));
+    if (groups[0].fds.empty())
+    {
+        int code = errno;
+        error = std::string("perf_event_open failed: ") + std::strerror(code);
+        if (code == ENOENT || code == EOPNOTSUPP)
+            error += " (no hardware events, e.g. inside a virtual machine)";
+        else if (code == EACCES || code == EPERM)
+            error += " (check /proc/sys/kernel/perf_event_paranoid)";
+        return false;
+    }
+    if (isIntel())
+    {
+        // A sum missing some widths would pass for the whole count, so the
+        // FLOP groups go unless every event opened
+        const size_t count = sizeof(flops) / sizeof(flops[0]);
+        bool all = true;
+        for (size_t first = 0, g = 1; first < count; first += GroupEvents, ++g)
+            all = build(groups[g], flops + first, std::min(count - first, (size_t)GroupEvents)) && all;
+        if (!all)
+            for (size_t g = 1; g < sizeof(groups) / sizeof(groups[0]); ++g)
+            {
+                for (int fd : groups[g].fds)
+                    ::close(fd);
+                groups[g] = Group();
+            }
+    }
+    return true;
+#else
+    error = "Hardware counters need Linux perf_event_open";
+    return false;
+#endif
+}
+
+void PerfCounters::close()
+{
+    for (Group& group : groups)
+    {
+#ifdef __linux__
+        for (int fd : group.fds)
+            ::close(fd);
+#endif
+        group.fds.clear();
+        group.events.clear();
+        group.weights.clear();
+    }
+}
+
+bool PerfCounters::has(Event e) const
+{
+    for (const Group& group : groups)
+        for (int event : group.events)
+            if (event == e)
+                return true;
+    return false;
+}
+
+void PerfCounters::begin()
+{
+#ifdef __linux__
+    for (Group& group : groups)
+    {
+        if (group.fds.empty())
+            continue;
+        ioctl(group.fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group.fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+}
+
+PerfCounters::Sample PerfCounters::end()
+{
+    Sample sample;
+#ifdef __linux__
+    // Events summed over groups are only valid if every group was read
+    bool missing[EventCount] = {};
+    for (Group& group : groups)
+    {
+        if (group.fds.empty())
+            continue;
+        ioctl(group.fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        // nr, time enabled, time running, then one value per event
+        buffer.resize(3 + group.fds.size());
+        ssize_t got = read(group.fds[0], buffer.data(), buffer.size() * sizeof(uint64_t));
+        if (got < (ssize_t)(3 * sizeof(uint64_t)) || buffer[0] != group.fds.size() || buffer[2] == 0)
+        {
+            for (int e : group.events)
+                missing[e] = true;
+            continue;
+        }
+        double scale = (double)buffer[1] / (double)buffer[2];
+        for (size_t i = 0; i < group.fds.size(); ++i)
+        {
+            int e = group.events[i];
+            sample.values[e] += (uint64_t)(buffer[3 + i] * group.weights[i] * scale);
+            sample.valid[e] = true;
+        }
+    }
+    for (int e = 0; e < EventCount; ++e)
+        sample.valid[e] = sample.valid[e] && !missing[e];
+#endif
+    return sample;
+}
+
+double PerfCounters::Sample::ipc() const
+{
+    return valid[Cycles] && valid[Instructions] && values[Cycles] ? (double)values[Instructions] / values[Cycles] : 0.0;
+}
+
+double PerfCounters::Sample::percent(Event part, Event whole) const
+{
+    return valid[part] && valid[whole] && values[whole] ? 100.0 * values[part] / values[whole] : 0.0;
+}
+
+const char* PerfCounters::name(Event e)
+{
+    static const char* names[EventCount] = {
+        "cycles", "instructions", "cache_references", "cache_misses", "branches", "branch_misses", "flops"
+    };
+    return names[e];
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hardware performance counters for one phase of a frame, read through a
+// perf_event_open group on Linux so every event covers the same interval.
+// begin() resets and starts the group on the calling thread, end() stops it
+// and reads the counts. Events the CPU or kernel refuses are left out and
+// reported as unavailable; on other platforms open() simply fails.
+// FLOPs come from the Intel FP_ARITH_INST_RETIRED events in groups of their
+// own, at most four events each as that is all the general-purpose counters
+// a core has with Hyper-Threading on, scaled when the kernel has to
+// multiplex them. They are only reported when every one of them opened.
+class PerfCounters
+{
+public:
+    enum Event
+    {
+        Cycles, Instructions, CacheReferences, CacheMisses, Branches, BranchMisses, Flops, EventCount
+    };
+
+    struct Sample
+    {
+        uint64_t values[EventCount] = {};
+        bool valid[EventCount] = {};
+
+        double ipc() const;
+        // Ratio of two events in percent, 0 when either is missing
+        double percent(Event part, Event whole) const;
+    };
+
+    PerfCounters() = default;
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool open(std::string& error);
+    void close();
+    bool isOpen() const { return !groups[0].fds.empty(); }
+    bool has(Event e) const;
+
+    void begin();
+    Sample end();
+
+    static const char* name(Event e);
+
+private:
+    struct Group
+    {
+        std::vector<int> fds;
+        std::vector<int> events;
+        std::vector<double> weights;
+    };
+
+    // The general events, then the FLOP events four at a time
+    static const size_t GroupEvents = 4;
+    Group groups[3];
+    std::vector<uint64_t> buffer;
+};
@@ -0,0 +1,148 @@
+#include "Cpu.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+#ifdef CPU_X86
+    void cpuid(uint32_t leaf, uint32_t sub, uint32_t r[4])
+    {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuidex(regs, (int)leaf, (int)sub);
+        for (int i = 0; i < 4; ++i)
+            r[i] = (uint32_t)regs[i];
+#else
+        __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+    }
+
+    // Register state the OS saves on context switch (XCR0)
+    uint64_t enabledState()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return ((uint64_t)hi << 32) | lo;
+#endif
+    }
+#endif
+
+    Cpu::Level detect()
+    {
+#ifdef CPU_X86
+        uint32_t r[4];
+        cpuid(0, 0, r);
+        if (r[0] < 7)
+            return Cpu::SSE2;
+        cpuid(1, 0, r);
+        const uint32_t ecx1 = r[2];
+        bool osxsave = (ecx1 >> 27) & 1, avx = (ecx1 >> 28) & 1, fma = (ecx1 >> 12) & 1;
+        if (!osxsave || !avx)
+            return Cpu::SSE2;
+        uint64_t xcr0 = enabledState();
+        cpuid(7, 0, r);
+        const uint32_t ebx7 = r[1];
+
+        // XMM and YMM state, then opmask and both halves of ZMM
+        bool ymm = (xcr0 & 0x6) == 0x6;
+        bool zmm = (xcr0 & 0xe6) == 0xe6;
+        bool avx2 = ymm && fma && ((ebx7 >> 5) & 1);
+        // F, DQ, BW and VL: the Skylake server baseline
+        bool avx512 = zmm && avx2 && ((ebx7 >> 16) & 1) && ((ebx7 >> 17) & 1) && ((ebx7 >> 30) & 1) && ((ebx7 >> 31) & 1);
+        if (avx512)
+            return Cpu::AVX512;
+        if (avx2)
+            return Cpu::AVX2;
+#endif
+        return Cpu::SSE2;
+    }
+
+    struct State
+    {
+        Cpu::Level detected;
+        std::atomic<int> active;
+        std::atomic<bool> forced{ false };
+
+        State();
+    };
+
+    bool apply(State& s, const std::string& level, std::string& error)
+    {
+        for (int l = 0; l < Cpu::LevelCount; ++l)
+        {
+            if (level != Cpu::name((Cpu::Level)l) && !(l == Cpu::SSE2 && level == "sse2"))
+                continue;
+            if (l > s.detected)
+            {
+                error = level + " is not supported by this CPU (detected " + Cpu::name(s.detected) + ")";
+                return false;
+            }
+            s.active.store(l, std::memory_order_relaxed);
+            s.forced = l != s.detected;
+            return true;
+        }
+        error = "Unknown instruction set " + level + ", expected sse2, avx2 or avx512";
+        return false;
+    }
+
+    State::State() : detected(detect()), active(detected)
+    {
+        if (const char* env = std::getenv("PENDULUM_ISA"))
+        {
+            std::string error;
+            // Left at the detected level when the variable asks for too much
+            apply(*this, env, error);
+        }
+    }
+
+    State& state()
+    {
+        static State s;
+        return s;
+    }
+}
+
+Cpu::Level Cpu::detected()
+{
+    return state().detected;
+}
+
+Cpu::Level Cpu::active()
+{
+    return (Level)state().active.load(std::memory_order_relaxed);
+}
+
+bool Cpu::setLevel(const std::string& level, std::string& error)
+{
+    return apply(state(), level, error);
+}
+
+const char* Cpu::name(Level level)
+{
+#ifdef CPU_X86
+    static const char* names[LevelCount] = { "sse2", "avx2", "avx512" };
+#else
+    static const char* names[LevelCount] = { "generic", "avx2", "avx512" };
+#endif
+    return names[level];
+}
+
+std::string Cpu::report()
+{
+    std::string text = name(active());
+    if (state().forced)
+        text += std::string(" (detected ") + name(detected()) + ", forced)";
+    return text;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+// Instruction set levels the batch kernels are built for, detected once
+// from CPUID. The active level can be forced lower for testing with
+// --isa=<name> or the PENDULUM_ISA environment variable.
+namespace Cpu
+{
+    enum Level
+    {
+        SSE2, AVX2, AVX512, LevelCount
+    };
+
+    // Highest level both the CPU and the operating system support
+    Level detected();
+    Level active();
+    // Fails when the name is unknown or the CPU lacks the level
+    bool setLevel(const std::string& name, std::string& error);
+    // "sse2", "avx2" or "avx512"; the baseline is "generic" off x86
+    const char* name(Level level);
+    // Active level and how it was chosen, e.g. "avx2 (detected avx512, forced)"
+    std::string report();
+}
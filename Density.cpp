@@ -0,0 +1,262 @@
+#include "Density.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const char* Names[Density::VariableCount] = { "theta1", "theta2", "omega1", "omega2" };
+    // Samples binned per pass of accumulate, so the cell indices stay in L1
+    const size_t BlockSize = 256;
+
+    struct FileAxis
+    {
+        uint32_t variable, bins;
+        float min, max;
+    };
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t dimensions;
+        FileAxis axes[Density::VariableCount];
+        uint64_t samples, outside;
+    };
+
+    const char* fileMagic() { return "PENDHST"; }
+    const uint32_t FileVersion = 1;
+}
+
+const char* Density::name(Variable v)
+{
+    return v >= 0 && v < VariableCount ? Names[v] : "?";
+}
+
+Density::Binning::Binning()
+{
+    // Every variable once, so the first two, three or four axes are valid
+    for (int k = 0; k < VariableCount; ++k)
+    {
+        axes[k].variable = (Variable)k;
+        if (k >= Omega1)
+        {
+            axes[k].min = -15.0f;
+            axes[k].max = 15.0f;
+        }
+    }
+}
+
+size_t Density::Binning::cells() const
+{
+    size_t n = 1;
+    for (int k = 0; k < dimensions; ++k)
+        n *= axes[k].bins;
+    return n;
+}
+
+bool Density::Histogram::reset(const Binning& binning, size_t workers, std::string& error)
+{
+    if (binning.dimensions < 2 || binning.dimensions > VariableCount)
+    {
+        error = "Histograms have two to four axes";
+        return false;
+    }
+    double cells = 1.0;
+    bool used[VariableCount] = {};
+    for (int k = 0; k < binning.dimensions; ++k)
+    {
+        const Axis& a = binning.axes[k];
+        if (a.variable < 0 || a.variable >= VariableCount || used[a.variable])
+        {
+            error = "Histogram axes must be distinct variables";
+            return false;
+        }
+        if (a.bins == 0 || !(a.max > a.min))
+        {
+            error = std::string("Bad ") + name(a.variable) + " axis, expected min < max and at least one bin";
+            return false;
+        }
+        used[a.variable] = true;
+        cells *= a.bins;
+    }
+    if (cells > (double)MaxCells)
+    {
+        error = "Histogram of " + std::to_string((unsigned long long)cells) + " cells is too large";
+        return false;
+    }
+
+    bins = binning;
+    size_t stride = 1;
+    for (int k = 0; k < bins.dimensions; ++k)
+    {
+        strides[k] = stride;
+        scales[k] = bins.axes[k].bins / (bins.axes[k].max - bins.axes[k].min);
+        stride *= bins.axes[k].bins;
+    }
+    locals.resize(std::max<size_t>(workers, 1));
+    for (Local& local : locals)
+        local.counts.assign(bins.cells() + 1, 0);
+    totals.assign(bins.cells(), 0);
+    merged = missed = 0;
+    for (Local& local : locals)
+        local.pending = 0;
+    return true;
+}
+
+void Density::Histogram::clear()
+{
+    for (Local& local : locals)
+    {
+        std::fill(local.counts.begin(), local.counts.end(), 0);
+        local.pending = 0;
+    }
+    std::fill(totals.begin(), totals.end(), 0);
+    merged = missed = 0;
+}
+
+void Density::Histogram::add(size_t worker, float theta1, float theta2, float omega1, float omega2)
+{
+    const float state[VariableCount] = { theta1, theta2, omega1, omega2 };
+    const size_t cells = totals.size();
+    size_t cell = 0;
+    bool inside = true;
+    for (int k = 0; k < bins.dimensions; ++k)
+    {
+        const Axis& a = bins.axes[k];
+        float f = (state[a.variable] - a.min) * scales[k];
+        inside = inside && f >= 0.0f && f <= (float)a.bins;
+        cell += std::min((uint32_t)(inside ? f : 0.0f), a.bins - 1) * strides[k];
+    }
+    Local& local = locals[worker];
+    ++local.counts[inside ? cell : cells];
+    ++local.pending;
+}
+
+void Density::Histogram::accumulate(size_t worker, const DoubleColumns& c, size_t begin, size_t end)
+{
+    const float* columns[VariableCount] = { c.theta1, c.theta2, c.omega1, c.omega2 };
+    const size_t cells = totals.size();
+    uint32_t* counts = locals[worker].counts.data();
+    uint32_t cell[BlockSize];
+    uint8_t outside[BlockSize];
+    for (size_t first = begin; first < end; first += BlockSize)
+    {
+        const size_t n = std::min(BlockSize, end - first);
+        // Indices an axis at a time, branch free, so the loops vectorize;
+        // NaN fails both range tests and counts as outside
+        for (size_t i = 0; i < n; ++i)
+        {
+            cell[i] = 0;
+            outside[i] = 0;
+        }
+        for (int k = 0; k < bins.dimensions; ++k)
+        {
+            const Axis& a = bins.axes[k];
+            const float* v = columns[a.variable] + first;
+            const float low = a.min, scale = scales[k], top = (float)a.bins;
+            const uint32_t last = a.bins - 1, stride = (uint32_t)strides[k];
+            for (size_t i = 0; i < n; ++i)
+            {
+                float f = (v[i] - low) * scale;
+                bool inside = f >= 0.0f && f <= top;
+                uint32_t q = (uint32_t)(inside ? f : 0.0f);
+                cell[i] += (q < last ? q : last) * stride;
+                outside[i] |= (uint8_t)!inside;
+            }
+        }
+        for (size_t i = 0; i < n; ++i)
+            ++counts[outside[i] ? cells : cell[i]];
+    }
+    locals[worker].pending += end - begin;
+}
+
+void Density::Histogram::step(size_t worker, const DoubleColumns& c, size_t begin, size_t end, float damping, float g,
+                              float dt, size_t steps)
+{
+    // A block's state stays in L1 across its steps, the worker's copy in L2
+    for (size_t b = begin; b < end; b += BlockSize)
+    {
+        const size_t e = std::min(end, b + BlockSize);
+        for (size_t s = 0; s < steps; ++s)
+        {
+            Batch::stepDoubles(c, b, e, damping, g, dt, 1);
+            accumulate(worker, c, b, e);
+        }
+    }
+}
+
+uint64_t Density::Histogram::pending() const
+{
+    uint64_t most = 0;
+    for (const Local& local : locals)
+        most = std::max(most, local.pending);
+    return most;
+}
+
+void Density::Histogram::merge(ThreadPool* pool)
+{
+    // Cells split between the pool's workers, each summing every copy over
+    // its own range, so the merge needs no locks either
+    auto fold = [this](size_t begin, size_t end) {
+        for (Local& local : locals)
+        {
+            uint32_t* counts = local.counts.data();
+            for (size_t cell = begin; cell < end; ++cell)
+                totals[cell] += counts[cell];
+            std::fill(counts + begin, counts + end, 0);
+        }
+    };
+    if (pool)
+        pool->forRanges(totals.size(), fold);
+    else
+        fold(0, totals.size());
+
+    const size_t cells = totals.size();
+    for (Local& local : locals)
+    {
+        merged += local.pending;
+        missed += local.counts[cells];
+        local.counts[cells] = 0;
+        local.pending = 0;
+    }
+}
+
+void Density::Histogram::project(int x, int y, std::vector<uint64_t>& out) const
+{
+    const uint32_t width = bins.axes[x].bins, height = bins.axes[y].bins;
+    out.assign((size_t)width * height, 0);
+    for (size_t cell = 0; cell < totals.size(); ++cell)
+    {
+        if (!totals[cell])
+            continue;
+        size_t column = cell / strides[x] % width, row = cell / strides[y] % height;
+        out[(height - 1 - row) * width + column] += totals[cell];
+    }
+}
+
+bool Density::Histogram::write(const std::string& path, std::string& error) const
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        error = "Cannot create " + path;
+        return false;
+    }
+    FileHeader header = {};
+    std::memcpy(header.magic, fileMagic(), sizeof(header.magic));
+    header.version = FileVersion;
+    header.dimensions = (uint32_t)bins.dimensions;
+    for (int k = 0; k < bins.dimensions; ++k)
+        header.axes[k] = { (uint32_t)bins.axes[k].variable, bins.axes[k].bins, bins.axes[k].min, bins.axes[k].max };
+    header.samples = merged;
+    header.outside = missed;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(totals.data()), (std::streamsize)(totals.size() * sizeof(uint64_t)));
+    if (!out)
+    {
+        error = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
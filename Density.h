@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Ensemble.h"
+#include "ThreadPool.h"
+
+// Invariant densities: histograms of where double pendulums spend their
+// time in (theta1, theta2, omega1, omega2) space, binned over two, three or
+// all four of those axes, accumulated over long runs and large ensembles.
+//
+// Every worker counts into a private copy of the histogram, so the hot path
+// is a plain increment with no atomics and no sharing; merge() folds the
+// copies into 64-bit totals at intervals, while the workers are idle.
+namespace Density
+{
+    enum Variable
+    {
+        Theta1, Theta2, Omega1, Omega2, VariableCount
+    };
+
+    const char* name(Variable v);
+
+    // Bins evenly over [min, max], max itself falling in the last bin
+    struct Axis
+    {
+        Variable variable = Theta1;
+        float min = -3.14159265f, max = 3.14159265f;
+        uint32_t bins = 256;
+    };
+
+    // Axis 0 varies fastest along the counts
+    struct Binning
+    {
+        int dimensions = 2;
+        Axis axes[VariableCount];
+
+        Binning();
+        size_t cells() const;
+    };
+
+    class Histogram
+    {
+    public:
+        // Private counts are 32-bit, so no worker may add more samples than
+        // this between merges
+        static const uint64_t MaxPending = UINT32_MAX;
+        // Cells in one copy; a worker's copy is four bytes a cell
+        static const size_t MaxCells = (size_t)1 << 28;
+
+        bool reset(const Binning& binning, size_t workers, std::string& error);
+        void clear();
+        const Binning& binning() const { return bins; }
+        size_t workers() const { return locals.size(); }
+
+        // One sample into worker's copy. Call only from that worker.
+        void add(size_t worker, float theta1, float theta2, float omega1, float omega2);
+        // The current states of doubles [begin, end), one sample each
+        void accumulate(size_t worker, const DoubleColumns& c, size_t begin, size_t end);
+        // Steps doubles [begin, end) by steps steps of dt with the batch
+        // kernels a block at a time, adding every state after every step
+        void step(size_t worker, const DoubleColumns& c, size_t begin, size_t end, float damping, float g, float dt,
+                  size_t steps);
+        // Samples added since the last merge, by one worker and by the busiest
+        uint64_t pending(size_t worker) const { return locals[worker].pending; }
+        uint64_t pending() const;
+
+        // Adds every copy into the totals and zeroes it, split over the pool
+        // when given. No worker may be adding meanwhile.
+        void merge(ThreadPool* pool = nullptr);
+        const std::vector<uint64_t>& counts() const { return totals; }
+        // Merged samples, and those of them that fell outside the binning
+        uint64_t samples() const { return merged; }
+        uint64_t outside() const { return missed; }
+
+        // Merged counts summed over every axis but x and y: out[row * bins
+        // of x + column], rows running down from the top of y's range
+        void project(int x, int y, std::vector<uint64_t>& out) const;
+        // Binary dump: a header naming the axes, then the counts as uint64
+        bool write(const std::string& path, std::string& error) const;
+
+    private:
+        struct Local
+        {
+            // One count per cell, then the samples outside
+            std::vector<uint32_t> counts;
+            uint64_t pending = 0;
+        };
+
+        Binning bins;
+        size_t strides[VariableCount] = {};
+        float scales[VariableCount] = {};
+        std::vector<Local> locals;
+        std::vector<uint64_t> totals;
+        uint64_t merged = 0, missed = 0;
+    };
+}
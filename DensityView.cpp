@@ -0,0 +1,155 @@
+#include "DensityView.h"
+#include "ImageFile.h"
+#include "imgui/imgui.h"
+#include <GL/glew.h>
+#include <algorithm>
+
+namespace
+{
+    // Black through red and yellow to white
+    void heat(uint8_t level, uint8_t* rgba)
+    {
+        int v = level * 3;
+        rgba[0] = (uint8_t)std::min(v, 255);
+        rgba[1] = (uint8_t)std::min(std::max(v - 255, 0), 255);
+        rgba[2] = (uint8_t)std::max(v - 510, 0);
+        rgba[3] = 255;
+    }
+
+    bool axisCombo(const char* label, int& axis, const Density::Binning& binning)
+    {
+        bool changed = false;
+        if (ImGui::BeginCombo(label, Density::name(binning.axes[axis].variable)))
+        {
+            for (int k = 0; k < binning.dimensions; ++k)
+                if (ImGui::Selectable(Density::name(binning.axes[k].variable), k == axis))
+                {
+                    changed = k != axis;
+                    axis = k;
+                }
+            ImGui::EndCombo();
+        }
+        return changed;
+    }
+}
+
+void DensityView::reset(Density::Histogram& histogram)
+{
+    Density::Binning binning;
+    binning.dimensions = wholeState ? 4 : 2;
+    for (int k = 0; k < binning.dimensions; ++k)
+    {
+        binning.axes[k].bins = (uint32_t)bins;
+        if (binning.axes[k].variable >= Density::Omega1)
+        {
+            binning.axes[k].min = -omegaRange;
+            binning.axes[k].max = omegaRange;
+        }
+    }
+    x = std::min(x, binning.dimensions - 1);
+    y = std::min(y, binning.dimensions - 1);
+    if (x == y)
+        y = x ? 0 : 1;
+    status.clear();
+    histogram.reset(binning, 1, status);
+    merged = -1.0;
+}
+
+void DensityView::release()
+{
+    if (texture)
+        glDeleteTextures(1, &texture);
+    texture = 0;
+}
+
+void DensityView::upload(const Density::Histogram& histogram)
+{
+    const Density::Binning& binning = histogram.binning();
+    histogram.project(x, y, projection);
+    ImageFile::logScale(projection.data(), projection.size(), levels);
+    pixels.resize(levels.size() * 4);
+    for (size_t i = 0; i < levels.size(); ++i)
+        heat(levels[i], &pixels[i * 4]);
+
+    if (!texture)
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (GLsizei)binning.axes[x].bins, (GLsizei)binning.axes[y].bins, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, pixels.data());
+}
+
+void DensityView::draw(Density::Histogram& histogram, bool* open)
+{
+    ImGui::SetNextWindowSize(ImVec2(480.0f, 600.0f), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Invariant Density", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    bool changed = ImGui::Checkbox("Whole state", &wholeState);
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Bin omega1 and omega2 as well as the angles, with fewer bins per axis");
+    if (changed)
+        bins = wholeState ? std::min(bins, 32) : std::max(bins, 256);
+    changed |= ImGui::SliderInt("Bins per axis", &bins, 8, wholeState ? 48 : 1024, "%d", ImGuiSliderFlags_Logarithmic);
+    changed |= ImGui::SliderFloat("Omega range", &omegaRange, 1.0f, 50.0f, "+-%.1f rad/s");
+    if (changed)
+        reset(histogram);
+    const Density::Binning& binning = histogram.binning();
+    bool moved = axisCombo("X", x, binning);
+    moved |= axisCombo("Y", y, binning);
+    if (x == y)
+        y = (x + 1) % binning.dimensions;
+    if (ImGui::Button("Clear"))
+    {
+        histogram.clear();
+        moved = true;
+    }
+    // Merged and uploaded at each refresh rather than every frame
+    double now = ImGui::GetTime();
+    if (merged < 0.0 || moved || now - merged >= refresh)
+    {
+        histogram.merge();
+        upload(histogram);
+        merged = now;
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(200.0f);
+    ImGui::InputText("##path", path, sizeof(path));
+    ImGui::SameLine();
+    if (ImGui::Button("Save"))
+    {
+        // The counts, and next to them the plane shown as an image
+        std::string error;
+        const std::string image = std::string(path) + ".pgm";
+        if (histogram.write(path, error) &&
+            ImageFile::writePgm(image, binning.axes[x].bins, binning.axes[y].bins, levels.data(), error))
+            status = "Saved " + std::string(path) + " and " + image;
+        else
+            status = error;
+    }
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Write the merged counts with their binning, and the plane shown as a PGM beside them");
+
+    ImGui::Text("%llu samples, %llu outside", (unsigned long long)histogram.samples(),
+                (unsigned long long)histogram.outside());
+    if (!status.empty())
+        ImGui::Text("%s", status.c_str());
+
+    ImVec2 size = ImGui::GetContentRegionAvail();
+    size.x = std::max(size.x, 64.0f);
+    size.y = std::max(size.y - ImGui::GetTextLineHeightWithSpacing(), 64.0f);
+    ImGui::Image((ImTextureID)(intptr_t)texture, size);
+    const Density::Axis& ax = binning.axes[x];
+    const Density::Axis& ay = binning.axes[y];
+    ImGui::Text("%s %.2f .. %.2f, %s %.2f .. %.2f", Density::name(ax.variable), ax.min, ax.max,
+                Density::name(ay.variable), ay.min, ay.max);
+    ImGui::End();
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Density.h"
+
+// Window showing the invariant density of the double pendulums as a
+// log-scaled image, with controls for the binning and the plane shown, and
+// a button dumping the counts to disk.
+struct DensityView
+{
+    // Angles alone, or the whole (theta1, theta2, omega1, omega2) state
+    bool wholeState = false;
+    int bins = 256;
+    float omegaRange = 15.0f;
+    // Binned axes shown across and up
+    int x = 0, y = 1;
+    // Seconds between merges and texture updates
+    float refresh = 0.25f;
+    char path[256] = "density.hist";
+
+    // Starts the histogram afresh with the current settings, for one worker
+    void reset(Density::Histogram& histogram);
+    // Changing the binning starts the histogram afresh
+    void draw(Density::Histogram& histogram, bool* open);
+    // Deletes the texture; call while the GL context is current
+    void release();
+
+private:
+    void upload(const Density::Histogram& histogram);
+
+    std::string status;
+    double merged = -1.0;
+    unsigned int texture = 0;
+    std::vector<uint64_t> projection;
+    std::vector<uint8_t> levels, pixels;
+};
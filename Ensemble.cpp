@@ -0,0 +1,207 @@
+#include "Ensemble.h"
+#include "BatchKernels.h"
+
+const Batch::Kernels& Batch::kernels(Cpu::Level level)
+{
+    static const Kernels* builds[Cpu::LevelCount] = { kernelsSSE2(), kernelsAVX2(), kernelsAVX512() };
+    for (int l = level; l > Cpu::SSE2; --l)
+        if (builds[l])
+            return *builds[l];
+    return *builds[Cpu::SSE2];
+}
+
+template <typename Real>
+void Batch::stepSingles(const SingleColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps)
+{
+    kernels(Cpu::active()).stepSingles(c, begin, end, damping, g, dt, steps);
+}
+
+template <typename Real>
+void Batch::stepDoubles(const DoubleColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps)
+{
+    kernels(Cpu::active()).stepDoubles(c, begin, end, damping, g, dt, steps);
+}
+
+template <typename Real>
+void Batch::stepDrivens(const DrivenColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps)
+{
+    kernels(Cpu::active()).stepDrivens(c, begin, end, damping, g, dt, steps);
+}
+
+template <typename Real>
+void Batch::stepElastics(const ElasticColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps)
+{
+    kernels(Cpu::active()).stepElastics(c, begin, end, damping, g, dt, steps);
+}
+
+template void Batch::stepSingles<float>(const SingleColumnsT<float>&, size_t, size_t, float, float, float, size_t);
+template void Batch::stepSingles<double>(const SingleColumnsT<double>&, size_t, size_t, double, double, double, size_t);
+template void Batch::stepDoubles<float>(const DoubleColumnsT<float>&, size_t, size_t, float, float, float, size_t);
+template void Batch::stepDoubles<double>(const DoubleColumnsT<double>&, size_t, size_t, double, double, double, size_t);
+template void Batch::stepDrivens<float>(const DrivenColumnsT<float>&, size_t, size_t, float, float, float, size_t);
+template void Batch::stepDrivens<double>(const DrivenColumnsT<double>&, size_t, size_t, double, double, double, size_t);
+template void Batch::stepElastics<float>(const ElasticColumnsT<float>&, size_t, size_t, float, float, float, size_t);
+template void Batch::stepElastics<double>(const ElasticColumnsT<double>&, size_t, size_t, double, double, double, size_t);
+
+void Ensemble::addSingle(float theta, float omega, float m, float L, float px, float py)
+{
+    sTheta.push_back(theta);
+    sOmega.push_back(omega);
+    sM.push_back(m);
+    sL.push_back(L);
+    sPx.push_back(px);
+    sPy.push_back(py);
+    sFrozen.push_back(0);
+}
+
+void Ensemble::addDouble(float theta1, float theta2, float omega1, float omega2,
+                         float m1, float m2, float L1, float L2, float px, float py)
+{
+    dTheta1.push_back(theta1);
+    dTheta2.push_back(theta2);
+    dOmega1.push_back(omega1);
+    dOmega2.push_back(omega2);
+    dM1.push_back(m1);
+    dM2.push_back(m2);
+    dL1.push_back(L1);
+    dL2.push_back(L2);
+    dPx.push_back(px);
+    dPy.push_back(py);
+    dFrozen.push_back(0);
+}
+
+void Ensemble::addDriven(float theta, float omega, float m, float L, float amplitude, float frequency,
+                         float phase, float px, float py)
+{
+    fTheta.push_back(theta);
+    fOmega.push_back(omega);
+    fPhase.push_back(phase);
+    fM.push_back(m);
+    fL.push_back(L);
+    fAmplitude.push_back(amplitude);
+    fFrequency.push_back(frequency);
+    fPx.push_back(px);
+    fPy.push_back(py);
+    fFrozen.push_back(0);
+}
+
+void Ensemble::addElastic(float theta, float omega, float r, float vr, float m, float L, float k, float px, float py)
+{
+    eTheta.push_back(theta);
+    eOmega.push_back(omega);
+    eR.push_back(r);
+    eVr.push_back(vr);
+    eM.push_back(m);
+    eL.push_back(L);
+    eK.push_back(k);
+    ePx.push_back(px);
+    ePy.push_back(py);
+    eFrozen.push_back(0);
+}
+
+void Ensemble::reserve(size_t singles, size_t doubles, size_t drivens, size_t elastics)
+{
+    for (auto* v : { &sTheta, &sOmega, &sM, &sL, &sPx, &sPy })
+        v->reserve(singles);
+    sFrozen.reserve(singles);
+    for (auto* v : { &dTheta1, &dTheta2, &dOmega1, &dOmega2, &dM1, &dM2, &dL1, &dL2, &dPx, &dPy })
+        v->reserve(doubles);
+    dFrozen.reserve(doubles);
+    for (auto* v : { &fTheta, &fOmega, &fPhase, &fM, &fL, &fAmplitude, &fFrequency, &fPx, &fPy })
+        v->reserve(drivens);
+    fFrozen.reserve(drivens);
+    for (auto* v : { &eTheta, &eOmega, &eR, &eVr, &eM, &eL, &eK, &ePx, &ePy })
+        v->reserve(elastics);
+    eFrozen.reserve(elastics);
+}
+
+void Ensemble::clear()
+{
+    for (auto* v : { &sTheta, &sOmega, &sM, &sL, &sPx, &sPy,
+                     &dTheta1, &dTheta2, &dOmega1, &dOmega2, &dM1, &dM2, &dL1, &dL2, &dPx, &dPy,
+                     &fTheta, &fOmega, &fPhase, &fM, &fL, &fAmplitude, &fFrequency, &fPx, &fPy,
+                     &eTheta, &eOmega, &eR, &eVr, &eM, &eL, &eK, &ePx, &ePy })
+        v->clear();
+    sFrozen.clear();
+    dFrozen.clear();
+    fFrozen.clear();
+    eFrozen.clear();
+}
+
+SingleColumns Ensemble::singles()
+{
+    SingleColumns c;
+    c.count = sTheta.size();
+    c.theta = sTheta.data();
+    c.omega = sOmega.data();
+    c.m = sM.data();
+    c.L = sL.data();
+    c.px = sPx.data();
+    c.py = sPy.data();
+    c.frozen = sFrozen.data();
+    return c;
+}
+
+DoubleColumns Ensemble::doubles()
+{
+    DoubleColumns c;
+    c.count = dTheta1.size();
+    c.theta1 = dTheta1.data();
+    c.theta2 = dTheta2.data();
+    c.omega1 = dOmega1.data();
+    c.omega2 = dOmega2.data();
+    c.m1 = dM1.data();
+    c.m2 = dM2.data();
+    c.L1 = dL1.data();
+    c.L2 = dL2.data();
+    c.px = dPx.data();
+    c.py = dPy.data();
+    c.frozen = dFrozen.data();
+    return c;
+}
+
+DrivenColumns Ensemble::drivens()
+{
+    DrivenColumns c;
+    c.count = fTheta.size();
+    c.theta = fTheta.data();
+    c.omega = fOmega.data();
+    c.phase = fPhase.data();
+    c.m = fM.data();
+    c.L = fL.data();
+    c.amplitude = fAmplitude.data();
+    c.frequency = fFrequency.data();
+    c.px = fPx.data();
+    c.py = fPy.data();
+    c.frozen = fFrozen.data();
+    return c;
+}
+
+ElasticColumns Ensemble::elastics()
+{
+    ElasticColumns c;
+    c.count = eTheta.size();
+    c.theta = eTheta.data();
+    c.omega = eOmega.data();
+    c.r = eR.data();
+    c.vr = eVr.data();
+    c.m = eM.data();
+    c.L = eL.data();
+    c.k = eK.data();
+    c.px = ePx.data();
+    c.py = ePy.data();
+    c.frozen = eFrozen.data();
+    return c;
+}
+
+void Ensemble::step(float damping, float g, float dt, size_t steps)
+{
+    SingleColumns s = singles();
+    DoubleColumns d = doubles();
+    DrivenColumns f = drivens();
+    ElasticColumns e = elastics();
+    Batch::stepSingles(s, 0, s.count, damping, g, dt, steps);
+    Batch::stepDoubles(d, 0, d.count, damping, g, dt, steps);
+    Batch::stepDrivens(f, 0, f.count, damping, g, dt, steps);
+    Batch::stepElastics(e, 0, e.count, damping, g, dt, steps);
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Column views over a batch of pendulums. They do not own the memory, so the
+// same kernels step an Ensemble or a scene file mapped straight from disk.
+// Kernels are instantiated for float and double.
+template <typename Real>
+struct SingleColumnsT
+{
+    size_t count = 0;
+    Real* theta = nullptr;
+    Real* omega = nullptr;
+    Real* m = nullptr;
+    Real* L = nullptr;
+    Real* px = nullptr;
+    Real* py = nullptr;
+    uint8_t* frozen = nullptr;
+};
+
+template <typename Real>
+struct DoubleColumnsT
+{
+    size_t count = 0;
+    Real* theta1 = nullptr;
+    Real* theta2 = nullptr;
+    Real* omega1 = nullptr;
+    Real* omega2 = nullptr;
+    Real* m1 = nullptr;
+    Real* m2 = nullptr;
+    Real* L1 = nullptr;
+    Real* L2 = nullptr;
+    Real* px = nullptr;
+    Real* py = nullptr;
+    uint8_t* frozen = nullptr;
+};
+
+// Single pendulums driven by a sinusoidal torque (Physics::stepDriven),
+// each with its own drive amplitude, frequency and current drive phase.
+template <typename Real>
+struct DrivenColumnsT
+{
+    size_t count = 0;
+    Real* theta = nullptr;
+    Real* omega = nullptr;
+    Real* phase = nullptr;
+    Real* m = nullptr;
+    Real* L = nullptr;
+    Real* amplitude = nullptr;
+    Real* frequency = nullptr;
+    Real* px = nullptr;
+    Real* py = nullptr;
+    uint8_t* frozen = nullptr;
+};
+
+// Single pendulums on springs (Physics::stepElastic): r is the current rod
+// length and vr its rate of change, L the spring's rest length and k its
+// stiffness.
+template <typename Real>
+struct ElasticColumnsT
+{
+    size_t count = 0;
+    Real* theta = nullptr;
+    Real* omega = nullptr;
+    Real* r = nullptr;
+    Real* vr = nullptr;
+    Real* m = nullptr;
+    Real* L = nullptr;
+    Real* k = nullptr;
+    Real* px = nullptr;
+    Real* py = nullptr;
+    uint8_t* frozen = nullptr;
+};
+
+using SingleColumns = SingleColumnsT<float>;
+using DoubleColumns = DoubleColumnsT<float>;
+using DrivenColumns = DrivenColumnsT<float>;
+using ElasticColumns = ElasticColumnsT<float>;
+
+namespace Batch
+{
+    // Advances pendulums [begin, end) by steps steps of dt, using the kernel
+    // build for the active instruction set level (BatchKernels.h).
+    template <typename Real>
+    void stepSingles(const SingleColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps = 1);
+    template <typename Real>
+    void stepDoubles(const DoubleColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps = 1);
+    template <typename Real>
+    void stepDrivens(const DrivenColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps = 1);
+    template <typename Real>
+    void stepElastics(const ElasticColumnsT<Real>& c, size_t begin, size_t end, Real damping, Real g, Real dt, size_t steps = 1);
+}
+
+// Owning column storage for pendulums stepped by the batch kernels.
+struct Ensemble
+{
+    void addSingle(float theta, float omega, float m, float L, float px = 0.0f, float py = 0.0f);
+    void addDouble(float theta1, float theta2, float omega1, float omega2,
+                   float m1, float m2, float L1, float L2, float px = 0.0f, float py = 0.0f);
+    void addDriven(float theta, float omega, float m, float L, float amplitude, float frequency,
+                   float phase = 0.0f, float px = 0.0f, float py = 0.0f);
+    void addElastic(float theta, float omega, float r, float vr, float m, float L, float k,
+                    float px = 0.0f, float py = 0.0f);
+    void reserve(size_t singles, size_t doubles, size_t drivens = 0, size_t elastics = 0);
+    void clear();
+
+    SingleColumns singles();
+    DoubleColumns doubles();
+    DrivenColumns drivens();
+    ElasticColumns elastics();
+    size_t size() const { return sTheta.size() + dTheta1.size() + fTheta.size() + eTheta.size(); }
+
+    void step(float damping, float g, float dt, size_t steps = 1);
+
+    std::vector<float> sTheta, sOmega, sM, sL, sPx, sPy;
+    std::vector<uint8_t> sFrozen;
+    std::vector<float> dTheta1, dTheta2, dOmega1, dOmega2, dM1, dM2, dL1, dL2, dPx, dPy;
+    std::vector<uint8_t> dFrozen;
+    // Driven (forced) singles
+    std::vector<float> fTheta, fOmega, fPhase, fM, fL, fAmplitude, fFrequency, fPx, fPy;
+    std::vector<uint8_t> fFrozen;
+    // Elastic (spring) singles
+    std::vector<float> eTheta, eOmega, eR, eVr, eM, eL, eK, ePx, ePy;
+    std::vector<uint8_t> eFrozen;
+};
@@ -0,0 +1,115 @@
+#include "FrameStats.h"
+#include "imgui/imgui.h"
+#include <algorithm>
+#include <cstdio>
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+void RollingSeries::push(float value)
+{
+    values[head] = value;
+    head = (head + 1) % Capacity;
+    if (count < Capacity)
+        ++count;
+}
+
+RollingSeries::Summary RollingSeries::summarize() const
+{
+    Summary s;
+    if (count == 0)
+        return s;
+    std::copy(values, values + count, scratch);
+    std::sort(scratch, scratch + count);
+    // Nearest-rank percentiles
+    auto rank = [&](float p) { return scratch[std::min(count - 1, (size_t)(p * count))]; };
+    s.p50 = rank(0.50f);
+    s.p95 = rank(0.95f);
+    s.p99 = rank(0.99f);
+    s.max = scratch[count - 1];
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i)
+        sum += scratch[i];
+    s.mean = (float)(sum / count);
+    return s;
+}
+
+const char* FrameStats::name(Phase phase)
+{
+    static const char* names[PhaseCount] = { "Frame", "Physics", "Render", "UI" };
+    return names[phase];
+}
+
+void FrameStats::draw(bool* open) const
+{
+    ImGui::SetNextWindowBgAlpha(0.8f);
+    if (!ImGui::Begin("Performance", open, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::End();
+        return;
+    }
+
+    char overlay[64];
+    for (int p = 0; p < PhaseCount; ++p)
+    {
+        const RollingSeries& series = phases[p];
+        RollingSeries::Summary s = series.summarize();
+        std::snprintf(overlay, sizeof(overlay), "%s %.2f ms", name((Phase)p), series.latest());
+        // Keep the scale steady at a 30 Hz frame unless something spikes past it
+        float scale = std::max(33.3f, s.max);
+        ImGui::PushID(p);
+        ImGui::PlotHistogram("##phase", series.data(), (int)series.size(), (int)series.offset(), overlay,
+                             0.0f, scale, ImVec2(320.0f, 48.0f));
+        ImGui::PopID();
+        ImGui::SameLine();
+        ImGui::Text("p50 %.2f\np95 %.2f\np99 %.2f\nmax %.2f", s.p50, s.p95, s.p99, s.max);
+    }
+
+    RollingSeries::Summary steps = substeps.summarize();
+    ImGui::Text("Substeps per frame %.0f (max %.0f)", substeps.latest(), steps.max);
+    ImGui::Text("Active pendulums %zu", activePendulums);
+    ImGui::Text("Trail vertices drawn %zu", trailVertices);
+    ImGui::Text("Trail memory %.1f MB", trailBytes / (1024.0 * 1024.0));
+    if (processBytes)
+        ImGui::Text("Process memory %.1f MB", processBytes / (1024.0 * 1024.0));
+    if (!kernels.empty())
+        ImGui::Text("Kernels %s", kernels.c_str());
+
+    ImGui::Text("Allocations last frame %llu (%llu bytes), most in a frame %.0f",
+                (unsigned long long)allocations[Frame], (unsigned long long)allocatedBytes[Frame],
+                frameAllocations.summarize().max);
+    for (int p = Physics; p < PhaseCount; ++p)
+        ImGui::Text("  %s %llu (%llu bytes)", name((Phase)p), (unsigned long long)allocations[p],
+                    (unsigned long long)allocatedBytes[p]);
+    ImGui::End();
+}
+
+size_t ProcessMemoryBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize;
+    return 0;
+#else
+    // Second field of statm is the resident set in pages; read without stdio so nothing is allocated
+    int fd = ::open("/proc/self/statm", O_RDONLY);
+    if (fd < 0)
+        return 0;
+    char text[128];
+    ssize_t n = ::read(fd, text, sizeof(text) - 1);
+    ::close(fd);
+    if (n <= 0)
+        return 0;
+    text[n] = '\0';
+    unsigned long long size = 0, resident = 0;
+    if (std::sscanf(text, "%llu %llu", &size, &resident) != 2)
+        return 0;
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The most recent values of one per-frame metric, kept in a fixed array so
+// pushing and summarizing never allocate.
+class RollingSeries
+{
+public:
+    static constexpr size_t Capacity = 512;
+
+    struct Summary
+    {
+        float p50 = 0, p95 = 0, p99 = 0, max = 0, mean = 0;
+    };
+
+    void push(float value);
+    void clear() { head = count = 0; }
+    size_t size() const { return count; }
+    float latest() const { return count ? values[(head + Capacity - 1) % Capacity] : 0.0f; }
+    // Oldest value first when read from offset(), as ImGui's plots expect
+    const float* data() const { return values; }
+    size_t offset() const { return count == Capacity ? head : 0; }
+    Summary summarize() const;
+
+private:
+    float values[Capacity] = {};
+    mutable float scratch[Capacity];
+    size_t head = 0;
+    size_t count = 0;
+};
+
+// Frame-time readout: phase timings with rolling histograms and
+// percentiles, plus the load the frame carried.
+struct FrameStats
+{
+    enum Phase
+    {
+        Frame, Physics, Render, UI, PhaseCount
+    };
+
+    RollingSeries phases[PhaseCount];
+    RollingSeries substeps;
+    size_t activePendulums = 0;
+    size_t trailVertices = 0;
+    size_t trailBytes = 0;
+    size_t processBytes = 0;
+    // Heap allocations the main thread made in each phase of the last frame
+    uint64_t allocations[PhaseCount] = {};
+    uint64_t allocatedBytes[PhaseCount] = {};
+    RollingSeries frameAllocations;
+    // Instruction set the batch kernels run on (Cpu::report)
+    std::string kernels;
+
+    static double nowMs()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static const char* name(Phase phase);
+
+    void draw(bool* open) const;
+};
+
+// Resident memory of the process, 0 where it cannot be read
+size_t ProcessMemoryBytes();
@@ -0,0 +1,57 @@
+#include "ImageFile.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace
+{
+    bool writeNetpbm(const std::string& path, const char* magic, size_t width, size_t height, size_t channels,
+                     const uint8_t* pixels, std::string& error)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            error = "Cannot create " + path;
+            return false;
+        }
+        out << magic << '\n' << width << ' ' << height << "\n255\n";
+        out.write(reinterpret_cast<const char*>(pixels), (std::streamsize)(width * height * channels));
+        if (!out)
+        {
+            error = "Cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    template <typename Count>
+    void scaleCounts(const Count* counts, size_t size, std::vector<uint8_t>& pixels)
+    {
+        pixels.resize(size);
+        Count most = size ? *std::max_element(counts, counts + size) : 0;
+        // A single hit still shows up clearly against the black
+        const float scale = most ? 200.0f / std::log1p((float)most) : 0.0f;
+        for (size_t i = 0; i < size; ++i)
+            pixels[i] = counts[i] ? (uint8_t)std::min(255.0f, 55.0f + std::log1p((float)counts[i]) * scale) : 0;
+    }
+}
+
+bool ImageFile::writePgm(const std::string& path, size_t width, size_t height, const uint8_t* pixels, std::string& error)
+{
+    return writeNetpbm(path, "P5", width, height, 1, pixels, error);
+}
+
+bool ImageFile::writePpm(const std::string& path, size_t width, size_t height, const uint8_t* pixels, std::string& error)
+{
+    return writeNetpbm(path, "P6", width, height, 3, pixels, error);
+}
+
+void ImageFile::logScale(const uint32_t* counts, size_t size, std::vector<uint8_t>& pixels)
+{
+    scaleCounts(counts, size, pixels);
+}
+
+void ImageFile::logScale(const uint64_t* counts, size_t size, std::vector<uint8_t>& pixels)
+{
+    scaleCounts(counts, size, pixels);
+}
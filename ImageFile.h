@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Images written by the batch tools: binary PGM and PPM, which every image
+// viewer and converter reads and which need nothing to write.
+namespace ImageFile
+{
+    // One byte per pixel, rows top to bottom
+    bool writePgm(const std::string& path, size_t width, size_t height, const uint8_t* pixels, std::string& error);
+    // Three bytes per pixel, RGB
+    bool writePpm(const std::string& path, size_t width, size_t height, const uint8_t* pixels, std::string& error);
+
+    // Maps hit counts to grey levels on a log scale, so sparse and dense
+    // regions both stay visible. Empty cells are black.
+    void logScale(const uint32_t* counts, size_t size, std::vector<uint8_t>& pixels);
+    void logScale(const uint64_t* counts, size_t size, std::vector<uint8_t>& pixels);
+}
@@ -1,12 +1,28 @@
 #define NOMINMAX
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <cmath>
+#include <fstream>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <csignal>
 #include "Renderer.h"
 #include "Pendulums.h"
+#include "Recorder.h"
+#include "Playback.h"
+#include "Trace.h"
+#include "Counters.h"
+#include "FrameStats.h"
+#include "AllocTracker.h"
+#include "Cpu.h"
+#include "SharedState.h"
+#include "Checkpoint.h"
+#include "PoincareView.h"
+#include "SpectrumView.h"
+#include "DensityView.h"
 #include <string>
 #define _USE_MATH_DEFINES
 
@@ -15,8 +31,77 @@ std::vector<std::shared_ptr<PendulumLike>> PendulumVec = {};
 float g = 9.807;
 float damping = 0.05f;
 
+// One row of the hardware counter overlay
+static void DrawCounterRow(const char* phase, const PerfCounters::Sample& s)
+{
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::TextUnformatted(phase);
+    ImGui::TableNextColumn();
+    ImGui::Text("%.2fM", s.values[PerfCounters::Cycles] / 1e6);
+    ImGui::TableNextColumn();
+    ImGui::Text("%.2f", s.ipc());
+    ImGui::TableNextColumn();
+    ImGui::Text("%.1f%%", s.percent(PerfCounters::CacheMisses, PerfCounters::CacheReferences));
+    ImGui::TableNextColumn();
+    ImGui::Text("%.2f%%", s.percent(PerfCounters::BranchMisses, PerfCounters::Branches));
+    ImGui::TableNextColumn();
+    if (s.valid[PerfCounters::Flops])
+        ImGui::Text("%.2fM", s.values[PerfCounters::Flops] / 1e6);
+    else
+        ImGui::TextUnformatted("n/a");
+}
 
-int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
+static void LogCounters(std::ostream& out, size_t frame, const char* phase, const PerfCounters::Sample& s)
+{
+    out << frame << ',' << phase;
+    for (int e = 0; e < PerfCounters::EventCount; ++e)
+    {
+        out << ',';
+        if (s.valid[e])
+            out << s.values[e];
+    }
+    out << ',' << s.ipc() << '\n';
+}
+
+
+// Stores the allocations made on this thread since the snapshot
+static void RecordAllocations(FrameStats& stats, FrameStats::Phase phase, const AllocTracker::Counts& since)
+{
+    AllocTracker::Counts made = AllocTracker::thread() - since;
+    stats.allocations[phase] = made.allocations;
+    stats.allocatedBytes[phase] = made.bytes;
+}
+
+static const char* DefaultShareName = "pendulum_state";
+
+// Publishes the shown pendulums, moving to a bigger segment when they outgrow it
+static bool PublishState(SharedState::Publisher& publisher, const std::vector<std::shared_ptr<PendulumLike>>& pendulums,
+                         uint64_t frame, double time, float g, float damping, std::string& error)
+{
+    if (pendulums.size() > publisher.capacity() && !publisher.grow(std::max<size_t>(1024, pendulums.size() * 2), error))
+        return false;
+    SharedState::Frame& f = publisher.begin();
+    Trajectory::PendulumInfo* infos = f.infos();
+    Trajectory::Sample* samples = f.samples(publisher.capacity());
+    size_t n = 0;
+    for (const auto& p : pendulums)
+    {
+        if (!p) continue;
+        infos[n] = DescribePendulum(*p);
+        samples[n] = SamplePendulum(*p);
+        ++n;
+    }
+    f.frame = frame;
+    f.time = time;
+    f.g = g;
+    f.damping = damping;
+    f.count = n;
+    publisher.end(f);
+    return true;
+}
+
+static int RunWindowed()
 {
     if (!glfwInit())
     {
@@ -68,28 +153,120 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 
     PendulumVec.reserve(128);
 
+    char scenePath[256] = "scene.pend";
+    bool sceneTrails = true;
+    std::string sceneStatus;
+
+    TrajectoryRecorder recorder;
+    std::vector<std::shared_ptr<PendulumLike>> recorded;
+    std::vector<Trajectory::Sample> recordSamples;
+    char recordPath[256] = "trajectory.prec";
+    int recordDecimation = 1;
+    bool recordPositions = false;
+    bool recordCompress = true;
+    std::string recordStatus;
+    double simTime = 0.0;
+
+    SharedState::Publisher sharedState;
+    bool sharing = false;
+    std::string shareStatus;
+    uint64_t frameNumber = 0;
+
+    TrajectoryPlayer player;
+    std::vector<std::shared_ptr<PendulumLike>> playbackPendulums;
+    std::vector<Trajectory::Sample> playbackSamples;
+    std::vector<std::pair<float, float>> playbackTrail;
+    char playbackPath[256] = "trajectory.prec";
+    double playbackTime = 0.0;
+    double playbackShown = -1.0;
+    float playbackSpeed = 1.0f;
+    bool playbackPlaying = false;
+    std::string playbackStatus;
+
+#if PENDULUM_TRACE
+    char tracePath[256] = "trace.json";
+    bool tracing = false;
+    std::string traceStatus;
+#endif
+    TRACE_THREAD("Main");
+
+    PerfCounters counters;
+    bool countersOn = false;
+    std::string countersStatus;
+    PerfCounters::Sample physicsCounters, renderCounters;
+
+    FrameStats frameStats;
+    frameStats.kernels = Cpu::report();
+    bool showStats = true;
+
+    Poincare::Recorder poincare;
+    PoincareView poincareView;
+    bool showPoincare = false;
+    Spectrum::Analyzer spectrum;
+    SpectrumView spectrumView;
+    bool showSpectrum = false;
+    Density::Histogram density;
+    DensityView densityView;
+    bool showDensity = false;
+    // Strict allocation mode only guards physics and render once the scene
+    // has had this many frames to reach its steady state
+    const int strictWarmupFrames = 120;
+    bool strictAllocations = false;
+    int strictFrames = 0;
+
     while (!glfwWindowShouldClose(window))
     {
+        TRACE_ZONE("Frame");
+        AllocTracker::Counts frameAllocs = AllocTracker::thread();
+        bool guarded = strictAllocations && strictFrames++ >= strictWarmupFrames;
         float currentTime = glfwGetTime();
         float deltaTime = currentTime - lastTime;
         lastTime = currentTime;
+        frameStats.phases[FrameStats::Frame].push(deltaTime * 1000.0f);
 
         if (trailTimers.size() != PendulumVec.size())
         {
             trailTimers.resize(PendulumVec.size(), 0.0f);
         }
+        if (showPoincare && poincare.pendulums() != PendulumVec.size())
+            poincare.reset(PendulumVec.size(), (size_t)poincareView.capacity);
+        if (showSpectrum && spectrum.pendulums() != PendulumVec.size())
+            spectrumView.reset(spectrum, PendulumVec.size());
+        if (showDensity && !density.workers())
+            densityView.reset(density);
 
         // -------- Physics update ----------
-        float t = deltaTime;
+        TRACE_BEGIN(physicsZone, "Physics");
+        double phaseStart = FrameStats::nowMs();
+        AllocTracker::Counts phaseAllocs = AllocTracker::thread();
+        AllocTracker::Guard physicsGuard("physics", guarded);
+        if (counters.isOpen())
+            counters.begin();
+        float t = player.isOpen() ? 0.0f : deltaTime;
+        int substeps = 0;
         while (t > 0.0f)
         {
+            TRACE_ZONE("Substep");
             float dtStep = std::min(physicsStep, t);
+            ++substeps;
+            bool sampleSpectrum = showSpectrum && spectrum.due(dtStep);
 
             for (size_t i = 0; i < PendulumVec.size(); ++i)
             {
                 auto& s = PendulumVec[i];
                 if (!s) continue;
+                DPendulum* d = (showPoincare || sampleSpectrum || showDensity) && s->getType() == DPend ? static_cast<DPendulum*>(s.get()) : nullptr;
+                Poincare::State before;
+                if (d)
+                    before = { { d->theta1, d->theta2, d->omega1, d->omega2 } };
                 s->update(damping, g, dtStep);
+                if (d && showPoincare)
+                    poincare.record(i, before, { { d->theta1, d->theta2, d->omega1, d->omega2 } },
+                                    { d->m1, d->m2, d->L1, d->L2, damping, g }, dtStep);
+                if (d && sampleSpectrum)
+                    spectrum.record(i, d->theta1, d->theta2);
+                if (d && showDensity)
+                    density.add(0, d->theta1, d->theta2, d->omega1, d->omega2);
 
                 trailTimers[i] += dtStep;
                 if (trailTimers[i] >= trailSample)
@@ -98,19 +275,88 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
                     s->AddTrailPoint();
                 }
             }
+            if (sampleSpectrum)
+                spectrum.commit();
+
+            if (recorder.isRecording())
+            {
+                TRACE_ZONE("Record samples");
+                for (size_t i = 0; i < recorded.size(); ++i)
+                    recordSamples[i] = SamplePendulum(*recorded[i]);
+                recorder.record(0, simTime, recordSamples.data());
+            }
+            simTime += dtStep;
             t -= dtStep;
         }
+        if (counters.isOpen())
+            physicsCounters = counters.end();
+        frameStats.phases[FrameStats::Physics].push((float)(FrameStats::nowMs() - phaseStart));
+        frameStats.substeps.push((float)substeps);
+        physicsGuard.end();
+        RecordAllocations(frameStats, FrameStats::Physics, phaseAllocs);
+        TRACE_END(physicsZone);
+
+        // -------- Playback ----------
+        if (player.isOpen())
+        {
+            TRACE_ZONE("Playback");
+            if (playbackPlaying)
+                playbackTime = std::min(playbackTime + deltaTime * playbackSpeed, player.endTime());
+            if (playbackTime != playbackShown && player.seek(playbackTime, playbackSamples))
+            {
+                // Extend trails while playing forward, rebuild them after a jump
+                bool forward = playbackShown >= 0.0 && playbackTime > playbackShown && playbackTime - playbackShown < 1.0;
+                for (size_t i = 0; i < playbackPendulums.size(); ++i)
+                {
+                    auto& p = playbackPendulums[i];
+                    ApplySample(*p, playbackSamples[i]);
+                    const Trajectory::PendulumInfo& info = player.pendulum(i);
+                    double from = forward ? playbackShown + 1e-9 : playbackTime - p->trail.getMaxSamples() * trailSample;
+                    if (!forward)
+                        p->clearTrail();
+                    player.positions(i, from, playbackTime, trailSample, playbackTrail);
+                    for (auto& xy : playbackTrail)
+                        p->trail.push(xy.first, xy.second, info.px, info.py, info.L1 + info.L2);
+                }
+                playbackShown = playbackTime;
+            }
+        }
+
+        if (sharedState.isOpen())
+        {
+            TRACE_ZONE("Share state");
+            auto& shown = player.isOpen() ? playbackPendulums : PendulumVec;
+            if (!PublishState(sharedState, shown, frameNumber, player.isOpen() ? playbackTime : simTime, g, damping, shareStatus))
+                sharing = false;
+        }
+        ++frameNumber;
 
         // -------- Render OpenGL ----------
+        TRACE_BEGIN(renderZone, "Render");
+        phaseStart = FrameStats::nowMs();
+        phaseAllocs = AllocTracker::thread();
+        AllocTracker::Guard renderGuard("render", guarded);
+        if (counters.isOpen())
+            counters.begin();
         glClear(GL_COLOR_BUFFER_BIT);
         glLoadIdentity();
 
-        for (auto& state : PendulumVec)
+        for (auto& state : player.isOpen() ? playbackPendulums : PendulumVec)
         {
             if (state) state->render();
         }
+        if (counters.isOpen())
+            renderCounters = counters.end();
+        frameStats.phases[FrameStats::Render].push((float)(FrameStats::nowMs() - phaseStart));
+        frameStats.trailVertices = Renderer::takeTrailVertexCount();
+        renderGuard.end();
+        RecordAllocations(frameStats, FrameStats::Render, phaseAllocs);
+        TRACE_END(renderZone);
 
         // -------- ImGui Frame ----------
+        TRACE_BEGIN(uiZone, "UI build");
+        phaseStart = FrameStats::nowMs();
+        phaseAllocs = AllocTracker::thread();
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -126,12 +372,177 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
             PendulumVec.push_back(std::make_shared<SPendulum>(/*Theta*/1.0f, /*Mass*/1.0f, /*Length*/0.5f));
             trailTimers.push_back(0.0f);
         }
+        if (ImGui::Button("Spawn Driven Pendulum"))
+        {
+            // Damping 0.5, drive 1.2 and frequency 2/3 in units of the natural
+            // frequency is the classic chaotic driven pendulum
+            float natural = std::sqrt(g / 0.5f);
+            PendulumVec.push_back(std::make_shared<DrivenPendulum>(/*Theta*/0.2f, /*Mass*/1.0f, /*Length*/0.5f,
+                                                                   1.2f * natural * natural, natural * 2.0f / 3.0f));
+            trailTimers.push_back(0.0f);
+        }
+        if (ImGui::Button("Spawn Elastic Pendulum"))
+        {
+            // Soft enough that the stretch shows; the stiffness slider goes to 1e6 N/m
+            PendulumVec.push_back(std::make_shared<ElasticPendulum>(/*Theta*/1.0f, /*Mass*/1.0f, /*Rest length*/0.5f,
+                                                                    /*Stiffness*/200.0f));
+            trailTimers.push_back(0.0f);
+        }
         if (ImGui::Button("Delete All Pendulums"))
         {
             PendulumVec.clear();
             trailTimers.clear();
         }
-        
+
+        ImGui::InputText("Scene File", scenePath, sizeof(scenePath));
+        ImGui::Checkbox("Save Trails", &sceneTrails);
+        if (ImGui::Button("Save Scene"))
+        {
+            std::string error;
+            sceneStatus = SaveScene(scenePath, g, damping, PendulumVec, sceneTrails, error) ? "Scene saved" : error;
+        }
+        if (ImGui::Button("Load Scene"))
+        {
+            std::string error;
+            sceneStatus = LoadScene(scenePath, g, damping, PendulumVec, error) ? "Scene loaded" : error;
+            trailTimers.assign(PendulumVec.size(), 0.0f);
+        }
+        if (!sceneStatus.empty())
+            ImGui::Text("%s", sceneStatus.c_str());
+
+        if (!recorder.isRecording())
+        {
+            ImGui::InputText("Trajectory File", recordPath, sizeof(recordPath));
+            ImGui::SliderInt("Record Every N Steps", &recordDecimation, 1, 100);
+            ImGui::Checkbox("Record Bob Positions", &recordPositions);
+            ImGui::Checkbox("Compress Trajectory", &recordCompress);
+            if (ImGui::Button("Start Recording"))
+            {
+                TrajectoryRecorder::Options options;
+                options.path = recordPath;
+                options.decimation = (uint32_t)recordDecimation;
+                options.positions = recordPositions;
+                options.compress = recordCompress;
+                recorded.clear();
+                for (auto& p : PendulumVec)
+                {
+                    if (p && p->isRecorded)
+                    {
+                        recorded.push_back(p);
+                        options.pendulums.push_back(DescribePendulum(*p));
+                    }
+                }
+                recordSamples.resize(recorded.size());
+                std::string error;
+                recordStatus = recorder.start(options, error) ? "" : error;
+            }
+        }
+        else
+        {
+            ImGui::Text("Recording %d pendulums", (int)recorded.size());
+            if (ImGui::Button("Stop Recording"))
+            {
+                std::string error;
+                recordStatus = recorder.stop(error) ? "" : error;
+            }
+            else if (recorder.writeFailed())
+                ImGui::Text("Writing the trajectory failed");
+        }
+        if (recorder.writtenChunks() > 0 || recorder.droppedChunks() > 0)
+            ImGui::Text("Chunks written %llu, dropped %llu, %.1f MB",
+                        (unsigned long long)recorder.writtenChunks(), (unsigned long long)recorder.droppedChunks(),
+                        recorder.bytesWritten() / (1024.0 * 1024.0));
+        if (!recordStatus.empty())
+            ImGui::Text("%s", recordStatus.c_str());
+
+        if (!player.isOpen())
+        {
+            ImGui::InputText("Playback File", playbackPath, sizeof(playbackPath));
+            if (ImGui::Button("Open Playback"))
+            {
+                std::string error;
+                playbackStatus = player.open(playbackPath, error) ? "" : error;
+                playbackPendulums.clear();
+                for (size_t i = 0; i < player.pendulumCount(); ++i)
+                    playbackPendulums.push_back(MakePendulum(player.pendulum(i)));
+                playbackTime = player.startTime();
+                playbackShown = -1.0;
+                playbackPlaying = false;
+            }
+        }
+        else
+        {
+            double start = player.startTime(), end = player.endTime();
+            ImGui::SliderScalar("Playback Time", ImGuiDataType_Double, &playbackTime, &start, &end, "%.3f s");
+            ImGui::Checkbox("Play", &playbackPlaying);
+            ImGui::SliderFloat("Playback Speed", &playbackSpeed, 0.1f, 10.0f);
+            if (player.droppedChunks() > 0)
+                ImGui::Text("Recording dropped %llu chunks", (unsigned long long)player.droppedChunks());
+            if (ImGui::Button("Close Playback"))
+            {
+                player.close();
+                playbackPendulums.clear();
+            }
+        }
+        if (!playbackStatus.empty())
+            ImGui::Text("%s", playbackStatus.c_str());
+
+#if PENDULUM_TRACE
+        if (ImGui::Checkbox("Trace Frames", &tracing))
+            Trace::setEnabled(tracing);
+        ImGui::InputText("Trace File", tracePath, sizeof(tracePath));
+        if (ImGui::Button("Dump Trace"))
+        {
+            std::string error;
+            traceStatus = Trace::writeChromeJson(tracePath, error) ? std::string("Trace written to ") + tracePath : error;
+        }
+        if (!traceStatus.empty())
+            ImGui::Text("%s", traceStatus.c_str());
+#endif
+
+        if (ImGui::Checkbox("Share State", &sharing))
+        {
+            shareStatus.clear();
+            if (sharing && !sharedState.open(DefaultShareName, std::max<size_t>(1024, PendulumVec.size() * 2), shareStatus))
+                sharing = false;
+            else if (!sharing)
+                sharedState.close();
+        }
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Publish every frame to shared memory for dashboards and other local readers");
+        if (sharedState.isOpen())
+            ImGui::Text("Publishing to %s", DefaultShareName);
+        else if (!shareStatus.empty())
+            ImGui::Text("%s", shareStatus.c_str());
+
+        if (ImGui::Checkbox("Hardware Counters", &countersOn))
+        {
+            countersStatus.clear();
+            if (countersOn && !counters.open(countersStatus))
+                countersOn = false;
+            else if (!countersOn)
+                counters.close();
+        }
+        if (!countersStatus.empty())
+            ImGui::Text("%s", countersStatus.c_str());
+        ImGui::Checkbox("Show Performance", &showStats);
+        ImGui::Checkbox("Poincare Section", &showPoincare);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Record where double pendulums cross a section of phase space and plot the crossings");
+        ImGui::Checkbox("Spectrum", &showSpectrum);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Sample the angles of double pendulums and plot their power spectra live");
+        ImGui::Checkbox("Invariant Density", &showDensity);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Histogram where double pendulums spend their time in phase space, every step");
+        if (ImGui::Checkbox("Strict Allocations", &strictAllocations))
+        {
+            AllocTracker::setStrict(strictAllocations);
+            strictFrames = 0;
+        }
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Abort on any heap allocation in physics or render after %d warmup frames", strictWarmupFrames);
+
         ImGui::SliderFloat("Damping", &damping, 0.0f, 1.0f);
 
         ImGui::SliderFloat("Gravity", &g, 0.0f, 1000.f);
@@ -150,8 +561,60 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
         if (ImGui::Button("Sun Gravity"))
             g = 274.0f;
 
+        ImVec2 controlsPos = ImGui::GetWindowPos();
+        ImVec2 controlsSize = ImGui::GetWindowSize();
         ImGui::End();
 
+        if (counters.isOpen())
+        {
+            ImGui::SetNextWindowPos(ImVec2(controlsPos.x + controlsSize.x + 8.0f, controlsPos.y), ImGuiCond_FirstUseEver);
+            ImGui::Begin("Hardware Counters", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+            if (ImGui::BeginTable("counters", 6, ImGuiTableFlags_Borders))
+            {
+                for (const char* header : { "Phase", "Cycles", "IPC", "Cache miss", "Branch miss", "FLOPs" })
+                    ImGui::TableSetupColumn(header);
+                ImGui::TableHeadersRow();
+                DrawCounterRow("Physics", physicsCounters);
+                DrawCounterRow("Render", renderCounters);
+                ImGui::EndTable();
+            }
+            ImGui::End();
+        }
+
+        if (showPoincare)
+        {
+            ImGui::SetNextWindowPos(ImVec2(controlsPos.x, controlsPos.y + controlsSize.y + 8.0f), ImGuiCond_FirstUseEver);
+            poincareView.draw(poincare, &showPoincare);
+        }
+
+        if (showSpectrum)
+        {
+            ImGui::SetNextWindowPos(ImVec2(controlsPos.x + controlsSize.x + 8.0f, controlsPos.y + controlsSize.y + 8.0f),
+                                    ImGuiCond_FirstUseEver);
+            spectrumView.draw(spectrum, &showSpectrum);
+        }
+
+        if (showDensity)
+        {
+            ImGui::SetNextWindowPos(ImVec2(controlsPos.x + 2.0f * (controlsSize.x + 8.0f), controlsPos.y + controlsSize.y + 8.0f),
+                                    ImGuiCond_FirstUseEver);
+            densityView.draw(density, &showDensity);
+        }
+
+        if (showStats)
+        {
+            frameStats.activePendulums = 0;
+            frameStats.trailBytes = 0;
+            for (auto& p : player.isOpen() ? playbackPendulums : PendulumVec)
+            {
+                if (!p) continue;
+                frameStats.activePendulums += !p->isFreezed;
+                frameStats.trailBytes += p->trail.memoryBytes();
+            }
+            frameStats.processBytes = ProcessMemoryBytes();
+            frameStats.draw(&showStats);
+        }
+
         for (size_t i = 0; i < PendulumVec.size(); ++i)
         {
             PendulumVec[i]->drawUI(i, PendulumVec);
@@ -161,17 +624,494 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
             trailTimers.resize(PendulumVec.size(), 0.0f);
         }
 
+        TRACE_END(uiZone);
+
+        TRACE_BEGIN(uiRenderZone, "UI render");
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        frameStats.phases[FrameStats::UI].push((float)(FrameStats::nowMs() - phaseStart));
+        RecordAllocations(frameStats, FrameStats::UI, phaseAllocs);
+        RecordAllocations(frameStats, FrameStats::Frame, frameAllocs);
+        frameStats.frameAllocations.push((float)frameStats.allocations[FrameStats::Frame]);
+        TRACE_END(uiRenderZone);
 
+        TRACE_BEGIN(swapZone, "Swap buffers");
         glfwSwapBuffers(window);
+        TRACE_END(swapZone);
+        TRACE_BEGIN(eventsZone, "Poll events");
         glfwPollEvents();
+        TRACE_END(eventsZone);
     }
 
     // -------- Cleanup ----------
+    std::string recordError;
+    if (!recorder.stop(recordError))
+        std::cerr << recordError << "\n";
+    densityView.release();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
     glfwTerminate();
     return 0;
 }
+
+// Everything a headless run carries from one frame to the next besides
+// the pendulums and physics settings, as saved in checkpoints
+struct HeadlessState
+{
+    uint64_t frame = 0;
+    float frameTime = 1.0f / 60.0f;
+    std::vector<float> trailTimers;
+    // Allocations per phase summed over the frames after warmup, and the most in one frame
+    AllocTracker::Counts steadyAllocs[FrameStats::PhaseCount];
+    uint64_t steadyMax[FrameStats::PhaseCount] = {};
+    PerfCounters::Sample counterTotals[2];
+};
+
+static void SaveHeadlessState(std::vector<uint8_t>& buffer, const HeadlessState& state)
+{
+    TRACE_ZONE("Snapshot");
+    buffer.clear();
+    Checkpoint::Writer out(buffer);
+    out.pod(state.frame);
+    out.pod(state.frameTime);
+    out.pod(g);
+    out.pod(damping);
+    out.array(state.trailTimers);
+    out.pod(state.steadyAllocs);
+    out.pod(state.steadyMax);
+    out.pod(state.counterTotals);
+    SavePendulumState(out, PendulumVec);
+}
+
+static bool LoadHeadlessState(const std::string& path, HeadlessState& state, std::string& error)
+{
+    std::vector<uint8_t> payload;
+    if (!Checkpoint::readFile(path, payload, error))
+        return false;
+    // Nothing changes until the whole checkpoint has been read and checked
+    HeadlessState loaded;
+    float loadedG = 0.0f, loadedDamping = 0.0f;
+    std::vector<std::shared_ptr<PendulumLike>> pendulums;
+    Checkpoint::Reader in(payload.data(), payload.size());
+    in.pod(loaded.frame);
+    in.pod(loaded.frameTime);
+    in.pod(loadedG);
+    in.pod(loadedDamping);
+    in.array(loaded.trailTimers);
+    in.pod(loaded.steadyAllocs);
+    in.pod(loaded.steadyMax);
+    in.pod(loaded.counterTotals);
+    if (!in.ok() || !LoadPendulumState(in, pendulums, error))
+    {
+        if (error.empty())
+            error = path + " is truncated";
+        return false;
+    }
+    if (loaded.trailTimers.size() != pendulums.size() || !in.atEnd())
+    {
+        error = path + " does not match its pendulums";
+        return false;
+    }
+    state = std::move(loaded);
+    g = loadedG;
+    damping = loadedDamping;
+    PendulumVec = std::move(pendulums);
+    return true;
+}
+
+static volatile std::sig_atomic_t StopRequested = 0;
+
+static void RequestStop(int)
+{
+    StopRequested = 1;
+}
+
+// Runs the simulation without the UI for a fixed number of frames, for
+// profiling and scripted runs:
+//   --headless [--frames=600] [--dt=0.016667] [--scene=file | --pendulums=100]
+//   [--counters[=file.csv]] [--trace=file.json] [--no-render]
+//   [--strict-alloc[=warmupFrames]] [--isa=sse2|avx2|avx512] [--share[=name]]
+//   [--checkpoint=file [--checkpoint-every=3600]] [--resume=file]
+// Rendering goes to a hidden window so the render phase still runs.
+// Checkpoints are taken every so many frames, at the end, and on SIGTERM or
+// SIGINT, which stop the run after the current frame; --resume continues
+// from one up to --frames in total, bit for bit as if never stopped.
+static int RunHeadless(const std::vector<std::string>& args)
+{
+    size_t frames = 600;
+    HeadlessState state;
+    float& frameTime = state.frameTime;
+    size_t pendulums = 100;
+    std::string scenePath, countersPath, tracePath;
+    bool countersOn = false;
+    bool render = true;
+    bool strictAlloc = false;
+    size_t warmupFrames = 60;
+    std::string shareName;
+    std::string checkpointPath, resumePath;
+    size_t checkpointEvery = 3600;
+    for (const std::string& arg : args)
+    {
+        auto value = [&](const char* key, std::string& out) {
+            size_t len = std::string(key).size();
+            if (arg.compare(0, len, key) != 0)
+                return false;
+            out = arg.substr(len);
+            return true;
+        };
+        std::string v;
+        try
+        {
+            if (arg == "--headless" || arg.compare(0, 6, "--isa=") == 0)
+                continue;
+            else if (value("--frames=", v))
+                frames = std::stoul(v);
+            else if (value("--dt=", v))
+                frameTime = std::stof(v);
+            else if (value("--pendulums=", v))
+                pendulums = std::stoul(v);
+            else if (value("--scene=", v))
+                scenePath = v;
+            else if (value("--counters=", v))
+                countersOn = true, countersPath = v;
+            else if (arg == "--counters")
+                countersOn = true;
+            else if (value("--trace=", v))
+                tracePath = v;
+            else if (arg == "--no-render")
+                render = false;
+            else if (value("--strict-alloc=", v))
+                strictAlloc = true, warmupFrames = std::stoul(v);
+            else if (arg == "--strict-alloc")
+                strictAlloc = true;
+            else if (value("--share=", v))
+                shareName = v;
+            else if (arg == "--share")
+                shareName = DefaultShareName;
+            else if (value("--checkpoint=", v))
+                checkpointPath = v;
+            else if (value("--checkpoint-every=", v))
+                checkpointEvery = std::max<size_t>(1, std::stoul(v));
+            else if (value("--resume=", v))
+                resumePath = v;
+            else
+            {
+                std::cerr << "Unknown argument " << arg << "\n";
+                return 1;
+            }
+        }
+        catch (const std::exception&)
+        {
+            std::cerr << "Bad value in " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (!resumePath.empty())
+    {
+        std::string error;
+        if (!LoadHeadlessState(resumePath, state, error))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        std::cerr << "Resuming at frame " << state.frame << " with " << PendulumVec.size() << " pendulums\n";
+    }
+    else if (!scenePath.empty())
+    {
+        std::string error;
+        if (!LoadScene(scenePath, g, damping, PendulumVec, error))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < pendulums; ++i)
+        {
+            float spread = pendulums > 1 ? (float)i / (pendulums - 1) : 0.0f;
+            PendulumVec.push_back(std::make_shared<DPendulum>(1.0f + 0.5f * spread, 1.0f, 1.0f, 1.0f, 0.6f, 0.4f));
+        }
+    }
+
+    GLFWwindow* window = nullptr;
+    if (render && glfwInit())
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(1280, 720, "Double Pendulum Simulation", nullptr, nullptr);
+        if (window)
+        {
+            glfwMakeContextCurrent(window);
+            glewInit();
+            glMatrixMode(GL_PROJECTION);
+            glLoadIdentity();
+            glOrtho(-1280.0 / 720.0, 1280.0 / 720.0, -1.0, 1.0, -1, 1);
+            glMatrixMode(GL_MODELVIEW);
+        }
+    }
+    if (render && !window)
+        std::cerr << "No OpenGL context, running physics only\n";
+
+    PerfCounters counters;
+    std::ofstream countersFile;
+    std::ostream* countersOut = &std::cout;
+    if (countersOn)
+    {
+        std::string error;
+        if (!counters.open(error))
+            std::cerr << error << "\n";
+        else if (!countersPath.empty())
+        {
+            countersFile.open(countersPath, std::ios::trunc);
+            if (!countersFile)
+            {
+                std::cerr << "Cannot create " << countersPath << "\n";
+                return 1;
+            }
+            countersOut = &countersFile;
+        }
+        if (counters.isOpen())
+        {
+            *countersOut << "frame,phase";
+            for (int e = 0; e < PerfCounters::EventCount; ++e)
+                *countersOut << ',' << PerfCounters::name((PerfCounters::Event)e);
+            *countersOut << ",ipc\n";
+        }
+    }
+
+    if (!tracePath.empty())
+        Trace::setEnabled(true);
+    TRACE_THREAD("Main");
+
+    const float physicsStep = 0.001f;
+    const float trailSample = 0.01f;
+    std::vector<float>& trailTimers = state.trailTimers;
+    trailTimers.resize(PendulumVec.size(), 0.0f);
+    SharedState::Publisher sharedState;
+    if (!shareName.empty())
+    {
+        std::string error;
+        if (!sharedState.open(shareName, std::max<size_t>(1024, PendulumVec.size() * 2), error))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+    }
+
+    PerfCounters::Sample* total = state.counterTotals;
+    FrameStats frameStats;
+    std::cerr << "Kernels: " << Cpu::report() << "\n";
+    AllocTracker::setStrict(strictAlloc);
+    AllocTracker::Counts* steadyAllocs = state.steadyAllocs;
+    uint64_t* steadyMax = state.steadyMax;
+
+    Checkpoint::BackgroundWriter checkpointWriter;
+    std::vector<uint8_t> snapshot;
+    if (!checkpointPath.empty())
+    {
+        std::signal(SIGINT, RequestStop);
+        std::signal(SIGTERM, RequestStop);
+    }
+
+    size_t frame = (size_t)state.frame;
+    for (; frame < frames && !StopRequested; ++frame)
+    {
+        TRACE_ZONE("Frame");
+        double frameStart = FrameStats::nowMs();
+        bool steady = frame >= warmupFrames;
+        AllocTracker::Counts frameAllocs = AllocTracker::thread();
+
+        TRACE_BEGIN(physicsZone, "Physics");
+        AllocTracker::Guard physicsGuard("physics", strictAlloc && steady);
+        if (counters.isOpen())
+            counters.begin();
+        float t = frameTime;
+        while (t > 0.0f)
+        {
+            TRACE_ZONE("Substep");
+            float dtStep = std::min(physicsStep, t);
+            for (size_t i = 0; i < PendulumVec.size(); ++i)
+            {
+                auto& s = PendulumVec[i];
+                s->update(damping, g, dtStep);
+                trailTimers[i] += dtStep;
+                if (trailTimers[i] >= trailSample)
+                {
+                    trailTimers[i] = fmodf(trailTimers[i], trailSample);
+                    s->AddTrailPoint();
+                }
+            }
+            t -= dtStep;
+        }
+        PerfCounters::Sample phases[2];
+        if (counters.isOpen())
+            phases[0] = counters.end();
+        frameStats.phases[FrameStats::Physics].push((float)(FrameStats::nowMs() - frameStart));
+        physicsGuard.end();
+        RecordAllocations(frameStats, FrameStats::Physics, frameAllocs);
+        TRACE_END(physicsZone);
+
+        if (sharedState.isOpen())
+        {
+            TRACE_ZONE("Share state");
+            std::string error;
+            if (!PublishState(sharedState, PendulumVec, frame, (frame + 1) * (double)frameTime, g, damping, error))
+            {
+                std::cerr << error << "\n";
+                return 1;
+            }
+        }
+
+        if (window)
+        {
+            TRACE_BEGIN(renderZone, "Render");
+            double renderStart = FrameStats::nowMs();
+            AllocTracker::Counts renderAllocs = AllocTracker::thread();
+            AllocTracker::Guard renderGuard("render", strictAlloc && steady);
+            if (counters.isOpen())
+                counters.begin();
+            glClear(GL_COLOR_BUFFER_BIT);
+            glLoadIdentity();
+            for (auto& state : PendulumVec)
+                state->render();
+            glFinish();
+            if (counters.isOpen())
+                phases[1] = counters.end();
+            frameStats.phases[FrameStats::Render].push((float)(FrameStats::nowMs() - renderStart));
+            renderGuard.end();
+            RecordAllocations(frameStats, FrameStats::Render, renderAllocs);
+            TRACE_END(renderZone);
+        }
+        frameStats.phases[FrameStats::Frame].push((float)(FrameStats::nowMs() - frameStart));
+        RecordAllocations(frameStats, FrameStats::Frame, frameAllocs);
+        if (steady)
+        {
+            for (int p = FrameStats::Frame; p <= FrameStats::Render; ++p)
+            {
+                steadyAllocs[p].allocations += frameStats.allocations[p];
+                steadyAllocs[p].bytes += frameStats.allocatedBytes[p];
+                steadyMax[p] = std::max(steadyMax[p], frameStats.allocations[p]);
+            }
+        }
+
+        if (counters.isOpen())
+        {
+            const char* names[2] = { "physics", "render" };
+            for (int p = 0; p < (window ? 2 : 1); ++p)
+            {
+                LogCounters(*countersOut, frame, names[p], phases[p]);
+                for (int e = 0; e < PerfCounters::EventCount; ++e)
+                {
+                    total[p].values[e] += phases[p].values[e];
+                    total[p].valid[e] = phases[p].valid[e];
+                }
+            }
+        }
+
+        if (!checkpointPath.empty() && (frame + 1) % checkpointEvery == 0)
+        {
+            // The copy is the only part on this thread; the writer checksums and syncs
+            TRACE_ZONE("Checkpoint");
+            state.frame = frame + 1;
+            SaveHeadlessState(snapshot, state);
+            if (!checkpointWriter.submit(checkpointPath, snapshot))
+                std::cerr << "Previous checkpoint still being written, skipped frame " << frame + 1 << "\n";
+        }
+    }
+
+    if (!checkpointPath.empty())
+    {
+        // The final state, also what a stop signal leaves behind
+        checkpointWriter.wait();
+        state.frame = frame;
+        SaveHeadlessState(snapshot, state);
+        std::string error;
+        if (!Checkpoint::writeFile(checkpointPath, snapshot, error))
+            std::cerr << error << "\n";
+        else
+            std::cerr << "Checkpoint at frame " << frame << " in " << checkpointPath << " ("
+                      << checkpointWriter.written() + 1 << " written)\n";
+        if (!checkpointWriter.lastError().empty())
+            std::cerr << checkpointWriter.lastError() << "\n";
+        if (StopRequested)
+            std::cerr << "Stopped at frame " << frame << "\n";
+    }
+
+    std::cerr << "Frame times over the last " << frameStats.phases[FrameStats::Frame].size() << " frames (ms):\n";
+    for (int p = FrameStats::Frame; p <= FrameStats::Render; ++p)
+    {
+        RollingSeries::Summary s = frameStats.phases[p].summarize();
+        if (frameStats.phases[p].size())
+            std::cerr << "  " << FrameStats::name((FrameStats::Phase)p) << ": p50 " << s.p50 << ", p95 " << s.p95
+                      << ", p99 " << s.p99 << ", max " << s.max << "\n";
+    }
+    if (frame > warmupFrames)
+    {
+        size_t steadyFrames = frame - warmupFrames;
+        std::cerr << "Heap allocations per frame after " << warmupFrames << " warmup frames:\n";
+        for (int p = FrameStats::Frame; p <= (window ? FrameStats::Render : FrameStats::Physics); ++p)
+            std::cerr << "  " << FrameStats::name((FrameStats::Phase)p) << ": mean "
+                      << (double)steadyAllocs[p].allocations / steadyFrames << " (" << (double)steadyAllocs[p].bytes / steadyFrames
+                      << " bytes), max " << steadyMax[p] << "\n";
+    }
+    if (counters.isOpen())
+    {
+        std::cerr << "Per frame over " << frame << " frames:\n";
+        const char* names[2] = { "physics", "render" };
+        for (int p = 0; p < (window ? 2 : 1); ++p)
+        {
+            std::cerr << "  " << names[p] << ": " << total[p].values[PerfCounters::Cycles] / std::max<size_t>(frame, 1)
+                      << " cycles, IPC " << total[p].ipc()
+                      << ", cache miss " << total[p].percent(PerfCounters::CacheMisses, PerfCounters::CacheReferences) << "%"
+                      << ", branch miss " << total[p].percent(PerfCounters::BranchMisses, PerfCounters::Branches) << "%\n";
+        }
+    }
+    if (!tracePath.empty())
+    {
+        std::string error;
+        if (!Trace::writeChromeJson(tracePath, error))
+            std::cerr << error << "\n";
+    }
+    if (window)
+        glfwTerminate();
+    return 0;
+}
+
+static int Run(const std::vector<std::string>& args)
+{
+    // --isa=sse2|avx2|avx512 forces a lower kernel build than CPUID picks
+    for (const std::string& arg : args)
+    {
+        std::string error;
+        if (arg.compare(0, 6, "--isa=") == 0 && !Cpu::setLevel(arg.substr(6), error))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+    }
+    if (std::find(args.begin(), args.end(), "--headless") != args.end())
+        return RunHeadless(args);
+    return RunWindowed();
+}
+
+#ifdef _WIN32
+int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
+{
+    std::vector<std::string> args;
+    for (int i = 1; i < __argc; ++i)
+    {
+        int size = WideCharToMultiByte(CP_UTF8, 0, __wargv[i], -1, nullptr, 0, nullptr, nullptr);
+        std::string arg(size > 0 ? size - 1 : 0, '\0');
+        WideCharToMultiByte(CP_UTF8, 0, __wargv[i], -1, &arg[0], size, nullptr, nullptr);
+        args.push_back(arg);
+    }
+    return Run(args);
+}
+#else
+int main(int argc, char** argv)
+{
+    return Run(std::vector<std::string>(argv + 1, argv + argc));
+}
+#endif
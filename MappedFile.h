@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read-only or copy-on-write memory mapping of a whole file.
+class MappedFile
+{
+public:
+    enum Mode
+    {
+        ReadOnly = 0, CopyOnWrite = 1
+    };
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const std::string& path, Mode mode, std::string& error);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    uint8_t* bytes() const { return data; }
+    size_t size() const { return length; }
+
+private:
+    uint8_t* data = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
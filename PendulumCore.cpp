@@ -0,0 +1,440 @@
+#include "PendulumCore.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Cpu.h"
+#include "Ensemble.h"
+#include "Playback.h"
+#include "Scene.h"
+#include "SharedState.h"
+
+static_assert((uint32_t)PC_SINGLE_THETA == Scene::SingleTheta && (uint32_t)PC_SINGLE_FROZEN == Scene::SingleFrozen &&
+              (uint32_t)PC_DOUBLE_THETA1 == Scene::DoubleTheta1 && (uint32_t)PC_DOUBLE_FROZEN == Scene::DoubleFrozen &&
+              (uint32_t)PC_DRIVEN_THETA == Scene::DrivenTheta && (uint32_t)PC_DRIVEN_FROZEN == Scene::DrivenFrozen &&
+              (uint32_t)PC_ELASTIC_THETA == Scene::ElasticTheta && (uint32_t)PC_ELASTIC_FROZEN == Scene::ElasticFrozen,
+              "pc_column follows the scene file column ids");
+static_assert(sizeof(pc_sample) == sizeof(Trajectory::Sample) &&
+              sizeof(pc_pendulum_info) == sizeof(Trajectory::PendulumInfo),
+              "C structs mirror the trajectory format");
+
+// Columns either live in owned storage or in a scene mapped copy-on-write
+struct pc_ensemble
+{
+    Ensemble owned;
+    Scene::Mapped mapped;
+    SingleColumns singles;
+    DoubleColumns doubles;
+    DrivenColumns drivens;
+    ElasticColumns elastics;
+    float g = 9.807f;
+    float damping = 0.0f;
+};
+
+struct pc_trajectory
+{
+    TrajectoryPlayer player;
+    std::vector<Trajectory::Sample> samples;
+    std::vector<std::pair<float, float>> positions;
+};
+
+struct pc_shared
+{
+    SharedState::Reader reader;
+};
+
+namespace
+{
+    void report(const char* message, size_t length, char* error, size_t size)
+    {
+        if (!error || size == 0)
+            return;
+        size_t n = std::min(length, size - 1);
+        std::memcpy(error, message, n);
+        error[n] = '\0';
+    }
+
+    void report(const std::string& message, char* error, size_t size)
+    {
+        report(message.data(), message.size(), error, size);
+    }
+
+    // For exceptions caught at the C boundary, without allocating
+    void report(const std::exception& ex, char* error, size_t size)
+    {
+        const char* message = dynamic_cast<const std::bad_alloc*>(&ex) ? "Out of memory" : ex.what();
+        report(message, std::strlen(message), error, size);
+    }
+}
+
+uint32_t pc_api_version(void)
+{
+    return PC_API_VERSION;
+}
+
+const char* pc_isa(void)
+{
+    return Cpu::name(Cpu::active());
+}
+
+int pc_set_isa(const char* name, char* error, size_t error_size)
+{
+    std::string message;
+    if (!Cpu::setLevel(name ? name : "", message))
+    {
+        report(message, error, error_size);
+        return 0;
+    }
+    return 1;
+}
+
+pc_ensemble* pc_ensemble_create(uint64_t singles, uint64_t doubles)
+{
+    return pc_ensemble_create_driven(singles, doubles, 0);
+}
+
+pc_ensemble* pc_ensemble_create_driven(uint64_t singles, uint64_t doubles, uint64_t drivens)
+{
+    return pc_ensemble_create_elastic(singles, doubles, drivens, 0);
+}
+
+pc_ensemble* pc_ensemble_create_elastic(uint64_t singles, uint64_t doubles, uint64_t drivens, uint64_t elastics)
+{
+    // Nothing may throw across the C boundary
+    try
+    {
+        std::unique_ptr<pc_ensemble> e(new pc_ensemble);
+        e->owned.reserve(singles, doubles, drivens, elastics);
+        for (uint64_t i = 0; i < singles; ++i)
+            e->owned.addSingle(0.0f, 0.0f, 1.0f, 1.0f);
+        for (uint64_t i = 0; i < doubles; ++i)
+            e->owned.addDouble(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.5f, 0.5f);
+        for (uint64_t i = 0; i < drivens; ++i)
+            e->owned.addDriven(0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f);
+        for (uint64_t i = 0; i < elastics; ++i)
+            e->owned.addElastic(0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1000.0f);
+        e->singles = e->owned.singles();
+        e->doubles = e->owned.doubles();
+        e->drivens = e->owned.drivens();
+        e->elastics = e->owned.elastics();
+        return e.release();
+    }
+    catch (const std::exception&)
+    {
+        return nullptr;
+    }
+}
+
+pc_ensemble* pc_ensemble_load(const char* path, char* error, size_t error_size)
+{
+    try
+    {
+        std::unique_ptr<pc_ensemble> e(new pc_ensemble);
+        std::string message;
+        if (!e->mapped.open(path ? path : "", message))
+        {
+            report(message, error, error_size);
+            return nullptr;
+        }
+        e->singles = e->mapped.singles();
+        e->doubles = e->mapped.doubles();
+        e->drivens = e->mapped.drivens();
+        e->elastics = e->mapped.elastics();
+        e->g = e->mapped.g();
+        e->damping = e->mapped.damping();
+        return e.release();
+    }
+    catch (const std::exception& ex)
+    {
+        report(ex, error, error_size);
+        return nullptr;
+    }
+}
+
+int pc_ensemble_save(const pc_ensemble* ensemble, const char* path, char* error, size_t error_size)
+{
+    try
+    {
+        Scene::Source source;
+        source.g = ensemble->g;
+        source.damping = ensemble->damping;
+        source.singles = ensemble->singles;
+        source.doubles = ensemble->doubles;
+        source.drivens = ensemble->drivens;
+        source.elastics = ensemble->elastics;
+        std::string message;
+        if (!Scene::save(path ? path : "", source, message))
+        {
+            report(message, error, error_size);
+            return 0;
+        }
+        return 1;
+    }
+    catch (const std::exception& ex)
+    {
+        report(ex, error, error_size);
+        return 0;
+    }
+}
+
+void pc_ensemble_destroy(pc_ensemble* ensemble)
+{
+    delete ensemble;
+}
+
+uint64_t pc_ensemble_count(const pc_ensemble* ensemble, pc_kind kind)
+{
+    switch (kind)
+    {
+    case PC_SINGLE: return ensemble->singles.count;
+    case PC_DOUBLE: return ensemble->doubles.count;
+    case PC_DRIVEN: return ensemble->drivens.count;
+    case PC_ELASTIC: return ensemble->elastics.count;
+    }
+    return 0;
+}
+
+void* pc_ensemble_column(pc_ensemble* ensemble, pc_column column)
+{
+    const SingleColumns& s = ensemble->singles;
+    const DoubleColumns& d = ensemble->doubles;
+    const DrivenColumns& f = ensemble->drivens;
+    const ElasticColumns& e = ensemble->elastics;
+    switch (column)
+    {
+    case PC_SINGLE_THETA: return s.theta;
+    case PC_SINGLE_OMEGA: return s.omega;
+    case PC_SINGLE_MASS: return s.m;
+    case PC_SINGLE_LENGTH: return s.L;
+    case PC_SINGLE_PIVOT_X: return s.px;
+    case PC_SINGLE_PIVOT_Y: return s.py;
+    case PC_SINGLE_FROZEN: return s.frozen;
+    case PC_DOUBLE_THETA1: return d.theta1;
+    case PC_DOUBLE_THETA2: return d.theta2;
+    case PC_DOUBLE_OMEGA1: return d.omega1;
+    case PC_DOUBLE_OMEGA2: return d.omega2;
+    case PC_DOUBLE_MASS1: return d.m1;
+    case PC_DOUBLE_MASS2: return d.m2;
+    case PC_DOUBLE_LENGTH1: return d.L1;
+    case PC_DOUBLE_LENGTH2: return d.L2;
+    case PC_DOUBLE_PIVOT_X: return d.px;
+    case PC_DOUBLE_PIVOT_Y: return d.py;
+    case PC_DOUBLE_FROZEN: return d.frozen;
+    case PC_DRIVEN_THETA: return f.theta;
+    case PC_DRIVEN_OMEGA: return f.omega;
+    case PC_DRIVEN_PHASE: return f.phase;
+    case PC_DRIVEN_MASS: return f.m;
+    case PC_DRIVEN_LENGTH: return f.L;
+    case PC_DRIVEN_AMPLITUDE: return f.amplitude;
+    case PC_DRIVEN_FREQUENCY: return f.frequency;
+    case PC_DRIVEN_PIVOT_X: return f.px;
+    case PC_DRIVEN_PIVOT_Y: return f.py;
+    case PC_DRIVEN_FROZEN: return f.frozen;
+    case PC_ELASTIC_THETA: return e.theta;
+    case PC_ELASTIC_OMEGA: return e.omega;
+    case PC_ELASTIC_LENGTH: return e.r;
+    case PC_ELASTIC_LENGTH_RATE: return e.vr;
+    case PC_ELASTIC_MASS: return e.m;
+    case PC_ELASTIC_REST_LENGTH: return e.L;
+    case PC_ELASTIC_STIFFNESS: return e.k;
+    case PC_ELASTIC_PIVOT_X: return e.px;
+    case PC_ELASTIC_PIVOT_Y: return e.py;
+    case PC_ELASTIC_FROZEN: return e.frozen;
+    }
+    return nullptr;
+}
+
+void pc_ensemble_set_physics(pc_ensemble* ensemble, float g, float damping)
+{
+    ensemble->g = g;
+    ensemble->damping = damping;
+}
+
+void pc_ensemble_get_physics(const pc_ensemble* ensemble, float* g, float* damping)
+{
+    if (g)
+        *g = ensemble->g;
+    if (damping)
+        *damping = ensemble->damping;
+}
+
+void pc_ensemble_step(pc_ensemble* ensemble, uint64_t steps, float dt)
+{
+    Batch::stepSingles(ensemble->singles, 0, ensemble->singles.count, ensemble->damping, ensemble->g, dt, steps);
+    Batch::stepDoubles(ensemble->doubles, 0, ensemble->doubles.count, ensemble->damping, ensemble->g, dt, steps);
+    Batch::stepDrivens(ensemble->drivens, 0, ensemble->drivens.count, ensemble->damping, ensemble->g, dt, steps);
+    Batch::stepElastics(ensemble->elastics, 0, ensemble->elastics.count, ensemble->damping, ensemble->g, dt, steps);
+}
+
+void pc_ensemble_step_range(pc_ensemble* ensemble, pc_kind kind, uint64_t begin, uint64_t end, uint64_t steps, float dt)
+{
+    if (kind == PC_SINGLE)
+    {
+        end = std::min<uint64_t>(end, ensemble->singles.count);
+        if (begin < end)
+            Batch::stepSingles(ensemble->singles, begin, end, ensemble->damping, ensemble->g, dt, steps);
+    }
+    else if (kind == PC_DOUBLE)
+    {
+        end = std::min<uint64_t>(end, ensemble->doubles.count);
+        if (begin < end)
+            Batch::stepDoubles(ensemble->doubles, begin, end, ensemble->damping, ensemble->g, dt, steps);
+    }
+    else if (kind == PC_DRIVEN)
+    {
+        end = std::min<uint64_t>(end, ensemble->drivens.count);
+        if (begin < end)
+            Batch::stepDrivens(ensemble->drivens, begin, end, ensemble->damping, ensemble->g, dt, steps);
+    }
+    else if (kind == PC_ELASTIC)
+    {
+        end = std::min<uint64_t>(end, ensemble->elastics.count);
+        if (begin < end)
+            Batch::stepElastics(ensemble->elastics, begin, end, ensemble->damping, ensemble->g, dt, steps);
+    }
+}
+
+pc_trajectory* pc_trajectory_open(const char* path, char* error, size_t error_size)
+{
+    try
+    {
+        std::unique_ptr<pc_trajectory> t(new pc_trajectory);
+        std::string message;
+        if (!t->player.open(path ? path : "", message))
+        {
+            report(message, error, error_size);
+            return nullptr;
+        }
+        return t.release();
+    }
+    catch (const std::exception& ex)
+    {
+        report(ex, error, error_size);
+        return nullptr;
+    }
+}
+
+void pc_trajectory_close(pc_trajectory* trajectory)
+{
+    delete trajectory;
+}
+
+uint64_t pc_trajectory_pendulum_count(const pc_trajectory* trajectory)
+{
+    return trajectory->player.pendulumCount();
+}
+
+double pc_trajectory_start_time(const pc_trajectory* trajectory)
+{
+    return trajectory->player.startTime();
+}
+
+double pc_trajectory_end_time(const pc_trajectory* trajectory)
+{
+    return trajectory->player.endTime();
+}
+
+int pc_trajectory_pendulum(const pc_trajectory* trajectory, uint64_t index, pc_pendulum_info* out)
+{
+    if (index >= trajectory->player.pendulumCount())
+        return 0;
+    std::memcpy(out, &trajectory->player.pendulum(index), sizeof(*out));
+    return 1;
+}
+
+int pc_trajectory_seek(pc_trajectory* trajectory, double time, pc_sample* out)
+{
+    // Decoding a chunk allocates
+    try
+    {
+        if (!trajectory->player.seek(time, trajectory->samples))
+            return 0;
+    }
+    catch (const std::exception&)
+    {
+        return 0;
+    }
+    std::memcpy(out, trajectory->samples.data(), trajectory->samples.size() * sizeof(pc_sample));
+    return 1;
+}
+
+uint64_t pc_trajectory_positions(pc_trajectory* trajectory, uint64_t index, double t0, double t1,
+                                 double interval, float* xy, uint64_t capacity)
+{
+    if (index >= trajectory->player.pendulumCount())
+        return 0;
+    size_t count = 0;
+    try
+    {
+        count = trajectory->player.positions(index, t0, t1, interval, trajectory->positions);
+    }
+    catch (const std::exception&)
+    {
+        return 0;
+    }
+    uint64_t n = std::min<uint64_t>(count, capacity);
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        xy[2 * i] = trajectory->positions[i].first;
+        xy[2 * i + 1] = trajectory->positions[i].second;
+    }
+    return count;
+}
+
+pc_shared* pc_shared_open(const char* name, char* error, size_t error_size)
+{
+    try
+    {
+        std::unique_ptr<pc_shared> shared(new pc_shared);
+        std::string message;
+        if (!shared->reader.open(name ? name : "", message))
+        {
+            report(message, error, error_size);
+            return nullptr;
+        }
+        return shared.release();
+    }
+    catch (const std::exception& ex)
+    {
+        report(ex, error, error_size);
+        return nullptr;
+    }
+}
+
+void pc_shared_close(pc_shared* shared)
+{
+    delete shared;
+}
+
+int pc_shared_closed(const pc_shared* shared)
+{
+    return shared->reader.closed() ? 1 : 0;
+}
+
+int pc_shared_acquire(pc_shared* shared, pc_shared_frame* out)
+{
+    uint64_t sequence = 0;
+    const SharedState::Frame* f = shared->reader.acquire(sequence);
+    if (!f)
+        return 0;
+    out->frame = f->frame;
+    out->time = f->time;
+    out->g = f->g;
+    out->damping = f->damping;
+    out->count = f->count;
+    out->infos = reinterpret_cast<const pc_pendulum_info*>(f->infos());
+    out->samples = reinterpret_cast<const pc_sample*>(f->samples(shared->reader.capacity()));
+    out->sequence = sequence;
+    out->buffer = f;
+    return 1;
+}
+
+int pc_shared_validate(const pc_shared* shared, const pc_shared_frame* frame)
+{
+    const SharedState::Frame* f = static_cast<const SharedState::Frame*>(frame->buffer);
+    return f && shared->reader.validate(*f, frame->sequence) ? 1 : 0;
+}
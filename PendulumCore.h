@@ -0,0 +1,165 @@
+#ifndef PENDULUM_CORE_H
+#define PENDULUM_CORE_H
+#include <stddef.h>
+#include <stdint.h>
+
+/* C interface to pendulum_core, the physics, scene and trajectory code
+ * without OpenGL or ImGui. Built as a static library (Core/pendulum_core)
+ * or a shared one (Core/pendulum_core_shared) that tools and Python's
+ * ctypes can load.
+ *
+ * An ensemble holds a fixed number of single, double, driven and elastic
+ * pendulums as float columns. pc_ensemble_column returns the column itself, so callers
+ * read and write state in place and the batch kernels step the same
+ * memory. Pointers stay valid until the ensemble is destroyed.
+ *
+ * Functions that can fail return 1 on success and 0 on failure, writing
+ * a message to error when it is not NULL. Additions keep existing
+ * functions and enum values as they are; PC_API_VERSION counts them. */
+
+#if defined(_WIN32) && defined(PENDULUM_CORE_SHARED)
+#ifdef PENDULUM_CORE_EXPORTS
+#define PC_API __declspec(dllexport)
+#else
+#define PC_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define PC_API __attribute__((visibility("default")))
+#else
+#define PC_API
+#endif
+
+#define PC_API_VERSION 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct pc_ensemble pc_ensemble;
+typedef struct pc_trajectory pc_trajectory;
+typedef struct pc_shared pc_shared;
+
+typedef enum pc_kind
+{
+    PC_SINGLE = 0,
+    PC_DOUBLE = 1,
+    PC_DRIVEN = 2,
+    PC_ELASTIC = 3
+} pc_kind;
+
+/* Same numbering as the scene file's columns. Every column is float
+ * except the *_FROZEN ones, which hold one byte per pendulum. */
+typedef enum pc_column
+{
+    PC_SINGLE_THETA = 1, PC_SINGLE_OMEGA, PC_SINGLE_MASS, PC_SINGLE_LENGTH,
+    PC_SINGLE_PIVOT_X, PC_SINGLE_PIVOT_Y, PC_SINGLE_FROZEN,
+    PC_DOUBLE_THETA1 = 16, PC_DOUBLE_THETA2, PC_DOUBLE_OMEGA1, PC_DOUBLE_OMEGA2,
+    PC_DOUBLE_MASS1, PC_DOUBLE_MASS2, PC_DOUBLE_LENGTH1, PC_DOUBLE_LENGTH2,
+    PC_DOUBLE_PIVOT_X, PC_DOUBLE_PIVOT_Y, PC_DOUBLE_FROZEN,
+    PC_DRIVEN_THETA = 48, PC_DRIVEN_OMEGA, PC_DRIVEN_PHASE, PC_DRIVEN_MASS, PC_DRIVEN_LENGTH,
+    PC_DRIVEN_AMPLITUDE, PC_DRIVEN_FREQUENCY, PC_DRIVEN_PIVOT_X, PC_DRIVEN_PIVOT_Y, PC_DRIVEN_FROZEN,
+    PC_ELASTIC_THETA = 64, PC_ELASTIC_OMEGA, PC_ELASTIC_LENGTH, PC_ELASTIC_LENGTH_RATE, PC_ELASTIC_MASS,
+    PC_ELASTIC_REST_LENGTH, PC_ELASTIC_STIFFNESS, PC_ELASTIC_PIVOT_X, PC_ELASTIC_PIVOT_Y, PC_ELASTIC_FROZEN
+} pc_column;
+
+/* Layouts match the trajectory file format */
+typedef struct pc_pendulum_info
+{
+    uint32_t type; /* 1 single, 2 double, 3 driven, 4 elastic */
+    float m1, m2;
+    float L1, L2;
+    float px, py;
+} pc_pendulum_info;
+
+/* Elastic pendulums store their length and its rate in theta2 and omega2 */
+typedef struct pc_sample
+{
+    float theta1, theta2;
+    float omega1, omega2;
+    float x1, y1;
+    float x2, y2;
+} pc_sample;
+
+PC_API uint32_t pc_api_version(void);
+
+/* Instruction set the batch kernels run on, e.g. "avx2" */
+PC_API const char* pc_isa(void);
+/* Forces a lower kernel build: "sse2", "avx2" or "avx512" */
+PC_API int pc_set_isa(const char* name, char* error, size_t error_size);
+
+/* Pendulums at rest hanging straight down: unit masses, singles of length
+ * 1, doubles with two arms of 0.5, pivots at the origin. NULL when out
+ * of memory. */
+PC_API pc_ensemble* pc_ensemble_create(uint64_t singles, uint64_t doubles);
+/* As pc_ensemble_create, plus driven singles of length 1 with the drive
+ * off (amplitude 0, frequency 1 rad/s) */
+PC_API pc_ensemble* pc_ensemble_create_driven(uint64_t singles, uint64_t doubles, uint64_t drivens);
+/* As pc_ensemble_create_driven, plus elastic singles on springs of rest
+ * length 1 and stiffness 1000 N/m, stretched to their rest length */
+PC_API pc_ensemble* pc_ensemble_create_elastic(uint64_t singles, uint64_t doubles, uint64_t drivens,
+                                               uint64_t elastics);
+/* Maps a scene file copy-on-write and steps its columns in place */
+PC_API pc_ensemble* pc_ensemble_load(const char* path, char* error, size_t error_size);
+PC_API int pc_ensemble_save(const pc_ensemble* ensemble, const char* path, char* error, size_t error_size);
+PC_API void pc_ensemble_destroy(pc_ensemble* ensemble);
+
+PC_API uint64_t pc_ensemble_count(const pc_ensemble* ensemble, pc_kind kind);
+/* count(kind) entries, NULL for an unknown column */
+PC_API void* pc_ensemble_column(pc_ensemble* ensemble, pc_column column);
+
+PC_API void pc_ensemble_set_physics(pc_ensemble* ensemble, float g, float damping);
+PC_API void pc_ensemble_get_physics(const pc_ensemble* ensemble, float* g, float* damping);
+
+/* Advances every unfrozen pendulum by steps steps of dt */
+PC_API void pc_ensemble_step(pc_ensemble* ensemble, uint64_t steps, float dt);
+/* Advances pendulums [begin, end) of one kind. Calls on disjoint ranges
+ * may run on different threads at once. */
+PC_API void pc_ensemble_step_range(pc_ensemble* ensemble, pc_kind kind, uint64_t begin, uint64_t end,
+                                   uint64_t steps, float dt);
+
+/* Recorded trajectory files */
+PC_API pc_trajectory* pc_trajectory_open(const char* path, char* error, size_t error_size);
+PC_API void pc_trajectory_close(pc_trajectory* trajectory);
+PC_API uint64_t pc_trajectory_pendulum_count(const pc_trajectory* trajectory);
+PC_API double pc_trajectory_start_time(const pc_trajectory* trajectory);
+PC_API double pc_trajectory_end_time(const pc_trajectory* trajectory);
+PC_API int pc_trajectory_pendulum(const pc_trajectory* trajectory, uint64_t index, pc_pendulum_info* out);
+/* State of every pendulum at the last sample at or before time; out holds
+ * pendulum_count samples */
+PC_API int pc_trajectory_seek(pc_trajectory* trajectory, double time, pc_sample* out);
+/* Outer bob positions of one pendulum over [t0, t1] as x, y pairs, oldest
+ * first, at most one per interval. Writes up to capacity points and
+ * returns how many there are in total. */
+PC_API uint64_t pc_trajectory_positions(pc_trajectory* trajectory, uint64_t index, double t0, double t1,
+                                        double interval, float* xy, uint64_t capacity);
+
+/* Live state a running simulation publishes to shared memory (--share).
+ * A frame's arrays point into the segment itself. Read what is needed,
+ * then call pc_shared_validate: 0 means the publisher overwrote the frame
+ * meanwhile and it should be acquired again. */
+typedef struct pc_shared_frame
+{
+    uint64_t frame;
+    double time;
+    float g, damping;
+    uint64_t count;
+    const pc_pendulum_info* infos;
+    const pc_sample* samples;
+    /* For pc_shared_validate */
+    uint64_t sequence;
+    const void* buffer;
+} pc_shared_frame;
+
+PC_API pc_shared* pc_shared_open(const char* name, char* error, size_t error_size);
+PC_API void pc_shared_close(pc_shared* shared);
+/* 1 once the publisher stopped or moved to a bigger segment; reopen to follow it */
+PC_API int pc_shared_closed(const pc_shared* shared);
+/* Newest frame; 0 before the first one */
+PC_API int pc_shared_acquire(pc_shared* shared, pc_shared_frame* out);
+PC_API int pc_shared_validate(const pc_shared* shared, const pc_shared_frame* frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,22 +1,19 @@
 #include "Pendulums.h"
+#include "Checkpoint.h"
+#include "Physics.h"
+#include "Scene.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
 
 float PendulumLike::WrapAngle(float theta)
 {
-    const float TWO_PI = 2.0f * M_PI;
-
-    theta = std::fmod(theta, TWO_PI);
-
-    if (theta > M_PI)
-        theta -= TWO_PI;
-    else if (theta < -M_PI)
-        theta += TWO_PI;
-
-    return theta;
+    return Physics::wrapAngle(theta);
 }
 
 void PendulumLike::clearTrail()
 {
-    this->trailPoints.clear();
+    this->trail.clear();
 }
 
 void DPendulum::AddTrailPoint()
@@ -24,44 +21,26 @@ void DPendulum::AddTrailPoint()
     float x2 = this->px + this->L1 * sin(this->theta1) + this->L2 * sin(this->theta2);
     float y2 = this->py - this->L1 * cos(this->theta1) - this->L2 * cos(this->theta2);
     if(!this->isFreezed)
-        trailPoints.emplace_back(x2, y2);
-    if (trailPoints.size() > (size_t)maxTrail)
-    {
-        size_t excess = trailPoints.size() - (size_t)maxTrail;
-        trailPoints.erase(trailPoints.begin(), trailPoints.begin() + excess);
-    }
+        trail.push(x2, y2, this->px, this->py, this->L1 + this->L2);
 }
 void DPendulum::update( float damping, float g, float dt)
 {
     if (this->isFreezed)
         return;
-    float delta = this->theta2 - this->theta1;
-    float den1 = (this->m1 + this->m2) * this->L1 - this->m2 * this->L1 * cos(delta) * cos(delta);
-    float den2 = (this->L2 / this->L1) * den1;
-
-    float a1 = (this->m2 * this->L1 * this->omega1 * this->omega1 * sin(delta) * cos(delta) +
-                this->m2 * g * sin(this->theta2) * cos(delta) +
-                this->m2 * this->L2 * this->omega2 * this->omega2 * sin(delta) -
-                (this->m1 + this->m2) * g * sin(this->theta1)) /
-               den1;
-
-    float a2 = (-this->m2 * this->L2 * this->omega2 * this->omega2 * sin(delta) * cos(delta) +
-                (this->m1 + this->m2) * (g * sin(this->theta1) * cos(delta) -
-                                 this->L1 * this->omega1 * this->omega1 * sin(delta) -
-                                 g * sin(this->theta2))) /
-               den2;
-
-    // Linear damping
-    a1 -= damping * this->omega1;
-    a2 -= damping * this->omega2;
-
-    this->omega1 += a1 * dt;
-    this->omega2 += a2 * dt;
-    this->theta1 += this->omega1 * dt;
-    this->theta2 += this->omega2 * dt;
-
-    this->theta1 = WrapAngle(this->theta1);
-    this->theta2 = WrapAngle(this->theta2);
+    // Extreme mass or length ratios go stiff; those steps take the Rosenbrock
+    // path. The same cheap screen as the batch kernels skips the Jacobian for
+    // the rest, so both paths step a pendulum identically.
+    if (!Physics::canStiffenDouble(this->theta1, this->theta2, this->omega1, this->omega2, this->m1, this->m2,
+                                   this->L1, this->L2, damping, g, dt, (float)Physics::StiffLimit))
+    {
+        Physics::stepDouble(this->theta1, this->theta2, this->omega1, this->omega2,
+                            this->m1, this->m2, this->L1, this->L2, damping, g, dt);
+        this->isStiff = false;
+        return;
+    }
+    this->isStiff = Physics::stepDoubleAuto(this->theta1, this->theta2, this->omega1, this->omega2,
+                                            this->m1, this->m2, this->L1, this->L2, damping, g, dt) >
+                    Physics::StiffLimit;
 }
 
 
@@ -80,7 +59,7 @@ void DPendulum::render()
     Renderer::drawCircle(x1, y1, 0.03f);
     Renderer::drawCircle(x2, y2, 0.03f);
     glColor3f(0.2f, 0.7f, 0.2f);
-    Renderer::drawTrail(this->trailPoints,5);
+    Renderer::drawTrail(this->trail, 5);
 }
 
 
@@ -104,12 +83,7 @@ void SPendulum::update(float damping, float g, float dt)
 {
     if (this->isFreezed)
         return;
-    float a = -(g / this->L) * sin(this->theta);
-    // Linear damping
-    a -= damping * this->omega;
-    this->omega += a * dt;
-    this->theta += this->omega * dt;
-	this->theta = WrapAngle(this->theta);
+    Physics::stepSingle(this->theta, this->omega, this->L, damping, g, dt);
 }
 
 
@@ -119,12 +93,7 @@ void SPendulum::AddTrailPoint()
     float x = this->px + this->L * sin(this->theta);
     float y = this->py - this->L * cos(this->theta);
 	if (!this->isFreezed)
-        trailPoints.emplace_back(x, y);
-    if (trailPoints.size() > (size_t)maxTrail)
-    {
-        size_t excess = trailPoints.size() - (size_t)maxTrail;
-        trailPoints.erase(trailPoints.begin(), trailPoints.begin() + excess);
-    }
+        trail.push(x, y, this->px, this->py, this->L);
 }
 
 
@@ -138,14 +107,20 @@ void SPendulum::render()
     Renderer::drawCircle(x, y, 0.03f);
     glColor3f(0.2f, 0.7f, 0.2f);
     glColor3f(0.2f, 0.7f, 0.2f);
-    Renderer::drawTrail(this->trailPoints, 5);
+    Renderer::drawTrail(this->trail, 5);
 }
 
 void SPendulum::drawUI(size_t index, std::vector<std::shared_ptr<PendulumLike>> &PendVec) {
-
-    ImGui::Begin(("Single Pendulum " + std::to_string(index + 1)).c_str());
-    ImGui::Checkbox(("Freeze Pendulum " + std::to_string(index + 1)).c_str(), &this->isFreezed);
-    ImGui::SliderInt("Max Trail", &this->maxTrail, 100, 5000);
+    // Labels are formatted on the stack so the UI does not allocate every frame
+    char label[64];
+    std::snprintf(label, sizeof(label), "Single Pendulum %zu", index + 1);
+    ImGui::Begin(label);
+    std::snprintf(label, sizeof(label), "Freeze Pendulum %zu", index + 1);
+    ImGui::Checkbox(label, &this->isFreezed);
+    std::snprintf(label, sizeof(label), "Record Pendulum %zu", index + 1);
+    ImGui::Checkbox(label, &this->isRecorded);
+    if (ImGui::SliderInt("Max Trail", &this->maxTrail, 100, 10000000, "%d", ImGuiSliderFlags_Logarithmic))
+        setMaxTrail(this->maxTrail);
     ImGui::Text("Pendulum %d Controls", (int)(index + 1));
     ImGui::Text("Pivoting");
     ImGui::SliderFloat("X Pivot", &this->px, -2.0f, 2.0f);
@@ -158,12 +133,14 @@ void SPendulum::drawUI(size_t index, std::vector<std::shared_ptr<PendulumLike>>
     ImGui::SliderFloat("Theta", &this->theta, -M_PI, M_PI);
     ImGui::Text("Angular Velocity (rad/s)");
     ImGui::SliderFloat("Omega", &this->omega, -10.0f, 10.0f);
-    if (ImGui::Button(("Delete Pendulum " + std::to_string(index + 1)).c_str()))
+    std::snprintf(label, sizeof(label), "Delete Pendulum %zu", index + 1);
+    if (ImGui::Button(label))
     {
         clearTrail();
 		PendVec.erase(PendVec.begin() + index);
     }
-    if (ImGui::Button(("Reset Pendulum " + std::to_string(index + 1)).c_str()))
+    std::snprintf(label, sizeof(label), "Reset Pendulum %zu", index + 1);
+    if (ImGui::Button(label))
     {
 		reset();
 		clearTrail();
@@ -172,10 +149,189 @@ void SPendulum::drawUI(size_t index, std::vector<std::shared_ptr<PendulumLike>>
 }
 
 
+void DrivenPendulum::reset()
+{
+    this->theta = 0.0f;
+    this->omega = 0.0f;
+    this->phase = 0.0f;
+}
+
+void DrivenPendulum::update(float damping, float g, float dt)
+{
+    if (this->isFreezed)
+        return;
+    Physics::stepDriven(this->theta, this->omega, this->phase, this->L, damping, g,
+                        this->amplitude, this->frequency, dt);
+}
+
+void DrivenPendulum::AddTrailPoint()
+{
+    float x = this->px + this->L * sin(this->theta);
+    float y = this->py - this->L * cos(this->theta);
+    if (!this->isFreezed)
+        trail.push(x, y, this->px, this->py, this->L);
+}
+
+void DrivenPendulum::render()
+{
+    float x = this->px + this->L * sin(this->theta);
+    float y = this->py - this->L * cos(this->theta);
+    glColor3f(1.0f, 1.0f, 1.0f);
+    Renderer::drawLine(this->px, this->py, x, y);
+    // The drive's push at the pivot, full width at its peak
+    glColor3f(1.0f, 0.6f, 0.1f);
+    if (this->amplitude != 0.0f)
+        Renderer::drawLine(this->px, this->py, this->px + 0.15f * cos(this->phase), this->py);
+    Renderer::drawCircle(x, y, 0.03f);
+    glColor3f(0.2f, 0.7f, 0.2f);
+    Renderer::drawTrail(this->trail, 5);
+}
+
+void DrivenPendulum::drawUI(size_t index, std::vector<std::shared_ptr<PendulumLike>>& PendVec) {
+    char label[64];
+    std::snprintf(label, sizeof(label), "Driven Pendulum %zu", index + 1);
+    ImGui::Begin(label);
+    std::snprintf(label, sizeof(label), "Freeze Pendulum %zu", index + 1);
+    ImGui::Checkbox(label, &this->isFreezed);
+    std::snprintf(label, sizeof(label), "Record Pendulum %zu", index + 1);
+    ImGui::Checkbox(label, &this->isRecorded);
+    if (ImGui::SliderInt("Max Trail", &this->maxTrail, 100, 10000000, "%d", ImGuiSliderFlags_Logarithmic))
+        setMaxTrail(this->maxTrail);
+    ImGui::Text("Pendulum %d Controls", (int)(index + 1));
+    ImGui::Text("Pivoting");
+    ImGui::SliderFloat("X Pivot", &this->px, -2.0f, 2.0f);
+    ImGui::SliderFloat("Y Pivot", &this->py, -1.5f, 1.5f);
+    ImGui::Text("Length");
+    ImGui::SliderFloat("Length", &this->L, 0.1, 2.0);
+    ImGui::Text("Mass");
+    ImGui::SliderFloat("Mass", &this->m, 0.1, 1000.0);
+    ImGui::Text("Drive");
+    ImGui::SliderFloat("Amplitude (rad/s^2)", &this->amplitude, 0.0f, 100.0f);
+    ImGui::SliderFloat("Frequency (rad/s)", &this->frequency, 0.1f, 20.0f);
+    ImGui::SliderFloat("Phase", &this->phase, -M_PI, M_PI);
+    ImGui::Text("Theta Angle (radians)");
+    ImGui::SliderFloat("Theta", &this->theta, -M_PI, M_PI);
+    ImGui::Text("Angular Velocity (rad/s)");
+    ImGui::SliderFloat("Omega", &this->omega, -10.0f, 10.0f);
+    std::snprintf(label, sizeof(label), "Delete Pendulum %zu", index + 1);
+    if (ImGui::Button(label))
+    {
+        clearTrail();
+        PendVec.erase(PendVec.begin() + index);
+    }
+    std::snprintf(label, sizeof(label), "Reset Pendulum %zu", index + 1);
+    if (ImGui::Button(label))
+    {
+        reset();
+        clearTrail();
+    }
+    ImGui::End();
+}
+
+
+void ElasticPendulum::reset()
+{
+    this->theta = 0.0f;
+    this->omega = 0.0f;
+    this->r = this->L;
+    this->vr = 0.0f;
+}
+
+void ElasticPendulum::update(float damping, float g, float dt)
+{
+    if (this->isFreezed)
+        return;
+    Physics::stepElastic(this->theta, this->omega, this->r, this->vr, this->m, this->L, this->k, damping, g, dt);
+}
+
+void ElasticPendulum::AddTrailPoint()
+{
+    float x = this->px + this->r * sin(this->theta);
+    float y = this->py - this->r * cos(this->theta);
+    // The spring can stretch well past its rest length
+    if (!this->isFreezed)
+        trail.push(x, y, this->px, this->py, 2.0f * std::max(this->r, this->L));
+}
+
+void ElasticPendulum::render()
+{
+    float s = sin(this->theta), c = cos(this->theta);
+    float x = this->px + this->r * s;
+    float y = this->py - this->r * c;
+    // The rod as a zigzag spring, with the coil count fixed so it visibly stretches
+    const int Coils = 12;
+    const float Width = 0.03f;
+    glColor3f(1.0f, 1.0f, 1.0f);
+    float lx = this->px, ly = this->py;
+    for (int i = 1; i <= 2 * Coils; ++i)
+    {
+        float along = this->r * i / (2 * Coils + 1);
+        float side = i % 2 ? Width : -Width;
+        float nx = this->px + along * s + side * c;
+        float ny = this->py - along * c + side * s;
+        Renderer::drawLine(lx, ly, nx, ny);
+        lx = nx;
+        ly = ny;
+    }
+    Renderer::drawLine(lx, ly, x, y);
+    glColor3f(0.9f, 0.8f, 0.2f);
+    Renderer::drawCircle(x, y, 0.03f);
+    glColor3f(0.2f, 0.7f, 0.2f);
+    Renderer::drawTrail(this->trail, 5);
+}
+
+void ElasticPendulum::drawUI(size_t index, std::vector<std::shared_ptr<PendulumLike>>& PendVec) {
+    char label[64];
+    std::snprintf(label, sizeof(label), "Elastic Pendulum %zu", index + 1);
+    ImGui::Begin(label);
+    std::snprintf(label, sizeof(label), "Freeze Pendulum %zu", index + 1);
+    ImGui::Checkbox(label, &this->isFreezed);
+    std::snprintf(label, sizeof(label), "Record Pendulum %zu", index + 1);
+    ImGui::Checkbox(label, &this->isRecorded);
+    if (ImGui::SliderInt("Max Trail", &this->maxTrail, 100, 10000000, "%d", ImGuiSliderFlags_Logarithmic))
+        setMaxTrail(this->maxTrail);
+    ImGui::Text("Pendulum %d Controls", (int)(index + 1));
+    ImGui::Text("Pivoting");
+    ImGui::SliderFloat("X Pivot", &this->px, -2.0f, 2.0f);
+    ImGui::SliderFloat("Y Pivot", &this->py, -1.5f, 1.5f);
+    ImGui::Text("Spring");
+    ImGui::SliderFloat("Rest Length", &this->L, 0.1, 2.0);
+    ImGui::SliderFloat("Stiffness (N/m)", &this->k, 1.0f, 1e6f, "%.1f", ImGuiSliderFlags_Logarithmic);
+    ImGui::Text("Mass");
+    ImGui::SliderFloat("Mass", &this->m, 0.1, 1000.0);
+    ImGui::Text("Theta Angle (radians)");
+    ImGui::SliderFloat("Theta", &this->theta, -M_PI, M_PI);
+    ImGui::Text("Angular Velocity (rad/s)");
+    ImGui::SliderFloat("Omega", &this->omega, -10.0f, 10.0f);
+    ImGui::Text("Length (m) and its rate (m/s)");
+    ImGui::SliderFloat("Length", &this->r, 0.05f, 4.0f);
+    ImGui::SliderFloat("Length Rate", &this->vr, -10.0f, 10.0f);
+    std::snprintf(label, sizeof(label), "Delete Pendulum %zu", index + 1);
+    if (ImGui::Button(label))
+    {
+        clearTrail();
+        PendVec.erase(PendVec.begin() + index);
+    }
+    std::snprintf(label, sizeof(label), "Reset Pendulum %zu", index + 1);
+    if (ImGui::Button(label))
+    {
+        reset();
+        clearTrail();
+    }
+    ImGui::End();
+}
+
+
 void DPendulum::drawUI(size_t index, std::vector<std::shared_ptr<PendulumLike>>& PendVec) {
-    ImGui::Begin(("Double Pendulum " + std::to_string(index + 1)).c_str());
-    ImGui::Checkbox(("Freeze Pendulum " + std::to_string(index + 1)).c_str(), &this->isFreezed);
-    ImGui::SliderInt("Max Trail", &this->maxTrail, 100, 5000);
+    char label[64];
+    std::snprintf(label, sizeof(label), "Double Pendulum %zu", index + 1);
+    ImGui::Begin(label);
+    std::snprintf(label, sizeof(label), "Freeze Pendulum %zu", index + 1);
+    ImGui::Checkbox(label, &this->isFreezed);
+    std::snprintf(label, sizeof(label), "Record Pendulum %zu", index + 1);
+    ImGui::Checkbox(label, &this->isRecorded);
+    if (ImGui::SliderInt("Max Trail", &this->maxTrail, 100, 10000000, "%d", ImGuiSliderFlags_Logarithmic))
+        setMaxTrail(this->maxTrail);
     ImGui::Text("Pendulum %d Controls", (int)(index + 1));
     ImGui::Text("Pivoting");
     ImGui::SliderFloat("X Pivot", &this->px, -2.0f, 2.0f);
@@ -192,15 +348,474 @@ void DPendulum::drawUI(size_t index, std::vector<std::shared_ptr<PendulumLike>>&
     ImGui::Text("Angular Velocities (rad/s)");
     ImGui::SliderFloat("Omega 1", &this->omega1, -10.0f, 10.0f);
     ImGui::SliderFloat("Omega 2", &this->omega2, -10.0f, 10.0f);
-    if (ImGui::Button(("Delete Pendulum " + std::to_string(index + 1)).c_str()))
+    ImGui::Text("Integrator: %s", this->isStiff ? "Rosenbrock (stiff)" : "Semi-implicit Euler");
+    std::snprintf(label, sizeof(label), "Delete Pendulum %zu", index + 1);
+    if (ImGui::Button(label))
     {
         clearTrail();
         PendVec.erase(PendVec.begin() + index);
     }
-    if (ImGui::Button(("Reset Pendulum " + std::to_string(index + 1)).c_str()))
+    std::snprintf(label, sizeof(label), "Reset Pendulum %zu", index + 1);
+    if (ImGui::Button(label))
     {
         reset();
         clearTrail();
     }
     ImGui::End();
-}
\ No newline at end of file
+}
+
+bool SaveScene(const std::string& path, float g, float damping,
+               const std::vector<std::shared_ptr<PendulumLike>>& PendVec, bool withTrails, std::string& error)
+{
+    TRACE_ZONE("Save scene");
+    Ensemble ensemble;
+    std::vector<const TrailHistory*> singleTrails, doubleTrails, drivenTrails, elasticTrails;
+    std::vector<uint32_t> singleMax, doubleMax, drivenMax, elasticMax;
+
+    for (const auto& p : PendVec)
+    {
+        if (!p)
+            continue;
+        if (p->getType() == SPend)
+        {
+            auto* s = static_cast<const SPendulum*>(p.get());
+            ensemble.addSingle(s->theta, s->omega, s->m, s->L, s->px, s->py);
+            ensemble.sFrozen.back() = s->isFreezed;
+            singleTrails.push_back(&s->trail);
+            singleMax.push_back((uint32_t)s->trail.getMaxSamples());
+        }
+        else if (p->getType() == DPend)
+        {
+            auto* d = static_cast<const DPendulum*>(p.get());
+            ensemble.addDouble(d->theta1, d->theta2, d->omega1, d->omega2, d->m1, d->m2, d->L1, d->L2, d->px, d->py);
+            ensemble.dFrozen.back() = d->isFreezed;
+            doubleTrails.push_back(&d->trail);
+            doubleMax.push_back((uint32_t)d->trail.getMaxSamples());
+        }
+        else if (p->getType() == DrivenPend)
+        {
+            auto* f = static_cast<const DrivenPendulum*>(p.get());
+            ensemble.addDriven(f->theta, f->omega, f->m, f->L, f->amplitude, f->frequency, f->phase, f->px, f->py);
+            ensemble.fFrozen.back() = f->isFreezed;
+            drivenTrails.push_back(&f->trail);
+            drivenMax.push_back((uint32_t)f->trail.getMaxSamples());
+        }
+        else if (p->getType() == ElasticPend)
+        {
+            auto* e = static_cast<const ElasticPendulum*>(p.get());
+            ensemble.addElastic(e->theta, e->omega, e->r, e->vr, e->m, e->L, e->k, e->px, e->py);
+            ensemble.eFrozen.back() = e->isFreezed;
+            elasticTrails.push_back(&e->trail);
+            elasticMax.push_back((uint32_t)e->trail.getMaxSamples());
+        }
+    }
+    singleTrails.insert(singleTrails.end(), doubleTrails.begin(), doubleTrails.end());
+    singleTrails.insert(singleTrails.end(), drivenTrails.begin(), drivenTrails.end());
+    singleTrails.insert(singleTrails.end(), elasticTrails.begin(), elasticTrails.end());
+    singleMax.insert(singleMax.end(), doubleMax.begin(), doubleMax.end());
+    singleMax.insert(singleMax.end(), drivenMax.begin(), drivenMax.end());
+    singleMax.insert(singleMax.end(), elasticMax.begin(), elasticMax.end());
+
+    Scene::Source source;
+    source.g = g;
+    source.damping = damping;
+    source.singles = ensemble.singles();
+    source.doubles = ensemble.doubles();
+    source.drivens = ensemble.drivens();
+    source.elastics = ensemble.elastics();
+    source.maxTrail = singleMax.data();
+    source.trails = withTrails ? &singleTrails : nullptr;
+    return Scene::save(path, source, error);
+}
+
+bool LoadScene(const std::string& path, float& g, float& damping,
+               std::vector<std::shared_ptr<PendulumLike>>& PendVec, std::string& error)
+{
+    TRACE_ZONE("Load scene");
+    Scene::Mapped scene;
+    if (!scene.open(path, error))
+        return false;
+
+    SingleColumns s = scene.singles();
+    DoubleColumns d = scene.doubles();
+    DrivenColumns f = scene.drivens();
+    ElasticColumns e = scene.elastics();
+    PendVec.clear();
+    PendVec.reserve(s.count + d.count + f.count + e.count);
+    for (size_t i = 0; i < s.count; ++i)
+    {
+        auto p = std::make_shared<SPendulum>(s.theta[i], s.m[i], s.L[i]);
+        p->omega = s.omega[i];
+        p->px = s.px[i];
+        p->py = s.py[i];
+        p->isFreezed = s.frozen[i] != 0;
+        PendVec.push_back(p);
+    }
+    for (size_t i = 0; i < d.count; ++i)
+    {
+        auto p = std::make_shared<DPendulum>(d.theta1[i], d.theta2[i], d.m1[i], d.m2[i], d.L1[i], d.L2[i]);
+        p->omega1 = d.omega1[i];
+        p->omega2 = d.omega2[i];
+        p->px = d.px[i];
+        p->py = d.py[i];
+        p->isFreezed = d.frozen[i] != 0;
+        PendVec.push_back(p);
+    }
+    for (size_t i = 0; i < f.count; ++i)
+    {
+        auto p = std::make_shared<DrivenPendulum>(f.theta[i], f.m[i], f.L[i], f.amplitude[i], f.frequency[i]);
+        p->omega = f.omega[i];
+        p->phase = f.phase[i];
+        p->px = f.px[i];
+        p->py = f.py[i];
+        p->isFreezed = f.frozen[i] != 0;
+        PendVec.push_back(p);
+    }
+    for (size_t i = 0; i < e.count; ++i)
+    {
+        auto p = std::make_shared<ElasticPendulum>(e.theta[i], e.m[i], e.L[i], e.k[i]);
+        p->omega = e.omega[i];
+        p->r = e.r[i];
+        p->vr = e.vr[i];
+        p->px = e.px[i];
+        p->py = e.py[i];
+        p->isFreezed = e.frozen[i] != 0;
+        PendVec.push_back(p);
+    }
+
+    for (size_t i = 0; i < PendVec.size(); ++i)
+    {
+        auto& p = PendVec[i];
+        if (scene.maxTrail())
+            p->setMaxTrail((int)scene.maxTrail()[i]);
+
+        size_t bytes = 0;
+        if (const uint8_t* state = scene.trailState(i, bytes))
+        {
+            Checkpoint::Reader in(state, bytes);
+            if (!p->trail.load(in))
+            {
+                // A damaged trail starts empty rather than failing the scene
+                p->trail = TrailHistory();
+                p->setMaxTrail(p->getMaxTrail());
+            }
+            continue;
+        }
+
+        // Older files keep flattened points, replayed as consecutive samples
+        size_t points = 0;
+        const float* xy = scene.trail(i, points);
+        float range, ox, oy;
+        if (i < s.count)
+        {
+            range = s.L[i];
+            ox = s.px[i];
+            oy = s.py[i];
+        }
+        else if (i < s.count + d.count)
+        {
+            size_t k = i - s.count;
+            range = d.L1[k] + d.L2[k];
+            ox = d.px[k];
+            oy = d.py[k];
+        }
+        else if (i < s.count + d.count + f.count)
+        {
+            size_t k = i - s.count - d.count;
+            range = f.L[k];
+            ox = f.px[k];
+            oy = f.py[k];
+        }
+        else
+        {
+            size_t k = i - s.count - d.count - f.count;
+            range = 2.0f * std::max(e.r[k], e.L[k]);
+            ox = e.px[k];
+            oy = e.py[k];
+        }
+        for (size_t k = 0; k < points; ++k)
+            p->trail.push(xy[k * 2], xy[k * 2 + 1], ox, oy, range);
+    }
+
+    g = scene.g();
+    damping = scene.damping();
+    return true;
+}
+
+Trajectory::PendulumInfo DescribePendulum(const PendulumLike& p)
+{
+    Trajectory::PendulumInfo info = {};
+    info.type = p.getType();
+    if (p.getType() == SPend)
+    {
+        auto& s = static_cast<const SPendulum&>(p);
+        info.m1 = s.m;
+        info.L1 = s.L;
+        info.px = s.px;
+        info.py = s.py;
+    }
+    else if (p.getType() == DPend)
+    {
+        auto& d = static_cast<const DPendulum&>(p);
+        info.m1 = d.m1;
+        info.m2 = d.m2;
+        info.L1 = d.L1;
+        info.L2 = d.L2;
+        info.px = d.px;
+        info.py = d.py;
+    }
+    else if (p.getType() == DrivenPend)
+    {
+        auto& f = static_cast<const DrivenPendulum&>(p);
+        info.m1 = f.m;
+        info.L1 = f.L;
+        info.px = f.px;
+        info.py = f.py;
+    }
+    else if (p.getType() == ElasticPend)
+    {
+        auto& e = static_cast<const ElasticPendulum&>(p);
+        info.m1 = e.m;
+        info.L1 = e.L;
+        info.px = e.px;
+        info.py = e.py;
+    }
+    return info;
+}
+
+Trajectory::Sample SamplePendulum(const PendulumLike& p)
+{
+    Trajectory::Sample s = {};
+    if (p.getType() == SPend)
+    {
+        auto& sp = static_cast<const SPendulum&>(p);
+        s.theta1 = sp.theta;
+        s.omega1 = sp.omega;
+        s.x1 = sp.px + sp.L * sin(sp.theta);
+        s.y1 = sp.py - sp.L * cos(sp.theta);
+        s.x2 = s.x1;
+        s.y2 = s.y1;
+    }
+    else if (p.getType() == DPend)
+    {
+        auto& d = static_cast<const DPendulum&>(p);
+        s.theta1 = d.theta1;
+        s.theta2 = d.theta2;
+        s.omega1 = d.omega1;
+        s.omega2 = d.omega2;
+        s.x1 = d.px + d.L1 * sin(d.theta1);
+        s.y1 = d.py - d.L1 * cos(d.theta1);
+        s.x2 = s.x1 + d.L2 * sin(d.theta2);
+        s.y2 = s.y1 - d.L2 * cos(d.theta2);
+    }
+    else if (p.getType() == DrivenPend)
+    {
+        auto& f = static_cast<const DrivenPendulum&>(p);
+        s.theta1 = f.theta;
+        s.omega1 = f.omega;
+        s.x1 = f.px + f.L * sin(f.theta);
+        s.y1 = f.py - f.L * cos(f.theta);
+        s.x2 = s.x1;
+        s.y2 = s.y1;
+    }
+    else if (p.getType() == ElasticPend)
+    {
+        auto& e = static_cast<const ElasticPendulum&>(p);
+        s.theta1 = e.theta;
+        s.theta2 = e.r;
+        s.omega1 = e.omega;
+        s.omega2 = e.vr;
+        s.x1 = e.px + e.r * sin(e.theta);
+        s.y1 = e.py - e.r * cos(e.theta);
+        s.x2 = s.x1;
+        s.y2 = s.y1;
+    }
+    return s;
+}
+
+std::shared_ptr<PendulumLike> MakePendulum(const Trajectory::PendulumInfo& info)
+{
+    std::shared_ptr<PendulumLike> p;
+    if (info.type == SPend)
+    {
+        auto s = std::make_shared<SPendulum>(0.0f, info.m1, info.L1);
+        s->px = info.px;
+        s->py = info.py;
+        p = s;
+    }
+    else if (info.type == DrivenPend)
+    {
+        // The drive is not recorded; playback only applies recorded states
+        auto f = std::make_shared<DrivenPendulum>(0.0f, info.m1, info.L1, 0.0f, 0.0f);
+        f->px = info.px;
+        f->py = info.py;
+        p = f;
+    }
+    else if (info.type == ElasticPend)
+    {
+        // Nor is the stiffness; the length comes back with every sample
+        auto e = std::make_shared<ElasticPendulum>(0.0f, info.m1, info.L1, 1000.0f);
+        e->px = info.px;
+        e->py = info.py;
+        p = e;
+    }
+    else
+    {
+        auto d = std::make_shared<DPendulum>(0.0f, 0.0f, info.m1, info.m2, info.L1, info.L2);
+        d->px = info.px;
+        d->py = info.py;
+        p = d;
+    }
+    return p;
+}
+
+void ApplySample(PendulumLike& p, const Trajectory::Sample& s)
+{
+    if (p.getType() == SPend)
+    {
+        auto& sp = static_cast<SPendulum&>(p);
+        sp.theta = s.theta1;
+        sp.omega = s.omega1;
+    }
+    else if (p.getType() == DPend)
+    {
+        auto& d = static_cast<DPendulum&>(p);
+        d.theta1 = s.theta1;
+        d.theta2 = s.theta2;
+        d.omega1 = s.omega1;
+        d.omega2 = s.omega2;
+    }
+    else if (p.getType() == DrivenPend)
+    {
+        auto& f = static_cast<DrivenPendulum&>(p);
+        f.theta = s.theta1;
+        f.omega = s.omega1;
+    }
+    else if (p.getType() == ElasticPend)
+    {
+        auto& e = static_cast<ElasticPendulum&>(p);
+        e.theta = s.theta1;
+        e.omega = s.omega1;
+        // Recordings from before the length had a channel only have it in the bob position
+        e.r = s.theta2 > 0.0f ? s.theta2 : std::hypot(s.x1 - e.px, s.y1 - e.py);
+        e.vr = s.omega2;
+    }
+}
+
+void SavePendulumState(Checkpoint::Writer& out, const std::vector<std::shared_ptr<PendulumLike>>& PendVec)
+{
+    out.pod<uint64_t>(PendVec.size());
+    for (const auto& p : PendVec)
+    {
+        out.pod<uint32_t>(p->getType());
+        out.pod<uint8_t>(p->isFreezed);
+        out.pod<uint8_t>(p->isRecorded);
+        out.pod<int32_t>(p->getMaxTrail());
+        if (p->getType() == SPend)
+        {
+            const auto& s = static_cast<const SPendulum&>(*p);
+            const float fields[] = { s.theta, s.omega, s.m, s.L, s.px, s.py };
+            out.pod(fields);
+        }
+        else if (p->getType() == DrivenPend)
+        {
+            const auto& f = static_cast<const DrivenPendulum&>(*p);
+            const float fields[] = { f.theta, f.omega, f.phase, f.m, f.L, f.amplitude, f.frequency, f.px, f.py };
+            out.pod(fields);
+        }
+        else if (p->getType() == ElasticPend)
+        {
+            const auto& e = static_cast<const ElasticPendulum&>(*p);
+            const float fields[] = { e.theta, e.omega, e.r, e.vr, e.m, e.L, e.k, e.px, e.py };
+            out.pod(fields);
+        }
+        else
+        {
+            const auto& d = static_cast<const DPendulum&>(*p);
+            const float fields[] = { d.theta1, d.theta2, d.omega1, d.omega2, d.m1, d.m2, d.L1, d.L2, d.px, d.py };
+            out.pod(fields);
+        }
+        p->trail.save(out);
+    }
+}
+
+bool LoadPendulumState(Checkpoint::Reader& in, std::vector<std::shared_ptr<PendulumLike>>& PendVec, std::string& error)
+{
+    uint64_t count = 0;
+    in.pod(count);
+    std::vector<std::shared_ptr<PendulumLike>> loaded;
+    for (uint64_t i = 0; i < count && in.ok(); ++i)
+    {
+        uint32_t type = 0;
+        uint8_t frozen = 0, recorded = 0;
+        int32_t maxTrail = 0;
+        in.pod(type);
+        in.pod(frozen);
+        in.pod(recorded);
+        in.pod(maxTrail);
+
+        std::shared_ptr<PendulumLike> p;
+        if (type == SPend)
+        {
+            float f[6] = {};
+            in.pod(f);
+            auto s = std::make_shared<SPendulum>(f[0], f[2], f[3]);
+            s->omega = f[1];
+            s->px = f[4];
+            s->py = f[5];
+            p = s;
+        }
+        else if (type == DPend)
+        {
+            float f[10] = {};
+            in.pod(f);
+            auto d = std::make_shared<DPendulum>(f[0], f[1], f[4], f[5], f[6], f[7]);
+            d->omega1 = f[2];
+            d->omega2 = f[3];
+            d->px = f[8];
+            d->py = f[9];
+            p = d;
+        }
+        else if (type == DrivenPend)
+        {
+            float f[9] = {};
+            in.pod(f);
+            auto r = std::make_shared<DrivenPendulum>(f[0], f[3], f[4], f[5], f[6]);
+            r->omega = f[1];
+            r->phase = f[2];
+            r->px = f[7];
+            r->py = f[8];
+            p = r;
+        }
+        else if (type == ElasticPend)
+        {
+            float f[9] = {};
+            in.pod(f);
+            auto e = std::make_shared<ElasticPendulum>(f[0], f[4], f[5], f[6]);
+            e->omega = f[1];
+            e->r = f[2];
+            e->vr = f[3];
+            e->px = f[7];
+            e->py = f[8];
+            p = e;
+        }
+        else
+        {
+            error = "Unknown pendulum type " + std::to_string(type) + " in checkpoint";
+            return false;
+        }
+        p->isFreezed = frozen != 0;
+        p->isRecorded = recorded != 0;
+        p->setMaxTrail(maxTrail);
+        if (!p->trail.load(in))
+            break;
+        loaded.push_back(p);
+    }
+    if (!in.ok() || loaded.size() != count)
+    {
+        error = "Checkpoint pendulum state is truncated";
+        return false;
+    }
+    PendVec.swap(loaded);
+    return true;
+}
@@ -3,19 +3,24 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <memory>
 #include "Renderer.h"
+#include "Trail.h"
+#include "TrajectoryFormat.h"
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
 enum PendulumTypes
 {
-    UNDECLARED = 0, SPend = 1, DPend = 2
+    UNDECLARED = 0, SPend = 1, DPend = 2, DrivenPend = 3, ElasticPend = 4
 };
 
 struct PendulumLike
 {
-    void setMaxTrail(int maxTrail) { this->maxTrail = maxTrail; }
+    PendulumLike() { trail.setMaxSamples(maxTrail); }
+    void setMaxTrail(int maxTrail) { this->maxTrail = maxTrail; trail.setMaxSamples(maxTrail); }
+    int getMaxTrail() const { return maxTrail; }
     virtual PendulumTypes getType() const { return UNDECLARED; };
     virtual void update(float damping, float g, float dt) = 0;
     virtual void reset() = 0;
@@ -26,7 +31,8 @@ struct PendulumLike
     
     
     bool isFreezed = false;
-    std::vector<std::pair<float, float>> trailPoints;
+    bool isRecorded = true;
+    TrailHistory trail;
     float px, py;
 
 protected:
@@ -47,6 +53,8 @@ struct DPendulum : PendulumLike
     float m1, m2;
     float px, py;
     float L1, L2;
+    // Whether the last step was stiff enough for the Rosenbrock path
+    bool isStiff = false;
 
     DPendulum(float t1, float t2, float m1_, float m2_, float L1_, float L2_)
         : theta1(t1), theta2(t2), omega1(0.0f), omega2(0.0f),
@@ -73,3 +81,73 @@ struct SPendulum : PendulumLike
     {
     }
 };
+// Single pendulum pushed by a sinusoidal torque, amplitude * cos(phase) of
+// angular acceleration with the phase turning at frequency rad/s
+struct DrivenPendulum : PendulumLike
+{
+    PendulumTypes getType() const override { return DrivenPend; }
+    void reset() override;
+    void update(float damping, float g, float dt) override;
+    void AddTrailPoint() override;
+    void render() override;
+    void drawUI(size_t index, std::vector<std::shared_ptr<PendulumLike>>& PendVec) override;
+    float theta;
+    float omega = 0.0f;
+    float phase = 0.0f;
+    float m;
+    float L;
+    float amplitude;
+    float frequency;
+    float px = 0.0f, py = 0.0f;
+    DrivenPendulum(float theta_, float m_, float L_, float amplitude_, float frequency_)
+        : theta(theta_), m(m_), L(L_), amplitude(amplitude_), frequency(frequency_)
+    {
+    }
+};
+
+// Single pendulum whose rod is a spring of rest length L and stiffness k
+// (N/m); r is the current length and vr its rate of change. Stepped with
+// Physics::stepElastic, which stays stable for stiff springs.
+struct ElasticPendulum : PendulumLike
+{
+    PendulumTypes getType() const override { return ElasticPend; }
+    void reset() override;
+    void update(float damping, float g, float dt) override;
+    void AddTrailPoint() override;
+    void render() override;
+    void drawUI(size_t index, std::vector<std::shared_ptr<PendulumLike>>& PendVec) override;
+    float theta;
+    float omega = 0.0f;
+    float r;
+    float vr = 0.0f;
+    float m;
+    float L;
+    float k;
+    float px = 0.0f, py = 0.0f;
+    ElasticPendulum(float theta_, float m_, float L_, float k_)
+        : theta(theta_), r(L_), m(m_), L(L_), k(k_)
+    {
+    }
+};
+
+// Scene files hold the pendulums as columns: singles, doubles, driven, then elastic ones
+bool SaveScene(const std::string& path, float g, float damping,
+               const std::vector<std::shared_ptr<PendulumLike>>& PendVec, bool withTrails, std::string& error);
+bool LoadScene(const std::string& path, float& g, float& damping,
+               std::vector<std::shared_ptr<PendulumLike>>& PendVec, std::string& error);
+
+// Recorder view of a pendulum: its fixed parameters and its current state
+Trajectory::PendulumInfo DescribePendulum(const PendulumLike& p);
+Trajectory::Sample SamplePendulum(const PendulumLike& p);
+// Playback counterparts: a pendulum built from recorded parameters, and a recorded state applied to it
+std::shared_ptr<PendulumLike> MakePendulum(const Trajectory::PendulumInfo& info);
+void ApplySample(PendulumLike& p, const Trajectory::Sample& s);
+
+namespace Checkpoint
+{
+    class Writer;
+    class Reader;
+}
+// Every field of every pendulum, trails included, so a restored run continues bit for bit
+void SavePendulumState(Checkpoint::Writer& out, const std::vector<std::shared_ptr<PendulumLike>>& PendVec);
+bool LoadPendulumState(Checkpoint::Reader& in, std::vector<std::shared_ptr<PendulumLike>>& PendVec, std::string& error);
@@ -0,0 +1,453 @@
+#pragma once
+#include <cmath>
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Equations of motion shared by the pendulum objects and the batch kernels,
+// so both paths produce the same numbers.
+namespace Physics
+{
+    template <typename Real>
+    inline Real wrapAngle(Real theta)
+    {
+        const Real TWO_PI = (Real)(2.0 * M_PI);
+
+        // Nearly every call is already in range, where fmod changes nothing
+        if (theta >= -M_PI && theta <= M_PI)
+            return theta;
+        theta = std::fmod(theta, TWO_PI);
+
+        if (theta > M_PI)
+            theta -= TWO_PI;
+        else if (theta < -M_PI)
+            theta += TWO_PI;
+
+        return theta;
+    }
+
+    template <typename Real>
+    inline Real accelSingle(Real theta, Real omega, Real L, Real damping, Real g)
+    {
+        Real a = -(g / L) * std::sin(theta);
+        // Linear damping
+        a -= damping * omega;
+        return a;
+    }
+
+    template <typename Real>
+    inline void accelDouble(Real theta1, Real theta2, Real omega1, Real omega2,
+                            Real m1, Real m2, Real L1, Real L2, Real damping, Real g,
+                            Real& a1, Real& a2)
+    {
+        Real delta = theta2 - theta1;
+        Real den1 = (m1 + m2) * L1 - m2 * L1 * std::cos(delta) * std::cos(delta);
+        Real den2 = (L2 / L1) * den1;
+
+        a1 = (m2 * L1 * omega1 * omega1 * std::sin(delta) * std::cos(delta) +
+               m2 * g * std::sin(theta2) * std::cos(delta) +
+               m2 * L2 * omega2 * omega2 * std::sin(delta) -
+               (m1 + m2) * g * std::sin(theta1)) /
+              den1;
+
+        a2 = (-m2 * L2 * omega2 * omega2 * std::sin(delta) * std::cos(delta) +
+               (m1 + m2) * (g * std::sin(theta1) * std::cos(delta) -
+                            L1 * omega1 * omega1 * std::sin(delta) -
+                            g * std::sin(theta2))) /
+              den2;
+
+        // Linear damping
+        a1 -= damping * omega1;
+        a2 -= damping * omega2;
+    }
+
+    // Semi-implicit Euler, the integrator the simulation runs with
+    template <typename Real>
+    inline void stepSingle(Real& theta, Real& omega, Real L, Real damping, Real g, Real dt)
+    {
+        Real a = accelSingle(theta, omega, L, damping, g);
+        omega += a * dt;
+        theta += omega * dt;
+        theta = wrapAngle(theta);
+    }
+
+    template <typename Real>
+    inline void stepDouble(Real& theta1, Real& theta2, Real& omega1, Real& omega2,
+                           Real m1, Real m2, Real L1, Real L2, Real damping, Real g, Real dt)
+    {
+        Real a1, a2;
+        accelDouble(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, a1, a2);
+
+        omega1 += a1 * dt;
+        omega2 += a2 * dt;
+        theta1 += omega1 * dt;
+        theta2 += omega2 * dt;
+
+        theta1 = wrapAngle(theta1);
+        theta2 = wrapAngle(theta2);
+    }
+
+    // accelDouble and its analytic Jacobian: A = d(a1, a2)/d(theta1, theta2)
+    // and B = d(a1, a2)/d(omega1, omega2), both row-major 2x2.
+    template <typename Real>
+    inline void accelJacobianDouble(Real theta1, Real theta2, Real omega1, Real omega2,
+                                    Real m1, Real m2, Real L1, Real L2, Real damping, Real g,
+                                    Real& a1, Real& a2, Real A[4], Real B[4])
+    {
+        const Real M = m1 + m2;
+        Real sd = std::sin(theta2 - theta1), cd = std::cos(theta2 - theta1);
+        Real s1 = std::sin(theta1), c1 = std::cos(theta1), s2 = std::sin(theta2), c2 = std::cos(theta2);
+        Real w1 = omega1 * omega1, w2 = omega2 * omega2;
+
+        Real den1 = M * L1 - m2 * L1 * cd * cd;
+        Real den2 = (L2 / L1) * den1;
+        Real n1 = m2 * L1 * w1 * sd * cd + m2 * g * s2 * cd + m2 * L2 * w2 * sd - M * g * s1;
+        Real n2 = -m2 * L2 * w2 * sd * cd + M * (g * s1 * cd - L1 * w1 * sd - g * s2);
+        Real u1 = n1 / den1, u2 = n2 / den2;
+
+        // Derivatives along delta = theta2 - theta1, then the explicit ones
+        Real dDen1 = 2 * m2 * L1 * cd * sd, dDen2 = (L2 / L1) * dDen1;
+        Real dn1 = m2 * L1 * w1 * (cd * cd - sd * sd) - m2 * g * s2 * sd + m2 * L2 * w2 * cd;
+        Real dn2 = -m2 * L2 * w2 * (cd * cd - sd * sd) - M * (g * s1 * sd + L1 * w1 * cd);
+        Real du1 = (dn1 - u1 * dDen1) / den1, du2 = (dn2 - u2 * dDen2) / den2;
+
+        A[0] = -du1 - M * g * c1 / den1;
+        A[1] = du1 + m2 * g * c2 * cd / den1;
+        A[2] = -du2 + M * g * c1 * cd / den2;
+        A[3] = du2 - M * g * c2 / den2;
+        B[0] = 2 * m2 * L1 * omega1 * sd * cd / den1 - damping;
+        B[1] = 2 * m2 * L2 * omega2 * sd / den1;
+        B[2] = -2 * M * L1 * omega1 * sd / den2;
+        B[3] = -2 * m2 * L2 * omega2 * sd * cd / den2 - damping;
+
+        a1 = u1 - damping * omega1;
+        a2 = u2 - damping * omega2;
+    }
+
+    // Bound on the spectral radius (1/s) of the double pendulum's Jacobian
+    // [[0, I], [A, B]]: its eigenvalues solve det(l^2 - l B - A) = 0, so
+    // |l| <= (|B| + sqrt(|B|^2 + 4 |A|)) / 2 in the infinity norm.
+    template <typename Real>
+    inline Real stiffnessDouble(const Real A[4], const Real B[4])
+    {
+        Real a = std::fabs(A[0]) + std::fabs(A[1]), b = std::fabs(B[0]) + std::fabs(B[1]);
+        Real a2 = std::fabs(A[2]) + std::fabs(A[3]), b2 = std::fabs(B[2]) + std::fabs(B[3]);
+        a = a > a2 ? a : a2;
+        b = b > b2 ? b : b2;
+        return (b + std::sqrt(b * b + 4 * a)) / 2;
+    }
+
+    // Whether dt times stiffnessDouble can pass limit in any state the
+    // pendulum can reach from this one without a drive, so one check covers
+    // any number of steps. Energy caps the speeds: the kinetic energy can
+    // grow by at most the bobs' height above their lowest point, and the
+    // mass matrix's smallest eigenvalue is at least det / trace. Each
+    // Jacobian entry is then bounded with every sine and cosine at 1 and den1
+    // at its minimum m1 L1, and the spectral bound
+    // (b + sqrt(b^2 + 4a)) / 2 <= limit / dt is tested as
+    // b <= limit / dt - a dt / limit. With b linear in the speed cap w, that
+    // compares squares, so there is no sqrt or trigonometry and a loop of
+    // these vectorizes.
+    template <typename Real>
+    inline bool canStiffenDouble(Real theta1, Real theta2, Real omega1, Real omega2, Real m1, Real m2, Real L1, Real L2,
+                                 Real damping, Real g, Real dt, Real limit)
+    {
+        const Real M = m1 + m2;
+        Real inv = 1 / (m1 * m2 * L1 * L1 * L2 * L2);
+        Real inv1 = inv * m2 * L1 * L2 * L2, inv2 = inv * m2 * L1 * L1 * L2; // 1 / (m1 L1), 1 / (m1 L2)
+        Real trace = M * L1 * L1 + m2 * L2 * L2;
+        Real kinetic = (Real)0.5 * (M * L1 * L1 * omega1 * omega1 + m2 * L2 * L2 * omega2 * omega2) +
+                       m2 * L1 * L2 * std::fabs(omega1 * omega2);
+        // Height above the lowest point, with 1 - cos(theta) <= min(theta^2 / 2, 2)
+        Real h1 = (Real)0.5 * theta1 * theta1, h2 = (Real)0.5 * theta2 * theta2;
+        h1 = h1 < 2 ? h1 : 2;
+        h2 = h2 < 2 ? h2 : 2;
+        Real w2 = 2 * (kinetic + g * (M * L1 * h1 + m2 * L2 * h2)) * trace * inv;
+
+        // |A| row sums, and |B| row sums as w times these plus damping
+        Real n1 = m2 * (L1 + L2) * w2 + (M + m2) * g, n2 = (m2 * L2 + M * L1) * w2 + 2 * M * g;
+        Real a1 = 2 * M * L1 * n1 * inv1 * inv1 + (M + m2) * g * inv1;
+        Real a2 = 2 * M * L2 * n2 * inv2 * inv2 + 2 * M * g * inv2;
+        Real b1 = 2 * m2 * (L1 + L2) * inv1, b2 = 2 * (M * L1 + m2 * L2) * inv2;
+        Real a = a1 > a2 ? a1 : a2, b = b1 > b2 ? b1 : b2;
+
+        Real room = limit / dt - a * dt / limit - damping;
+        return (room < 0) | (b * b * w2 > room * room);
+    }
+
+    // dt times the stiffness above which stepDoubleAuto leaves semi-implicit
+    // Euler, which goes unstable at 2 on an oscillator and loses accuracy
+    // well before
+    const double StiffLimit = 0.5;
+    // Largest local error, in radians, stepDoubleStiff lets a substep make
+    const double StiffTolerance = 1e-4;
+
+    // Linearly implicit Rosenbrock step, ROS2 (Verwer et al.) with
+    // gamma = 1 - 1/sqrt(2): second order and L-stable, using the analytic
+    // Jacobian. Each stage solves (I - gamma dt J) k = r; with
+    // J = [[0, I], [A, B]] that reduces to a 2x2 system for the omega part.
+    // Returns the local error estimate against the embedded first order
+    // solution, with the omega part scaled by dt into radians.
+    template <typename Real>
+    inline Real stepDoubleRosenbrock(Real& theta1, Real& theta2, Real& omega1, Real& omega2,
+                                     Real m1, Real m2, Real L1, Real L2, Real damping, Real g, Real dt)
+    {
+        Real a1, a2, A[4], B[4];
+        accelJacobianDouble(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, a1, a2, A, B);
+
+        const Real h = (Real)(1.0 - 0.70710678118654752) * dt;
+        Real S[4] = { 1 - h * B[0] - h * h * A[0], -h * B[1] - h * h * A[1],
+                      -h * B[2] - h * h * A[2], 1 - h * B[3] - h * h * A[3] };
+        Real inv = 1 / (S[0] * S[3] - S[1] * S[2]);
+        auto solve = [&](Real rt1, Real rt2, Real ro1, Real ro2, Real k[4]) {
+            Real v1 = ro1 + h * (A[0] * rt1 + A[1] * rt2), v2 = ro2 + h * (A[2] * rt1 + A[3] * rt2);
+            k[2] = (S[3] * v1 - S[1] * v2) * inv;
+            k[3] = (S[0] * v2 - S[2] * v1) * inv;
+            k[0] = rt1 + h * k[2];
+            k[1] = rt2 + h * k[3];
+        };
+
+        Real k1[4], k2[4];
+        solve(omega1, omega2, a1, a2, k1);
+        Real t1 = theta1 + dt * k1[0], t2 = theta2 + dt * k1[1];
+        Real o1 = omega1 + dt * k1[2], o2 = omega2 + dt * k1[3];
+        Real b1, b2;
+        accelDouble(t1, t2, o1, o2, m1, m2, L1, L2, damping, g, b1, b2);
+        solve(o1 - 2 * k1[0], o2 - 2 * k1[1], b1 - 2 * k1[2], b2 - 2 * k1[3], k2);
+
+        theta1 = wrapAngle(theta1 + dt * (Real)1.5 * k1[0] + dt * (Real)0.5 * k2[0]);
+        theta2 = wrapAngle(theta2 + dt * (Real)1.5 * k1[1] + dt * (Real)0.5 * k2[1]);
+        omega1 += dt * (Real)1.5 * k1[2] + dt * (Real)0.5 * k2[2];
+        omega2 += dt * (Real)1.5 * k1[3] + dt * (Real)0.5 * k2[3];
+
+        Real e = std::fabs(k1[0] + k2[0]);
+        e = std::fmax(e, std::fabs(k1[1] + k2[1]));
+        e = std::fmax(e, std::fabs(k1[2] + k2[2]) * dt);
+        e = std::fmax(e, std::fabs(k1[3] + k2[3]) * dt);
+        return (Real)0.5 * dt * e;
+    }
+
+    // Advances a stiff double pendulum by dt in as many Rosenbrock substeps
+    // as StiffTolerance needs. The first substep tries the whole dt, so
+    // nothing carries over between calls. The stiffness of these pendulums
+    // comes from near-singular moments where the light link whips round in
+    // a few milliseconds, not from a mode that just decays, and a linearly
+    // implicit step cannot cross those at a fixed size; the error control
+    // shrinks the substeps through the whip and grows them back after.
+    // Substeps never go below dt / MaxSubsteps, and once the attempts run
+    // out the rest of dt goes in one, so a call always finishes.
+    template <typename Real>
+    inline void stepDoubleStiff(Real& theta1, Real& theta2, Real& omega1, Real& omega2,
+                                Real m1, Real m2, Real L1, Real L2, Real damping, Real g, Real dt)
+    {
+        const Real tol = (Real)StiffTolerance;
+        const int MaxSubsteps = 1000;
+        const Real smallest = dt / MaxSubsteps;
+        Real t = 0, h = dt;
+        for (int n = 0; t < dt; ++n)
+        {
+            // A NaN state never passes the error test; it stays as it is
+            if (!(std::isfinite(theta1) && std::isfinite(theta2) && std::isfinite(omega1) && std::isfinite(omega2)))
+                return;
+            // Out of attempts, the rest of dt stands rather than stalling the frame
+            bool last = n >= MaxSubsteps || h >= dt - t;
+            Real step = last ? dt - t : h;
+            Real y[4] = { theta1, theta2, omega1, omega2 };
+            Real err = stepDoubleRosenbrock(y[0], y[1], y[2], y[3], m1, m2, L1, L2, damping, g, step);
+            if (std::isnan(err))
+                return;
+            if ((err <= tol && std::isfinite(y[2]) && std::isfinite(y[3])) || n >= MaxSubsteps || step <= smallest)
+            {
+                theta1 = y[0];
+                theta2 = y[1];
+                omega1 = y[2];
+                omega2 = y[3];
+                t = last ? dt : t + step;
+            }
+            // Usual controller for a second order pair, kept within [0.2, 4]
+            Real f = !std::isfinite(err) ? (Real)0.2 : err > 0 ? (Real)0.9 * std::sqrt(tol / err) : (Real)4;
+            f = f < (Real)0.2 ? (Real)0.2 : f > (Real)4 ? (Real)4 : f;
+            h = step * f > smallest ? step * f : smallest;
+        }
+    }
+
+    // Semi-implicit Euler while the pendulum is not stiff at this dt, the
+    // error-controlled Rosenbrock path once it is, decided afresh from the
+    // state every step. Returns dt times the stiffness it measured, so the
+    // step was stiff when that is above StiffLimit.
+    template <typename Real>
+    inline Real stepDoubleAuto(Real& theta1, Real& theta2, Real& omega1, Real& omega2,
+                               Real m1, Real m2, Real L1, Real L2, Real damping, Real g, Real dt)
+    {
+        Real a1, a2, A[4], B[4];
+        accelJacobianDouble(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, a1, a2, A, B);
+        Real ratio = dt * stiffnessDouble(A, B);
+        // NaN stays on the explicit path, which cannot loop on it
+        if (!(ratio > (Real)StiffLimit))
+        {
+            omega1 += a1 * dt;
+            omega2 += a2 * dt;
+            theta1 = wrapAngle(theta1 + omega1 * dt);
+            theta2 = wrapAngle(theta2 + omega2 * dt);
+            return ratio;
+        }
+        stepDoubleStiff(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, dt);
+        return ratio;
+    }
+
+    // Single pendulum driven by a sinusoidal torque: amplitude is the angular
+    // acceleration it adds at its peak and phase the drive's current angle.
+    template <typename Real>
+    inline Real accelDriven(Real theta, Real omega, Real L, Real damping, Real g, Real amplitude, Real phase)
+    {
+        return accelSingle(theta, omega, L, damping, g) + amplitude * std::cos(phase);
+    }
+
+    // Semi-implicit Euler like stepSingle, with the drive advanced by
+    // frequency (rad/s) each step. frequency * dt stays below a turn, so one
+    // correction keeps the phase in [-pi, pi] without fmod.
+    template <typename Real>
+    inline void stepDriven(Real& theta, Real& omega, Real& phase, Real L, Real damping, Real g,
+                           Real amplitude, Real frequency, Real dt)
+    {
+        const Real TWO_PI = (Real)(2.0 * M_PI);
+        Real a = accelDriven(theta, omega, L, damping, g, amplitude, phase);
+        omega += a * dt;
+        theta += omega * dt;
+        theta = wrapAngle(theta);
+        phase += frequency * dt;
+        if (phase > (Real)M_PI)
+            phase -= TWO_PI;
+        else if (phase < (Real)-M_PI)
+            phase += TWO_PI;
+    }
+
+    // Single pendulum on a spring of rest length L and stiffness k: the rod
+    // length r is a state of its own, with vr its rate of change. Stiff
+    // springs ring far faster than the swing, so the step is IMEX: gravity,
+    // the centrifugal and Coriolis terms are semi-implicit Euler as in
+    // stepSingle, while the spring and radial damping are solved with the
+    // trapezoidal rule. That part is A-stable, so any k runs at the usual
+    // millisecond steps, and it does not bleed energy from soft springs.
+    // Everything is branch-free so the batch kernel vectorizes across
+    // pendulums.
+    template <typename Real>
+    inline void stepElastic(Real& theta, Real& omega, Real& r, Real& vr, Real m, Real L, Real k,
+                            Real damping, Real g, Real dt)
+    {
+        const Real TWO_PI = (Real)(2.0 * M_PI);
+        Real s = std::sin(theta), c = std::cos(theta);
+
+        Real a = (-g * s - 2 * vr * omega) / r - damping * omega;
+        omega += a * dt;
+
+        // v' = v + dt (ar - w2 (r + r') / 2 + w2 L - damping (v + v') / 2)
+        // with r' = r + dt (v + v') / 2, solved for v'
+        Real w2 = k / m;
+        Real ar = r * omega * omega + g * c - w2 * (r - L);
+        Real h = dt / 2, stiff = h * damping + h * h * w2;
+        Real v = (vr * (1 - stiff) + dt * ar) / (1 + stiff);
+        r += h * (vr + v);
+        vr = v;
+        // A collapsed spring would put the bob on the pivot
+        r = r > (Real)0.01 * L ? r : (Real)0.01 * L;
+
+        theta += omega * dt;
+        theta -= TWO_PI * std::floor(theta / TWO_PI + (Real)0.5);
+    }
+
+    // Explicit midpoint (second order Runge-Kutta)
+    template <typename Real>
+    inline void stepSingleRK2(Real& theta, Real& omega, Real L, Real damping, Real g, Real dt)
+    {
+        const Real h = dt / 2;
+        Real a = accelSingle(theta, omega, L, damping, g);
+        Real tm = theta + h * omega, om = omega + h * a;
+        theta += dt * om;
+        omega += dt * accelSingle(tm, om, L, damping, g);
+        theta = wrapAngle(theta);
+    }
+
+    template <typename Real>
+    inline void stepDoubleRK2(Real& theta1, Real& theta2, Real& omega1, Real& omega2,
+                              Real m1, Real m2, Real L1, Real L2, Real damping, Real g, Real dt)
+    {
+        const Real h = dt / 2;
+        Real a1, a2;
+        accelDouble(theta1, theta2, omega1, omega2, m1, m2, L1, L2, damping, g, a1, a2);
+        Real t1 = theta1 + h * omega1, t2 = theta2 + h * omega2;
+        Real o1 = omega1 + h * a1, o2 = omega2 + h * a2;
+        accelDouble(t1, t2, o1, o2, m1, m2, L1, L2, damping, g, a1, a2);
+
+        theta1 = wrapAngle(theta1 + dt * o1);
+        theta2 = wrapAngle(theta2 + dt * o2);
+        omega1 += dt * a1;
+        omega2 += dt * a2;
+    }
+
+    // Classical fourth order Runge-Kutta
+    template <typename Real>
+    inline void stepSingleRK4(Real& theta, Real& omega, Real L, Real damping, Real g, Real dt)
+    {
+        const Real h = dt / 2;
+        Real kt1 = omega, ko1 = accelSingle(theta, omega, L, damping, g);
+        Real kt2 = omega + h * ko1, ko2 = accelSingle(theta + h * kt1, kt2, L, damping, g);
+        Real kt3 = omega + h * ko2, ko3 = accelSingle(theta + h * kt2, kt3, L, damping, g);
+        Real kt4 = omega + dt * ko3, ko4 = accelSingle(theta + dt * kt3, kt4, L, damping, g);
+
+        theta += dt / 6 * (kt1 + 2 * kt2 + 2 * kt3 + kt4);
+        omega += dt / 6 * (ko1 + 2 * ko2 + 2 * ko3 + ko4);
+        theta = wrapAngle(theta);
+    }
+
+    template <typename Real>
+    inline void stepDoubleRK4(Real& theta1, Real& theta2, Real& omega1, Real& omega2,
+                              Real m1, Real m2, Real L1, Real L2, Real damping, Real g, Real dt)
+    {
+        const Real h = dt / 2;
+        Real a1[4], a2[4], w1[4], w2[4];
+
+        w1[0] = omega1;
+        w2[0] = omega2;
+        accelDouble(theta1, theta2, w1[0], w2[0], m1, m2, L1, L2, damping, g, a1[0], a2[0]);
+        w1[1] = omega1 + h * a1[0];
+        w2[1] = omega2 + h * a2[0];
+        accelDouble(theta1 + h * w1[0], theta2 + h * w2[0], w1[1], w2[1], m1, m2, L1, L2, damping, g, a1[1], a2[1]);
+        w1[2] = omega1 + h * a1[1];
+        w2[2] = omega2 + h * a2[1];
+        accelDouble(theta1 + h * w1[1], theta2 + h * w2[1], w1[2], w2[2], m1, m2, L1, L2, damping, g, a1[2], a2[2]);
+        w1[3] = omega1 + dt * a1[2];
+        w2[3] = omega2 + dt * a2[2];
+        accelDouble(theta1 + dt * w1[2], theta2 + dt * w2[2], w1[3], w2[3], m1, m2, L1, L2, damping, g, a1[3], a2[3]);
+
+        theta1 = wrapAngle(theta1 + dt / 6 * (w1[0] + 2 * w1[1] + 2 * w1[2] + w1[3]));
+        theta2 = wrapAngle(theta2 + dt / 6 * (w2[0] + 2 * w2[1] + 2 * w2[2] + w2[3]));
+        omega1 += dt / 6 * (a1[0] + 2 * a1[1] + 2 * a1[2] + a1[3]);
+        omega2 += dt / 6 * (a2[0] + 2 * a2[1] + 2 * a2[2] + a2[3]);
+    }
+
+    // Total mechanical energy, with the pivot as the zero of potential
+    template <typename Real>
+    inline Real energySingle(Real theta, Real omega, Real m, Real L, Real g)
+    {
+        return (Real)0.5 * m * L * L * omega * omega - m * g * L * std::cos(theta);
+    }
+
+    template <typename Real>
+    inline Real energyDouble(Real theta1, Real theta2, Real omega1, Real omega2,
+                             Real m1, Real m2, Real L1, Real L2, Real g)
+    {
+        Real kinetic = (Real)0.5 * (m1 + m2) * L1 * L1 * omega1 * omega1 +
+                       (Real)0.5 * m2 * L2 * L2 * omega2 * omega2 +
+                       m2 * L1 * L2 * omega1 * omega2 * std::cos(theta1 - theta2);
+        Real potential = -(m1 + m2) * g * L1 * std::cos(theta1) - m2 * g * L2 * std::cos(theta2);
+        return kinetic + potential;
+    }
+
+    template <typename Real>
+    inline Real energyElastic(Real theta, Real omega, Real r, Real vr, Real m, Real L, Real k, Real g)
+    {
+        return (Real)0.5 * m * (vr * vr + r * r * omega * omega) - m * g * r * std::cos(theta) +
+               (Real)0.5 * k * (r - L) * (r - L);
+    }
+}
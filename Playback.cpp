@@ -0,0 +1,288 @@
+#include "Playback.h"
+#include "Compression.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+bool TrajectoryPlayer::open(const std::string& path, std::string& error)
+{
+    close();
+    if (!file.open(path, MappedFile::ReadOnly, error))
+        return false;
+
+    const uint8_t* base = file.bytes();
+    if (file.size() < sizeof(header))
+    {
+        error = path + " is not a trajectory file";
+        close();
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, Trajectory::fileMagic(), sizeof(header.magic)) != 0 ||
+        header.version != Trajectory::Version || header.headerSize != sizeof(header) ||
+        header.laneCount == 0 || header.laneCount > header.pendulumCount ||
+        (header.channelCount != Trajectory::StateChannels && header.channelCount != Trajectory::ChannelCount) ||
+        header.pendulumCount > (file.size() - sizeof(header)) / sizeof(Trajectory::PendulumInfo))
+    {
+        error = path + " is not a trajectory file this version can read";
+        close();
+        return false;
+    }
+
+    infos.resize(header.pendulumCount);
+    std::memcpy(infos.data(), base + sizeof(header), infos.size() * sizeof(Trajectory::PendulumInfo));
+
+    lanes.resize(header.laneCount);
+    for (size_t l = 0; l < lanes.size(); ++l)
+    {
+        lanes[l].first = l * infos.size() / lanes.size();
+        lanes[l].count = (l + 1) * infos.size() / lanes.size() - lanes[l].first;
+    }
+
+    if (!buildIndex(error))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TrajectoryPlayer::close()
+{
+    file.close();
+    infos.clear();
+    lanes.clear();
+    for (Decoded& d : cache)
+        d.offset = UINT64_MAX;
+    start = end = 0.0;
+    dropped = 0;
+}
+
+bool TrajectoryPlayer::buildIndex(std::string& error)
+{
+    const uint8_t* base = file.bytes();
+    const uint64_t size = file.size();
+    const uint64_t dataStart = sizeof(header) + infos.size() * sizeof(Trajectory::PendulumInfo);
+
+    // Prefer the footer index, fall back to walking the chunk headers of a file cut short
+    Trajectory::Footer footer = {};
+    bool haveFooter = false;
+    if (size >= dataStart + sizeof(footer))
+    {
+        std::memcpy(&footer, base + size - sizeof(footer), sizeof(footer));
+        haveFooter = std::memcmp(footer.magic, Trajectory::footerMagic(), sizeof(footer.magic)) == 0 &&
+                     footer.indexOffset >= dataStart && footer.indexOffset <= size - sizeof(footer) &&
+                     footer.chunkCount <= (size - sizeof(footer) - footer.indexOffset) / sizeof(Trajectory::IndexEntry);
+    }
+
+    std::vector<Trajectory::IndexEntry> entries;
+    if (haveFooter)
+    {
+        entries.resize(footer.chunkCount);
+        std::memcpy(entries.data(), base + footer.indexOffset, entries.size() * sizeof(Trajectory::IndexEntry));
+        dropped = footer.droppedChunks;
+    }
+    else
+    {
+        uint64_t at = dataStart;
+        Trajectory::ChunkHeader chunk;
+        while (at + sizeof(chunk) <= size)
+        {
+            std::memcpy(&chunk, base + at, sizeof(chunk));
+            if (chunk.magic != Trajectory::ChunkMagic || chunk.storedBytes > size - at - sizeof(chunk))
+                break;
+            entries.push_back({ chunk.t0, chunk.t1, at, chunk.lane, chunk.sampleCount });
+            at += sizeof(chunk) + chunk.storedBytes;
+        }
+    }
+
+    for (const auto& e : entries)
+    {
+        if (e.lane >= lanes.size() || e.offset < dataStart || e.offset > size - sizeof(Trajectory::ChunkHeader) || e.sampleCount == 0)
+        {
+            error = "Trajectory index points outside the file";
+            return false;
+        }
+        lanes[e.lane].keyframes.push_back({ e.t0, e.t1, e.offset, e.sampleCount });
+    }
+
+    bool any = false;
+    for (Lane& lane : lanes)
+    {
+        std::sort(lane.keyframes.begin(), lane.keyframes.end(),
+                  [](const Keyframe& a, const Keyframe& b) { return a.t0 < b.t0; });
+        if (lane.keyframes.empty())
+            continue;
+        start = any ? std::min(start, lane.keyframes.front().t0) : lane.keyframes.front().t0;
+        end = any ? std::max(end, lane.keyframes.back().t1) : lane.keyframes.back().t1;
+        any = true;
+    }
+    if (!any)
+    {
+        error = "Trajectory file holds no samples";
+        return false;
+    }
+    return true;
+}
+
+const TrajectoryPlayer::Decoded* TrajectoryPlayer::decode(const Lane& lane, const Keyframe& key)
+{
+    Decoded* slot = &cache[0];
+    for (Decoded& d : cache)
+    {
+        if (d.offset == key.offset)
+        {
+            d.lastUse = ++useCounter;
+            return &d;
+        }
+        if (d.lastUse < slot->lastUse)
+            slot = &d;
+    }
+
+    TRACE_ZONE("Decode chunk");
+    Trajectory::ChunkHeader chunk;
+    std::memcpy(&chunk, file.bytes() + key.offset, sizeof(chunk));
+    const uint64_t columns = (uint64_t)chunk.pendulumCount * header.channelCount;
+    const uint64_t expected = chunk.sampleCount * (sizeof(double) + columns * sizeof(float));
+    if (chunk.magic != Trajectory::ChunkMagic || chunk.rawBytes != expected ||
+        chunk.storedBytes > file.size() - key.offset - sizeof(chunk))
+        return nullptr;
+    // seek and sampleAt index the chunk by the lane's pendulums and the key's samples
+    if (chunk.lane != (size_t)(&lane - lanes.data()) || chunk.firstPendulum != lane.first ||
+        chunk.pendulumCount != lane.count || chunk.sampleCount != key.samples)
+        return nullptr;
+
+    const uint8_t* payload = file.bytes() + key.offset + sizeof(chunk);
+    slot->bytes.resize(chunk.rawBytes);
+    if (chunk.codec == Trajectory::Raw)
+    {
+        if (chunk.storedBytes != chunk.rawBytes)
+            return nullptr;
+        std::memcpy(slot->bytes.data(), payload, chunk.rawBytes);
+    }
+    else if (chunk.codec == Trajectory::ShuffledLz)
+    {
+        scratch.resize(chunk.rawBytes);
+        if (!Compression::decompress(payload, chunk.storedBytes, scratch.data(), chunk.rawBytes))
+            return nullptr;
+        const size_t timeBytes = chunk.sampleCount * sizeof(double);
+        Compression::unshuffle(scratch.data(), chunk.sampleCount, sizeof(double), slot->bytes.data());
+        Compression::unshuffle(scratch.data() + timeBytes, columns * chunk.sampleCount, sizeof(float),
+                               slot->bytes.data() + timeBytes);
+    }
+    else
+    {
+        return nullptr;
+    }
+
+    slot->offset = key.offset;
+    slot->samples = chunk.sampleCount;
+    slot->lastUse = ++useCounter;
+    return slot;
+}
+
+size_t TrajectoryPlayer::laneOf(size_t pendulum) const
+{
+    for (size_t l = 0; l < lanes.size(); ++l)
+        if (pendulum < lanes[l].first + lanes[l].count)
+            return l;
+    return lanes.size() - 1;
+}
+
+Trajectory::Sample TrajectoryPlayer::sampleAt(const Decoded& chunk, size_t local, size_t s, size_t pendulum) const
+{
+    float values[Trajectory::ChannelCount] = {};
+    for (size_t c = 0; c < header.channelCount; ++c)
+        values[c] = chunk.column(local, c, header.channelCount)[s];
+
+    Trajectory::Sample sample;
+    std::memcpy(&sample, values, Trajectory::StateChannels * sizeof(float));
+    if (header.channelCount == Trajectory::ChannelCount)
+    {
+        std::memcpy(&sample, values, sizeof(sample));
+        return sample;
+    }
+
+    // Positions were not stored, rebuild them from the angles
+    const Trajectory::PendulumInfo& info = infos[pendulum];
+    if (info.type == Trajectory::ElasticType)
+    {
+        // The rod's length is in theta2, falling back to its rest length
+        const float r = sample.theta2 > 0.0f ? sample.theta2 : info.L1;
+        sample.x1 = sample.x2 = info.px + r * std::sin(sample.theta1);
+        sample.y1 = sample.y2 = info.py - r * std::cos(sample.theta1);
+        return sample;
+    }
+    sample.x1 = info.px + info.L1 * std::sin(sample.theta1);
+    sample.y1 = info.py - info.L1 * std::cos(sample.theta1);
+    sample.x2 = sample.x1 + info.L2 * std::sin(sample.theta2);
+    sample.y2 = sample.y1 - info.L2 * std::cos(sample.theta2);
+    return sample;
+}
+
+bool TrajectoryPlayer::seek(double time, std::vector<Trajectory::Sample>& out)
+{
+    out.resize(infos.size());
+    for (const Lane& lane : lanes)
+    {
+        if (lane.keyframes.empty())
+            continue;
+        auto it = std::upper_bound(lane.keyframes.begin(), lane.keyframes.end(), time,
+                                   [](double t, const Keyframe& k) { return t < k.t0; });
+        const Keyframe& key = it == lane.keyframes.begin() ? *it : *(it - 1);
+        const Decoded* chunk = decode(lane, key);
+        if (!chunk)
+            return false;
+
+        const double* times = chunk->time();
+        size_t s = std::upper_bound(times, times + chunk->samples, time) - times;
+        s = s == 0 ? 0 : s - 1;
+        for (size_t p = 0; p < lane.count; ++p)
+            out[lane.first + p] = sampleAt(*chunk, p, s, lane.first + p);
+    }
+    return true;
+}
+
+template <typename Visit>
+void TrajectoryPlayer::visitSamples(size_t i, double t0, double t1, double interval, Visit&& visit)
+{
+    if (i >= infos.size())
+        return;
+    const Lane& lane = lanes[laneOf(i)];
+    auto it = std::upper_bound(lane.keyframes.begin(), lane.keyframes.end(), t0,
+                               [](double t, const Keyframe& k) { return t < k.t0; });
+    if (it != lane.keyframes.begin())
+        --it;
+
+    double last = -INFINITY;
+    for (; it != lane.keyframes.end() && it->t0 <= t1; ++it)
+    {
+        const Decoded* chunk = decode(lane, *it);
+        if (!chunk)
+            break;
+        const double* times = chunk->time();
+        for (size_t s = 0; s < chunk->samples; ++s)
+        {
+            if (times[s] < t0 || times[s] > t1 || times[s] - last < interval)
+                continue;
+            visit(sampleAt(*chunk, i - lane.first, s, i));
+            last = times[s];
+        }
+    }
+}
+
+size_t TrajectoryPlayer::positions(size_t i, double t0, double t1, double interval,
+                                   std::vector<std::pair<float, float>>& out)
+{
+    out.clear();
+    visitSamples(i, t0, t1, interval, [&](const Trajectory::Sample& sample) { out.emplace_back(sample.x2, sample.y2); });
+    return out.size();
+}
+
+size_t TrajectoryPlayer::states(size_t i, double t0, double t1, double interval, std::vector<Trajectory::Sample>& out)
+{
+    out.clear();
+    visitSamples(i, t0, t1, interval, [&](const Trajectory::Sample& sample) { out.push_back(sample); });
+    return out.size();
+}
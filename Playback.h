@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include "MappedFile.h"
+#include "TrajectoryFormat.h"
+
+// Random access to a recorded trajectory file. The file is mapped, every
+// lane keeps a time-sorted keyframe per chunk, and seeking decodes only the
+// chunk holding the requested instant.
+class TrajectoryPlayer
+{
+public:
+    bool open(const std::string& path, std::string& error);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    size_t pendulumCount() const { return infos.size(); }
+    const Trajectory::PendulumInfo& pendulum(size_t i) const { return infos[i]; }
+    double startTime() const { return start; }
+    double endTime() const { return end; }
+    uint64_t droppedChunks() const { return dropped; }
+
+    // State of every pendulum at the last sample at or before time.
+    bool seek(double time, std::vector<Trajectory::Sample>& out);
+    // Outer bob positions of pendulum i over [t0, t1], oldest first, at most one per interval.
+    size_t positions(size_t i, double t0, double t1, double interval, std::vector<std::pair<float, float>>& out);
+    // Whole states of pendulum i, picked the same way
+    size_t states(size_t i, double t0, double t1, double interval, std::vector<Trajectory::Sample>& out);
+
+private:
+    struct Keyframe
+    {
+        double t0, t1;
+        uint64_t offset;
+        uint32_t samples;
+    };
+
+    struct Lane
+    {
+        size_t first = 0, count = 0;
+        std::vector<Keyframe> keyframes;
+    };
+
+    struct Decoded
+    {
+        uint64_t offset = UINT64_MAX;
+        uint64_t lastUse = 0;
+        uint32_t samples = 0;
+        std::vector<uint8_t> bytes;
+        const double* time() const { return reinterpret_cast<const double*>(bytes.data()); }
+        const float* column(size_t pendulum, size_t channel, size_t channels) const
+        {
+            return reinterpret_cast<const float*>(bytes.data() + samples * sizeof(double)) +
+                   (pendulum * channels + channel) * samples;
+        }
+    };
+
+    // Calls visit(sample) for the samples of pendulum i that positions and states pick
+    template <typename Visit>
+    void visitSamples(size_t i, double t0, double t1, double interval, Visit&& visit);
+    bool buildIndex(std::string& error);
+    const Decoded* decode(const Lane& lane, const Keyframe& key);
+    size_t laneOf(size_t pendulum) const;
+    Trajectory::Sample sampleAt(const Decoded& chunk, size_t local, size_t s, size_t pendulum) const;
+
+    MappedFile file;
+    Trajectory::FileHeader header = {};
+    std::vector<Trajectory::PendulumInfo> infos;
+    std::vector<Lane> lanes;
+    double start = 0.0, end = 0.0;
+    uint64_t dropped = 0;
+
+    Decoded cache[8];
+    uint64_t useCounter = 0;
+    std::vector<uint8_t> scratch;
+};
@@ -0,0 +1,220 @@
+#include "Poincare.h"
+#include <algorithm>
+#include <cmath>
+#include "Physics.h"
+
+namespace
+{
+    const char* Names[Poincare::VariableCount] = { "theta1", "theta2", "omega1", "omega2" };
+    // Pendulums per block in Recorder::step, sized so a block's state stays in L1
+    const size_t BlockSize = 256;
+
+    bool isAngle(int v)
+    {
+        return v == Poincare::Theta1 || v == Poincare::Theta2;
+    }
+
+    double hermite(double y0, double d0, double y1, double d1, double dt, double s)
+    {
+        double s2 = s * s, s3 = s2 * s;
+        return (2 * s3 - 3 * s2 + 1) * y0 + (s3 - 2 * s2 + s) * dt * d0 + (3 * s2 - 2 * s3) * y1 + (s3 - s2) * dt * d1;
+    }
+
+    // Distance of the section variable past the plane, angles relative to it
+    double offset(const Poincare::Section& section, const Poincare::State& s)
+    {
+        double d = (double)s.v[section.variable] - section.value;
+        return isAngle(section.variable) ? Physics::wrapAngle(d) : d;
+    }
+
+    float wrapOnce(float d)
+    {
+        const float Pi = 3.14159265f, TwoPi = 6.28318531f;
+        d = d > Pi ? d - TwoPi : d;
+        return d < -Pi ? d + TwoPi : d;
+    }
+
+    bool straddles(Poincare::Direction direction, double g0, double g1)
+    {
+        bool rising = g0 < 0.0 && g1 >= 0.0;
+        bool falling = g0 > 0.0 && g1 <= 0.0;
+        return direction == Poincare::Rising ? rising : direction == Poincare::Falling ? falling : rising || falling;
+    }
+}
+
+const char* Poincare::name(Variable v)
+{
+    return v >= 0 && v < VariableCount ? Names[v] : "?";
+}
+
+bool Poincare::locate(const Section& section, const State& before, const State& after, const Params& p, float dt,
+                      State& crossing, float* fraction)
+{
+    // Angles continue across the wrap so the interpolant stays smooth
+    double y0[VariableCount], y1[VariableCount];
+    for (int v = 0; v < VariableCount; ++v)
+    {
+        y0[v] = before.v[v];
+        y1[v] = isAngle(v) ? y0[v] + Physics::wrapAngle((double)after.v[v] - before.v[v]) : (double)after.v[v];
+    }
+    const double g0 = offset(section, before);
+    const double g1 = g0 + (y1[section.variable] - y0[section.variable]);
+    if (!straddles(section.direction, g0, g1))
+        return false;
+
+    double a0[2], a1[2];
+    Physics::accelDouble<double>(y0[Theta1], y0[Theta2], y0[Omega1], y0[Omega2], p.m1, p.m2, p.L1, p.L2, p.damping, p.g,
+                                 a0[0], a0[1]);
+    Physics::accelDouble<double>(y1[Theta1], y1[Theta2], y1[Omega1], y1[Omega2], p.m1, p.m2, p.L1, p.L2, p.damping, p.g,
+                                 a1[0], a1[1]);
+    const double d0[VariableCount] = { y0[Omega1], y0[Omega2], a0[0], a0[1] };
+    const double d1[VariableCount] = { y1[Omega1], y1[Omega2], a1[0], a1[1] };
+
+    const int k = section.variable;
+    auto g = [&](double s) { return hermite(g0, d0[k], g1, d1[k], dt, s); };
+
+    // Illinois regula falsi on [0, 1]: bracketed like bisection, close to
+    // secant speed on a cubic this smooth
+    double lo = 0.0, hi = 1.0, glo = g0, ghi = g1, s = 1.0;
+    int side = 0;
+    for (int i = 0; i < 40 && ghi != 0.0; ++i)
+    {
+        s = (lo * ghi - hi * glo) / (ghi - glo);
+        double gs = g(s);
+        if (gs == 0.0 || hi - lo < 1e-12)
+            break;
+        if ((gs < 0.0) == (glo < 0.0))
+        {
+            lo = s;
+            glo = gs;
+            if (side == -1)
+                ghi *= 0.5;
+            side = -1;
+        }
+        else
+        {
+            hi = s;
+            ghi = gs;
+            if (side == 1)
+                glo *= 0.5;
+            side = 1;
+        }
+    }
+
+    for (int v = 0; v < VariableCount; ++v)
+    {
+        double y = hermite(y0[v], d0[v], y1[v], d1[v], dt, s);
+        crossing.v[v] = (float)(isAngle(v) ? Physics::wrapAngle(y) : y);
+    }
+    // Exactly on the plane, whatever rounding the interpolant left
+    crossing.v[k] = isAngle(k) ? Physics::wrapAngle(section.value) : section.value;
+    if (fraction)
+        *fraction = (float)s;
+    return true;
+}
+
+void Poincare::Recorder::reset(size_t pendulums, size_t capacity)
+{
+    slots = std::max<size_t>(capacity, 1);
+    ring.assign(pendulums * slots, State());
+    totals.assign(pendulums, 0);
+}
+
+void Poincare::Recorder::clear()
+{
+    std::fill(totals.begin(), totals.end(), 0);
+}
+
+void Poincare::Recorder::setSection(const Section& section)
+{
+    current = section;
+    clear();
+}
+
+size_t Poincare::Recorder::count(size_t pendulum) const
+{
+    return (size_t)std::min<uint64_t>(totals[pendulum], slots);
+}
+
+const Poincare::State& Poincare::Recorder::at(size_t pendulum, size_t i) const
+{
+    uint64_t first = totals[pendulum] > slots ? totals[pendulum] - slots : 0;
+    return ring[pendulum * slots + (size_t)((first + i) % slots)];
+}
+
+uint64_t Poincare::Recorder::totalCrossings() const
+{
+    uint64_t sum = 0;
+    for (uint64_t t : totals)
+        sum += t;
+    return sum;
+}
+
+void Poincare::Recorder::record(size_t pendulum, const State& before, const State& after, const Params& params, float dt)
+{
+    State crossing;
+    if (!locate(current, before, after, params, dt, crossing))
+        return;
+    uint64_t& t = totals[pendulum];
+    ring[pendulum * slots + (size_t)(t % slots)] = crossing;
+    ++t;
+}
+
+void Poincare::Recorder::step(const DoubleColumns& c, size_t begin, size_t end, float damping, float g, float dt,
+                              size_t steps)
+{
+    float* columns[VariableCount] = { c.theta1, c.theta2, c.omega1, c.omega2 };
+    float previous[VariableCount][BlockSize];
+    uint8_t crossed[BlockSize];
+    const int k = current.variable;
+    const bool angle = isAngle(k);
+    const float value = current.value;
+    const Direction direction = current.direction;
+
+    for (size_t b = begin; b < end; b += BlockSize)
+    {
+        const size_t e = std::min(end, b + BlockSize), n = e - b;
+        for (size_t s = 0; s < steps; ++s)
+        {
+            for (int v = 0; v < VariableCount; ++v)
+                std::copy(columns[v] + b, columns[v] + e, previous[v]);
+            Batch::stepDoubles(c, b, e, damping, g, dt, 1);
+
+            // A cheap sign test on the section variable first, branch free so
+            // it vectorizes; only the rare crossing pays for the derivatives
+            // and the root finding. Angles and their differences stay within
+            // one turn of [-pi, pi], so a single correction wraps them.
+            const float* now = columns[k] + b;
+            const float* was = previous[k];
+            bool any = false;
+            for (size_t i = 0; i < n; ++i)
+            {
+                float g0 = was[i] - value, moved = now[i] - was[i];
+                if (angle)
+                {
+                    g0 = wrapOnce(g0);
+                    moved = wrapOnce(moved);
+                }
+                float g1 = g0 + moved;
+                bool rising = g0 < 0.0f && g1 >= 0.0f, falling = g0 > 0.0f && g1 <= 0.0f;
+                crossed[i] = direction == Rising ? rising : direction == Falling ? falling : (rising | falling);
+                any |= crossed[i] != 0;
+            }
+            if (!any)
+                continue;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (!crossed[i])
+                    continue;
+                State before, after;
+                for (int v = 0; v < VariableCount; ++v)
+                {
+                    before.v[v] = previous[v][i];
+                    after.v[v] = columns[v][b + i];
+                }
+                record(b + i, before, after, Params{ c.m1[b + i], c.m2[b + i], c.L1[b + i], c.L2[b + i], damping, g }, dt);
+            }
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Ensemble.h"
+
+// Poincaré sections of double pendulums. A section is a plane such as
+// theta1 = 0 crossed with omega1 > 0. Every step is checked for a crossing
+// and crossings are located on the cubic Hermite interpolant of the step,
+// built from the states and derivatives at both ends, so they land on the
+// plane to float precision rather than wherever the step happened to end.
+// Angles are unwrapped across the step, so wrapping at +-pi is not taken
+// for a crossing.
+namespace Poincare
+{
+    enum Variable
+    {
+        Theta1, Theta2, Omega1, Omega2, VariableCount
+    };
+
+    enum Direction
+    {
+        Rising, Falling, Both
+    };
+
+    struct Section
+    {
+        Variable variable = Theta1;
+        float value = 0.0f;
+        Direction direction = Rising;
+    };
+
+    struct State
+    {
+        float v[VariableCount];
+    };
+
+    struct Params
+    {
+        float m1, m2, L1, L2, damping, g;
+    };
+
+    const char* name(Variable v);
+
+    // True if the step from before to after crosses the section; crossing
+    // then holds the interpolated state and fraction how far into the step.
+    bool locate(const Section& section, const State& before, const State& after, const Params& params, float dt,
+                State& crossing, float* fraction = nullptr);
+
+    // Crossings per pendulum, each pendulum keeping the newest capacity in a
+    // ring of its own, so ranges of pendulums can be stepped and recorded on
+    // different threads at once.
+    class Recorder
+    {
+    public:
+        void reset(size_t pendulums, size_t capacity);
+        void clear();
+        void setSection(const Section& section);
+        const Section& section() const { return current; }
+        size_t pendulums() const { return totals.size(); }
+        size_t capacity() const { return slots; }
+
+        // Checks one step of one pendulum
+        void record(size_t pendulum, const State& before, const State& after, const Params& params, float dt);
+        // Steps doubles [begin, end) by steps steps of dt with the batch kernels,
+        // checking every step. Recorder pendulum i is column i.
+        void step(const DoubleColumns& c, size_t begin, size_t end, float damping, float g, float dt, size_t steps);
+
+        // Crossings ever found for a pendulum, and how many are still held
+        uint64_t total(size_t pendulum) const { return totals[pendulum]; }
+        size_t count(size_t pendulum) const;
+        // Held crossing i of a pendulum, oldest first
+        const State& at(size_t pendulum, size_t i) const;
+        uint64_t totalCrossings() const;
+
+    private:
+        Section current;
+        size_t slots = 0;
+        std::vector<State> ring;
+        std::vector<uint64_t> totals;
+    };
+}
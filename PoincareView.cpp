@@ -0,0 +1,122 @@
+#include "PoincareView.h"
+#include "imgui/imgui.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const char* Directions[] = { "Rising", "Falling", "Both" };
+    const float Pi = 3.14159265f;
+
+    bool isAngle(int v)
+    {
+        return v == Poincare::Theta1 || v == Poincare::Theta2;
+    }
+
+    bool variableCombo(const char* label, int& v)
+    {
+        bool changed = false;
+        if (ImGui::BeginCombo(label, Poincare::name((Poincare::Variable)v)))
+        {
+            for (int i = 0; i < Poincare::VariableCount; ++i)
+                if (ImGui::Selectable(Poincare::name((Poincare::Variable)i), i == v))
+                {
+                    changed = i != v;
+                    v = i;
+                }
+            ImGui::EndCombo();
+        }
+        return changed;
+    }
+}
+
+void PoincareView::draw(Poincare::Recorder& recorder, bool* open)
+{
+    ImGui::SetNextWindowSize(ImVec2(480.0f, 640.0f), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Poincare Section", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    Poincare::Section section = recorder.section();
+    int variable = section.variable;
+    int direction = section.direction;
+    bool changed = variableCombo("Section", variable);
+    changed |= ImGui::SliderFloat("Value", &section.value, -Pi, Pi);
+    changed |= ImGui::Combo("Direction", &direction, Directions, IM_ARRAYSIZE(Directions));
+    if (changed)
+    {
+        section.variable = (Poincare::Variable)variable;
+        section.direction = (Poincare::Direction)direction;
+        recorder.setSection(section);
+    }
+    if (ImGui::InputInt("Crossings per pendulum", &capacity, 1024, 16384))
+    {
+        capacity = std::max(capacity, 16);
+        recorder.reset(recorder.pendulums(), (size_t)capacity);
+    }
+    variableCombo("X", x);
+    variableCombo("Y", y);
+    ImGui::SliderInt("Points drawn", &maxPoints, 1000, 500000, "%d", ImGuiSliderFlags_Logarithmic);
+    ImGui::SliderFloat("Point size", &pointSize, 1.0f, 4.0f);
+    if (ImGui::Button("Clear"))
+        recorder.clear();
+    ImGui::SameLine();
+    ImGui::Text("%llu crossings", (unsigned long long)recorder.totalCrossings());
+
+    size_t active = 0;
+    for (size_t p = 0; p < recorder.pendulums(); ++p)
+        active += recorder.count(p) > 0;
+    size_t perPendulum = active ? std::max<size_t>(1, (size_t)maxPoints / active) : 0;
+
+    // Angles span the circle; velocities are scaled to the largest one shown
+    float extent[2] = { Pi, Pi };
+    const int axes[2] = { x, y };
+    for (int a = 0; a < 2; ++a)
+    {
+        if (isAngle(axes[a]))
+            continue;
+        float largest = 1e-3f;
+        for (size_t p = 0; p < recorder.pendulums(); ++p)
+        {
+            size_t n = recorder.count(p), first = n - std::min(n, perPendulum);
+            for (size_t i = first; i < n; ++i)
+                largest = std::max(largest, std::fabs(recorder.at(p, i).v[axes[a]]));
+        }
+        extent[a] = largest * 1.05f;
+    }
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImVec2 size = ImGui::GetContentRegionAvail();
+    size.x = std::max(size.x, 64.0f);
+    size.y = std::max(size.y - ImGui::GetTextLineHeightWithSpacing(), 64.0f);
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(16, 16, 20, 255));
+    draw->AddLine(ImVec2(origin.x + size.x * 0.5f, origin.y), ImVec2(origin.x + size.x * 0.5f, origin.y + size.y),
+                  IM_COL32(60, 60, 70, 255));
+    draw->AddLine(ImVec2(origin.x, origin.y + size.y * 0.5f), ImVec2(origin.x + size.x, origin.y + size.y * 0.5f),
+                  IM_COL32(60, 60, 70, 255));
+    draw->PushClipRect(origin, ImVec2(origin.x + size.x, origin.y + size.y), true);
+    const float sx = size.x * 0.5f / extent[0], sy = size.y * 0.5f / extent[1];
+    const float cx = origin.x + size.x * 0.5f, cy = origin.y + size.y * 0.5f;
+    for (size_t p = 0; p < recorder.pendulums(); ++p)
+    {
+        size_t n = recorder.count(p);
+        if (!n)
+            continue;
+        // Golden-ratio hues keep neighbouring pendulums apart
+        ImU32 colour = ImColor::HSV(std::fmod(p * 0.618034f, 1.0f), 0.6f, 1.0f);
+        for (size_t i = n - std::min(n, perPendulum); i < n; ++i)
+        {
+            const Poincare::State& s = recorder.at(p, i);
+            float px = cx + s.v[x] * sx, py = cy - s.v[y] * sy;
+            draw->AddRectFilled(ImVec2(px, py), ImVec2(px + pointSize, py + pointSize), colour);
+        }
+    }
+    draw->PopClipRect();
+    ImGui::Dummy(size);
+    ImGui::Text("%s %.2f .. %.2f, %s %.2f .. %.2f", Poincare::name((Poincare::Variable)x), -extent[0], extent[0],
+                Poincare::name((Poincare::Variable)y), -extent[1], extent[1]);
+    ImGui::End();
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "Poincare.h"
+
+// Window showing a Poincaré section as a point cloud, one colour per
+// pendulum, with controls for the section and the plane it is viewed in.
+struct PoincareView
+{
+    // Coordinates the crossings are plotted in. The defaults suit the
+    // default theta1 = 0 section.
+    int x = Poincare::Theta2;
+    int y = Poincare::Omega2;
+    int capacity = 4096;
+    // Points drawn per frame, shared evenly between pendulums, newest first
+    int maxPoints = 50000;
+    float pointSize = 1.5f;
+
+    // Changing the section or the capacity starts the recorder afresh
+    void draw(Poincare::Recorder& recorder, bool* open);
+};
@@ -0,0 +1,35 @@
+#include "Range.h"
+#include <cstdlib>
+
+bool parseRange(const std::string& text, Range& range, std::string& error)
+{
+    const char* s = text.c_str();
+    char* end = nullptr;
+    Range r;
+    r.min = std::strtod(s, &end);
+    bool ok = end != s;
+    r.max = r.min;
+    if (ok && *end == ':')
+    {
+        s = end + 1;
+        r.max = std::strtod(s, &end);
+        ok = end != s;
+        if (ok && *end == ':')
+        {
+            s = end + 1;
+            r.levels = (int)std::strtol(s, &end, 10);
+            ok = end != s && r.levels >= 1;
+        }
+        else if (ok)
+        {
+            r.levels = 2;
+        }
+    }
+    if (!ok || *end != '\0')
+    {
+        error = "Bad range " + text + ", expected value or min:max[:levels]";
+        return false;
+    }
+    range = r;
+    return true;
+}
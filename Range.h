@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+
+// A value or a span of values given on a command line, shared by the sweep
+// designs and the tools' options.
+struct Range
+{
+    double min = 1.0, max = 1.0;
+    // Grid levels for Cartesian designs, min alone when 1
+    int levels = 1;
+};
+
+// Parses "value" or "min:max[:levels]"
+bool parseRange(const std::string& text, Range& range, std::string& error);
@@ -0,0 +1,311 @@
+#include "Recorder.h"
+#include "Compression.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+void TrajectoryRecorder::Ring::reset(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity + 1)
+        size <<= 1;
+    slots.assign(size, 0);
+    head.store(0);
+    tail.store(0);
+}
+
+bool TrajectoryRecorder::Ring::push(uint32_t value)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == slots.size())
+        return false;
+    slots[h & (slots.size() - 1)] = value;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+bool TrajectoryRecorder::Ring::pop(uint32_t& value)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+        return false;
+    value = slots[t & (slots.size() - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+    std::string error;
+    stop(error);
+}
+
+bool TrajectoryRecorder::start(const Options& opts, std::string& error)
+{
+    stop(error);
+    if (opts.pendulums.empty() || opts.lanes == 0 || opts.chunkSamples == 0 || opts.chunksPerLane == 0)
+    {
+        error = "Nothing to record";
+        return false;
+    }
+
+    file.open(opts.path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        error = "Cannot create " + opts.path;
+        return false;
+    }
+
+    options = opts;
+    options.decimation = std::max<uint32_t>(options.decimation, 1);
+    options.lanes = std::min(options.lanes, options.pendulums.size());
+    channels = options.positions ? (uint32_t)Trajectory::ChannelCount : Trajectory::StateChannels;
+
+    Trajectory::FileHeader header = {};
+    std::memcpy(header.magic, Trajectory::fileMagic(), sizeof(header.magic));
+    header.version = Trajectory::Version;
+    header.headerSize = sizeof(header);
+    header.pendulumCount = (uint32_t)options.pendulums.size();
+    header.channelCount = channels;
+    header.laneCount = (uint32_t)options.lanes;
+    header.chunkSamples = options.chunkSamples;
+    header.decimation = options.decimation;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(options.pendulums.data()),
+               options.pendulums.size() * sizeof(Trajectory::PendulumInfo));
+    if (!file)
+    {
+        file.close();
+        error = "Cannot write " + opts.path;
+        return false;
+    }
+    offset = sizeof(header) + options.pendulums.size() * sizeof(Trajectory::PendulumInfo);
+
+    const size_t n = options.pendulums.size();
+    lanes.clear();
+    for (size_t l = 0; l < options.lanes; ++l)
+    {
+        auto lane = std::make_unique<Lane>();
+        lane->first = l * n / options.lanes;
+        lane->count = (l + 1) * n / options.lanes - lane->first;
+        lane->chunks.resize(options.chunksPerLane);
+        for (Chunk& chunk : lane->chunks)
+        {
+            chunk.time.resize(options.chunkSamples);
+            chunk.data.resize(lane->count * channels * options.chunkSamples);
+        }
+        lane->free.reset(options.chunksPerLane);
+        lane->full.reset(options.chunksPerLane);
+        for (uint32_t i = 0; i < options.chunksPerLane; ++i)
+            lane->free.push(i);
+        lanes.push_back(std::move(lane));
+    }
+
+    index.clear();
+    failed.store(false);
+    failure.clear();
+    dropped.store(0);
+    written.store(0);
+    bytes.store(offset);
+    stopping.store(false);
+    recording = true;
+    writer = std::thread(&TrajectoryRecorder::writerLoop, this);
+    return true;
+}
+
+bool TrajectoryRecorder::stop(std::string& error)
+{
+    if (!recording)
+        return true;
+    for (auto& lane : lanes)
+    {
+        if (lane->current && lane->current->samples > 0)
+            lane->full.push(lane->currentIndex);
+        lane->current = nullptr;
+    }
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+    recording = false;
+    if (failed.load())
+    {
+        error = failure;
+        return false;
+    }
+    return true;
+}
+
+bool TrajectoryRecorder::check()
+{
+    if (file)
+        return true;
+    if (!failed.load(std::memory_order_relaxed))
+        failure = "Cannot write " + options.path + ", the recording stops at the last complete chunk";
+    failed.store(true, std::memory_order_relaxed);
+    return false;
+}
+
+size_t TrajectoryRecorder::lanePendulums(size_t lane, size_t& first) const
+{
+    first = lanes[lane]->first;
+    return lanes[lane]->count;
+}
+
+void TrajectoryRecorder::record(size_t laneIndex, double time, const Trajectory::Sample* samples)
+{
+    Lane& lane = *lanes[laneIndex];
+    if (lane.tick++ % options.decimation != 0)
+        return;
+
+    if (!lane.current)
+    {
+        uint32_t i;
+        if (!lane.free.pop(i))
+        {
+            // Writer is behind, count one dropped chunk per chunk-sized run of lost samples
+            if (lane.droppedSamples++ % options.chunkSamples == 0)
+                dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        lane.droppedSamples = 0;
+        lane.currentIndex = i;
+        lane.current = &lane.chunks[i];
+        lane.current->samples = 0;
+    }
+
+    Chunk& chunk = *lane.current;
+    const size_t cs = options.chunkSamples;
+    const uint32_t s = chunk.samples++;
+    chunk.time[s] = time;
+    for (size_t p = 0; p < lane.count; ++p)
+    {
+        const float* values = reinterpret_cast<const float*>(&samples[p]);
+        float* column = chunk.data.data() + p * channels * cs + s;
+        for (uint32_t c = 0; c < channels; ++c)
+            column[c * cs] = values[c];
+    }
+
+    if (chunk.samples == cs)
+    {
+        lane.full.push(lane.currentIndex);
+        lane.current = nullptr;
+    }
+}
+
+void TrajectoryRecorder::writerLoop()
+{
+    TRACE_THREAD("Trajectory writer");
+    while (true)
+    {
+        bool wrote = false;
+        for (size_t l = 0; l < lanes.size(); ++l)
+        {
+            Lane& lane = *lanes[l];
+            uint32_t i;
+            while (lane.full.pop(i))
+            {
+                writeChunk(l, lane, lane.chunks[i]);
+                lane.free.push(i);
+                wrote = true;
+            }
+        }
+        if (!wrote)
+        {
+            // Stop only once a pass after the stop request found nothing left
+            if (stopping.load(std::memory_order_acquire))
+            {
+                bool empty = true;
+                for (auto& lane : lanes)
+                    empty = empty && lane->full.head.load() == lane->full.tail.load();
+                if (empty)
+                    break;
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+    }
+
+    // No footer after a failed write; the file ends where the disk did
+    if (!failed.load(std::memory_order_relaxed))
+    {
+        Trajectory::Footer footer = {};
+        footer.indexOffset = offset;
+        footer.chunkCount = index.size();
+        footer.droppedChunks = dropped.load();
+        std::memcpy(footer.magic, Trajectory::footerMagic(), sizeof(footer.magic));
+        file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(Trajectory::IndexEntry));
+        file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+        file.flush();
+        if (check())
+            bytes.fetch_add(index.size() * sizeof(Trajectory::IndexEntry) + sizeof(footer));
+    }
+    file.close();
+    check();
+}
+
+void TrajectoryRecorder::writeChunk(size_t laneIndex, Lane& lane, Chunk& chunk)
+{
+    TRACE_ZONE("Write chunk");
+    if (failed.load(std::memory_order_relaxed))
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const size_t n = chunk.samples;
+    const size_t cs = options.chunkSamples;
+    const size_t columns = lane.count * channels;
+    const size_t timeBytes = n * sizeof(double);
+    const size_t rawBytes = timeBytes + columns * n * sizeof(float);
+
+    // Pack the columns down to the samples actually taken
+    packed.resize(rawBytes);
+    std::memcpy(packed.data(), chunk.time.data(), timeBytes);
+    for (size_t c = 0; c < columns; ++c)
+        std::memcpy(packed.data() + timeBytes + c * n * sizeof(float), chunk.data.data() + c * cs, n * sizeof(float));
+
+    Trajectory::ChunkHeader header = {};
+    header.magic = Trajectory::ChunkMagic;
+    header.lane = (uint32_t)laneIndex;
+    header.firstPendulum = (uint32_t)lane.first;
+    header.pendulumCount = (uint32_t)lane.count;
+    header.sampleCount = (uint32_t)n;
+    header.codec = Trajectory::Raw;
+    header.rawBytes = rawBytes;
+    header.storedBytes = rawBytes;
+    header.sequence = lane.sequence++;
+    header.t0 = chunk.time[0];
+    header.t1 = chunk.time[n - 1];
+
+    const uint8_t* payload = packed.data();
+    if (options.compress)
+    {
+        TRACE_ZONE("Compress chunk");
+        shuffled.resize(rawBytes);
+        Compression::shuffle(packed.data(), n, sizeof(double), shuffled.data());
+        Compression::shuffle(packed.data() + timeBytes, columns * n, sizeof(float), shuffled.data() + timeBytes);
+        compressed.resize(Compression::compressBound(rawBytes));
+        size_t size = Compression::compress(shuffled.data(), rawBytes, compressed.data(), compressed.size());
+        if (size > 0 && size < rawBytes)
+        {
+            header.codec = Trajectory::ShuffledLz;
+            header.storedBytes = size;
+            payload = compressed.data();
+        }
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(payload), header.storedBytes);
+    // Flushed so a chunk only counts as written once the system has it
+    file.flush();
+    if (!check())
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    index.push_back({ header.t0, header.t1, offset, header.lane, header.sampleCount });
+    offset += sizeof(header) + header.storedBytes;
+    written.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(sizeof(header) + header.storedBytes, std::memory_order_relaxed);
+}
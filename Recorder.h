@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include "TrajectoryFormat.h"
+
+// Captures trajectories into preallocated chunks and leaves the disk to a
+// background thread. Each producer thread owns a lane covering a contiguous
+// range of the recorded pendulums; lanes hand full chunks to the writer
+// through single-producer rings, so recording never takes a lock. When the
+// writer falls behind, samples are dropped and counted per chunk instead of
+// stalling the producer.
+class TrajectoryRecorder
+{
+public:
+    struct Options
+    {
+        std::string path;
+        std::vector<Trajectory::PendulumInfo> pendulums;
+        size_t lanes = 1;
+        uint32_t decimation = 1;
+        uint32_t chunkSamples = 1024;
+        size_t chunksPerLane = 8;
+        bool positions = false;
+        bool compress = true;
+    };
+
+    TrajectoryRecorder() = default;
+    ~TrajectoryRecorder();
+    TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+    TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+    bool start(const Options& options, std::string& error);
+    // Flushes partial chunks and waits for the writer. Producers must be idle.
+    // False if any write failed, leaving the file without the rest.
+    bool stop(std::string& error);
+    bool isRecording() const { return recording; }
+
+    // Pendulums recorded through a lane, first is their index in Options::pendulums.
+    size_t lanePendulums(size_t lane, size_t& first) const;
+    // One sample for each of the lane's pendulums. Call only from the lane's thread.
+    void record(size_t lane, double time, const Trajectory::Sample* samples);
+
+    uint64_t droppedChunks() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t writtenChunks() const { return written.load(std::memory_order_relaxed); }
+    uint64_t bytesWritten() const { return bytes.load(std::memory_order_relaxed); }
+    // Set once a write fails; chunks after that are dropped
+    bool writeFailed() const { return failed.load(std::memory_order_relaxed); }
+
+private:
+    struct Chunk
+    {
+        std::vector<double> time;
+        std::vector<float> data;
+        uint32_t samples = 0;
+    };
+
+    // Single-producer single-consumer ring of chunk indices
+    struct Ring
+    {
+        std::vector<uint32_t> slots;
+        std::atomic<size_t> head{ 0 };
+        std::atomic<size_t> tail{ 0 };
+
+        void reset(size_t capacity);
+        bool push(uint32_t value);
+        bool pop(uint32_t& value);
+    };
+
+    struct Lane
+    {
+        size_t first = 0;
+        size_t count = 0;
+        std::vector<Chunk> chunks;
+        Ring free, full;
+        Chunk* current = nullptr;
+        uint32_t currentIndex = 0;
+        uint64_t tick = 0;
+        uint64_t sequence = 0;
+        uint32_t droppedSamples = 0;
+    };
+
+    void writerLoop();
+    void writeChunk(size_t laneIndex, Lane& lane, Chunk& chunk);
+    // Latches the first failed write; only the writer calls it once running
+    bool check();
+
+    Options options;
+    uint32_t channels = 0;
+    std::vector<std::unique_ptr<Lane>> lanes;
+    std::ofstream file;
+    uint64_t offset = 0;
+    std::vector<Trajectory::IndexEntry> index;
+    std::vector<uint8_t> packed, shuffled, compressed;
+    std::thread writer;
+    std::atomic<bool> stopping{ false };
+    std::atomic<bool> failed{ false };
+    std::string failure;
+    bool recording = false;
+    std::atomic<uint64_t> dropped{ 0 }, written{ 0 }, bytes{ 0 };
+};
@@ -0,0 +1,331 @@
+#include "Recurrence.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    // Points per contiguous run handed to one worker in quantify, so runs
+    // along the trajectory stay in cache while workers share the load
+    const size_t Chunk = 4096;
+
+    void count(std::vector<uint64_t>& histogram, size_t length)
+    {
+        if (length >= histogram.size())
+            histogram.resize(length + 1, 0);
+        ++histogram[length];
+    }
+
+    // Ordered pairs of points more than theiler apart in time
+    double pairsOutside(size_t n, size_t theiler)
+    {
+        return n > theiler + 1 ? (double)(n - theiler - 1) * (double)(n - theiler) : 0.0;
+    }
+}
+
+void Recurrence::Points::standardize()
+{
+    for (int k = 0; k < dimension; ++k)
+    {
+        double sum = 0.0, squares = 0.0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            double v = coords[i * dimension + k];
+            sum += v;
+            squares += v * v;
+        }
+        double mean = count ? sum / count : 0.0;
+        double variance = count ? squares / count - mean * mean : 0.0;
+        double scale = variance > 0.0 ? 1.0 / std::sqrt(variance) : 1.0;
+        for (size_t i = 0; i < count; ++i)
+            coords[i * dimension + k] = (float)((coords[i * dimension + k] - mean) * scale);
+    }
+}
+
+void Recurrence::embed(const float* series, size_t samples, size_t stride, int dimension, size_t delay, Points& points)
+{
+    const size_t span = (size_t)(dimension - 1) * delay;
+    points.dimension = dimension;
+    points.count = samples > span ? samples - span : 0;
+    points.coords.resize(points.count * dimension);
+    for (size_t i = 0; i < points.count; ++i)
+        for (int k = 0; k < dimension; ++k)
+            points.coords[i * dimension + k] = series[(i + k * delay) * stride];
+}
+
+void Recurrence::Tree::build(const Points& points, ThreadPool& pool)
+{
+    const size_t n = points.count;
+    dimension = points.dimension;
+    source = &points;
+    // Deep enough that the halved ranges fit in a leaf
+    depth = 0;
+    while (((n + ((size_t)1 << depth) - 1) >> depth) > LeafSize)
+        ++depth;
+    order.resize(n);
+    std::iota(order.begin(), order.end(), 0u);
+    keys.resize(n);
+    splitValue.assign(((size_t)1 << depth) - 1, 0.0f);
+    splitAxis.assign(splitValue.size(), 0);
+
+    // Eight subtrees per worker even out their differing leaf counts
+    int stop = 0;
+    while (stop < depth && ((size_t)1 << stop) < 8 * pool.size())
+        ++stop;
+    std::vector<Subtree> frontier;
+    split({ 0, 0, n, 0 }, stop, &frontier);
+    pool.run([&](size_t worker, size_t workers) {
+        for (size_t i = worker; i < frontier.size(); i += workers)
+            split(frontier[i], depth, nullptr);
+    });
+
+    sorted.resize(n * dimension);
+    pool.forRanges(n, [&](size_t begin, size_t end) {
+        for (size_t slot = begin; slot < end; ++slot)
+            std::copy(points.at(order[slot]), points.at(order[slot]) + dimension, sorted.data() + slot * dimension);
+    });
+    keys.clear();
+    keys.shrink_to_fit();
+}
+
+void Recurrence::Tree::split(const Subtree& t, int stop, std::vector<Subtree>* frontier)
+{
+    if (t.level == stop)
+    {
+        if (frontier && t.level < depth)
+            frontier->push_back(t);
+        return;
+    }
+
+    // Widest coordinate over the range
+    const Points& points = *source;
+    int axis = 0;
+    float widest = -1.0f;
+    for (int k = 0; k < dimension; ++k)
+    {
+        float low = INFINITY, high = -INFINITY;
+        for (size_t slot = t.begin; slot < t.end; ++slot)
+        {
+            float v = points.at(order[slot])[k];
+            low = std::min(low, v);
+            high = std::max(high, v);
+        }
+        if (high - low > widest)
+        {
+            widest = high - low;
+            axis = k;
+        }
+    }
+
+    // Median by selection on (coordinate, point) pairs, which sit together
+    // in memory where the coordinates alone would be scattered
+    const size_t middle = t.begin + (t.end - t.begin) / 2;
+    for (size_t slot = t.begin; slot < t.end; ++slot)
+        keys[slot] = { points.at(order[slot])[axis], order[slot] };
+    std::nth_element(keys.begin() + t.begin, keys.begin() + middle, keys.begin() + t.end,
+                     [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first < b.first; });
+    for (size_t slot = t.begin; slot < t.end; ++slot)
+        order[slot] = keys[slot].second;
+    splitAxis[t.node] = (uint8_t)axis;
+    splitValue[t.node] = keys[middle].first;
+
+    split({ 2 * t.node + 1, t.begin, middle, t.level + 1 }, stop, frontier);
+    split({ 2 * t.node + 2, middle, t.end, t.level + 1 }, stop, frontier);
+}
+
+void Recurrence::correlate(const Points& points, const Tree& tree, ThreadPool& pool, float rMin, float rMax,
+                           size_t radii, size_t theiler, size_t references, Correlation& out)
+{
+    const size_t n = points.count;
+    radii = std::max<size_t>(radii, 2);
+    references = std::min(std::max<size_t>(references, 1), n);
+    out.radii.resize(radii);
+    out.sums.assign(radii, 0.0);
+    out.pairs = 0.0;
+    std::vector<float> r2(radii);
+    for (size_t k = 0; k < radii; ++k)
+    {
+        out.radii[k] = rMin * std::pow(rMax / rMin, (float)k / (float)(radii - 1));
+        r2[k] = out.radii[k] * out.radii[k];
+    }
+    if (!n)
+        return;
+
+    // Each worker bins its own pairs by the smallest radius holding them.
+    // C grows as a power of r, so most pairs fall in the outer bins and a
+    // scan down from the top ends sooner than a binary search would.
+    std::vector<std::vector<uint64_t>> bins(pool.size(), std::vector<uint64_t>(radii, 0));
+    std::vector<double> pairs(pool.size(), 0.0);
+    pool.run([&](size_t worker, size_t workers) {
+        std::vector<uint64_t>& local = bins[worker];
+        for (size_t r = worker; r < references; r += workers)
+        {
+            const size_t i = r * n / references;
+            tree.within(points.at(i), out.radii.back(), [&](size_t j, float d2) {
+                if (j + theiler >= i && i + theiler >= j)
+                    return;
+                size_t k = radii - 1;
+                while (k && d2 <= r2[k - 1])
+                    --k;
+                ++local[k];
+            });
+            pairs[worker] += (double)(n - 1 - std::min(i, theiler) - std::min(n - 1 - i, theiler));
+        }
+    });
+
+    double total = 0.0;
+    for (size_t k = 0; k < radii; ++k)
+    {
+        for (const std::vector<uint64_t>& local : bins)
+            total += (double)local[k];
+        out.sums[k] = total;
+    }
+    for (double p : pairs)
+        out.pairs += p;
+    for (double& s : out.sums)
+        s = out.pairs > 0.0 ? s / out.pairs : 0.0;
+}
+
+double Recurrence::localSlope(const Correlation& c, size_t i)
+{
+    if (i + 1 >= c.sums.size() || !(c.sums[i] > 0.0))
+        return NAN;
+    return std::log(c.sums[i + 1] / c.sums[i]) / std::log((double)c.radii[i + 1] / c.radii[i]);
+}
+
+double Recurrence::dimension(const Correlation& c)
+{
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    size_t used = 0;
+    for (size_t k = 0; k < c.sums.size(); ++k)
+    {
+        if (c.sums[k] * c.pairs < MinPairs || c.sums[k] > MaxSum)
+            continue;
+        double x = std::log((double)c.radii[k]), y = std::log(c.sums[k]);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+        ++used;
+    }
+    if (used < 2)
+        return NAN;
+    return (used * sxy - sx * sy) / (used * sxx - sx * sx);
+}
+
+float Recurrence::radiusFor(const Correlation& c, double rate)
+{
+    for (size_t k = 0; k + 1 < c.sums.size(); ++k)
+    {
+        if (!(c.sums[k] > 0.0) || c.sums[k] > rate || c.sums[k + 1] < rate)
+            continue;
+        double f = c.sums[k + 1] > c.sums[k] ? std::log(rate / c.sums[k]) / std::log(c.sums[k + 1] / c.sums[k]) : 0.0;
+        return (float)(c.radii[k] * std::pow((double)c.radii[k + 1] / c.radii[k], f));
+    }
+    return 0.0f;
+}
+
+void Recurrence::quantify(const Points& points, const Tree& tree, ThreadPool& pool, float radius, size_t theiler,
+                          size_t minLine, Quantification& out, Plot* plot)
+{
+    const size_t n = points.count;
+    const int dim = points.dimension;
+    const float r2 = radius * radius;
+    out = Quantification();
+    minLine = std::max<size_t>(minLine, 1);
+    auto recurrent = [&](size_t a, size_t b) { return distanceSquared(points.at(a), points.at(b), dim) <= r2; };
+    auto outside = [&](size_t a, size_t b) { return a + theiler < b || b + theiler < a; };
+
+    struct Local
+    {
+        uint64_t recurrences = 0;
+        std::vector<uint64_t> diagonal, vertical;
+        std::vector<uint32_t> cells;
+    };
+    std::vector<Local> locals(pool.size());
+    const size_t size = plot ? plot->size : 0;
+    pool.run([&](size_t worker, size_t workers) {
+        Local& local = locals[worker];
+        local.cells.assign(size * size, 0);
+        for (size_t first = worker * Chunk; first < n; first += workers * Chunk)
+            for (size_t i = first; i < std::min(n, first + Chunk); ++i)
+                tree.within(points.at(i), radius, [&](size_t j, float) {
+                    if (!outside(i, j))
+                        return;
+                    ++local.recurrences;
+                    if (size)
+                        ++local.cells[(i * size / n) * size + j * size / n];
+                    // Diagonals from the upper triangle alone; the lower mirrors them
+                    if (j > i && (i == 0 || !recurrent(i - 1, j - 1)))
+                    {
+                        size_t length = 1;
+                        while (j + length < n && recurrent(i + length, j + length))
+                            ++length;
+                        count(local.diagonal, length);
+                    }
+                    // Column i down from row j, stopping at the Theiler window
+                    if (j == 0 || !outside(i, j - 1) || !recurrent(i, j - 1))
+                    {
+                        size_t length = 1;
+                        while (j + length < n && outside(i, j + length) && recurrent(i, j + length))
+                            ++length;
+                        count(local.vertical, length);
+                    }
+                });
+    });
+
+    std::vector<uint64_t> diagonal, vertical;
+    for (Local& local : locals)
+    {
+        out.recurrences += local.recurrences;
+        diagonal.resize(std::max(diagonal.size(), local.diagonal.size()), 0);
+        for (size_t l = 0; l < local.diagonal.size(); ++l)
+            diagonal[l] += local.diagonal[l];
+        vertical.resize(std::max(vertical.size(), local.vertical.size()), 0);
+        for (size_t l = 0; l < local.vertical.size(); ++l)
+            vertical[l] += local.vertical[l];
+    }
+    if (plot)
+    {
+        plot->counts.assign(size * size, 0);
+        for (const Local& local : locals)
+            for (size_t c = 0; c < local.cells.size(); ++c)
+                plot->counts[c] += local.cells[c];
+    }
+
+    double pairs = pairsOutside(n, theiler);
+    out.recurrenceRate = pairs > 0.0 ? out.recurrences / pairs : 0.0;
+
+    // Points on lines of any length, on lines of at least minLine, and those lines
+    double all = 0.0, long_ = 0.0, lines = 0.0;
+    for (size_t l = 1; l < diagonal.size(); ++l)
+    {
+        all += (double)l * diagonal[l];
+        if (l < minLine || !diagonal[l])
+            continue;
+        long_ += (double)l * diagonal[l];
+        lines += (double)diagonal[l];
+        out.longestDiagonal = l;
+    }
+    out.determinism = all > 0.0 ? long_ / all : 0.0;
+    out.meanDiagonal = lines > 0.0 ? long_ / lines : 0.0;
+    for (size_t l = minLine; l < diagonal.size(); ++l)
+        if (diagonal[l])
+        {
+            double p = diagonal[l] / lines;
+            out.entropy -= p * std::log(p);
+        }
+
+    all = long_ = lines = 0.0;
+    for (size_t l = 1; l < vertical.size(); ++l)
+    {
+        all += (double)l * vertical[l];
+        if (l < minLine || !vertical[l])
+            continue;
+        long_ += (double)l * vertical[l];
+        lines += (double)vertical[l];
+        out.longestVertical = l;
+    }
+    out.laminarity = all > 0.0 ? long_ / all : 0.0;
+    out.trappingTime = lines > 0.0 ? long_ / lines : 0.0;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+// Recurrence analysis of long trajectories: correlation sums and dimension,
+// recurrence quantification and downsampled recurrence plots. Trajectories
+// are embedded as points, either a scalar series by time delays or whole
+// states, and a k-d tree over the points answers the fixed-radius neighbour
+// queries every measure comes down to, so the cost grows with the pairs
+// that are actually close rather than with the square of the length.
+//
+// Pairs closer in time than the Theiler window are left out throughout,
+// since neighbours along the trajectory say nothing about recurrence.
+namespace Recurrence
+{
+    // Point i of an embedded trajectory is at coords[i * dimension]
+    struct Points
+    {
+        size_t count = 0;
+        int dimension = 0;
+        std::vector<float> coords;
+
+        const float* at(size_t i) const { return coords.data() + i * dimension; }
+        // Shifts and scales every coordinate to zero mean and unit variance,
+        // so radii are in standard deviations
+        void standardize();
+    };
+
+    // Point i is (x[i], x[i + delay], ..., x[i + (dimension - 1) * delay])
+    // with sample t of the series at series[t * stride]
+    void embed(const float* series, size_t samples, size_t stride, int dimension, size_t delay, Points& points);
+
+    inline float distanceSquared(const float* a, const float* b, int dimension)
+    {
+        float sum = 0.0f;
+        for (int k = 0; k < dimension; ++k)
+            sum += (a[k] - b[k]) * (a[k] - b[k]);
+        return sum;
+    }
+
+    // Balanced k-d tree over a copy of the points. Splits are at the median
+    // of the widest coordinate, so the tree is implicit: node n has children
+    // 2n + 1 and 2n + 2 and covers a fixed half of its parent's range, and
+    // leaves hold at most LeafSize points stored together.
+    class Tree
+    {
+    public:
+        static const size_t LeafSize = 32;
+
+        // The top levels are split on the calling thread until there are
+        // subtrees enough to keep every worker busy, then the pool builds them
+        void build(const Points& points, ThreadPool& pool);
+        size_t size() const { return order.size(); }
+
+        // Calls visit(j, distance squared) for every point j within radius
+        // of query, in no particular order
+        template <typename Visit>
+        void within(const float* query, float radius, Visit&& visit) const;
+
+    private:
+        struct Subtree
+        {
+            size_t node, begin, end;
+            int level;
+        };
+
+        // Splits down to level stop, handing the subtrees left there to frontier
+        void split(const Subtree& subtree, int stop, std::vector<Subtree>* frontier);
+
+        int dimension = 0, depth = 0;
+        std::vector<uint32_t> order;
+        std::vector<float> sorted;
+        std::vector<float> splitValue;
+        std::vector<uint8_t> splitAxis;
+        // Scratch for the splits: one key and point per slot
+        std::vector<std::pair<float, uint32_t>> keys;
+        const Points* source = nullptr;
+    };
+
+    // Correlation sums C(r): the fraction of pairs outside the Theiler
+    // window closer than r, at radii spaced evenly in log
+    struct Correlation
+    {
+        std::vector<float> radii;
+        std::vector<double> sums;
+        double pairs = 0.0;
+    };
+
+    // Sums over references reference points spread evenly along the
+    // trajectory against all of them, on the pool
+    void correlate(const Points& points, const Tree& tree, ThreadPool& pool, float rMin, float rMax, size_t radii,
+                   size_t theiler, size_t references, Correlation& out);
+    // Slope of log C against log r between adjacent radii i and i + 1
+    double localSlope(const Correlation& c, size_t i);
+    // Correlation dimension: the least-squares slope of log C against log r
+    // over the radii where at least MinPairs pairs count and C is below
+    // MaxSum, clear of both noise and saturation; NaN without two such radii
+    const double MinPairs = 1000.0;
+    const double MaxSum = 0.05;
+    double dimension(const Correlation& c);
+    // Radius at which C reaches rate, interpolated in log; zero when out of range
+    float radiusFor(const Correlation& c, double rate);
+
+    // Recurrence quantification for one radius. Diagonal lines are runs of
+    // recurrences along i = j + k, vertical lines runs down one column; lines
+    // of at least minLine points count towards determinism and laminarity.
+    struct Quantification
+    {
+        uint64_t recurrences = 0;
+        double recurrenceRate = 0.0;
+        double determinism = 0.0, meanDiagonal = 0.0, entropy = 0.0;
+        double laminarity = 0.0, trappingTime = 0.0;
+        size_t longestDiagonal = 0, longestVertical = 0;
+    };
+
+    // Downsampled recurrence plot: the trajectory is cut into size equal
+    // spans and cell (a, b) counts the recurrences between spans a and b
+    struct Plot
+    {
+        size_t size = 0;
+        std::vector<uint32_t> counts;
+    };
+
+    // Every point queries its neighbours on the pool; a recurrence starts a
+    // line only if the one before it along the line is not a recurrence, and
+    // only starts walk their lines, so lines cost their length once.
+    void quantify(const Points& points, const Tree& tree, ThreadPool& pool, float radius, size_t theiler,
+                  size_t minLine, Quantification& out, Plot* plot = nullptr);
+}
+
+template <typename Visit>
+void Recurrence::Tree::within(const float* query, float radius, Visit&& visit) const
+{
+    // Depth first, so the stack holds at most one sibling per level
+    Subtree stack[64];
+    int top = 0;
+    if (!order.empty())
+        stack[top++] = { 0, 0, order.size(), 0 };
+    const float r2 = radius * radius;
+    while (top)
+    {
+        const Subtree p = stack[--top];
+        if (p.level == depth)
+        {
+            for (size_t slot = p.begin; slot < p.end; ++slot)
+            {
+                float d2 = distanceSquared(sorted.data() + slot * dimension, query, dimension);
+                if (d2 <= r2)
+                    visit((size_t)order[slot], d2);
+            }
+            continue;
+        }
+        const size_t middle = p.begin + (p.end - p.begin) / 2;
+        const float offset = query[splitAxis[p.node]] - splitValue[p.node];
+        if (offset >= -radius)
+            stack[top++] = { 2 * p.node + 2, middle, p.end, p.level + 1 };
+        if (offset <= radius)
+            stack[top++] = { 2 * p.node + 1, p.begin, middle, p.level + 1 };
+    }
+}
@@ -1,4 +1,10 @@
 #include "Renderer.h"
+#include "Trace.h"
+
+namespace
+{
+    size_t trailVertices = 0;
+}
 
 // Draw helpers
 void Renderer::drawLine(float x1, float y1, float x2, float y2)
@@ -21,6 +27,37 @@ void Renderer::drawTrail(const std::vector<std::pair<float, float>>& points, flo
 	glLineWidth(1.0f);
 }
 
+size_t Renderer::drawTrail(const TrailHistory& trail, float thickness)
+{
+    TRACE_ZONE("Draw trail");
+    static std::vector<std::pair<float, float>> vertices;
+
+    // One pixel in world units, the projection maps the viewport height to [-1, 1]
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    float pixelSize = 2.0f / (float)(viewport[3] > 0 ? viewport[3] : 1);
+
+    size_t count = trail.collect(pixelSize, vertices);
+    trailVertices += count;
+    if (count < 2)
+        return count;
+
+    glLineWidth(thickness);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(vertices[0]), vertices.data());
+    glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)count);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glLineWidth(1.0f);
+    return count;
+}
+
+size_t Renderer::takeTrailVertexCount()
+{
+    size_t count = trailVertices;
+    trailVertices = 0;
+    return count;
+}
+
 void Renderer::drawCircle(float cx, float cy, float r, int segments)
 {
     glBegin(GL_TRIANGLE_FAN);
@@ -6,6 +6,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <cmath>
+#include "Trail.h"
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -14,6 +15,9 @@ namespace Renderer
 {
 	void drawLine(float x1, float y1, float x2, float y2);
 	void drawTrail(const std::vector<std::pair<float, float>>& points, float thickness);
+	size_t drawTrail(const TrailHistory& trail, float thickness);
+	// Trail vertices drawn since the last call
+	size_t takeTrailVertexCount();
 	void drawCircle(float cx, float cy, float r, int segments = 32);
 	void SetupImGuiStyle();
 }
\ No newline at end of file
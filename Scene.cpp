@@ -0,0 +1,305 @@
+#include "Scene.h"
+#include "Checkpoint.h"
+#include <fstream>
+#include <cstring>
+
+static const char SceneMagic[8] = { 'P', 'E', 'N', 'D', 'S', 'C', 'N', '\0' };
+
+namespace
+{
+    struct Column
+    {
+        uint32_t id;
+        uint32_t elementSize;
+        uint64_t count;
+        const void* data;
+    };
+
+    uint64_t alignUp(uint64_t v) { return (v + Scene::Alignment - 1) / Scene::Alignment * Scene::Alignment; }
+}
+
+bool Scene::save(const std::string& path, const Source& scene, std::string& error)
+{
+    const SingleColumns& sc = scene.singles;
+    const DoubleColumns& dc = scene.doubles;
+    const DrivenColumns& fc = scene.drivens;
+    const ElasticColumns& ec = scene.elastics;
+    const uint64_t total = sc.count + dc.count + fc.count + ec.count;
+
+    std::vector<Column> columns = {
+        { SingleTheta, 4, sc.count, sc.theta }, { SingleOmega, 4, sc.count, sc.omega },
+        { SingleMass, 4, sc.count, sc.m }, { SingleLength, 4, sc.count, sc.L },
+        { SinglePivotX, 4, sc.count, sc.px }, { SinglePivotY, 4, sc.count, sc.py },
+        { SingleFrozen, 1, sc.count, sc.frozen },
+        { DoubleTheta1, 4, dc.count, dc.theta1 }, { DoubleTheta2, 4, dc.count, dc.theta2 },
+        { DoubleOmega1, 4, dc.count, dc.omega1 }, { DoubleOmega2, 4, dc.count, dc.omega2 },
+        { DoubleMass1, 4, dc.count, dc.m1 }, { DoubleMass2, 4, dc.count, dc.m2 },
+        { DoubleLength1, 4, dc.count, dc.L1 }, { DoubleLength2, 4, dc.count, dc.L2 },
+        { DoublePivotX, 4, dc.count, dc.px }, { DoublePivotY, 4, dc.count, dc.py },
+        { DoubleFrozen, 1, dc.count, dc.frozen },
+    };
+    if (fc.count)
+    {
+        columns.insert(columns.end(), {
+            { DrivenTheta, 4, fc.count, fc.theta }, { DrivenOmega, 4, fc.count, fc.omega },
+            { DrivenPhase, 4, fc.count, fc.phase }, { DrivenMass, 4, fc.count, fc.m },
+            { DrivenLength, 4, fc.count, fc.L }, { DrivenAmplitude, 4, fc.count, fc.amplitude },
+            { DrivenFrequency, 4, fc.count, fc.frequency }, { DrivenPivotX, 4, fc.count, fc.px },
+            { DrivenPivotY, 4, fc.count, fc.py }, { DrivenFrozen, 1, fc.count, fc.frozen },
+        });
+    }
+    if (ec.count)
+    {
+        columns.insert(columns.end(), {
+            { ElasticTheta, 4, ec.count, ec.theta }, { ElasticOmega, 4, ec.count, ec.omega },
+            { ElasticLength, 4, ec.count, ec.r }, { ElasticLengthRate, 4, ec.count, ec.vr },
+            { ElasticMass, 4, ec.count, ec.m }, { ElasticRestLength, 4, ec.count, ec.L },
+            { ElasticStiffness, 4, ec.count, ec.k }, { ElasticPivotX, 4, ec.count, ec.px },
+            { ElasticPivotY, 4, ec.count, ec.py }, { ElasticFrozen, 1, ec.count, ec.frozen },
+        });
+    }
+    if (scene.maxTrail)
+        columns.push_back({ MaxTrail, 4, total, scene.maxTrail });
+
+    // Every level of every trail as a checkpoint keeps it, so a loaded trail
+    // carries on with the same spacing and reach it was saved with
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> states;
+    if (scene.trails && scene.trails->size() == total)
+    {
+        Checkpoint::Writer writer(states);
+        offsets.reserve(total + 1);
+        offsets.push_back(0);
+        for (const TrailHistory* trail : *scene.trails)
+        {
+            if (trail)
+                trail->save(writer);
+            offsets.push_back(states.size());
+        }
+        columns.push_back({ TrailStateOffsets, 8, offsets.size(), offsets.data() });
+        columns.push_back({ TrailStates, 1, states.size(), states.data() });
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, SceneMagic, sizeof(SceneMagic));
+    header.version = Version;
+    header.headerSize = sizeof(Header);
+    header.g = scene.g;
+    header.damping = scene.damping;
+    header.singleCount = sc.count;
+    header.doubleCount = dc.count;
+    header.sectionCount = (uint32_t)columns.size();
+
+    std::vector<Section> sections;
+    uint64_t offset = alignUp(sizeof(Header) + columns.size() * sizeof(Section));
+    for (const Column& c : columns)
+    {
+        sections.push_back({ c.id, c.elementSize, c.count, offset });
+        offset = alignUp(offset + c.count * c.elementSize);
+    }
+    header.fileSize = offset;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        error = "Cannot create " + path;
+        return false;
+    }
+
+    static const char zeros[Alignment] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(sections.data()), sections.size() * sizeof(Section));
+    uint64_t written = sizeof(header) + sections.size() * sizeof(Section);
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        out.write(zeros, sections[i].offset - written);
+        uint64_t bytes = columns[i].count * columns[i].elementSize;
+        if (bytes)
+            out.write(static_cast<const char*>(columns[i].data), bytes);
+        written = sections[i].offset + bytes;
+    }
+    out.write(zeros, header.fileSize - written);
+
+    if (!out)
+    {
+        error = "Failed writing " + path;
+        return false;
+    }
+    return true;
+}
+
+const Scene::Section* Scene::Mapped::find(uint32_t id) const
+{
+    for (uint32_t i = 0; i < header->sectionCount; ++i)
+        if (sections[i].id == id)
+            return &sections[i];
+    return nullptr;
+}
+
+bool Scene::Mapped::open(const std::string& path, std::string& error)
+{
+    header = nullptr;
+    trailOffsets = nullptr;
+    stateOffsets = nullptr;
+    maxTrails = nullptr;
+    if (!file.open(path, MappedFile::CopyOnWrite, error))
+        return false;
+
+    uint8_t* base = file.bytes();
+    const uint64_t size = file.size();
+    const Header* h = reinterpret_cast<const Header*>(base);
+    if (size < sizeof(Header) || std::memcmp(h->magic, SceneMagic, sizeof(SceneMagic)) != 0)
+    {
+        error = path + " is not a scene file";
+        return false;
+    }
+    if (h->version < OldestVersion || h->version > Version || h->headerSize != sizeof(Header))
+    {
+        error = path + " has unsupported scene version " + std::to_string(h->version);
+        return false;
+    }
+    if (h->fileSize != size || h->sectionCount > (size - sizeof(Header)) / sizeof(Section))
+    {
+        error = path + " is truncated or corrupt";
+        return false;
+    }
+
+    header = h;
+    sections = reinterpret_cast<const Section*>(base + sizeof(Header));
+    for (uint32_t i = 0; i < h->sectionCount; ++i)
+    {
+        const Section& sec = sections[i];
+        if (sec.offset % Alignment != 0 || sec.offset > size ||
+            sec.elementSize == 0 || sec.count > (size - sec.offset) / sec.elementSize)
+        {
+            error = path + " has a section outside the file";
+            header = nullptr;
+            return false;
+        }
+    }
+
+    // Looks up a column and checks it has the expected shape
+    bool ok = true;
+    auto column = [&](uint32_t id, uint32_t elementSize, uint64_t count, bool required) -> uint8_t* {
+        const Section* sec = find(id);
+        if (!sec)
+        {
+            ok = ok && !required;
+            return nullptr;
+        }
+        if (sec->elementSize != elementSize || (count != UINT64_MAX && sec->count != count))
+        {
+            ok = false;
+            return nullptr;
+        }
+        return base + sec->offset;
+    };
+
+    const uint64_t sn = h->singleCount, dn = h->doubleCount;
+    s.count = (size_t)sn;
+    s.theta = reinterpret_cast<float*>(column(SingleTheta, 4, sn, true));
+    s.omega = reinterpret_cast<float*>(column(SingleOmega, 4, sn, true));
+    s.m = reinterpret_cast<float*>(column(SingleMass, 4, sn, true));
+    s.L = reinterpret_cast<float*>(column(SingleLength, 4, sn, true));
+    s.px = reinterpret_cast<float*>(column(SinglePivotX, 4, sn, true));
+    s.py = reinterpret_cast<float*>(column(SinglePivotY, 4, sn, true));
+    s.frozen = column(SingleFrozen, 1, sn, true);
+    d.count = (size_t)dn;
+    d.theta1 = reinterpret_cast<float*>(column(DoubleTheta1, 4, dn, true));
+    d.theta2 = reinterpret_cast<float*>(column(DoubleTheta2, 4, dn, true));
+    d.omega1 = reinterpret_cast<float*>(column(DoubleOmega1, 4, dn, true));
+    d.omega2 = reinterpret_cast<float*>(column(DoubleOmega2, 4, dn, true));
+    d.m1 = reinterpret_cast<float*>(column(DoubleMass1, 4, dn, true));
+    d.m2 = reinterpret_cast<float*>(column(DoubleMass2, 4, dn, true));
+    d.L1 = reinterpret_cast<float*>(column(DoubleLength1, 4, dn, true));
+    d.L2 = reinterpret_cast<float*>(column(DoubleLength2, 4, dn, true));
+    d.px = reinterpret_cast<float*>(column(DoublePivotX, 4, dn, true));
+    d.py = reinterpret_cast<float*>(column(DoublePivotY, 4, dn, true));
+    d.frozen = column(DoubleFrozen, 1, dn, true);
+    const bool kinds = h->version >= 2;
+    const Section* drivenSection = kinds ? find(DrivenTheta) : nullptr;
+    const uint64_t fn = drivenSection ? drivenSection->count : 0;
+    f = DrivenColumns();
+    if (fn)
+    {
+        f.count = (size_t)fn;
+        f.theta = reinterpret_cast<float*>(column(DrivenTheta, 4, fn, true));
+        f.omega = reinterpret_cast<float*>(column(DrivenOmega, 4, fn, true));
+        f.phase = reinterpret_cast<float*>(column(DrivenPhase, 4, fn, true));
+        f.m = reinterpret_cast<float*>(column(DrivenMass, 4, fn, true));
+        f.L = reinterpret_cast<float*>(column(DrivenLength, 4, fn, true));
+        f.amplitude = reinterpret_cast<float*>(column(DrivenAmplitude, 4, fn, true));
+        f.frequency = reinterpret_cast<float*>(column(DrivenFrequency, 4, fn, true));
+        f.px = reinterpret_cast<float*>(column(DrivenPivotX, 4, fn, true));
+        f.py = reinterpret_cast<float*>(column(DrivenPivotY, 4, fn, true));
+        f.frozen = column(DrivenFrozen, 1, fn, true);
+    }
+    const Section* elasticSection = kinds ? find(ElasticTheta) : nullptr;
+    const uint64_t en = elasticSection ? elasticSection->count : 0;
+    e = ElasticColumns();
+    if (en)
+    {
+        e.count = (size_t)en;
+        e.theta = reinterpret_cast<float*>(column(ElasticTheta, 4, en, true));
+        e.omega = reinterpret_cast<float*>(column(ElasticOmega, 4, en, true));
+        e.r = reinterpret_cast<float*>(column(ElasticLength, 4, en, true));
+        e.vr = reinterpret_cast<float*>(column(ElasticLengthRate, 4, en, true));
+        e.m = reinterpret_cast<float*>(column(ElasticMass, 4, en, true));
+        e.L = reinterpret_cast<float*>(column(ElasticRestLength, 4, en, true));
+        e.k = reinterpret_cast<float*>(column(ElasticStiffness, 4, en, true));
+        e.px = reinterpret_cast<float*>(column(ElasticPivotX, 4, en, true));
+        e.py = reinterpret_cast<float*>(column(ElasticPivotY, 4, en, true));
+        e.frozen = column(ElasticFrozen, 1, en, true);
+    }
+    const uint64_t total = sn + dn + fn + en;
+    maxTrails = reinterpret_cast<const uint32_t*>(column(MaxTrail, 4, total, false));
+
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(column(TrailOffsets, 8, total + 1, false));
+    const Section* pointSection = find(TrailPoints);
+    if (offsets && pointSection && pointSection->elementSize == 8 && offsets[total] <= pointSection->count)
+    {
+        trailOffsets = offsets;
+        trailPoints = reinterpret_cast<const float*>(base + pointSection->offset);
+        trailPointCount = pointSection->count;
+    }
+    const uint64_t* saved = reinterpret_cast<const uint64_t*>(column(TrailStateOffsets, 8, total + 1, false));
+    const Section* stateSection = find(TrailStates);
+    if (saved && stateSection && stateSection->elementSize == 1 && saved[total] <= stateSection->count)
+    {
+        stateOffsets = saved;
+        states = base + stateSection->offset;
+        stateBytes = stateSection->count;
+    }
+
+    if (!ok)
+    {
+        error = path + " is missing pendulum columns";
+        header = nullptr;
+        return false;
+    }
+    return true;
+}
+
+const uint8_t* Scene::Mapped::trailState(size_t i, size_t& bytes) const
+{
+    bytes = 0;
+    if (!stateOffsets || i >= s.count + d.count + f.count + e.count)
+        return nullptr;
+    uint64_t begin = stateOffsets[i], end = stateOffsets[i + 1];
+    if (begin >= end || end > stateBytes)
+        return nullptr;
+    bytes = (size_t)(end - begin);
+    return states + begin;
+}
+
+const float* Scene::Mapped::trail(size_t i, size_t& points) const
+{
+    points = 0;
+    if (!trailOffsets || i >= s.count + d.count + f.count + e.count)
+        return nullptr;
+    uint64_t begin = trailOffsets[i], end = trailOffsets[i + 1];
+    if (begin > end || end > trailPointCount)
+        return nullptr;
+    points = (size_t)(end - begin);
+    return trailPoints + begin * 2;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Ensemble.h"
+#include "MappedFile.h"
+#include "Trail.h"
+
+// Versioned binary scene file. A header and section table are followed by
+// one 64-byte aligned column per pendulum field, so a mapped file can be
+// handed to the batch kernels as is. Wherever columns cover several kinds,
+// singles come first, then doubles, then driven, then elastic pendulums.
+// The driven and elastic columns are only written when there are any; their
+// counts are the lengths of the DrivenTheta and ElasticTheta columns.
+// Trails are kept exactly, every level as TrailHistory::save writes it;
+// files from before that hold flattened points instead.
+namespace Scene
+{
+    // Version 2 added the driven and elastic columns; version 1 files load
+    // with none of either
+    const uint32_t Version = 2;
+    const uint32_t OldestVersion = 1;
+    const uint64_t Alignment = 64;
+
+    enum ColumnId : uint32_t
+    {
+        SingleTheta = 1, SingleOmega, SingleMass, SingleLength, SinglePivotX, SinglePivotY, SingleFrozen,
+        DoubleTheta1 = 16, DoubleTheta2, DoubleOmega1, DoubleOmega2, DoubleMass1, DoubleMass2,
+        DoubleLength1, DoubleLength2, DoublePivotX, DoublePivotY, DoubleFrozen,
+        MaxTrail = 32, TrailOffsets, TrailPoints, TrailStateOffsets, TrailStates,
+        DrivenTheta = 48, DrivenOmega, DrivenPhase, DrivenMass, DrivenLength, DrivenAmplitude, DrivenFrequency,
+        DrivenPivotX, DrivenPivotY, DrivenFrozen,
+        ElasticTheta = 64, ElasticOmega, ElasticLength, ElasticLengthRate, ElasticMass, ElasticRestLength,
+        ElasticStiffness, ElasticPivotX, ElasticPivotY, ElasticFrozen
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        float g;
+        float damping;
+        uint64_t singleCount;
+        uint64_t doubleCount;
+        uint64_t fileSize;
+        uint32_t sectionCount;
+        uint32_t flags;
+    };
+
+    struct Section
+    {
+        uint32_t id;
+        uint32_t elementSize;
+        uint64_t count;
+        uint64_t offset;
+    };
+
+    struct Source
+    {
+        float g = 9.807f;
+        float damping = 0.0f;
+        SingleColumns singles;
+        DoubleColumns doubles;
+        DrivenColumns drivens;
+        ElasticColumns elastics;
+        // Optional, one entry per pendulum
+        const uint32_t* maxTrail = nullptr;
+        const std::vector<const TrailHistory*>* trails = nullptr;
+    };
+
+    bool save(const std::string& path, const Source& scene, std::string& error);
+
+    // A validated scene mapped copy-on-write, its columns can be stepped in place.
+    class Mapped
+    {
+    public:
+        bool open(const std::string& path, std::string& error);
+
+        float g() const { return header->g; }
+        float damping() const { return header->damping; }
+        SingleColumns singles() const { return s; }
+        DoubleColumns doubles() const { return d; }
+        DrivenColumns drivens() const { return f; }
+        ElasticColumns elastics() const { return e; }
+        const uint32_t* maxTrail() const { return maxTrails; }
+        bool hasTrails() const { return trailOffsets != nullptr || stateOffsets != nullptr; }
+        // Saved trail of pendulum i for TrailHistory::load, null if none.
+        const uint8_t* trailState(size_t i, size_t& bytes) const;
+        // Trail of pendulum i as x, y pairs from oldest to newest, in older files.
+        const float* trail(size_t i, size_t& points) const;
+
+    private:
+        const Section* find(uint32_t id) const;
+
+        MappedFile file;
+        const Header* header = nullptr;
+        const Section* sections = nullptr;
+        SingleColumns s;
+        DoubleColumns d;
+        DrivenColumns f;
+        ElasticColumns e;
+        const uint32_t* maxTrails = nullptr;
+        const uint64_t* trailOffsets = nullptr;
+        const float* trailPoints = nullptr;
+        uint64_t trailPointCount = 0;
+        const uint64_t* stateOffsets = nullptr;
+        const uint8_t* states = nullptr;
+        uint64_t stateBytes = 0;
+    };
+}
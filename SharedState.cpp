@@ -0,0 +1,394 @@
+#include "SharedState.h"
+#include <cstring>
+#include <new>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char Magic[8] = { 'P', 'E', 'N', 'D', 'S', 'H', 'M', '1' };
+
+    size_t alignUp(size_t v)
+    {
+        return (v + 63) & ~(size_t)63;
+    }
+
+    size_t infosOffset()
+    {
+        return alignUp(sizeof(SharedState::Frame));
+    }
+
+    size_t samplesOffset(size_t capacity)
+    {
+        return alignUp(infosOffset() + capacity * sizeof(Trajectory::PendulumInfo));
+    }
+
+    size_t frameBytes(size_t capacity)
+    {
+        return alignUp(samplesOffset(capacity) + capacity * sizeof(Trajectory::Sample));
+    }
+
+    // POSIX names start with a slash, Windows ones live in the session namespace
+    std::string systemName(const std::string& name)
+    {
+#ifdef _WIN32
+        return "Local\\" + (name.empty() || name[0] != '/' ? name : name.substr(1));
+#else
+        return name.empty() || name[0] != '/' ? "/" + name : name;
+#endif
+    }
+
+    SharedState::Frame* frameAt(uint8_t* base, const SharedState::Header* h, uint64_t index)
+    {
+        return reinterpret_cast<SharedState::Frame*>(base + alignUp(sizeof(SharedState::Header)) +
+                                                     (index % SharedState::Buffers) * h->frameBytes);
+    }
+
+    SharedState::Header* initialize(uint8_t* base, size_t capacity)
+    {
+        using namespace SharedState;
+        Header* header = new (base) Header();
+        header->version = Version;
+        header->headerSize = sizeof(Header);
+        header->capacity = capacity;
+        header->frameBytes = frameBytes(capacity);
+        for (uint64_t b = 0; b < Buffers; ++b)
+            new (frameAt(base, header, b)) Frame();
+        // Readers check the magic first, so it goes in last
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->magic, Magic, sizeof(Magic));
+        return header;
+    }
+
+    // Readers give up following a publisher that keeps moving faster than this
+    const int MaxHops = 16;
+}
+
+size_t SharedState::segmentBytes(size_t capacity)
+{
+    return alignUp(sizeof(Header)) + Buffers * frameBytes(capacity);
+}
+
+std::string SharedState::generationName(const std::string& name, uint32_t generation)
+{
+    return generation ? name + "." + std::to_string(generation) : name;
+}
+
+const Trajectory::PendulumInfo* SharedState::Frame::infos() const
+{
+    return reinterpret_cast<const Trajectory::PendulumInfo*>(reinterpret_cast<const uint8_t*>(this) + infosOffset());
+}
+
+const Trajectory::Sample* SharedState::Frame::samples(size_t capacity) const
+{
+    return reinterpret_cast<const Trajectory::Sample*>(reinterpret_cast<const uint8_t*>(this) + samplesOffset(capacity));
+}
+
+Trajectory::PendulumInfo* SharedState::Frame::infos()
+{
+    return reinterpret_cast<Trajectory::PendulumInfo*>(reinterpret_cast<uint8_t*>(this) + infosOffset());
+}
+
+Trajectory::Sample* SharedState::Frame::samples(size_t capacity)
+{
+    return reinterpret_cast<Trajectory::Sample*>(reinterpret_cast<uint8_t*>(this) + samplesOffset(capacity));
+}
+
+SharedState::Segment::~Segment()
+{
+    close();
+}
+
+void SharedState::Segment::swap(Segment& other)
+{
+    std::swap(data, other.data);
+    std::swap(length, other.length);
+    owned.swap(other.owned);
+#ifdef _WIN32
+    std::swap(mapping, other.mapping);
+#endif
+}
+
+#ifdef _WIN32
+
+bool SharedState::Segment::create(const std::string& name, size_t bytes, std::string& error)
+{
+    close();
+    std::string system = systemName(name);
+    HANDLE h = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32),
+                                  (DWORD)bytes, system.c_str());
+    if (!h)
+    {
+        error = "Cannot create shared memory " + system;
+        return false;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        CloseHandle(h);
+        error = "Shared memory " + system + " is still in use";
+        return false;
+    }
+    void* view = MapViewOfFile(h, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    if (!view)
+    {
+        CloseHandle(h);
+        error = "Cannot map shared memory " + system;
+        return false;
+    }
+    mapping = h;
+    data = static_cast<uint8_t*>(view);
+    length = bytes;
+    return true;
+}
+
+bool SharedState::Segment::open(const std::string& name, std::string& error)
+{
+    close();
+    std::string system = systemName(name);
+    HANDLE h = OpenFileMappingA(FILE_MAP_READ, FALSE, system.c_str());
+    if (!h)
+    {
+        error = "No shared memory " + system;
+        return false;
+    }
+    void* view = MapViewOfFile(h, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (!view || !VirtualQuery(view, &info, sizeof(info)))
+    {
+        if (view)
+            UnmapViewOfFile(view);
+        CloseHandle(h);
+        error = "Cannot map shared memory " + system;
+        return false;
+    }
+    mapping = h;
+    data = static_cast<uint8_t*>(view);
+    length = info.RegionSize;
+    return true;
+}
+
+void SharedState::Segment::close()
+{
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    data = nullptr;
+    mapping = nullptr;
+    length = 0;
+}
+
+#else
+
+bool SharedState::Segment::create(const std::string& name, size_t bytes, std::string& error)
+{
+    close();
+    std::string system = systemName(name);
+    // Drop a segment left behind by a publisher that did not shut down
+    shm_unlink(system.c_str());
+    int fd = shm_open(system.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        error = "Cannot create shared memory " + system;
+        return false;
+    }
+    if (ftruncate(fd, (off_t)bytes) != 0)
+    {
+        ::close(fd);
+        shm_unlink(system.c_str());
+        error = "Cannot size shared memory " + system;
+        return false;
+    }
+    void* view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+    {
+        shm_unlink(system.c_str());
+        error = "Cannot map shared memory " + system;
+        return false;
+    }
+    data = static_cast<uint8_t*>(view);
+    length = bytes;
+    owned = system;
+    return true;
+}
+
+bool SharedState::Segment::open(const std::string& name, std::string& error)
+{
+    close();
+    std::string system = systemName(name);
+    int fd = shm_open(system.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        error = "No shared memory " + system;
+        return false;
+    }
+    struct stat st;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+    {
+        error = "Cannot map shared memory " + system;
+        return false;
+    }
+    data = static_cast<uint8_t*>(view);
+    length = (size_t)st.st_size;
+    return true;
+}
+
+void SharedState::Segment::close()
+{
+    if (data)
+        munmap(data, length);
+    if (!owned.empty())
+        shm_unlink(owned.c_str());
+    data = nullptr;
+    length = 0;
+    owned.clear();
+}
+
+#endif
+
+bool SharedState::Publisher::open(const std::string& name, size_t capacity, std::string& error)
+{
+    close();
+    if (!first.create(name, segmentBytes(capacity), error))
+        return false;
+    firstHeader = header = initialize(first.bytes(), capacity);
+    segmentName = name;
+    return true;
+}
+
+bool SharedState::Publisher::grow(size_t capacity, std::string& error)
+{
+    Segment next;
+    if (!next.create(generationName(segmentName, generation + 1), segmentBytes(capacity), error))
+        return false;
+    Header* h = initialize(next.bytes(), capacity);
+    ++generation;
+    // Where the frames went, then closed, in the old segment and the first
+    header->moved.store(generation, std::memory_order_release);
+    header->closed.store(1, std::memory_order_release);
+    firstHeader->moved.store(generation, std::memory_order_release);
+    firstHeader->closed.store(1, std::memory_order_release);
+    // The first segment stays for readers opening the name; the one in
+    // between goes once next takes its place
+    segment.swap(next);
+    header = h;
+    return true;
+}
+
+void SharedState::Publisher::close()
+{
+    if (header)
+        header->closed.store(1, std::memory_order_release);
+    if (firstHeader)
+        firstHeader->closed.store(1, std::memory_order_release);
+    header = firstHeader = nullptr;
+    segment.close();
+    first.close();
+    segmentName.clear();
+    generation = 0;
+}
+
+SharedState::Frame& SharedState::Publisher::begin()
+{
+    Frame& f = *frameAt(reinterpret_cast<uint8_t*>(header), header, header->published.load(std::memory_order_relaxed));
+    // Odd while the buffer is being written
+    f.sequence.store(f.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return f;
+}
+
+void SharedState::Publisher::end(Frame& frame)
+{
+    frame.sequence.store(frame.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    header->published.fetch_add(1, std::memory_order_release);
+}
+
+bool SharedState::Reader::open(const std::string& name, std::string& error)
+{
+    // A publisher that moved on leaves its current generation under the
+    // name; that one may itself be gone by the time we get there
+    std::string current = name;
+    for (int hop = 0; hop < MaxHops; ++hop)
+    {
+        if (!attach(current, error))
+        {
+            if (current == name)
+                return false;
+            current = name;
+            continue;
+        }
+        uint32_t moved = header->moved.load(std::memory_order_acquire);
+        if (!moved)
+            return true;
+        current = generationName(name, moved);
+    }
+    close();
+    error = "Shared memory " + name + " keeps moving";
+    return false;
+}
+
+bool SharedState::Reader::attach(const std::string& name, std::string& error)
+{
+    close();
+    if (!segment.open(name, error))
+        return false;
+    const Header* h = reinterpret_cast<const Header*>(segment.bytes());
+    if (segment.size() < sizeof(Header) || std::memcmp(h->magic, Magic, sizeof(Magic)) != 0 ||
+        h->version != Version || segment.size() < segmentBytes((size_t)h->capacity))
+    {
+        segment.close();
+        error = "Shared memory " + name + " is not a pendulum state segment";
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    header = h;
+    return true;
+}
+
+void SharedState::Reader::close()
+{
+    header = nullptr;
+    segment.close();
+}
+
+bool SharedState::Reader::closed() const
+{
+    return !header || header->closed.load(std::memory_order_acquire) != 0;
+}
+
+const SharedState::Frame* SharedState::Reader::acquire(uint64_t& sequence) const
+{
+    if (!header)
+        return nullptr;
+    while (true)
+    {
+        uint64_t published = header->published.load(std::memory_order_acquire);
+        if (published == 0)
+            return nullptr;
+        const Frame* f = frameAt(segment.bytes(), header, published - 1);
+        sequence = f->sequence.load(std::memory_order_acquire);
+        // Odd means the publisher already lapped us onto this buffer
+        if ((sequence & 1) == 0)
+            return f;
+    }
+}
+
+bool SharedState::Reader::validate(const Frame& frame, uint64_t sequence) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return frame.sequence.load(std::memory_order_relaxed) == sequence;
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "TrajectoryFormat.h"
+
+// Live simulation state in a named shared-memory segment (shm_open on
+// POSIX, a named file mapping on Windows) for local readers such as
+// dashboards. The segment holds two frame buffers, each guarded by a
+// sequence counter. The publisher fills the older buffer, making its counter
+// odd before and even again after, and never waits for anyone. Readers use
+// the newest buffer in place and check its counter afterwards; they only
+// have to retry if reading took longer than a whole frame.
+//
+// A publisher that outgrows its segment moves to a new one named after the
+// first plus ".1", ".2" and so on, since readers may still map the old one,
+// and keeps the first one open to tell readers which generation is current.
+namespace SharedState
+{
+    const uint32_t Version = 1;
+    const size_t Buffers = 2;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t capacity;
+        uint64_t frameBytes;
+        // Frames published so far, the newest is in buffer (published - 1) % Buffers
+        std::atomic<uint64_t> published;
+        // Set when the publisher stops or moves to a bigger segment
+        std::atomic<uint32_t> closed;
+        // Generation of the segment the publisher moved to, 0 until it does;
+        // stored before closed
+        std::atomic<uint32_t> moved;
+    };
+
+    // One buffer: this header, then capacity PendulumInfo and capacity Sample
+    // arrays, each starting on a 64-byte boundary.
+    struct Frame
+    {
+        std::atomic<uint64_t> sequence;
+        uint64_t frame;
+        double time;
+        float g, damping;
+        uint64_t count;
+
+        const Trajectory::PendulumInfo* infos() const;
+        const Trajectory::Sample* samples(size_t capacity) const;
+        Trajectory::PendulumInfo* infos();
+        Trajectory::Sample* samples(size_t capacity);
+    };
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "shared counters must not need a lock");
+
+    // Maps the segment; shared by both ends.
+    class Segment
+    {
+    public:
+        Segment() = default;
+        ~Segment();
+        Segment(const Segment&) = delete;
+        Segment& operator=(const Segment&) = delete;
+
+        bool create(const std::string& name, size_t bytes, std::string& error);
+        bool open(const std::string& name, std::string& error);
+        void close();
+        void swap(Segment& other);
+        bool isOpen() const { return data != nullptr; }
+        uint8_t* bytes() const { return data; }
+        size_t size() const { return length; }
+
+    private:
+        uint8_t* data = nullptr;
+        size_t length = 0;
+        std::string owned;
+#ifdef _WIN32
+        void* mapping = nullptr;
+#endif
+    };
+
+    class Publisher
+    {
+    public:
+        ~Publisher() { close(); }
+
+        // Replaces any segment left under the same name
+        bool open(const std::string& name, size_t capacity, std::string& error);
+        // Moves to a segment of the new capacity under the next generation's
+        // name; readers of the old one see it closed and reopen the name
+        bool grow(size_t capacity, std::string& error);
+        void close();
+        bool isOpen() const { return first.isOpen(); }
+        size_t capacity() const { return header ? (size_t)header->capacity : 0; }
+        const std::string& name() const { return segmentName; }
+
+        // Claims the older buffer for writing; fill at most capacity() entries.
+        Frame& begin();
+        // Makes the buffer the newest one.
+        void end(Frame& frame);
+
+    private:
+        // The segment under the name itself, and once moved the current one
+        Segment first, segment;
+        Header* firstHeader = nullptr;
+        Header* header = nullptr;
+        std::string segmentName;
+        uint32_t generation = 0;
+    };
+
+    class Reader
+    {
+    public:
+        // Follows the name to the publisher's current generation
+        bool open(const std::string& name, std::string& error);
+        void close();
+        bool isOpen() const { return header != nullptr; }
+        // True once the publisher stopped or moved on; reopen to follow it
+        bool closed() const;
+        size_t capacity() const { return header ? (size_t)header->capacity : 0; }
+
+        // Newest complete frame, read in place, or null before the first one.
+        const Frame* acquire(uint64_t& sequence) const;
+        // True if the frame was not rewritten since acquire returned it.
+        bool validate(const Frame& frame, uint64_t sequence) const;
+
+    private:
+        bool attach(const std::string& name, std::string& error);
+
+        Segment segment;
+        const Header* header = nullptr;
+    };
+
+    // Segment size for a capacity
+    size_t segmentBytes(size_t capacity);
+    // Name of a publisher's segment after it moved generation times
+    std::string generationName(const std::string& name, uint32_t generation);
+}
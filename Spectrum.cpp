@@ -0,0 +1,268 @@
+#include "Spectrum.h"
+#include <algorithm>
+#include <cmath>
+#include "BatchKernels.h"
+#include "Physics.h"
+
+namespace
+{
+    const char* Names[Spectrum::MotionCount] = { "periodic", "quasi-periodic", "chaotic" };
+    const double TwoPi = 6.283185307179586;
+    // Radians an unwrapped angle may move from its lane's base before the
+    // base follows it, keeping stored samples within a float's fine range
+    const double RebaseDistance = 64.0;
+
+    // Peak position refined by a parabola through the log powers around it
+    float refine(const float* power, size_t stride, size_t bins, size_t k)
+    {
+        if (k == 0 || k + 1 >= bins)
+            return (float)k;
+        const float Floor = 1e-30f;
+        float a = std::log(power[(k - 1) * stride] + Floor), b = std::log(power[k * stride] + Floor),
+              c = std::log(power[(k + 1) * stride] + Floor);
+        float curve = a - 2.0f * b + c;
+        return curve < 0.0f ? (float)k + 0.5f * (a - c) / curve : (float)k;
+    }
+}
+
+bool Spectrum::Plan::reset(size_t n, std::string& error)
+{
+    size_t half = n / 2, rest = half;
+    if (n < 16 || n % 2)
+    {
+        error = "Spectrum length " + std::to_string(n) + " must be even and at least 16";
+        return false;
+    }
+    std::vector<int> radices;
+    for (int radix : { 4, 2, 3, 5 })
+        while (rest % radix == 0)
+        {
+            radices.push_back(radix);
+            rest /= radix;
+        }
+    if (rest != 1)
+    {
+        error = "Spectrum length " + std::to_string(n) + " has factors other than 2, 3 and 5";
+        return false;
+    }
+
+    length = n;
+    passes.clear();
+    twiddleRe.clear();
+    twiddleIm.clear();
+    size_t span = 1;
+    for (int radix : radices)
+    {
+        // Run j of the pass rotates its output u by exp(-2 pi i j u / (radix * runs))
+        Pass pass = { radix, span, half / (span * radix), twiddleRe.size() };
+        for (size_t j = 0; j < pass.runs; ++j)
+            for (int u = 1; u < radix; ++u)
+            {
+                double angle = -TwoPi * (double)(j * u) / (double)(radix * pass.runs);
+                twiddleRe.push_back((float)std::cos(angle));
+                twiddleIm.push_back((float)std::sin(angle));
+            }
+        passes.push_back(pass);
+        span *= radix;
+    }
+
+    splitRe.resize(half + 1);
+    splitIm.resize(half + 1);
+    for (size_t k = 0; k <= half; ++k)
+    {
+        splitRe[k] = (float)std::cos(-TwoPi * k / n);
+        splitIm[k] = (float)std::sin(-TwoPi * k / n);
+    }
+    // Periodic Hann, whose halves overlap to a constant
+    window.resize(n);
+    double sum = 0.0;
+    for (size_t t = 0; t < n; ++t)
+    {
+        window[t] = (float)(0.5 - 0.5 * std::cos(TwoPi * t / n));
+        sum += (double)window[t] * window[t];
+    }
+    windowPower = (float)sum;
+    return true;
+}
+
+void Spectrum::welch(const Plan& plan, const float* series, size_t stride, size_t lanes, size_t segments,
+                     float sampleRate, float* power, float* work)
+{
+    if (!segments || !lanes)
+        return;
+    float scale = 1.0f / ((float)segments * sampleRate * plan.windowPower);
+    Batch::kernels(Cpu::active()).welch(plan, series, stride, lanes, segments, scale, power, work);
+}
+
+const char* Spectrum::name(Motion motion)
+{
+    return motion >= 0 && motion < MotionCount ? Names[motion] : "?";
+}
+
+Spectrum::Summary Spectrum::summarize(const float* power, size_t stride, size_t bins, float binWidth)
+{
+    Summary summary;
+    double total = 0.0;
+    float strongest = 0.0f;
+    size_t peak = 0;
+    for (size_t k = 1; k < bins; ++k)
+    {
+        float p = power[k * stride];
+        total += p;
+        if (p > strongest)
+        {
+            strongest = p;
+            peak = k;
+        }
+    }
+    if (!(total > 0.0))
+        return summary;
+    summary.peak = refine(power, stride, bins, peak) * binWidth;
+
+    double entropy = 0.0;
+    for (size_t k = 1; k < bins; ++k)
+    {
+        double q = power[k * stride] / total;
+        if (q > 0.0)
+            entropy -= q * std::log(q);
+    }
+    summary.entropy = bins > 2 ? (float)(entropy / std::log((double)(bins - 1))) : 0.0f;
+
+    // Lines in rising order, so the first is the fundamental the rest are
+    // held against; each claims the bins within two of it as its own
+    const float threshold = strongest * LineRange;
+    double claimed = 0.0;
+    size_t claimedTo = 0;
+    float fundamental = 0.0f;
+    bool harmonic = true;
+    for (size_t k = 1; k < bins; ++k)
+    {
+        float p = power[k * stride];
+        float below = power[(k - 1) * stride], above = k + 1 < bins ? power[(k + 1) * stride] : 0.0f;
+        if (p < threshold || p < below || p <= above)
+            continue;
+        float floor = INFINITY;
+        if (k > LineReach)
+            floor = power[(k - LineReach) * stride];
+        if (k + LineReach < bins)
+            floor = std::min(floor, power[(k + LineReach) * stride]);
+        if (p < LineProminence * floor)
+            continue;
+        ++summary.lines;
+        for (size_t c = std::max(k - std::min<size_t>(k, 2), claimedTo); c <= std::min(k + 2, bins - 1); ++c)
+            claimed += c ? power[c * stride] : 0.0f;
+        claimedTo = std::min(k + 2, bins - 1) + 1;
+
+        float at = refine(power, stride, bins, k);
+        if (summary.lines == 1)
+        {
+            fundamental = at;
+            continue;
+        }
+        // Harmonic n of a fundamental off by a fraction of a bin is off by n times that
+        float n = std::round(at / fundamental);
+        harmonic &= std::fabs(at - n * fundamental) <= 0.5f + 0.05f * n;
+    }
+    summary.broadband = (float)std::max(0.0, 1.0 - claimed / total);
+    summary.motion = summary.broadband > ChaoticBroadband ? Chaotic : harmonic ? Periodic : QuasiPeriodic;
+    return summary;
+}
+
+bool Spectrum::Analyzer::reset(size_t pendulums, size_t length, size_t segments, float sampleRate, std::string& error)
+{
+    if (!(sampleRate > 0.0f))
+    {
+        error = "Sample rate must be positive";
+        return false;
+    }
+    if (!plan.reset(length, error))
+        return false;
+    lanes = pendulums * ChannelCount;
+    maxSegments = std::max<size_t>(1, segments);
+    capacity = length + (maxSegments - 1) * hop(length);
+    rate = sampleRate;
+    ring.assign(2 * capacity * lanes, 0.0f);
+    last.assign(lanes, 0.0f);
+    unwrapped.assign(lanes, 0.0);
+    base.assign(lanes, 0.0);
+    spectra.assign(plan.bins() * lanes, 0.0f);
+    work.assign(plan.workSize(), 0.0f);
+    clear();
+    return true;
+}
+
+void Spectrum::Analyzer::clear()
+{
+    recorded = 0;
+    clock = 0.0f;
+    std::fill(spectra.begin(), spectra.end(), 0.0f);
+}
+
+bool Spectrum::Analyzer::due(float dt)
+{
+    if (!lanes)
+        return false;
+    clock += dt;
+    const float interval = 1.0f / rate;
+    if (clock < interval)
+        return false;
+    clock = std::fmod(clock, interval);
+    return true;
+}
+
+void Spectrum::Analyzer::record(size_t pendulum, float theta1, float theta2)
+{
+    const size_t slot = (size_t)(recorded % capacity);
+    const float angles[ChannelCount] = { theta1, theta2 };
+    for (int c = 0; c < ChannelCount; ++c)
+    {
+        const size_t lane = pendulum * ChannelCount + c;
+        double& angle = unwrapped[lane];
+        if (!recorded)
+            angle = base[lane] = angles[c];
+        else
+            angle += Physics::wrapAngle((double)angles[c] - last[lane]);
+        last[lane] = angles[c];
+        if (std::fabs(angle - base[lane]) > RebaseDistance)
+            rebase(lane, angle);
+        ring[slot * lanes + lane] = ring[(slot + capacity) * lanes + lane] = (float)(angle - base[lane]);
+    }
+}
+
+void Spectrum::Analyzer::rebase(size_t lane, double to)
+{
+    // Both mirror copies; slots not yet written shift too, harmlessly
+    const float shift = (float)(to - base[lane]);
+    for (size_t slot = 0; slot < 2 * capacity; ++slot)
+        ring[slot * lanes + lane] -= shift;
+    base[lane] = to;
+}
+
+void Spectrum::Analyzer::commit()
+{
+    ++recorded;
+}
+
+size_t Spectrum::Analyzer::held() const
+{
+    return (size_t)std::min<uint64_t>(recorded, capacity);
+}
+
+size_t Spectrum::Analyzer::heldSegments() const
+{
+    return std::min(maxSegments, Spectrum::segments(held(), plan.length));
+}
+
+bool Spectrum::Analyzer::compute(size_t begin, size_t end)
+{
+    const size_t count = heldSegments();
+    end = std::min(end, pendulums());
+    if (!count || begin >= end)
+        return false;
+    // The newest samples that make up whole segments, contiguous in the mirror
+    const size_t used = plan.length + (count - 1) * hop(plan.length);
+    const size_t first = (size_t)((recorded - used) % capacity);
+    welch(plan, ring.data() + first * lanes + begin * ChannelCount, lanes, (end - begin) * ChannelCount, count, rate,
+          spectra.data() + begin * ChannelCount, work.data());
+    return true;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Power spectra of angle time series, to tell periodic, quasi-periodic and
+// chaotic motion apart. Spectra are Welch estimates: Hann windowed segments
+// overlapping by half, each linearly detrended and put through a real FFT,
+// with the periodograms averaged. The FFT is a Stockham autosort transform
+// with radix 4, 2, 3 and 5 passes, so segment lengths are even numbers
+// whose other factors are 2, 3 and 5.
+//
+// Series are stored lane-interleaved: sample t of lane l at t * stride + l,
+// which is the order an ensemble produces them in step by step. The
+// transforms run on blocks of lanes with the lanes innermost, so every
+// butterfly vectorizes across spectra; the kernels are built per
+// instruction set level with the batch step kernels (BatchKernels.inl).
+namespace Spectrum
+{
+    // Lanes transformed together, a multiple of every vector width
+    const size_t LaneBlock = 16;
+
+    // Radix passes, twiddles and window for real transforms of one length
+    struct Plan
+    {
+        struct Pass
+        {
+            int radix;
+            // Points per run and runs, where the passes so far multiply to span
+            size_t span, runs;
+            // First of this pass's (radix - 1) * runs twiddles
+            size_t twiddle;
+        };
+
+        size_t length = 0;
+        std::vector<Pass> passes;
+        std::vector<float> twiddleRe, twiddleIm;
+        // exp(-2 pi i k / length) for the split of the half-length transform
+        std::vector<float> splitRe, splitIm;
+        std::vector<float> window;
+        float windowPower = 0.0f;
+
+        // Fails unless length is even, at least 16, and 2, 3 and 5 smooth
+        bool reset(size_t length, std::string& error);
+        size_t bins() const { return length / 2 + 1; }
+        // Floats of scratch the kernels need for one block of lanes
+        size_t workSize() const { return 2 * length * LaneBlock; }
+    };
+
+    // Segments start half a segment apart
+    inline size_t hop(size_t length)
+    {
+        return length / 2;
+    }
+    // Welch segments of length that fit in samples
+    inline size_t segments(size_t samples, size_t length)
+    {
+        return samples < length ? 0 : (samples - length) / hop(length) + 1;
+    }
+
+    // Averages the periodograms of segments segments, hop samples apart, for
+    // lanes [0, lanes) of series at stride. power[k * stride + l] receives the
+    // one-sided density of lane l at frequency k * sampleRate / length, in
+    // squared units per Hz. work holds plan.workSize() floats.
+    void welch(const Plan& plan, const float* series, size_t stride, size_t lanes, size_t segments, float sampleRate,
+               float* power, float* work);
+
+    enum Motion
+    {
+        Periodic, QuasiPeriodic, Chaotic, MotionCount
+    };
+
+    const char* name(Motion motion);
+
+    // What a spectrum's shape says about the motion behind it. Lines are
+    // local maxima within LineRange of the strongest that stand LineProminence
+    // times above the spectrum LineReach bins away on one side at least, past
+    // where a Hann windowed tone leaks to; broadband is the share of power
+    // more than two bins from any line. Broadband spectra are chaotic, line
+    // spectra periodic when every line sits on a harmonic of the lowest one
+    // and quasi-periodic otherwise. DC is left out.
+    struct Summary
+    {
+        float peak = 0.0f;
+        float entropy = 0.0f;
+        float broadband = 0.0f;
+        int lines = 0;
+        Motion motion = Periodic;
+    };
+
+    const float LineRange = 1e-4f;
+    const float LineProminence = 10.0f;
+    const size_t LineReach = 4;
+    const float ChaoticBroadband = 0.2f;
+
+    Summary summarize(const float* power, size_t stride, size_t bins, float binWidth);
+
+    // Streaming spectra of theta1 and theta2 for a set of pendulums, sampled
+    // at a fixed rate from the simulation's own steps. Samples go into a
+    // mirrored ring, each written twice, so the newest history is always
+    // contiguous and is transformed in place. Angles are unwrapped as they
+    // arrive, which needs less than half a turn between samples, and stored
+    // relative to a per-lane base kept near them, so a pendulum that has
+    // spun many turns keeps float precision; the detrend removes the offset.
+    class Analyzer
+    {
+    public:
+        enum Channel
+        {
+            Theta1, Theta2, ChannelCount
+        };
+
+        // Keeps segments Welch segments of length samples per pendulum
+        bool reset(size_t pendulums, size_t length, size_t segments, float sampleRate, std::string& error);
+        void clear();
+        size_t pendulums() const { return lanes / ChannelCount; }
+        size_t length() const { return plan.length; }
+        size_t segments() const { return maxSegments; }
+        float sampleRate() const { return rate; }
+
+        // Advances the sample clock by dt, true when the steps now ending
+        // should be sampled
+        bool due(float dt);
+        void record(size_t pendulum, float theta1, float theta2);
+        // Called once after every pendulum of a due step has been recorded
+        void commit();
+
+        // Samples held, and in how many full segments
+        size_t held() const;
+        size_t heldSegments() const;
+        uint64_t total() const { return recorded; }
+
+        // Recomputes the spectra of pendulums [begin, end) from the held
+        // history; false until a whole segment has been recorded
+        bool compute(size_t begin, size_t end);
+        size_t bins() const { return plan.bins(); }
+        float binWidth() const { return rate / (float)plan.length; }
+        const float* power(size_t pendulum, Channel channel) const { return spectra.data() + pendulum * ChannelCount + channel; }
+        size_t stride() const { return lanes; }
+
+    private:
+        // Moves a lane's base to to, shifting every sample it holds to match
+        void rebase(size_t lane, double to);
+
+        Plan plan;
+        size_t lanes = 0, capacity = 0, maxSegments = 0;
+        float rate = 0.0f, clock = 0.0f;
+        uint64_t recorded = 0;
+        std::vector<float> ring, last, spectra, work;
+        std::vector<double> unwrapped, base;
+    };
+}
@@ -0,0 +1,152 @@
+#include "SpectrumView.h"
+#include "imgui/imgui.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const char* Channels[] = { "theta1", "theta2" };
+    const int Lengths[] = { 128, 256, 512, 1024, 2048, 4096 };
+    const char* LengthNames[] = { "128", "256", "512", "1024", "2048", "4096" };
+
+    float level(float power, bool decibels)
+    {
+        return decibels ? 10.0f * std::log10(std::max(power, 1e-30f)) : power;
+    }
+}
+
+void SpectrumView::reset(Spectrum::Analyzer& analyzer, size_t pendulums)
+{
+    status.clear();
+    analyzer.reset(pendulums, (size_t)length, (size_t)segments, sampleRate, status);
+    computed = -1.0;
+}
+
+void SpectrumView::draw(Spectrum::Analyzer& analyzer, bool* open)
+{
+    ImGui::SetNextWindowSize(ImVec2(520.0f, 640.0f), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Spectrum", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (!analyzer.length())
+        reset(analyzer, analyzer.pendulums());
+    ImGui::Combo("Angle", &channel, Channels, IM_ARRAYSIZE(Channels));
+    int index = (int)(std::find(Lengths, Lengths + IM_ARRAYSIZE(Lengths), length) - Lengths);
+    bool changed = false;
+    if (ImGui::Combo("Segment", &index, LengthNames, IM_ARRAYSIZE(LengthNames)) && index < IM_ARRAYSIZE(Lengths))
+    {
+        length = Lengths[index];
+        changed = true;
+    }
+    changed |= ImGui::SliderInt("Segments", &segments, 1, 16);
+    changed |= ImGui::SliderFloat("Sample rate", &sampleRate, 10.0f, 500.0f, "%.0f Hz", ImGuiSliderFlags_Logarithmic);
+    if (changed)
+        reset(analyzer, analyzer.pendulums());
+    ImGui::Checkbox("Decibels", &decibels);
+    if (decibels)
+    {
+        ImGui::SameLine();
+        ImGui::SliderFloat("Range", &range, 20.0f, 140.0f, "%.0f dB");
+    }
+    ImGui::SliderInt("Pendulums shown", &maxCurves, 1, 256);
+    if (ImGui::Button("Clear"))
+    {
+        analyzer.clear();
+        computed = -1.0;
+    }
+    ImGui::SameLine();
+    ImGui::Text("%zu of %zu samples, %zu segments, %.3f Hz bins", analyzer.held(),
+                analyzer.length() + (analyzer.segments() - 1) * Spectrum::hop(analyzer.length()),
+                analyzer.heldSegments(), analyzer.binWidth());
+    if (!status.empty())
+        ImGui::Text("%s", status.c_str());
+
+    const size_t shown = std::min(analyzer.pendulums(), (size_t)maxCurves);
+    double now = ImGui::GetTime();
+    if (computed < 0.0 || now - computed >= refresh)
+    {
+        if (analyzer.compute(0, shown))
+            computed = now;
+    }
+    if (computed < 0.0)
+    {
+        ImGui::Text("Waiting for a whole segment, %.1f s", analyzer.length() / analyzer.sampleRate());
+        ImGui::End();
+        return;
+    }
+
+    // Scale to the strongest line shown, DC aside
+    const Spectrum::Analyzer::Channel c = (Spectrum::Analyzer::Channel)channel;
+    const size_t bins = analyzer.bins(), stride = analyzer.stride();
+    float top = 1e-30f;
+    for (size_t p = 0; p < shown; ++p)
+    {
+        const float* power = analyzer.power(p, c);
+        for (size_t k = 1; k < bins; ++k)
+            top = std::max(top, power[k * stride]);
+    }
+    const float high = level(top, decibels), low = decibels ? high - range : 0.0f;
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImVec2 size = ImGui::GetContentRegionAvail();
+    size.x = std::max(size.x, 64.0f);
+    size.y = std::max(size.y * 0.6f, 64.0f);
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(16, 16, 20, 255));
+    draw->PushClipRect(origin, ImVec2(origin.x + size.x, origin.y + size.y), true);
+    const float sx = size.x / (float)(bins - 1), sy = size.y / std::max(high - low, 1e-30f);
+    for (size_t p = 0; p < shown; ++p)
+    {
+        const float* power = analyzer.power(p, c);
+        // Golden-ratio hues keep neighbouring pendulums apart, as in the Poincaré view
+        ImU32 colour = ImColor::HSV(std::fmod(p * 0.618034f, 1.0f), 0.6f, 1.0f);
+        ImVec2 previous(origin.x, origin.y + size.y - (level(power[0], decibels) - low) * sy);
+        for (size_t k = 1; k < bins; ++k)
+        {
+            ImVec2 point(origin.x + k * sx, origin.y + size.y - (level(power[k * stride], decibels) - low) * sy);
+            draw->AddLine(previous, point, colour);
+            previous = point;
+        }
+    }
+    draw->PopClipRect();
+    ImGui::Dummy(size);
+    ImGui::Text("0 .. %.1f Hz, %.3g .. %.3g %s", analyzer.sampleRate() * 0.5f, low, high,
+                decibels ? "dB rad^2/Hz" : "rad^2/Hz");
+
+    int counts[Spectrum::MotionCount] = {};
+    // The table scrolls above one line left for the totals
+    ImVec2 table(0.0f, -ImGui::GetTextLineHeightWithSpacing());
+    if (ImGui::BeginTable("spectra", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY, table))
+    {
+        for (const char* header : { "Pendulum", "Peak Hz", "Lines", "Broadband", "Motion" })
+            ImGui::TableSetupColumn(header);
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableHeadersRow();
+        for (size_t p = 0; p < shown; ++p)
+        {
+            Spectrum::Summary s = Spectrum::summarize(analyzer.power(p, c), stride, bins, analyzer.binWidth());
+            // Pendulums that are not double pendulums are never sampled
+            if (s.peak <= 0.0f)
+                continue;
+            ++counts[s.motion];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextColored(ImColor::HSV(std::fmod(p * 0.618034f, 1.0f), 0.6f, 1.0f), "%zu", p);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", s.peak);
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", s.lines);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f%%", s.broadband * 100.0f);
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", Spectrum::name(s.motion));
+        }
+        ImGui::EndTable();
+    }
+    ImGui::Text("%d periodic, %d quasi-periodic, %d chaotic", counts[Spectrum::Periodic],
+                counts[Spectrum::QuasiPeriodic], counts[Spectrum::Chaotic]);
+    ImGui::End();
+}
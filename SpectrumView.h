@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include "Spectrum.h"
+
+// Window showing the live Welch spectra of the watched pendulums, one
+// colour per pendulum, with how each spectrum reads: periodic,
+// quasi-periodic or chaotic.
+struct SpectrumView
+{
+    int channel = Spectrum::Analyzer::Theta1;
+    // Samples per segment; with the rate this sets the resolution
+    int length = 512;
+    int segments = 8;
+    float sampleRate = 50.0f;
+    bool decibels = true;
+    float range = 80.0f;
+    // Spectra computed and drawn, from the first pendulum on
+    int maxCurves = 32;
+    // Seconds between recomputations
+    float refresh = 0.25f;
+
+    // Starts the analyzer afresh for pendulums with the current settings
+    void reset(Spectrum::Analyzer& analyzer, size_t pendulums);
+    // Changing the length, segments or rate starts the analyzer afresh
+    void draw(Spectrum::Analyzer& analyzer, bool* open);
+
+private:
+    std::string status;
+    double computed = -1.0;
+};
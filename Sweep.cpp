@@ -0,0 +1,252 @@
+#include "Sweep.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include "Ensemble.h"
+#include "Physics.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    const char* Names[Sweep::ParameterCount] = { "m1", "m2", "L1", "L2", "g", "damping", "theta1", "theta2" };
+
+    // Per-worker scratch, reused from point to point
+    struct Member
+    {
+        float lastTheta1 = 0, lastTheta2 = 0;
+        double flips = 0;
+        double firstFlip = -1;
+    };
+
+    struct Scratch
+    {
+        Ensemble ensemble;
+        std::vector<Member> members;
+    };
+
+    void observe(const DoubleColumns& c, std::vector<Member>& members, double time, double& maxOmega)
+    {
+        for (size_t i = 0; i < c.count; ++i)
+        {
+            Member& m = members[i];
+            // Angles wrap at the top, so a jump of more than half a turn is an arm going over
+            bool flipped = std::fabs(c.theta1[i] - m.lastTheta1) > (float)M_PI ||
+                           std::fabs(c.theta2[i] - m.lastTheta2) > (float)M_PI;
+            if (flipped)
+            {
+                m.flips += 1;
+                if (m.firstFlip < 0)
+                    m.firstFlip = time;
+            }
+            m.lastTheta1 = c.theta1[i];
+            m.lastTheta2 = c.theta2[i];
+            maxOmega = std::max(maxOmega, (double)std::max(std::fabs(c.omega1[i]), std::fabs(c.omega2[i])));
+        }
+    }
+
+    double totalEnergy(const DoubleColumns& c, double g)
+    {
+        double e = 0;
+        for (size_t i = 0; i < c.count; ++i)
+            e += Physics::energyDouble<double>(c.theta1[i], c.theta2[i], c.omega1[i], c.omega2[i],
+                                               c.m1[i], c.m2[i], c.L1[i], c.L2[i], g);
+        return e / (double)c.count;
+    }
+
+    Sweep::Metrics simulate(const Sweep::Point& point, const Sweep::Options& options, Scratch& scratch)
+    {
+        const double* v = point.values;
+        const float m1 = (float)v[Sweep::Mass1], m2 = (float)v[Sweep::Mass2];
+        const float L1 = (float)v[Sweep::Length1], L2 = (float)v[Sweep::Length2];
+        const float g = (float)v[Sweep::Gravity], damping = (float)v[Sweep::Damping];
+        const float theta1 = (float)v[Sweep::Theta1], theta2 = (float)v[Sweep::Theta2];
+        const size_t n = std::max<size_t>(options.members, 1);
+
+        Ensemble& e = scratch.ensemble;
+        e.clear();
+        e.reserve(0, n);
+        for (size_t i = 0; i < n; ++i)
+            e.addDouble(theta1 + options.spread * (float)i, theta2 + options.spread * (float)i,
+                        0.0f, 0.0f, m1, m2, L1, L2);
+        DoubleColumns c = e.doubles();
+        scratch.members.assign(n, Member());
+        for (size_t i = 0; i < n; ++i)
+        {
+            scratch.members[i].lastTheta1 = c.theta1[i];
+            scratch.members[i].lastTheta2 = c.theta2[i];
+        }
+
+        Sweep::Metrics m;
+        const double e0 = totalEnergy(c, g);
+        const size_t steps = (size_t)std::llround(options.duration / options.dt);
+        const size_t every = std::max<size_t>(options.observeEvery, 1);
+        for (size_t done = 0; done < steps;)
+        {
+            size_t chunk = std::min(every, steps - done);
+            Batch::stepDoubles(c, 0, n, damping, g, options.dt, chunk);
+            done += chunk;
+            observe(c, scratch.members, (double)done * options.dt, m.maxOmega);
+        }
+
+        const double duration = (double)steps * options.dt;
+        double firstFlip = 0;
+        for (const Member& member : scratch.members)
+        {
+            m.flipsMean += member.flips;
+            m.flipsMax = std::max(m.flipsMax, member.flips);
+            firstFlip += member.firstFlip < 0 ? duration : member.firstFlip;
+        }
+        m.flipsMean /= (double)n;
+        m.firstFlip = firstFlip / (double)n;
+
+        // Hanging straight down at rest
+        const double bottom = -((double)m1 + m2) * g * L1 - (double)m2 * g * L2;
+        const double above = e0 - bottom;
+        m.energyLoss = above > 1e-12 ? (e0 - totalEnergy(c, g)) / above : 0.0;
+
+        if (n > 1)
+        {
+            auto bob = [&](size_t i, double& x, double& y)
+            {
+                x = L1 * std::sin(c.theta1[i]) + L2 * std::sin(c.theta2[i]);
+                y = -L1 * std::cos(c.theta1[i]) - L2 * std::cos(c.theta2[i]);
+            };
+            double x0, y0;
+            bob(0, x0, y0);
+            double sum = 0;
+            for (size_t i = 1; i < n; ++i)
+            {
+                double x, y;
+                bob(i, x, y);
+                sum += std::hypot(x - x0, y - y0);
+            }
+            m.divergence = sum / (double)(n - 1) / ((double)L1 + L2);
+        }
+        return m;
+    }
+}
+
+Sweep::Design::Design()
+{
+    ranges[Gravity] = Range{ 9.807, 9.807, 1 };
+    ranges[Damping] = Range{ 0.0, 0.0, 1 };
+    ranges[Theta1] = Range{ 2.0, 2.0, 1 };
+    ranges[Theta2] = Range{ 2.0, 2.0, 1 };
+}
+
+const char* Sweep::name(Parameter p)
+{
+    return p >= 0 && p < ParameterCount ? Names[p] : "?";
+}
+
+std::vector<Sweep::Point> Sweep::expand(const Design& design)
+{
+    std::vector<Point> points;
+    if (design.kind == Design::Cartesian)
+    {
+        size_t total = 1;
+        for (const Range& r : design.ranges)
+            total *= (size_t)std::max(r.levels, 1);
+        points.resize(total);
+        for (size_t i = 0; i < total; ++i)
+        {
+            points[i].index = i;
+            // The last parameter varies fastest
+            size_t rest = i;
+            for (int p = ParameterCount - 1; p >= 0; --p)
+            {
+                const Range& r = design.ranges[p];
+                size_t levels = (size_t)std::max(r.levels, 1);
+                size_t level = rest % levels;
+                rest /= levels;
+                points[i].values[p] = levels == 1 ? r.min : r.min + (r.max - r.min) * (double)level / (double)(levels - 1);
+            }
+        }
+        return points;
+    }
+
+    // Latin hypercube: each parameter's range is cut into samples strata and
+    // every stratum is used exactly once, in a random order per parameter
+    const size_t n = design.samples;
+    points.resize(n);
+    std::mt19937_64 rng(design.seed);
+    std::uniform_real_distribution<double> jitter(0.0, 1.0);
+    std::vector<size_t> strata(n);
+    for (int p = 0; p < ParameterCount; ++p)
+    {
+        const Range& r = design.ranges[p];
+        std::iota(strata.begin(), strata.end(), (size_t)0);
+        std::shuffle(strata.begin(), strata.end(), rng);
+        for (size_t i = 0; i < n; ++i)
+        {
+            points[i].index = i;
+            points[i].values[p] = r.min + (r.max - r.min) * ((double)strata[i] + jitter(rng)) / (double)n;
+        }
+    }
+    return points;
+}
+
+std::vector<Sweep::Result> Sweep::run(const std::vector<Point>& points, const Options& options, ThreadPool& pool,
+                                      const std::function<void(size_t done, size_t total)>& progress)
+{
+    std::vector<Result> results(points.size());
+    std::vector<Scratch> scratch(pool.size());
+    // Points differ a lot in cost (short arms flip more, heavy damping settles),
+    // so workers take them one at a time rather than in fixed ranges
+    std::atomic<size_t> next(0), done(0);
+    pool.run([&](size_t worker, size_t)
+    {
+        for (size_t i = next.fetch_add(1); i < points.size(); i = next.fetch_add(1))
+        {
+            results[i].point = points[i];
+            results[i].metrics = simulate(points[i], options, scratch[worker]);
+            size_t finished = done.fetch_add(1) + 1;
+            if (worker == 0 && progress)
+                progress(finished, points.size());
+        }
+    });
+    return results;
+}
+
+void Sweep::writeCsvHeader(std::ostream& out)
+{
+    out << "index";
+    for (const char* n : Names)
+        out << ',' << n;
+    out << ",flips_mean,flips_max,first_flip,energy_loss,max_omega,divergence\n";
+}
+
+void Sweep::writeCsvRow(std::ostream& out, const Result& result)
+{
+    char line[512];
+    const double* v = result.point.values;
+    const Metrics& m = result.metrics;
+    std::snprintf(line, sizeof(line), "%zu,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n",
+                  result.point.index, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7],
+                  m.flipsMean, m.flipsMax, m.firstFlip, m.energyLoss, m.maxOmega, m.divergence);
+    out << line;
+}
+
+bool Sweep::writeCsv(const std::string& path, const std::vector<Result>& results, std::string& error)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+    {
+        error = "Cannot create " + path;
+        return false;
+    }
+    writeCsvHeader(out);
+    for (const Result& r : results)
+        writeCsvRow(out, r);
+    if (!out)
+    {
+        error = "Cannot write " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "Range.h"
+
+class ThreadPool;
+
+// Parameter sweeps over double pendulums. A design spans masses, lengths,
+// gravity, damping and the starting angles, either as a Cartesian grid or
+// a Latin hypercube; a grid over the angles alone is a flip-time fractal.
+// Every point runs a small ensemble started from nearby angles on the
+// batch kernels, with points spread over a thread pool, and reduces it to
+// a row of metrics.
+namespace Sweep
+{
+    enum Parameter
+    {
+        Mass1, Mass2, Length1, Length2, Gravity, Damping, Theta1, Theta2, ParameterCount
+    };
+
+    struct Design
+    {
+        enum Kind
+        {
+            Cartesian, LatinHypercube
+        };
+
+        Kind kind = Cartesian;
+        Range ranges[ParameterCount];
+        // Latin hypercube points
+        size_t samples = 64;
+        uint64_t seed = 1;
+
+        Design();
+    };
+
+    struct Point
+    {
+        size_t index = 0;
+        double values[ParameterCount] = {};
+    };
+
+    struct Options
+    {
+        // Members start spread radians apart from the point's angles
+        float spread = 1e-3f;
+        size_t members = 16;
+        float dt = 0.001f;
+        double duration = 20.0;
+        // Steps between looks at the state for flips and peak velocity
+        size_t observeEvery = 5;
+    };
+
+    struct Metrics
+    {
+        // Times either arm went over the top, per member
+        double flipsMean = 0, flipsMax = 0;
+        // Mean time to the first flip, the duration for members that never flip
+        double firstFlip = 0;
+        // Fraction of the energy above the resting state lost by the end
+        double energyLoss = 0;
+        double maxOmega = 0;
+        // Mean final distance of the outer bobs from the first member's, over the arm length
+        double divergence = 0;
+    };
+
+    struct Result
+    {
+        Point point;
+        Metrics metrics;
+    };
+
+    const char* name(Parameter p);
+
+    std::vector<Point> expand(const Design& design);
+
+    // Runs the points on the pool; progress, if set, is called from the
+    // calling thread with the number of finished points.
+    std::vector<Result> run(const std::vector<Point>& points, const Options& options, ThreadPool& pool,
+                            const std::function<void(size_t done, size_t total)>& progress = nullptr);
+
+    void writeCsvHeader(std::ostream& out);
+    void writeCsvRow(std::ostream& out, const Result& result);
+    bool writeCsv(const std::string& path, const std::vector<Result>& results, std::string& error);
+}
@@ -0,0 +1,667 @@
+#include "SweepCluster.h"
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+
+bool SweepCluster::coordinate(const std::vector<Sweep::Point>&, const Sweep::Options&, const CoordinatorOptions&,
+                              std::vector<Sweep::Result>&, std::string& error)
+{
+    error = "Cluster sweeps need POSIX sockets";
+    return false;
+}
+
+bool SweepCluster::work(const WorkerOptions&, ThreadPool&, std::string& error)
+{
+    error = "Cluster sweeps need POSIX sockets";
+    return false;
+}
+
+#else
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+#ifdef MSG_NOSIGNAL
+    const int SendFlags = MSG_NOSIGNAL;
+#else
+    const int SendFlags = 0;
+#endif
+
+    struct Address
+    {
+        bool local = false;
+        std::string path;
+        std::string host, port;
+    };
+
+    bool parseAddress(const std::string& text, Address& a, std::string& error)
+    {
+        if (text.compare(0, 5, "unix:") == 0 || text.find('/') != std::string::npos)
+        {
+            a.local = true;
+            a.path = text.compare(0, 5, "unix:") == 0 ? text.substr(5) : text;
+            if (a.path.empty() || a.path.size() >= sizeof(sockaddr_un().sun_path))
+            {
+                error = "Bad socket path " + a.path;
+                return false;
+            }
+            return true;
+        }
+        size_t colon = text.rfind(':');
+        if (colon == std::string::npos || colon + 1 == text.size())
+        {
+            error = "Bad address " + text + ", expected unix:/path or host:port";
+            return false;
+        }
+        a.host = text.substr(0, colon);
+        a.port = text.substr(colon + 1);
+        return true;
+    }
+
+    void configure(int fd)
+    {
+#ifdef SO_NOSIGPIPE
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        // A peer that stops reading must not stall the other end for good
+        timeval tv = { 30, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+
+    int listenOn(const Address& a, std::string& error)
+    {
+        if (a.local)
+        {
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un sa = {};
+            sa.sun_family = AF_UNIX;
+            std::strncpy(sa.sun_path, a.path.c_str(), sizeof(sa.sun_path) - 1);
+            // A socket file left by a coordinator that did not shut down
+            unlink(a.path.c_str());
+            if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0 || listen(fd, 64) != 0)
+            {
+                error = "Cannot listen on " + a.path + ": " + std::strerror(errno);
+                if (fd >= 0)
+                    close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* list = nullptr;
+        if (getaddrinfo(a.host.empty() ? nullptr : a.host.c_str(), a.port.c_str(), &hints, &list) != 0)
+        {
+            error = "Cannot resolve " + a.host + ":" + a.port;
+            return -1;
+        }
+        int fd = -1;
+        for (addrinfo* ai = list; ai && fd < 0; ai = ai->ai_next)
+        {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0)
+                continue;
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, 64) != 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(list);
+        if (fd < 0)
+            error = "Cannot listen on " + a.host + ":" + a.port + ": " + std::strerror(errno);
+        return fd;
+    }
+
+    int connectTo(const Address& a)
+    {
+        if (a.local)
+        {
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un sa = {};
+            sa.sun_family = AF_UNIX;
+            std::strncpy(sa.sun_path, a.path.c_str(), sizeof(sa.sun_path) - 1);
+            if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) != 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+            return fd;
+        }
+
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* list = nullptr;
+        if (getaddrinfo(a.host.c_str(), a.port.c_str(), &hints, &list) != 0)
+            return -1;
+        int fd = -1;
+        for (addrinfo* ai = list; ai && fd < 0; ai = ai->ai_next)
+        {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(list);
+        if (fd >= 0)
+        {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        return fd;
+    }
+
+    bool sendAll(int fd, const std::string& data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, SendFlags);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            sent += (size_t)n;
+        }
+        return true;
+    }
+
+    // Splits a whole message off the front of inbox: the header line plus
+    // the count lines that SHARD and RESULT announce. False until all of it
+    // has arrived.
+    bool takeMessage(std::string& inbox, std::vector<std::string>& lines)
+    {
+        size_t eol = inbox.find('\n');
+        if (eol == std::string::npos)
+            return false;
+        std::string header = inbox.substr(0, eol);
+        size_t extra = 0;
+        char kind[16] = {};
+        unsigned long long id = 0, count = 0;
+        if (std::sscanf(header.c_str(), "%15s %llu %llu", kind, &id, &count) == 3 &&
+            (std::strcmp(kind, "SHARD") == 0 || std::strcmp(kind, "RESULT") == 0))
+            extra = (size_t)count;
+
+        size_t end = eol + 1;
+        for (size_t i = 0; i < extra; ++i)
+        {
+            size_t next = inbox.find('\n', end);
+            if (next == std::string::npos)
+                return false;
+            end = next + 1;
+        }
+
+        lines.clear();
+        for (size_t pos = 0; pos < end;)
+        {
+            size_t next = inbox.find('\n', pos);
+            lines.push_back(inbox.substr(pos, next - pos));
+            pos = next + 1;
+        }
+        inbox.erase(0, end);
+        return true;
+    }
+
+    struct Shard
+    {
+        size_t begin = 0, end = 0;
+        bool done = false;
+        // Workers running it right now; more than one once it has a backup copy
+        std::vector<size_t> holders;
+        Clock::time_point started;
+    };
+
+    struct Peer
+    {
+        int fd = -1;
+        std::string name;
+        std::string inbox;
+        // Shard being run, or -1
+        long shard = -1;
+        bool idle = false;
+        Clock::time_point since;
+    };
+
+    class Coordinator
+    {
+    public:
+        Coordinator(const std::vector<Sweep::Point>& points, const Sweep::Options& options,
+                    const SweepCluster::CoordinatorOptions& settings, std::vector<Sweep::Result>& results)
+            : points(points), options(options), settings(settings), results(results)
+        {
+            size_t size = std::max<size_t>(settings.shardSize, 1);
+            for (size_t b = 0; b < points.size(); b += size)
+            {
+                Shard s;
+                s.begin = b;
+                s.end = std::min(points.size(), b + size);
+                queue.push_back(shards.size());
+                shards.push_back(s);
+            }
+            results.assign(points.size(), Sweep::Result());
+        }
+
+        ~Coordinator()
+        {
+            for (Peer& p : peers)
+                if (p.fd >= 0)
+                    close(p.fd);
+        }
+
+        bool serve(int listener)
+        {
+            std::vector<pollfd> fds;
+            std::vector<std::string> lines;
+            while (completed < shards.size())
+            {
+                fds.clear();
+                fds.push_back(pollfd{ listener, POLLIN, 0 });
+                for (const Peer& p : peers)
+                    fds.push_back(pollfd{ p.fd, POLLIN, 0 });
+                // Wake up every second to look for workers past the timeout
+                if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR)
+                    return false;
+
+                for (size_t i = 1; i < fds.size(); ++i)
+                {
+                    size_t id = i - 1;
+                    if (!fds[i].revents || peers[id].fd < 0)
+                        continue;
+                    char buffer[65536];
+                    ssize_t n = recv(peers[id].fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                        continue;
+                    if (n <= 0)
+                    {
+                        drop(id, "disconnected");
+                        continue;
+                    }
+                    peers[id].inbox.append(buffer, (size_t)n);
+                    while (peers[id].fd >= 0 && takeMessage(peers[id].inbox, lines))
+                        handle(id, lines);
+                }
+
+                if (fds[0].revents & POLLIN)
+                {
+                    int fd = accept(listener, nullptr, nullptr);
+                    if (fd >= 0)
+                    {
+                        configure(fd);
+                        Peer p;
+                        p.fd = fd;
+                        p.name = "?";
+                        peers.push_back(p);
+                    }
+                }
+
+                if (settings.timeout > 0.0)
+                {
+                    Clock::time_point now = Clock::now();
+                    for (size_t id = 0; id < peers.size(); ++id)
+                        if (peers[id].fd >= 0 && peers[id].shard >= 0 &&
+                            std::chrono::duration<double>(now - peers[id].since).count() > settings.timeout)
+                            drop(id, "timed out");
+                }
+
+                // Forget closed connections; ids are only held within one pass
+                peers.erase(std::remove_if(peers.begin(), peers.end(), [](const Peer& p) { return p.fd < 0; }),
+                            peers.end());
+                for (Shard& s : shards)
+                    s.holders.clear();
+                for (size_t id = 0; id < peers.size(); ++id)
+                    if (peers[id].shard >= 0)
+                        shards[(size_t)peers[id].shard].holders.push_back(id);
+            }
+
+            // Idle workers hear DONE; ones still running a backup copy just see the socket close
+            for (Peer& p : peers)
+                if (p.fd >= 0 && p.idle)
+                    sendAll(p.fd, "DONE\n");
+            return true;
+        }
+
+    private:
+        void log(const std::string& message)
+        {
+            if (settings.log)
+                settings.log(message);
+        }
+
+        void handle(size_t id, const std::vector<std::string>& lines)
+        {
+            Peer& p = peers[id];
+            char kind[16] = {};
+            char name[128] = {};
+            unsigned long long shard = 0, count = 0, threads = 0;
+            if (std::sscanf(lines[0].c_str(), "%15s", kind) != 1)
+            {
+                drop(id, "sent garbage");
+                return;
+            }
+            if (std::strcmp(kind, "HELLO") == 0 && std::sscanf(lines[0].c_str(), "HELLO %127s %llu", name, &threads) == 2)
+            {
+                p.name = name;
+                log("Worker " + p.name + " joined with " + std::to_string(threads) + " threads");
+                assign(id);
+            }
+            else if (std::strcmp(kind, "RESULT") == 0 && p.shard >= 0 &&
+                     std::sscanf(lines[0].c_str(), "RESULT %llu %llu", &shard, &count) == 2 &&
+                     shard == (unsigned long long)p.shard)
+            {
+                Shard& s = shards[(size_t)shard];
+                if (!s.done)
+                {
+                    if (!store(s, lines))
+                    {
+                        drop(id, "sent a bad result");
+                        return;
+                    }
+                    s.done = true;
+                    ++completed;
+                    log(std::to_string(completed) + " / " + std::to_string(shards.size()) + " shards");
+                }
+                unhold(id);
+                assign(id);
+            }
+            else
+            {
+                drop(id, "sent an unexpected message");
+            }
+        }
+
+        bool store(const Shard& s, const std::vector<std::string>& lines)
+        {
+            if (lines.size() != 1 + (s.end - s.begin))
+                return false;
+            for (size_t i = 1; i < lines.size(); ++i)
+            {
+                unsigned long long index = 0;
+                Sweep::Metrics m;
+                if (std::sscanf(lines[i].c_str(), "%llu %lf %lf %lf %lf %lf %lf", &index, &m.flipsMean, &m.flipsMax,
+                                &m.firstFlip, &m.energyLoss, &m.maxOmega, &m.divergence) != 7 ||
+                    index < s.begin || index >= s.end)
+                    return false;
+                results[index].point = points[index];
+                results[index].metrics = m;
+            }
+            return true;
+        }
+
+        void unhold(size_t id)
+        {
+            Peer& p = peers[id];
+            if (p.shard >= 0)
+            {
+                std::vector<size_t>& holders = shards[(size_t)p.shard].holders;
+                holders.erase(std::remove(holders.begin(), holders.end(), id), holders.end());
+            }
+            p.shard = -1;
+        }
+
+        void drop(size_t id, const char* why)
+        {
+            Peer& p = peers[id];
+            long shard = p.shard;
+            unhold(id);
+            close(p.fd);
+            p.fd = -1;
+            p.idle = false;
+            if (shard >= 0 && !shards[(size_t)shard].done && shards[(size_t)shard].holders.empty())
+            {
+                // Nobody else is on it, so it goes next
+                queue.push_front((size_t)shard);
+                log("Worker " + p.name + " " + why + ", shard " + std::to_string(shard) + " requeued");
+                for (size_t other = 0; other < peers.size(); ++other)
+                    if (peers[other].fd >= 0 && peers[other].idle)
+                        assign(other);
+            }
+            else
+            {
+                log("Worker " + p.name + " " + why);
+            }
+        }
+
+        // Next shard for a worker: the queue first, then a backup copy of
+        // the longest-running shard that has only one worker on it
+        void assign(size_t id)
+        {
+            Peer& p = peers[id];
+            p.idle = false;
+            if (completed == shards.size())
+            {
+                p.idle = true;
+                return;
+            }
+            long next = -1;
+            while (!queue.empty() && next < 0)
+            {
+                size_t s = queue.front();
+                queue.pop_front();
+                if (!shards[s].done)
+                    next = (long)s;
+            }
+            if (next < 0)
+            {
+                for (size_t s = 0; s < shards.size(); ++s)
+                    if (!shards[s].done && shards[s].holders.size() == 1 &&
+                        (next < 0 || shards[s].started < shards[(size_t)next].started))
+                        next = (long)s;
+                if (next >= 0)
+                    log("Worker " + p.name + " takes a backup copy of shard " + std::to_string(next));
+            }
+            if (next < 0)
+            {
+                // Woken up again if a shard is requeued
+                p.idle = true;
+                return;
+            }
+
+            Shard& s = shards[(size_t)next];
+            char line[256];
+            std::snprintf(line, sizeof(line), "SHARD %ld %zu %zu %.17g %.17g %.17g %zu\n", next, s.end - s.begin,
+                          options.members, (double)options.spread, (double)options.dt, options.duration,
+                          options.observeEvery);
+            std::string message = line;
+            for (size_t i = s.begin; i < s.end; ++i)
+            {
+                std::snprintf(line, sizeof(line), "%zu", i);
+                message += line;
+                for (double v : points[i].values)
+                {
+                    std::snprintf(line, sizeof(line), " %.17g", v);
+                    message += line;
+                }
+                message += '\n';
+            }
+            if (s.holders.empty())
+                s.started = Clock::now();
+            s.holders.push_back(id);
+            p.shard = next;
+            p.since = Clock::now();
+            if (!sendAll(p.fd, message))
+                drop(id, "disconnected");
+        }
+
+        const std::vector<Sweep::Point>& points;
+        const Sweep::Options& options;
+        const SweepCluster::CoordinatorOptions& settings;
+        std::vector<Sweep::Result>& results;
+        std::vector<Shard> shards;
+        std::deque<size_t> queue;
+        std::vector<Peer> peers;
+        size_t completed = 0;
+    };
+
+    class LineReader
+    {
+    public:
+        explicit LineReader(int fd) : fd(fd) {}
+
+        // False once the other end has closed
+        bool next(std::string& line)
+        {
+            while (true)
+            {
+                size_t eol = inbox.find('\n', pos);
+                if (eol != std::string::npos)
+                {
+                    line.assign(inbox, pos, eol - pos);
+                    pos = eol + 1;
+                    return true;
+                }
+                inbox.erase(0, pos);
+                pos = 0;
+                char buffer[65536];
+                ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                inbox.append(buffer, (size_t)n);
+            }
+        }
+
+    private:
+        int fd;
+        std::string inbox;
+        size_t pos = 0;
+    };
+}
+
+bool SweepCluster::coordinate(const std::vector<Sweep::Point>& points, const Sweep::Options& options,
+                              const CoordinatorOptions& coordinator, std::vector<Sweep::Result>& results,
+                              std::string& error)
+{
+    Address address;
+    if (!parseAddress(coordinator.address, address, error))
+        return false;
+    int listener = listenOn(address, error);
+    if (listener < 0)
+        return false;
+
+    bool ok;
+    {
+        Coordinator c(points, options, coordinator, results);
+        ok = c.serve(listener);
+    }
+    close(listener);
+    if (address.local)
+        unlink(address.path.c_str());
+    if (!ok)
+        error = std::string("Coordinator failed: ") + std::strerror(errno);
+    return ok;
+}
+
+bool SweepCluster::work(const WorkerOptions& worker, ThreadPool& pool, std::string& error)
+{
+    Address address;
+    if (!parseAddress(worker.address, address, error))
+        return false;
+
+    Clock::time_point start = Clock::now();
+    int fd = connectTo(address);
+    while (fd < 0 && std::chrono::duration<double>(Clock::now() - start).count() < worker.connectTimeout)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        fd = connectTo(address);
+    }
+    if (fd < 0)
+    {
+        error = "Cannot connect to " + worker.address;
+        return false;
+    }
+    configure(fd);
+
+    std::string name = worker.name;
+    if (name.empty())
+    {
+        char host[64] = {};
+        gethostname(host, sizeof(host) - 1);
+        name = std::string(host) + "/" + std::to_string((long)getpid());
+    }
+    std::replace(name.begin(), name.end(), ' ', '_');
+
+    LineReader reader(fd);
+    std::string message = "HELLO " + name + " " + std::to_string(pool.size()) + "\n";
+    std::string line;
+    std::vector<Sweep::Point> points;
+    char text[256];
+    bool ok = true;
+    // The coordinator closing on us means the sweep is finished
+    while (sendAll(fd, message) && reader.next(line))
+    {
+        if (line == "DONE")
+            break;
+        unsigned long long shard = 0, count = 0, members = 0, every = 0;
+        double spread = 0, dt = 0, duration = 0;
+        if (std::sscanf(line.c_str(), "SHARD %llu %llu %llu %lf %lf %lf %llu", &shard, &count, &members, &spread,
+                        &dt, &duration, &every) != 7)
+        {
+            error = "Unexpected message from the coordinator: " + line;
+            ok = false;
+            break;
+        }
+        Sweep::Options options;
+        options.members = (size_t)members;
+        options.spread = (float)spread;
+        options.dt = (float)dt;
+        options.duration = duration;
+        options.observeEvery = (size_t)every;
+
+        points.assign((size_t)count, Sweep::Point());
+        size_t received = 0;
+        for (Sweep::Point& p : points)
+        {
+            if (!reader.next(line))
+                break;
+            ++received;
+            char* s = const_cast<char*>(line.c_str());
+            p.index = (size_t)std::strtoull(s, &s, 10);
+            for (double& v : p.values)
+                v = std::strtod(s, &s);
+        }
+        if (received < points.size())
+            break;
+
+        std::vector<Sweep::Result> results = Sweep::run(points, options, pool);
+        std::snprintf(text, sizeof(text), "RESULT %llu %llu\n", shard, count);
+        message = text;
+        for (const Sweep::Result& r : results)
+        {
+            const Sweep::Metrics& m = r.metrics;
+            std::snprintf(text, sizeof(text), "%zu %.17g %.17g %.17g %.17g %.17g %.17g\n", r.point.index,
+                          m.flipsMean, m.flipsMax, m.firstFlip, m.energyLoss, m.maxOmega, m.divergence);
+            message += text;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Sweep.h"
+
+class ThreadPool;
+
+// Sweeps split across processes. The coordinator cuts the points into
+// shards and listens on a Unix socket ("unix:/path", or any address with a
+// slash) or TCP ("host:port") for workers on other machines. Workers pull
+// one shard at a time, run it with Sweep::run on their own thread pool and
+// send the metrics back; the coordinator merges them by point index.
+//
+// A worker whose connection drops, or that sits on a shard past the
+// timeout, is dropped and its shard goes back to the front of the queue.
+// Once the queue is empty, workers that ask for more get a second copy of
+// the oldest shard still running elsewhere, so one slow machine cannot hold
+// up the end of a sweep; whichever copy finishes first is kept.
+//
+// The protocol is line-based text, one message per exchange:
+//   worker:      HELLO <name> <threads>
+//   coordinator: SHARD <id> <count> <members> <spread> <dt> <duration> <observeEvery>
+//                then count lines of <index> <parameter values>
+//                or DONE
+//   worker:      RESULT <id> <count>, then count lines of <index> <metrics>
+// and the worker sends RESULT in place of HELLO for every later shard.
+// Sockets need POSIX; elsewhere both ends fail with an error.
+namespace SweepCluster
+{
+    struct CoordinatorOptions
+    {
+        std::string address;
+        size_t shardSize = 256;
+        // Seconds a worker may hold a shard before it is presumed lost, 0 to wait forever
+        double timeout = 600.0;
+        // Worker joins, losses and progress, for the log
+        std::function<void(const std::string& message)> log;
+    };
+
+    struct WorkerOptions
+    {
+        std::string address;
+        std::string name;
+        // Seconds to keep trying while the coordinator is not up yet
+        double connectTimeout = 10.0;
+    };
+
+    // Serves every point and returns once all results are in; results come back by index.
+    bool coordinate(const std::vector<Sweep::Point>& points, const Sweep::Options& options,
+                    const CoordinatorOptions& coordinator, std::vector<Sweep::Result>& results, std::string& error);
+
+    // Runs shards until the coordinator says DONE or goes away.
+    bool work(const WorkerOptions& worker, ThreadPool& pool, std::string& error);
+}
@@ -0,0 +1,86 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <string>
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0)
+        threads = hardwareThreads();
+    for (size_t i = 1; i < threads; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers)
+        t.join();
+}
+
+size_t ThreadPool::hardwareThreads()
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+void ThreadPool::run(const std::function<void(size_t worker, size_t workers)>& job)
+{
+    if (workers.empty())
+    {
+        job(0, 1);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = &job;
+        pending = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    job(0, size());
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return pending == 0; });
+    current = nullptr;
+}
+
+void ThreadPool::forRanges(size_t count, const std::function<void(size_t begin, size_t end)>& job)
+{
+    run([&](size_t worker, size_t workers) {
+        size_t begin = count * worker / workers;
+        size_t end = count * (worker + 1) / workers;
+        if (begin < end)
+            job(begin, end);
+    });
+}
+
+void ThreadPool::workerLoop(size_t worker)
+{
+#if PENDULUM_TRACE
+    std::string name = "Pool worker " + std::to_string(worker);
+    TRACE_THREAD(name.c_str());
+#endif
+    uint64_t seen = 0;
+    while (true)
+    {
+        const std::function<void(size_t, size_t)>* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            job = current;
+        }
+        (*job)(worker, size());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+}
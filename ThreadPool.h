@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool: run() hands the same job to every worker, with the
+// calling thread taking part as worker 0, and returns when all of them are
+// done. Workers sleep between jobs, so a pool can live for a whole run.
+class ThreadPool
+{
+public:
+    // threads counts the caller; 0 uses every hardware thread
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size() + 1; }
+
+    // Calls job(worker, size()) once on each worker.
+    void run(const std::function<void(size_t worker, size_t workers)>& job);
+    // Splits [0, count) into one contiguous range per worker.
+    void forRanges(size_t count, const std::function<void(size_t begin, size_t end)>& job);
+
+    static size_t hardwareThreads();
+
+private:
+    void workerLoop(size_t worker);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const std::function<void(size_t, size_t)>* current = nullptr;
+    uint64_t generation = 0;
+    size_t pending = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,165 @@
+// Bifurcation diagrams of the driven damped pendulum from the command line.
+//
+// --columns drive amplitudes from --amplitude=min:max each run --starts
+// pendulums through --transient drive periods, then strobe --samples
+// periods, on the batch kernels over --threads workers (Bifurcation.h).
+// The diagram of --plot (theta or omega) against amplitude goes to --image
+// as a binary PGM, --columns wide and --height tall, and every strobed
+// state to --csv.
+//
+//   BifurcationDiagram [--amplitude=0.9:1.5] [--columns=4000] [--starts=1]
+//                      [--frequency=0.6667] [--damping=0.5] [--g=1] [--L=1]
+//                      [--theta0=0.2] [--omega0=0] [--steps-per-period=200]
+//                      [--transient=300] [--samples=200] [--threads=0]
+//                      [--image=bifurcation.pgm] [--height=1200] [--plot=omega]
+//                      [--csv=bifurcation.csv] [--isa=sse2|avx2|avx512]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "Bifurcation.h"
+#include "Cpu.h"
+#include "Range.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    struct Options
+    {
+        Bifurcation::Options diagram;
+        size_t threads = 0;
+        std::string image = "bifurcation.pgm";
+        size_t height = 1200;
+        Bifurcation::Variable plot = Bifurcation::Omega;
+        std::string csv;
+    };
+
+    bool parse(int argc, char** argv, Options& o)
+    {
+        Bifurcation::Options& d = o.diagram;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](const char* key) -> const char* {
+                size_t len = std::strlen(key);
+                return arg.compare(0, len, key) == 0 ? arg.c_str() + len : nullptr;
+            };
+            std::string error;
+            try
+            {
+                if (const char* v = value("--amplitude="))
+                {
+                    Range range;
+                    if (!parseRange(v, range, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                    d.amplitudeMin = range.min;
+                    d.amplitudeMax = range.max;
+                }
+                else if (const char* v = value("--columns="))
+                    d.columns = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--starts="))
+                    d.starts = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--frequency="))
+                    d.frequency = std::stof(v);
+                else if (const char* v = value("--damping="))
+                    d.damping = std::stof(v);
+                else if (const char* v = value("--g="))
+                    d.g = std::stof(v);
+                else if (const char* v = value("--L="))
+                    d.L = std::stof(v);
+                else if (const char* v = value("--theta0="))
+                    d.theta0 = std::stof(v);
+                else if (const char* v = value("--omega0="))
+                    d.omega0 = std::stof(v);
+                else if (const char* v = value("--steps-per-period="))
+                    d.stepsPerPeriod = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--transient="))
+                    d.transient = std::stoull(v);
+                else if (const char* v = value("--samples="))
+                    d.samples = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--threads="))
+                    o.threads = std::stoull(v);
+                else if (const char* v = value("--image="))
+                    o.image = v;
+                else if (const char* v = value("--height="))
+                    o.height = std::max<size_t>(2, std::stoull(v));
+                else if (const char* v = value("--plot="))
+                {
+                    std::string plot = v;
+                    if (plot == "theta")
+                        o.plot = Bifurcation::Theta;
+                    else if (plot == "omega")
+                        o.plot = Bifurcation::Omega;
+                    else
+                    {
+                        std::fprintf(stderr, "Unknown plot %s, expected theta or omega\n", v);
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--csv="))
+                    o.csv = v;
+                else if (const char* v = value("--isa="))
+                {
+                    if (!Cpu::setLevel(v, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else
+                {
+                    std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::fprintf(stderr, "Bad value in %s\n", arg.c_str());
+                return false;
+            }
+        }
+        if (!(d.frequency > 0.0f))
+        {
+            std::fprintf(stderr, "--frequency must be positive\n");
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+        return 1;
+
+    const Bifurcation::Options& d = options.diagram;
+    ThreadPool pool(options.threads);
+    std::fprintf(stderr, "Kernels: %s\n", Cpu::report().c_str());
+    std::fprintf(stderr, "%zu columns x %zu starts, %zu + %zu periods of %zu steps on %zu threads\n", d.columns,
+                 d.starts, d.transient, d.samples, d.stepsPerPeriod, pool.size());
+
+    auto start = std::chrono::steady_clock::now();
+    Bifurcation::Diagram diagram = Bifurcation::run(d, pool);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double steps = (double)d.columns * d.starts * (d.transient + d.samples) * d.stepsPerPeriod;
+    std::fprintf(stderr, "%.2f s, %.1f M pendulum steps/s\n", seconds, steps / seconds * 1e-6);
+
+    std::string error;
+    if (!options.image.empty() && !Bifurcation::writeImage(diagram, options.plot, options.height, options.image, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if (!options.csv.empty() && !Bifurcation::writeCsv(diagram, options.csv, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
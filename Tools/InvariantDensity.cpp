@@ -0,0 +1,329 @@
+// Invariant densities of double pendulum ensembles from the command line.
+//
+// The pendulums start from rest on a square grid over --theta1 x --theta2
+// and run --duration seconds on the batch kernels, spread over --threads
+// workers in contiguous ranges. After every step each state is binned into
+// the worker's own copy of the histogram over --axes (Density.h), so the
+// workers never touch shared counts; the copies are merged every --merge
+// steps. Angles bin over [-pi, pi] and velocities over --omega1 and
+// --omega2, --bins per axis.
+//
+// --dump writes the merged counts with their binning, --image the --plot
+// projection of them as a log-scaled PGM.
+//
+//   InvariantDensity [--pendulums=1000000] [--theta1=-3:3] [--theta2=-3:3]
+//                    [--m1=1] [--m2=1] [--L1=1] [--L2=1] [--g=9.807] [--damping=0]
+//                    [--axes=theta1:theta2[:omega1[:omega2]]] [--bins=512|128|32]
+//                    [--omega1=-15:15] [--omega2=-15:15] [--duration=10] [--dt=0.001]
+//                    [--merge=100] [--threads=0] [--dump=density.hist]
+//                    [--image=density.pgm] [--plot=theta1:theta2] [--isa=sse2|avx2|avx512]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Cpu.h"
+#include "Density.h"
+#include "Ensemble.h"
+#include "ImageFile.h"
+#include "Range.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    struct Options
+    {
+        size_t pendulums = 1000000;
+        Range theta1, theta2;
+        float m1 = 1.0f, m2 = 1.0f, L1 = 1.0f, L2 = 1.0f, g = 9.807f, damping = 0.0f;
+        Density::Binning binning;
+        Range omega1, omega2;
+        uint32_t bins = 0;
+        double duration = 10.0;
+        float dt = 0.001f;
+        size_t merge = 100;
+        size_t threads = 0;
+        std::string dump, image;
+        int x = 0, y = 1;
+
+        Options()
+        {
+            theta1.min = theta2.min = -3.0;
+            theta1.max = theta2.max = 3.0;
+            omega1.min = omega2.min = -15.0;
+            omega1.max = omega2.max = 15.0;
+        }
+    };
+
+    bool parseVariable(const std::string& text, Density::Variable& v)
+    {
+        for (int i = 0; i < Density::VariableCount; ++i)
+            if (text == Density::name((Density::Variable)i))
+            {
+                v = (Density::Variable)i;
+                return true;
+            }
+        return false;
+    }
+
+    // Colon separated variable names, at most four
+    bool parseVariables(const std::string& text, Density::Variable* out, int& count)
+    {
+        count = 0;
+        size_t start = 0;
+        while (true)
+        {
+            size_t colon = text.find(':', start);
+            if (count == Density::VariableCount || !parseVariable(text.substr(start, colon - start), out[count++]))
+                return false;
+            if (colon == std::string::npos)
+                return true;
+            start = colon + 1;
+        }
+    }
+
+    bool parse(int argc, char** argv, Options& o)
+    {
+        Density::Variable plot[Density::VariableCount];
+        int plotted = 0;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](const char* key) -> const char* {
+                size_t len = std::strlen(key);
+                return arg.compare(0, len, key) == 0 ? arg.c_str() + len : nullptr;
+            };
+            std::string error;
+            try
+            {
+                if (const char* v = value("--pendulums="))
+                    o.pendulums = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--theta1="))
+                {
+                    if (!parseRange(v, o.theta1, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--theta2="))
+                {
+                    if (!parseRange(v, o.theta2, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--m1="))
+                    o.m1 = std::stof(v);
+                else if (const char* v = value("--m2="))
+                    o.m2 = std::stof(v);
+                else if (const char* v = value("--L1="))
+                    o.L1 = std::stof(v);
+                else if (const char* v = value("--L2="))
+                    o.L2 = std::stof(v);
+                else if (const char* v = value("--g="))
+                    o.g = std::stof(v);
+                else if (const char* v = value("--damping="))
+                    o.damping = std::stof(v);
+                else if (const char* v = value("--axes="))
+                {
+                    Density::Variable axes[Density::VariableCount];
+                    if (!parseVariables(v, axes, o.binning.dimensions))
+                    {
+                        std::fprintf(stderr, "Bad axes %s, expected two to four of theta1, theta2, omega1, omega2\n", v);
+                        return false;
+                    }
+                    for (int k = 0; k < o.binning.dimensions; ++k)
+                        o.binning.axes[k].variable = axes[k];
+                }
+                else if (const char* v = value("--bins="))
+                    o.bins = (uint32_t)std::max(1, std::stoi(v));
+                else if (const char* v = value("--omega1="))
+                {
+                    if (!parseRange(v, o.omega1, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--omega2="))
+                {
+                    if (!parseRange(v, o.omega2, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--duration="))
+                    o.duration = std::stod(v);
+                else if (const char* v = value("--dt="))
+                    o.dt = std::stof(v);
+                else if (const char* v = value("--merge="))
+                    o.merge = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--threads="))
+                    o.threads = std::stoull(v);
+                else if (const char* v = value("--dump="))
+                    o.dump = v;
+                else if (const char* v = value("--image="))
+                    o.image = v;
+                else if (const char* v = value("--plot="))
+                {
+                    if (!parseVariables(v, plot, plotted) || plotted != 2 || plot[0] == plot[1])
+                    {
+                        std::fprintf(stderr, "Bad plot %s, expected two different axes as x:y\n", v);
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--isa="))
+                {
+                    if (!Cpu::setLevel(v, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else
+                {
+                    std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::fprintf(stderr, "Bad value in %s\n", arg.c_str());
+                return false;
+            }
+        }
+        if (!(o.dt > 0.0f))
+        {
+            std::fprintf(stderr, "--dt must be positive\n");
+            return false;
+        }
+
+        // Fewer bins per axis the more axes, so the copies stay a few MB
+        const uint32_t bins = o.bins ? o.bins : o.binning.dimensions == 2 ? 512 : o.binning.dimensions == 3 ? 128 : 32;
+        for (int k = 0; k < o.binning.dimensions; ++k)
+        {
+            Density::Axis& axis = o.binning.axes[k];
+            axis.bins = bins;
+            if (axis.variable == Density::Omega1 || axis.variable == Density::Omega2)
+            {
+                const Range& range = axis.variable == Density::Omega1 ? o.omega1 : o.omega2;
+                axis.min = (float)range.min;
+                axis.max = (float)range.max;
+            }
+            else
+            {
+                axis.min = -3.14159265f;
+                axis.max = 3.14159265f;
+            }
+        }
+        for (int p = 0; p < plotted; ++p)
+        {
+            int& axis = p ? o.y : o.x;
+            axis = -1;
+            for (int k = 0; k < o.binning.dimensions; ++k)
+                if (o.binning.axes[k].variable == plot[p])
+                    axis = k;
+            if (axis < 0)
+            {
+                std::fprintf(stderr, "--plot %s is not one of --axes\n", Density::name(plot[p]));
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void populate(const Options& o, Ensemble& ensemble)
+    {
+        const size_t side = (size_t)std::ceil(std::sqrt((double)o.pendulums));
+        ensemble.reserve(0, o.pendulums);
+        for (size_t i = 0; i < o.pendulums; ++i)
+        {
+            double u = side > 1 ? (double)(i % side) / (side - 1) : 0.5;
+            double v = side > 1 ? (double)(i / side) / (side - 1) : 0.5;
+            double theta1 = o.theta1.min + u * (o.theta1.max - o.theta1.min);
+            double theta2 = o.theta2.min + v * (o.theta2.max - o.theta2.min);
+            ensemble.addDouble((float)theta1, (float)theta2, 0.0f, 0.0f, o.m1, o.m2, o.L1, o.L2);
+        }
+    }
+
+    bool writeImage(const Options& o, const Density::Histogram& histogram, std::string& error)
+    {
+        std::vector<uint64_t> counts;
+        histogram.project(o.x, o.y, counts);
+        std::vector<uint8_t> pixels;
+        ImageFile::logScale(counts.data(), counts.size(), pixels);
+        return ImageFile::writePgm(o.image, o.binning.axes[o.x].bins, o.binning.axes[o.y].bins, pixels.data(), error);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+        return 1;
+
+    Ensemble ensemble;
+    populate(options, ensemble);
+    DoubleColumns columns = ensemble.doubles();
+    ThreadPool pool(options.threads);
+    Density::Histogram histogram;
+    std::string error;
+    if (!histogram.reset(options.binning, pool.size(), error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    const size_t steps = (size_t)std::llround(options.duration / options.dt);
+    // Merge before any worker's 32-bit counts could wrap
+    const size_t perWorker = (columns.count + pool.size() - 1) / pool.size();
+    const size_t merge = std::max<size_t>(1, std::min<size_t>(options.merge, Density::Histogram::MaxPending / perWorker));
+    std::fprintf(stderr, "Kernels: %s\n", Cpu::report().c_str());
+    std::fprintf(stderr, "%zu pendulums x %zu steps on %zu threads, %zu cells, merged every %zu steps\n",
+                 columns.count, steps, pool.size(), options.binning.cells(), merge);
+
+    auto start = std::chrono::steady_clock::now();
+    double mergeSeconds = 0.0;
+    size_t reported = 0;
+    for (size_t done = 0; done < steps;)
+    {
+        const size_t chunk = std::min(merge, steps - done);
+        pool.run([&](size_t worker, size_t workers) {
+            const size_t begin = columns.count * worker / workers, end = columns.count * (worker + 1) / workers;
+            histogram.step(worker, columns, begin, end, options.damping, options.g, options.dt, chunk);
+        });
+        auto mergeStart = std::chrono::steady_clock::now();
+        histogram.merge(&pool);
+        mergeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mergeStart).count();
+        done += chunk;
+        // Progress in tenths
+        if (done * 10 / steps != reported)
+        {
+            reported = done * 10 / steps;
+            std::fprintf(stderr, "\r%zu / %zu steps, %llu samples", done, steps, (unsigned long long)histogram.samples());
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "\n%.2f s, %.1f M pendulum steps/s, %.3f s merging\n", seconds,
+                 columns.count * (double)steps / seconds * 1e-6, mergeSeconds);
+    std::fprintf(stderr, "%llu samples, %.3g%% outside the binning\n", (unsigned long long)histogram.samples(),
+                 histogram.samples() ? 100.0 * histogram.outside() / histogram.samples() : 0.0);
+
+    if (!options.dump.empty() && !histogram.write(options.dump, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if (!options.image.empty() && !writeImage(options, histogram, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,266 @@
+// Parameter sweeps over double pendulums from the command line.
+//
+// Each of --m1, --m2, --L1, --L2, --g, --damping and the starting angles
+// --theta1 and --theta2 takes a value or a min:max[:levels] range. A
+// Cartesian design runs every combination of the levels; a Latin hypercube
+// draws --samples points that cover each range evenly. Every point runs
+// --members pendulums started --spread radians apart on the batch kernels,
+// spread over --threads workers, and becomes one CSV row of metrics
+// (Sweep.h) on stdout or in --out.
+//
+// With --coordinator the points are served in shards of --shard-size to
+// worker processes (SweepCluster.h) instead, which connect with --worker
+// from this or other machines; --spawn starts that many local ones.
+//
+//   PendulumSweep [--design=cartesian|lhs] [--samples=64] [--seed=1]
+//                 [--m1=1] [--m2=1] [--L1=1] [--L2=1] [--g=9.807] [--damping=0]
+//                 [--theta1=2] [--theta2=2] [--members=16] [--spread=0.001]
+//                 [--duration=20] [--dt=0.001] [--threads=0] [--out=sweep.csv]
+//                 [--coordinator=unix:/tmp/sweep.sock|host:port [--shard-size=256]
+//                  [--timeout=600] [--spawn=0]]
+//                 [--isa=sse2|avx2|avx512]
+//   PendulumSweep --worker=unix:/tmp/sweep.sock|host:port [--threads=0] [--name=id]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "Cpu.h"
+#include "Sweep.h"
+#include "SweepCluster.h"
+#include "ThreadPool.h"
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct Options
+    {
+        Sweep::Design design;
+        Sweep::Options sweep;
+        size_t threads = 0;
+        std::string out;
+        SweepCluster::CoordinatorOptions coordinator;
+        SweepCluster::WorkerOptions worker;
+        size_t spawn = 0;
+    };
+
+    bool parse(int argc, char** argv, Options& o)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](const char* key) -> const char* {
+                size_t len = std::strlen(key);
+                return arg.compare(0, len, key) == 0 ? arg.c_str() + len : nullptr;
+            };
+            bool matched = false;
+            for (int p = 0; p < Sweep::ParameterCount; ++p)
+            {
+                std::string key = std::string("--") + Sweep::name((Sweep::Parameter)p) + "=";
+                if (const char* v = value(key.c_str()))
+                {
+                    std::string error;
+                    if (!parseRange(v, o.design.ranges[p], error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                    matched = true;
+                }
+            }
+            if (matched)
+                continue;
+
+            try
+            {
+                if (const char* v = value("--design="))
+                {
+                    std::string design = v;
+                    if (design == "cartesian")
+                        o.design.kind = Sweep::Design::Cartesian;
+                    else if (design == "lhs")
+                        o.design.kind = Sweep::Design::LatinHypercube;
+                    else
+                    {
+                        std::fprintf(stderr, "Unknown design %s\n", v);
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--samples="))
+                    o.design.samples = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--seed="))
+                    o.design.seed = std::stoull(v);
+                else if (const char* v = value("--members="))
+                    o.sweep.members = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--spread="))
+                    o.sweep.spread = std::stof(v);
+                else if (const char* v = value("--duration="))
+                    o.sweep.duration = std::stod(v);
+                else if (const char* v = value("--dt="))
+                    o.sweep.dt = std::stof(v);
+                else if (const char* v = value("--threads="))
+                    o.threads = std::stoull(v);
+                else if (const char* v = value("--out="))
+                    o.out = v;
+                else if (const char* v = value("--coordinator="))
+                    o.coordinator.address = v;
+                else if (const char* v = value("--shard-size="))
+                    o.coordinator.shardSize = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--timeout="))
+                    o.coordinator.timeout = std::stod(v);
+                else if (const char* v = value("--spawn="))
+                    o.spawn = std::stoull(v);
+                else if (const char* v = value("--worker="))
+                    o.worker.address = v;
+                else if (const char* v = value("--name="))
+                    o.worker.name = v;
+                else if (const char* v = value("--isa="))
+                {
+                    std::string error;
+                    if (!Cpu::setLevel(v, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else
+                {
+                    std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::fprintf(stderr, "Bad value in %s\n", arg.c_str());
+                return false;
+            }
+        }
+        if (!(o.sweep.dt > 0.0f) || !(o.sweep.duration > 0.0))
+        {
+            std::fprintf(stderr, "--dt and --duration must be positive\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Local workers for --spawn, each a copy of this program
+    std::vector<long> spawnWorkers(const char* self, const Options& o)
+    {
+        std::vector<long> children;
+#ifndef _WIN32
+        std::string address = "--worker=" + o.coordinator.address;
+        std::string threads = "--threads=" + std::to_string(o.threads);
+        for (size_t i = 0; i < o.spawn; ++i)
+        {
+            std::string name = "--name=local" + std::to_string(i);
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                char* args[] = { const_cast<char*>(self), const_cast<char*>(address.c_str()),
+                                 const_cast<char*>(threads.c_str()), const_cast<char*>(name.c_str()), nullptr };
+                execv("/proc/self/exe", args);
+                execvp(self, args);
+                _exit(127);
+            }
+            if (pid > 0)
+                children.push_back((long)pid);
+        }
+#else
+        (void)self;
+        if (o.spawn)
+            std::fprintf(stderr, "--spawn needs POSIX, start workers by hand\n");
+#endif
+        return children;
+    }
+
+    void reap(const std::vector<long>& children)
+    {
+#ifndef _WIN32
+        for (long pid : children)
+            waitpid((pid_t)pid, nullptr, 0);
+#else
+        (void)children;
+#endif
+    }
+
+    int runWorker(const Options& o)
+    {
+        ThreadPool pool(o.threads);
+        std::string error;
+        if (!SweepCluster::work(o.worker, pool, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+        return 1;
+
+    if (!options.worker.address.empty())
+        return runWorker(options);
+
+    std::vector<Sweep::Point> points = Sweep::expand(options.design);
+    std::fprintf(stderr, "Kernels: %s\n", Cpu::report().c_str());
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Sweep::Result> results;
+
+    if (!options.coordinator.address.empty())
+    {
+        std::fprintf(stderr, "%zu points x %zu members in shards of %zu on %s\n", points.size(),
+                     options.sweep.members, options.coordinator.shardSize, options.coordinator.address.c_str());
+        options.coordinator.log = [](const std::string& message) { std::fprintf(stderr, "%s\n", message.c_str()); };
+        std::vector<long> children = spawnWorkers(argv[0], options);
+        std::string error;
+        bool ok = SweepCluster::coordinate(points, options.sweep, options.coordinator, results, error);
+        reap(children);
+        if (!ok)
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    else
+    {
+        ThreadPool pool(options.threads);
+        std::fprintf(stderr, "%zu points x %zu members on %zu threads\n", points.size(), options.sweep.members,
+                     pool.size());
+        size_t reported = 0;
+        results = Sweep::run(points, options.sweep, pool, [&](size_t done, size_t total) {
+            // Every tenth, so the log stays short
+            if (done * 10 / total != reported)
+            {
+                reported = done * 10 / total;
+                std::fprintf(stderr, "\r%zu / %zu points", done, total);
+            }
+        });
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "\r%zu points in %.2f s\n", results.size(), seconds);
+
+    if (options.out.empty())
+    {
+        Sweep::writeCsvHeader(std::cout);
+        for (const Sweep::Result& r : results)
+            Sweep::writeCsvRow(std::cout, r);
+        return 0;
+    }
+    std::string error;
+    if (!Sweep::writeCsv(options.out, results, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,346 @@
+// Poincaré sections of double pendulum ensembles from the command line.
+//
+// With --energy every pendulum starts on the section theta1 = 0 at that
+// total energy, from rest in theta2, with its theta2 spread evenly over
+// --theta2 and omega1 > 0 making up the energy; starts the energy cannot
+// reach are skipped. Without it the pendulums start from rest on the line
+// from (theta1 min, theta2 min) to (theta1 max, theta2 max).
+//
+// Each pendulum runs --duration seconds on the batch kernels, spread over
+// --threads workers, and its crossings of --section are located on the step
+// interpolant (Poincare.h). The newest --capacity crossings per pendulum are
+// written as CSV to --csv, and as a log-scaled density image of the --plot
+// plane to --image.
+//
+//   PoincareSection [--pendulums=1000] [--energy=E] [--theta1=0:0] [--theta2=-2:2]
+//                   [--m1=1] [--m2=1] [--L1=1] [--L2=1] [--g=9.807] [--damping=0]
+//                   [--section=theta1:0:rising] [--plot=theta2:omega2]
+//                   [--duration=200] [--dt=0.001] [--capacity=2048] [--threads=0]
+//                   [--image=section.pgm] [--size=1024] [--csv=crossings.csv]
+//                   [--isa=sse2|avx2|avx512]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "Cpu.h"
+#include "Ensemble.h"
+#include "ImageFile.h"
+#include "Poincare.h"
+#include "Range.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    struct Options
+    {
+        size_t pendulums = 1000;
+        bool fixedEnergy = false;
+        double energy = 0.0;
+        Range theta1, theta2;
+        float m1 = 1.0f, m2 = 1.0f, L1 = 1.0f, L2 = 1.0f, g = 9.807f, damping = 0.0f;
+        Poincare::Section section;
+        int x = Poincare::Theta2, y = Poincare::Omega2;
+        double duration = 200.0;
+        float dt = 0.001f;
+        size_t capacity = 2048;
+        size_t threads = 0;
+        std::string image, csv;
+        size_t size = 1024;
+
+        Options()
+        {
+            theta1.min = theta1.max = 0.0;
+            theta2.min = -2.0;
+            theta2.max = 2.0;
+        }
+    };
+
+    bool parseVariable(const std::string& text, int& v)
+    {
+        for (int i = 0; i < Poincare::VariableCount; ++i)
+            if (text == Poincare::name((Poincare::Variable)i))
+            {
+                v = i;
+                return true;
+            }
+        return false;
+    }
+
+    // variable:value[:rising|falling|both]
+    bool parseSection(const std::string& text, Poincare::Section& section)
+    {
+        size_t colon = text.find(':');
+        int v = 0;
+        if (!parseVariable(text.substr(0, colon), v))
+            return false;
+        section.variable = (Poincare::Variable)v;
+        if (colon == std::string::npos)
+            return true;
+        size_t second = text.find(':', colon + 1);
+        try
+        {
+            section.value = std::stof(text.substr(colon + 1, second - colon - 1));
+        }
+        catch (...)
+        {
+            return false;
+        }
+        if (second == std::string::npos)
+            return true;
+        std::string direction = text.substr(second + 1);
+        if (direction == "rising")
+            section.direction = Poincare::Rising;
+        else if (direction == "falling")
+            section.direction = Poincare::Falling;
+        else if (direction == "both")
+            section.direction = Poincare::Both;
+        else
+            return false;
+        return true;
+    }
+
+    bool parse(int argc, char** argv, Options& o)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](const char* key) -> const char* {
+                size_t len = std::strlen(key);
+                return arg.compare(0, len, key) == 0 ? arg.c_str() + len : nullptr;
+            };
+            std::string error;
+            try
+            {
+                if (const char* v = value("--pendulums="))
+                    o.pendulums = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--energy="))
+                {
+                    o.fixedEnergy = true;
+                    o.energy = std::stod(v);
+                }
+                else if (const char* v = value("--theta1="))
+                {
+                    if (!parseRange(v, o.theta1, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--theta2="))
+                {
+                    if (!parseRange(v, o.theta2, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--m1="))
+                    o.m1 = std::stof(v);
+                else if (const char* v = value("--m2="))
+                    o.m2 = std::stof(v);
+                else if (const char* v = value("--L1="))
+                    o.L1 = std::stof(v);
+                else if (const char* v = value("--L2="))
+                    o.L2 = std::stof(v);
+                else if (const char* v = value("--g="))
+                    o.g = std::stof(v);
+                else if (const char* v = value("--damping="))
+                    o.damping = std::stof(v);
+                else if (const char* v = value("--section="))
+                {
+                    if (!parseSection(v, o.section))
+                    {
+                        std::fprintf(stderr, "Bad section %s, expected variable:value[:rising|falling|both]\n", v);
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--plot="))
+                {
+                    std::string plot = v;
+                    size_t colon = plot.find(':');
+                    if (colon == std::string::npos || !parseVariable(plot.substr(0, colon), o.x) ||
+                        !parseVariable(plot.substr(colon + 1), o.y))
+                    {
+                        std::fprintf(stderr, "Bad plot %s, expected x:y such as theta2:omega2\n", v);
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--duration="))
+                    o.duration = std::stod(v);
+                else if (const char* v = value("--dt="))
+                    o.dt = std::stof(v);
+                else if (const char* v = value("--capacity="))
+                    o.capacity = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--threads="))
+                    o.threads = std::stoull(v);
+                else if (const char* v = value("--image="))
+                    o.image = v;
+                else if (const char* v = value("--size="))
+                    o.size = std::max<size_t>(16, std::stoull(v));
+                else if (const char* v = value("--csv="))
+                    o.csv = v;
+                else if (const char* v = value("--isa="))
+                {
+                    if (!Cpu::setLevel(v, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else
+                {
+                    std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::fprintf(stderr, "Bad value in %s\n", arg.c_str());
+                return false;
+            }
+        }
+        if (!(o.dt > 0.0f) || !(o.duration > 0.0))
+        {
+            std::fprintf(stderr, "--dt and --duration must be positive\n");
+            return false;
+        }
+        return true;
+    }
+
+    void populate(const Options& o, Ensemble& ensemble)
+    {
+        ensemble.reserve(0, o.pendulums);
+        for (size_t i = 0; i < o.pendulums; ++i)
+        {
+            double f = o.pendulums > 1 ? (double)i / (o.pendulums - 1) : 0.5;
+            double theta2 = o.theta2.min + f * (o.theta2.max - o.theta2.min);
+            if (!o.fixedEnergy)
+            {
+                double theta1 = o.theta1.min + f * (o.theta1.max - o.theta1.min);
+                ensemble.addDouble((float)theta1, (float)theta2, 0.0f, 0.0f, o.m1, o.m2, o.L1, o.L2);
+                continue;
+            }
+            // On theta1 = 0 with omega2 = 0 all the kinetic energy is in omega1
+            double potential = -(double)(o.m1 + o.m2) * o.g * o.L1 - (double)o.m2 * o.g * o.L2 * std::cos(theta2);
+            double kinetic = o.energy - potential;
+            if (kinetic < 0.0)
+                continue;
+            double omega1 = std::sqrt(2.0 * kinetic / ((double)(o.m1 + o.m2) * o.L1 * o.L1));
+            ensemble.addDouble(0.0f, (float)theta2, (float)omega1, 0.0f, o.m1, o.m2, o.L1, o.L2);
+        }
+    }
+
+    bool writeCsv(const std::string& path, const Poincare::Recorder& recorder, std::string& error)
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out)
+        {
+            error = "Cannot create " + path;
+            return false;
+        }
+        out << "pendulum,theta1,theta2,omega1,omega2\n";
+        char line[128];
+        for (size_t p = 0; p < recorder.pendulums(); ++p)
+            for (size_t i = 0; i < recorder.count(p); ++i)
+            {
+                const Poincare::State& s = recorder.at(p, i);
+                std::snprintf(line, sizeof(line), "%zu,%.7g,%.7g,%.7g,%.7g\n", p, s.v[0], s.v[1], s.v[2], s.v[3]);
+                out << line;
+            }
+        if (!out)
+        {
+            error = "Cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    bool writeImage(const Options& o, const Poincare::Recorder& recorder, std::string& error)
+    {
+        // Angles span the circle, velocities the largest one recorded
+        const int axes[2] = { o.x, o.y };
+        float extent[2];
+        for (int a = 0; a < 2; ++a)
+        {
+            extent[a] = 3.14159265f;
+            if (axes[a] == Poincare::Theta1 || axes[a] == Poincare::Theta2)
+                continue;
+            extent[a] = 1e-3f;
+            for (size_t p = 0; p < recorder.pendulums(); ++p)
+                for (size_t i = 0; i < recorder.count(p); ++i)
+                    extent[a] = std::max(extent[a], std::fabs(recorder.at(p, i).v[axes[a]]));
+        }
+        std::vector<uint32_t> counts(o.size * o.size, 0);
+        for (size_t p = 0; p < recorder.pendulums(); ++p)
+            for (size_t i = 0; i < recorder.count(p); ++i)
+            {
+                const Poincare::State& s = recorder.at(p, i);
+                float u = (s.v[o.x] / extent[0] + 1.0f) * 0.5f, v = (1.0f - s.v[o.y] / extent[1]) * 0.5f;
+                size_t cx = std::min(o.size - 1, (size_t)std::max(0.0f, u * o.size));
+                size_t cy = std::min(o.size - 1, (size_t)std::max(0.0f, v * o.size));
+                ++counts[cy * o.size + cx];
+            }
+        std::vector<uint8_t> pixels;
+        ImageFile::logScale(counts.data(), counts.size(), pixels);
+        std::fprintf(stderr, "Image spans %s +-%.3g, %s +-%.3g\n", Poincare::name((Poincare::Variable)o.x), extent[0],
+                     Poincare::name((Poincare::Variable)o.y), extent[1]);
+        return ImageFile::writePgm(o.image, o.size, o.size, pixels.data(), error);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+        return 1;
+
+    Ensemble ensemble;
+    populate(options, ensemble);
+    DoubleColumns columns = ensemble.doubles();
+    if (columns.count == 0)
+    {
+        std::fprintf(stderr, "No starting point is reachable at energy %g\n", options.energy);
+        return 1;
+    }
+    Poincare::Recorder recorder;
+    recorder.setSection(options.section);
+    recorder.reset(columns.count, options.capacity);
+
+    ThreadPool pool(options.threads);
+    const size_t steps = (size_t)std::llround(options.duration / options.dt);
+    std::fprintf(stderr, "Kernels: %s\n", Cpu::report().c_str());
+    std::fprintf(stderr, "%zu pendulums x %zu steps on %zu threads\n", columns.count, steps, pool.size());
+
+    auto start = std::chrono::steady_clock::now();
+    // Tenths, for progress; each worker keeps its own contiguous range
+    for (size_t done = 0, part = 1; done < steps; ++part)
+    {
+        size_t until = steps * part / 10;
+        size_t chunk = until - done;
+        pool.forRanges(columns.count, [&](size_t begin, size_t end) {
+            recorder.step(columns, begin, end, options.damping, options.g, options.dt, chunk);
+        });
+        done = until;
+        std::fprintf(stderr, "\r%zu / %zu steps, %llu crossings", done, steps,
+                     (unsigned long long)recorder.totalCrossings());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "\n%.2f s, %.1f M pendulum steps/s\n", seconds, columns.count * (double)steps / seconds * 1e-6);
+
+    std::string error;
+    if (!options.csv.empty() && !writeCsv(options.csv, recorder, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if (!options.image.empty() && !writeImage(options, recorder, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
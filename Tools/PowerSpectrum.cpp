@@ -0,0 +1,327 @@
+// Power spectra of double pendulum ensembles from the command line.
+//
+// The pendulums start from rest on the line from (theta1 min, theta2 min)
+// to (theta1 max, theta2 max), run --settle seconds to shed their start,
+// then have --variable sampled at --rate Hz for as long as --segments
+// Welch segments of --length samples take. Stepping and transforms run a
+// block of pendulums at a time on every --threads worker, the transforms
+// on the batch FFT (Spectrum.h), so the samples held are one block's per
+// worker however large the ensemble.
+//
+// Every spectrum is summarized as periodic, quasi-periodic or chaotic
+// (Spectrum::summarize), one CSV row per pendulum to --csv. --image writes
+// the spectra as a PGM, one row per pendulum and one column per frequency
+// bin, each row in decibels below its own peak down to --range; it holds
+// every spectrum in memory until the end.
+//
+//   PowerSpectrum [--pendulums=1000] [--theta1=0.1:3] [--theta2=0.1:3]
+//                 [--m1=1] [--m2=1] [--L1=1] [--L2=1] [--g=9.807] [--damping=0]
+//                 [--variable=theta1|theta2] [--settle=10] [--rate=50]
+//                 [--length=1024] [--segments=8] [--dt=0.001] [--threads=0]
+//                 [--csv=spectra.csv] [--image=spectra.pgm] [--range=80]
+//                 [--isa=sse2|avx2|avx512]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "BatchKernels.h"
+#include "Cpu.h"
+#include "Ensemble.h"
+#include "ImageFile.h"
+#include "Physics.h"
+#include "Range.h"
+#include "Spectrum.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    // Pendulums stepped and transformed together on one worker
+    const size_t BlockSize = 256;
+
+    struct Options
+    {
+        size_t pendulums = 1000;
+        Range theta1, theta2;
+        float m1 = 1.0f, m2 = 1.0f, L1 = 1.0f, L2 = 1.0f, g = 9.807f, damping = 0.0f;
+        bool second = false;
+        double settle = 10.0;
+        float rate = 50.0f;
+        size_t length = 1024, segments = 8;
+        float dt = 0.001f;
+        size_t threads = 0;
+        std::string csv, image;
+        float range = 80.0f;
+
+        Options()
+        {
+            theta1.min = theta2.min = 0.1;
+            theta1.max = theta2.max = 3.0;
+        }
+    };
+
+    bool parse(int argc, char** argv, Options& o)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](const char* key) -> const char* {
+                size_t len = std::strlen(key);
+                return arg.compare(0, len, key) == 0 ? arg.c_str() + len : nullptr;
+            };
+            std::string error;
+            try
+            {
+                if (const char* v = value("--pendulums="))
+                    o.pendulums = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--theta1="))
+                {
+                    if (!parseRange(v, o.theta1, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--theta2="))
+                {
+                    if (!parseRange(v, o.theta2, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--m1="))
+                    o.m1 = std::stof(v);
+                else if (const char* v = value("--m2="))
+                    o.m2 = std::stof(v);
+                else if (const char* v = value("--L1="))
+                    o.L1 = std::stof(v);
+                else if (const char* v = value("--L2="))
+                    o.L2 = std::stof(v);
+                else if (const char* v = value("--g="))
+                    o.g = std::stof(v);
+                else if (const char* v = value("--damping="))
+                    o.damping = std::stof(v);
+                else if (const char* v = value("--variable="))
+                {
+                    std::string variable = v;
+                    if (variable != "theta1" && variable != "theta2")
+                    {
+                        std::fprintf(stderr, "Bad variable %s, expected theta1 or theta2\n", v);
+                        return false;
+                    }
+                    o.second = variable == "theta2";
+                }
+                else if (const char* v = value("--settle="))
+                    o.settle = std::max(0.0, std::stod(v));
+                else if (const char* v = value("--rate="))
+                    o.rate = std::stof(v);
+                else if (const char* v = value("--length="))
+                    o.length = std::stoull(v);
+                else if (const char* v = value("--segments="))
+                    o.segments = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--dt="))
+                    o.dt = std::stof(v);
+                else if (const char* v = value("--threads="))
+                    o.threads = std::stoull(v);
+                else if (const char* v = value("--csv="))
+                    o.csv = v;
+                else if (const char* v = value("--image="))
+                    o.image = v;
+                else if (const char* v = value("--range="))
+                    o.range = std::max(1.0f, std::stof(v));
+                else if (const char* v = value("--isa="))
+                {
+                    if (!Cpu::setLevel(v, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else
+                {
+                    std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::fprintf(stderr, "Bad value in %s\n", arg.c_str());
+                return false;
+            }
+        }
+        if (!(o.dt > 0.0f) || !(o.rate > 0.0f))
+        {
+            std::fprintf(stderr, "--dt and --rate must be positive\n");
+            return false;
+        }
+        if (o.rate * o.dt > 1.0f)
+        {
+            std::fprintf(stderr, "--rate cannot exceed one sample per step of --dt\n");
+            return false;
+        }
+        return true;
+    }
+
+    void populate(const Options& o, Ensemble& ensemble)
+    {
+        ensemble.reserve(0, o.pendulums);
+        for (size_t i = 0; i < o.pendulums; ++i)
+        {
+            double f = o.pendulums > 1 ? (double)i / (o.pendulums - 1) : 0.5;
+            double theta1 = o.theta1.min + f * (o.theta1.max - o.theta1.min);
+            double theta2 = o.theta2.min + f * (o.theta2.max - o.theta2.min);
+            ensemble.addDouble((float)theta1, (float)theta2, 0.0f, 0.0f, o.m1, o.m2, o.L1, o.L2);
+        }
+    }
+
+    bool writeCsv(const std::string& path, const std::vector<float>& starts,
+                  const std::vector<Spectrum::Summary>& summaries, std::string& error)
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out)
+        {
+            error = "Cannot create " + path;
+            return false;
+        }
+        out << "pendulum,theta1,theta2,peak_hz,lines,broadband,entropy,motion\n";
+        char line[160];
+        for (size_t p = 0; p < summaries.size(); ++p)
+        {
+            const Spectrum::Summary& s = summaries[p];
+            std::snprintf(line, sizeof(line), "%zu,%.7g,%.7g,%.7g,%d,%.5f,%.5f,%s\n", p, starts[2 * p],
+                          starts[2 * p + 1], s.peak, s.lines, s.broadband, s.entropy, Spectrum::name(s.motion));
+            out << line;
+        }
+        if (!out)
+        {
+            error = "Cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+    bool writeImage(const Options& o, const std::vector<float>& spectra, size_t bins, std::string& error)
+    {
+        const size_t rows = spectra.size() / bins;
+        std::vector<uint8_t> pixels(rows * bins);
+        for (size_t p = 0; p < rows; ++p)
+        {
+            const float* power = spectra.data() + p * bins;
+            float top = *std::max_element(power + 1, power + bins);
+            for (size_t k = 0; k < bins; ++k)
+            {
+                float below = top > 0.0f && power[k] > 0.0f ? -10.0f * std::log10(power[k] / top) : o.range;
+                pixels[p * bins + k] = (uint8_t)std::lround(255.0f * std::max(0.0f, 1.0f - below / o.range));
+            }
+        }
+        return ImageFile::writePgm(o.image, bins, rows, pixels.data(), error);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+        return 1;
+
+    Spectrum::Plan plan;
+    std::string error;
+    if (!plan.reset(options.length, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const size_t bins = plan.bins();
+    const size_t samples = options.length + (options.segments - 1) * Spectrum::hop(options.length);
+    const size_t stride = (size_t)std::max(1L, std::lround(1.0 / (options.rate * options.dt)));
+    const float rate = 1.0f / (stride * options.dt);
+    const size_t settleSteps = (size_t)std::llround(options.settle / options.dt);
+
+    Ensemble ensemble;
+    populate(options, ensemble);
+    DoubleColumns columns = ensemble.doubles();
+    std::vector<float> starts(2 * columns.count);
+    for (size_t p = 0; p < columns.count; ++p)
+    {
+        starts[2 * p] = columns.theta1[p];
+        starts[2 * p + 1] = columns.theta2[p];
+    }
+    std::vector<Spectrum::Summary> summaries(columns.count);
+    std::vector<float> spectra(options.image.empty() ? 0 : columns.count * bins);
+
+    ThreadPool pool(options.threads);
+    std::vector<double> fftSeconds(pool.size(), 0.0);
+    std::fprintf(stderr, "Kernels: %s\n", Cpu::report().c_str());
+    std::fprintf(stderr, "%zu pendulums, %zu samples at %.4g Hz after %zu settling steps, %zu threads\n",
+                 columns.count, samples, rate, settleSteps, pool.size());
+
+    auto start = std::chrono::steady_clock::now();
+    pool.run([&](size_t worker, size_t workers) {
+        const size_t begin = columns.count * worker / workers, end = columns.count * (worker + 1) / workers;
+        std::vector<float> series(samples * BlockSize), power(bins * BlockSize), work(plan.workSize());
+        float last[BlockSize];
+        double unwrapped[BlockSize];
+        const float* angle = options.second ? columns.theta2 : columns.theta1;
+        for (size_t b = begin; b < end; b += BlockSize)
+        {
+            const size_t e = std::min(end, b + BlockSize), n = e - b;
+            Batch::stepDoubles(columns, b, e, options.damping, options.g, options.dt, settleSteps);
+            // Angles come back wrapped; unwrapping keeps rotations continuous
+            for (size_t i = 0; i < n; ++i)
+                unwrapped[i] = last[i] = angle[b + i];
+            for (size_t t = 0; t < samples; ++t)
+            {
+                if (t)
+                    Batch::stepDoubles(columns, b, e, options.damping, options.g, options.dt, stride);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    unwrapped[i] += Physics::wrapAngle((double)angle[b + i] - last[i]);
+                    last[i] = angle[b + i];
+                    series[t * n + i] = (float)unwrapped[i];
+                }
+            }
+
+            auto fftStart = std::chrono::steady_clock::now();
+            Spectrum::welch(plan, series.data(), n, n, options.segments, rate, power.data(), work.data());
+            fftSeconds[worker] += std::chrono::duration<double>(std::chrono::steady_clock::now() - fftStart).count();
+            for (size_t i = 0; i < n; ++i)
+            {
+                summaries[b + i] = Spectrum::summarize(power.data() + i, n, bins, rate / options.length);
+                if (!spectra.empty())
+                    for (size_t k = 0; k < bins; ++k)
+                        spectra[(b + i) * bins + k] = power[k * n + i];
+            }
+        }
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double fft = 0.0;
+    for (double s : fftSeconds)
+        fft += s;
+    const double steps = (double)columns.count * (settleSteps + (samples - 1) * stride);
+    std::fprintf(stderr, "%.2f s, %.1f M pendulum steps/s\n", seconds, steps / seconds * 1e-6);
+    std::fprintf(stderr, "Welch: %.3f thread-s, %.0f spectra/s and %.0f transforms/s per thread\n", fft,
+                 columns.count / fft, columns.count * options.segments / fft);
+
+    size_t counts[Spectrum::MotionCount] = {};
+    for (const Spectrum::Summary& s : summaries)
+        ++counts[s.motion];
+    std::fprintf(stderr, "%zu periodic, %zu quasi-periodic, %zu chaotic\n", counts[Spectrum::Periodic],
+                 counts[Spectrum::QuasiPeriodic], counts[Spectrum::Chaotic]);
+
+    if (!options.csv.empty() && !writeCsv(options.csv, starts, summaries, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if (!options.image.empty() && !writeImage(options, spectra, bins, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,394 @@
+// Recurrence analysis of one double pendulum trajectory from the command line.
+//
+// The trajectory is either read from a recording (--trajectory, pendulum
+// --pendulum between --from and --to) or simulated here from --theta1 and
+// --theta2 at rest, --samples of them; either way one sample is kept per
+// --interval seconds. By default every sample is embedded whole, as
+// (cos theta1, sin theta1, cos theta2, sin theta2, omega1, omega2) with each
+// coordinate standardized; --variable instead delay-embeds one scalar in
+// --dimension coordinates --delay samples apart.
+//
+// A k-d tree over the points (Recurrence::Tree) is built on every --threads
+// worker. The correlation sum runs from --references points spread along the
+// trajectory, prints the correlation dimension and writes C(r) and its local
+// slopes to --correlation. Recurrence quantification then runs from every
+// point at --radius, or at the radius where C reaches --recurrence-rate; its
+// cost grows with the recurrences found, so lower the rate for longer runs.
+// --plot writes the recurrence plot downsampled to --size pixels square.
+//
+//   RecurrenceAnalysis [--trajectory=run.traj] [--pendulum=0] [--from=0] [--to=inf]
+//                      [--theta1=2] [--theta2=2.5] [--m1=1] [--m2=1] [--L1=1] [--L2=1]
+//                      [--g=9.807] [--damping=0] [--dt=0.001] [--samples=100000]
+//                      [--interval=0.01] [--variable=state|omega1|omega2|x2|y2]
+//                      [--dimension=3] [--delay=10] [--theiler=100]
+//                      [--radii=0.01:1:24] [--references=4000]
+//                      [--radius=r] [--recurrence-rate=0.001] [--min-line=2]
+//                      [--correlation=correlation.csv] [--plot=recurrence.pgm]
+//                      [--size=1024] [--threads=0] [--isa=sse2|avx2|avx512]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "BatchKernels.h"
+#include "Cpu.h"
+#include "Ensemble.h"
+#include "ImageFile.h"
+#include "Playback.h"
+#include "Range.h"
+#include "Recurrence.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    // DPend in Pendulums.h, which brings the renderer along with it
+    const uint32_t DoubleType = 2;
+
+    enum Variable
+    {
+        WholeState,
+        Omega1,
+        Omega2,
+        X2,
+        Y2
+    };
+
+    struct Options
+    {
+        std::string trajectory;
+        size_t pendulum = 0;
+        double from = 0.0, to = INFINITY;
+        float theta1 = 2.0f, theta2 = 2.5f;
+        float m1 = 1.0f, m2 = 1.0f, L1 = 1.0f, L2 = 1.0f, g = 9.807f, damping = 0.0f;
+        float dt = 0.001f;
+        size_t samples = 100000;
+        double interval = 0.01;
+        Variable variable = WholeState;
+        int dimension = 3;
+        size_t delay = 10;
+        size_t theiler = 100;
+        Range radii;
+        size_t references = 4000;
+        float radius = 0.0f;
+        double rate = 0.001;
+        size_t minLine = 2;
+        std::string correlation, plot;
+        size_t size = 1024;
+        size_t threads = 0;
+
+        Options()
+        {
+            radii.min = 0.01;
+            radii.max = 1.0;
+            radii.levels = 24;
+        }
+    };
+
+    bool parse(int argc, char** argv, Options& o)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&](const char* key) -> const char* {
+                size_t len = std::strlen(key);
+                return arg.compare(0, len, key) == 0 ? arg.c_str() + len : nullptr;
+            };
+            std::string error;
+            try
+            {
+                if (const char* v = value("--trajectory="))
+                    o.trajectory = v;
+                else if (const char* v = value("--pendulum="))
+                    o.pendulum = std::stoull(v);
+                else if (const char* v = value("--from="))
+                    o.from = std::stod(v);
+                else if (const char* v = value("--to="))
+                    o.to = std::stod(v);
+                else if (const char* v = value("--theta1="))
+                    o.theta1 = std::stof(v);
+                else if (const char* v = value("--theta2="))
+                    o.theta2 = std::stof(v);
+                else if (const char* v = value("--m1="))
+                    o.m1 = std::stof(v);
+                else if (const char* v = value("--m2="))
+                    o.m2 = std::stof(v);
+                else if (const char* v = value("--L1="))
+                    o.L1 = std::stof(v);
+                else if (const char* v = value("--L2="))
+                    o.L2 = std::stof(v);
+                else if (const char* v = value("--g="))
+                    o.g = std::stof(v);
+                else if (const char* v = value("--damping="))
+                    o.damping = std::stof(v);
+                else if (const char* v = value("--dt="))
+                    o.dt = std::stof(v);
+                else if (const char* v = value("--samples="))
+                    o.samples = std::max<size_t>(2, std::stoull(v));
+                else if (const char* v = value("--interval="))
+                    o.interval = std::stod(v);
+                else if (const char* v = value("--variable="))
+                {
+                    static const char* names[] = { "state", "omega1", "omega2", "x2", "y2" };
+                    size_t k = 0;
+                    while (k < 5 && std::strcmp(v, names[k]) != 0)
+                        ++k;
+                    if (k == 5)
+                    {
+                        std::fprintf(stderr, "Bad variable %s, expected state, omega1, omega2, x2 or y2\n", v);
+                        return false;
+                    }
+                    o.variable = (Variable)k;
+                }
+                else if (const char* v = value("--dimension="))
+                    o.dimension = std::max(1, std::min(64, std::stoi(v)));
+                else if (const char* v = value("--delay="))
+                    o.delay = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--theiler="))
+                    o.theiler = std::stoull(v);
+                else if (const char* v = value("--radii="))
+                {
+                    if (!parseRange(v, o.radii, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else if (const char* v = value("--references="))
+                    o.references = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--radius="))
+                    o.radius = std::stof(v);
+                else if (const char* v = value("--recurrence-rate="))
+                    o.rate = std::stod(v);
+                else if (const char* v = value("--min-line="))
+                    o.minLine = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--correlation="))
+                    o.correlation = v;
+                else if (const char* v = value("--plot="))
+                    o.plot = v;
+                else if (const char* v = value("--size="))
+                    o.size = std::max<size_t>(1, std::stoull(v));
+                else if (const char* v = value("--threads="))
+                    o.threads = std::stoull(v);
+                else if (const char* v = value("--isa="))
+                {
+                    if (!Cpu::setLevel(v, error))
+                    {
+                        std::fprintf(stderr, "%s\n", error.c_str());
+                        return false;
+                    }
+                }
+                else
+                {
+                    std::fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::fprintf(stderr, "Bad value in %s\n", arg.c_str());
+                return false;
+            }
+        }
+        if (!(o.dt > 0.0f) || !(o.interval >= 0.0))
+        {
+            std::fprintf(stderr, "--dt must be positive and --interval not negative\n");
+            return false;
+        }
+        if (!(o.radii.min > 0.0) || !(o.radii.max > o.radii.min))
+        {
+            std::fprintf(stderr, "--radii must run from a positive radius up\n");
+            return false;
+        }
+        return true;
+    }
+
+    bool record(const Options& o, std::vector<Trajectory::Sample>& out, std::string& error)
+    {
+        TrajectoryPlayer player;
+        if (!player.open(o.trajectory, error))
+            return false;
+        if (o.pendulum >= player.pendulumCount())
+        {
+            error = o.trajectory + " holds " + std::to_string(player.pendulumCount()) + " pendulums";
+            return false;
+        }
+        if (player.pendulum(o.pendulum).type != DoubleType)
+        {
+            error = "Pendulum " + std::to_string(o.pendulum) + " is not a double pendulum";
+            return false;
+        }
+        player.states(o.pendulum, o.from, o.to, o.interval, out);
+        return true;
+    }
+
+    void simulate(const Options& o, std::vector<Trajectory::Sample>& out)
+    {
+        Ensemble ensemble;
+        ensemble.reserve(0, 1);
+        ensemble.addDouble(o.theta1, o.theta2, 0.0f, 0.0f, o.m1, o.m2, o.L1, o.L2);
+        DoubleColumns columns = ensemble.doubles();
+        const size_t stride = (size_t)std::max(1LL, std::llround(o.interval / o.dt));
+        out.resize(o.samples);
+        for (size_t t = 0; t < o.samples; ++t)
+        {
+            if (t)
+                Batch::stepDoubles(columns, 0, 1, o.damping, o.g, o.dt, stride);
+            Trajectory::Sample& s = out[t];
+            s.theta1 = columns.theta1[0];
+            s.theta2 = columns.theta2[0];
+            s.omega1 = columns.omega1[0];
+            s.omega2 = columns.omega2[0];
+            s.x1 = o.L1 * std::sin(s.theta1);
+            s.y1 = -o.L1 * std::cos(s.theta1);
+            s.x2 = s.x1 + o.L2 * std::sin(s.theta2);
+            s.y2 = s.y1 - o.L2 * std::cos(s.theta2);
+        }
+    }
+
+    void embed(const Options& o, const std::vector<Trajectory::Sample>& samples, Recurrence::Points& points)
+    {
+        if (o.variable == WholeState)
+        {
+            points.count = samples.size();
+            points.dimension = 6;
+            points.coords.resize(points.count * 6);
+            for (size_t i = 0; i < points.count; ++i)
+            {
+                const Trajectory::Sample& s = samples[i];
+                float* p = points.coords.data() + i * 6;
+                p[0] = std::cos(s.theta1);
+                p[1] = std::sin(s.theta1);
+                p[2] = std::cos(s.theta2);
+                p[3] = std::sin(s.theta2);
+                p[4] = s.omega1;
+                p[5] = s.omega2;
+            }
+        }
+        else
+        {
+            static const size_t offsets[] = { 0, offsetof(Trajectory::Sample, omega1), offsetof(Trajectory::Sample, omega2),
+                                              offsetof(Trajectory::Sample, x2), offsetof(Trajectory::Sample, y2) };
+            const float* series = reinterpret_cast<const float*>(
+                reinterpret_cast<const char*>(samples.data()) + offsets[o.variable]);
+            Recurrence::embed(series, samples.size(), sizeof(Trajectory::Sample) / sizeof(float), o.dimension, o.delay,
+                              points);
+        }
+        points.standardize();
+    }
+
+    bool writeCorrelation(const std::string& path, const Recurrence::Correlation& c, std::string& error)
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out)
+        {
+            error = "Cannot create " + path;
+            return false;
+        }
+        out << "radius,correlation_sum,local_slope\n";
+        char line[96];
+        for (size_t k = 0; k < c.radii.size(); ++k)
+        {
+            std::snprintf(line, sizeof(line), "%.7g,%.7g,%.5g\n", c.radii[k], c.sums[k], Recurrence::localSlope(c, k));
+            out << line;
+        }
+        if (!out)
+        {
+            error = "Cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse(argc, argv, options))
+        return 1;
+
+    std::string error;
+    std::vector<Trajectory::Sample> samples;
+    auto start = std::chrono::steady_clock::now();
+    if (!options.trajectory.empty())
+    {
+        if (!record(options, samples, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    else
+    {
+        simulate(options, samples);
+    }
+    Recurrence::Points points;
+    embed(options, samples, points);
+    samples = std::vector<Trajectory::Sample>();
+    if (points.count <= options.theiler + 1)
+    {
+        std::fprintf(stderr, "%zu points leave no pairs outside a Theiler window of %zu\n", points.count,
+                     options.theiler);
+        return 1;
+    }
+
+    ThreadPool pool(options.threads);
+    std::fprintf(stderr, "Kernels: %s\n", Cpu::report().c_str());
+    std::fprintf(stderr, "%zu points in %d dimensions, %.2f s to load and embed, %zu threads\n", points.count,
+                 points.dimension, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+                 pool.size());
+
+    start = std::chrono::steady_clock::now();
+    Recurrence::Tree tree;
+    tree.build(points, pool);
+    std::fprintf(stderr, "Tree: %.2f s\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    start = std::chrono::steady_clock::now();
+    Recurrence::Correlation correlation;
+    Recurrence::correlate(points, tree, pool, (float)options.radii.min, (float)options.radii.max,
+                          (size_t)std::max(2, options.radii.levels), options.theiler, options.references, correlation);
+    std::fprintf(stderr, "Correlation sums: %.2f s from %zu references\n",
+                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+                 std::min(options.references, points.count));
+    std::printf("correlation dimension %.4f\n", Recurrence::dimension(correlation));
+    if (!options.correlation.empty() && !writeCorrelation(options.correlation, correlation, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    float radius = options.radius > 0.0f ? options.radius : Recurrence::radiusFor(correlation, options.rate);
+    if (!(radius > 0.0f))
+    {
+        std::fprintf(stderr, "Recurrence rate %g is outside the sums over --radii\n", options.rate);
+        return 1;
+    }
+    start = std::chrono::steady_clock::now();
+    Recurrence::Quantification q;
+    Recurrence::Plot plot;
+    plot.size = options.plot.empty() ? 0 : options.size;
+    Recurrence::quantify(points, tree, pool, radius, options.theiler, options.minLine, q,
+                         options.plot.empty() ? nullptr : &plot);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "Quantification: %.2f s, %.1f M recurrences/s\n", seconds, q.recurrences / seconds * 1e-6);
+    std::printf("radius %.5g\nrecurrence rate %.6g\ndeterminism %.5f\nmean diagonal %.4f\nlongest diagonal %zu\n"
+                "diagonal entropy %.4f\nlaminarity %.5f\ntrapping time %.4f\nlongest vertical %zu\n",
+                radius, q.recurrenceRate, q.determinism, q.meanDiagonal, q.longestDiagonal, q.entropy, q.laminarity,
+                q.trappingTime, q.longestVertical);
+
+    if (!options.plot.empty())
+    {
+        std::vector<uint8_t> pixels;
+        ImageFile::logScale(plot.counts.data(), plot.counts.size(), pixels);
+        if (!ImageFile::writePgm(options.plot, plot.size, plot.size, pixels.data(), error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
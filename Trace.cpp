@@ -0,0 +1,188 @@
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::enabled{ false };
+
+namespace
+{
+    const size_t Capacity = 1 << 14;
+    // Events this close to the writer may be overwritten while being copied
+    const size_t Slack = 256;
+
+    struct Event
+    {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    struct ThreadBuffer
+    {
+        std::vector<Event> events = std::vector<Event>(Capacity);
+        std::atomic<uint64_t> head{ 0 };
+        // Events before this index were cleared
+        std::atomic<uint64_t> floor{ 0 };
+        std::atomic<bool> retired{ false };
+        uint32_t tid = 0;
+        std::string name;
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        uint64_t tick0 = Trace::now();
+        std::chrono::steady_clock::time_point time0 = std::chrono::steady_clock::now();
+    };
+
+    Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+
+    // Buffers outlive their threads so a dump still shows them; a finished
+    // thread's buffer is handed to the next thread that starts tracing.
+    struct ThreadSlot
+    {
+        ThreadBuffer* buffer = nullptr;
+        ~ThreadSlot()
+        {
+            if (buffer)
+                buffer->retired.store(true, std::memory_order_release);
+        }
+    };
+    thread_local ThreadSlot slot;
+
+    ThreadBuffer* threadBuffer()
+    {
+        if (slot.buffer)
+            return slot.buffer;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& b : r.buffers)
+        {
+            if (b->retired.load(std::memory_order_acquire))
+            {
+                b->retired.store(false, std::memory_order_relaxed);
+                b->name.clear();
+                slot.buffer = b.get();
+                return slot.buffer;
+            }
+        }
+        r.buffers.push_back(std::make_unique<ThreadBuffer>());
+        r.buffers.back()->tid = (uint32_t)r.buffers.size();
+        slot.buffer = r.buffers.back().get();
+        return slot.buffer;
+    }
+
+    void writeEscaped(std::ofstream& out, const char* s)
+    {
+        for (; *s; ++s)
+        {
+            if (*s == '"' || *s == '\\')
+                out << '\\';
+            out << *s;
+        }
+    }
+}
+
+void Trace::setEnabled(bool on)
+{
+    registry();
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+void Trace::setThreadName(const char* name)
+{
+    ThreadBuffer* b = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    b->name = name;
+}
+
+void Trace::record(const char* name, uint64_t begin, uint64_t end)
+{
+    ThreadBuffer* b = threadBuffer();
+    uint64_t h = b->head.load(std::memory_order_relaxed);
+    b->events[h & (Capacity - 1)] = { name, begin, end };
+    b->head.store(h + 1, std::memory_order_release);
+}
+
+void Trace::clear()
+{
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for (auto& b : registry().buffers)
+        b->floor.store(b->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+bool Trace::writeChromeJson(const std::string& path, std::string& error)
+{
+    Registry& r = registry();
+
+    // Relate ticks to wall time over everything since the registry was made
+    uint64_t tick1 = now();
+    auto time1 = std::chrono::steady_clock::now();
+    double elapsedUs = std::chrono::duration<double, std::micro>(time1 - r.time0).count();
+    double ticksPerUs = elapsedUs > 0.0 ? (double)(tick1 - r.tick0) / elapsedUs : 1.0;
+    if (ticksPerUs <= 0.0)
+        ticksPerUs = 1.0;
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+    {
+        error = "Cannot create " + path;
+        return false;
+    }
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<Event> copy;
+    for (auto& b : r.buffers)
+    {
+        uint64_t head = b->head.load(std::memory_order_acquire);
+        uint64_t from = head > Capacity - Slack ? head - (Capacity - Slack) : 0;
+        from = std::max(from, b->floor.load(std::memory_order_relaxed));
+        copy.clear();
+        for (uint64_t i = from; i < head; ++i)
+            copy.push_back(b->events[i & (Capacity - 1)]);
+        // Drop whatever the owning thread overwrote, or is overwriting, while we copied
+        uint64_t after = b->head.load(std::memory_order_acquire);
+        size_t skip = after + 1 > Capacity + from ? (size_t)(after + 1 - Capacity - from) : 0;
+        skip = std::min(skip, copy.size());
+
+        if (!b->name.empty())
+        {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid
+                << ",\"args\":{\"name\":\"";
+            writeEscaped(out, b->name.c_str());
+            out << "\"}}";
+            first = false;
+        }
+        char line[128];
+        for (size_t i = skip; i < copy.size(); ++i)
+        {
+            const Event& e = copy[i];
+            if (e.end < e.begin || e.begin < r.tick0)
+                continue;
+            out << (first ? "" : ",\n") << "{\"name\":\"";
+            writeEscaped(out, e.name);
+            std::snprintf(line, sizeof(line), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                          b->tid, (e.begin - r.tick0) / ticksPerUs, (e.end - e.begin) / ticksPerUs);
+            out << line;
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    if (!out)
+    {
+        error = "Failed writing " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define TRACE_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_HAS_TSC 1
+#endif
+
+// Build with PENDULUM_TRACE=0 to compile every zone out
+#ifndef PENDULUM_TRACE
+#define PENDULUM_TRACE 1
+#endif
+
+// Frame-phase tracing. A zone stamps the TSC (steady_clock off x86) when it
+// opens and closes and drops one event into a ring owned by the calling
+// thread, so tracing never takes a lock. Rings keep the most recent events
+// and are dumped on demand as Chrome trace JSON, which chrome://tracing and
+// Perfetto both open. While tracing is disabled a zone costs one relaxed load.
+namespace Trace
+{
+    extern std::atomic<bool> enabled;
+
+    inline uint64_t now()
+    {
+#ifdef TRACE_HAS_TSC
+        return __rdtsc();
+#else
+        return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    void setEnabled(bool on);
+    inline bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Names the calling thread's track in the dump
+    void setThreadName(const char* name);
+    // name must outlive the trace, in practice a string literal
+    void record(const char* name, uint64_t begin, uint64_t end);
+    void clear();
+    bool writeChromeJson(const std::string& path, std::string& error);
+
+    struct Zone
+    {
+        explicit Zone(const char* name) : name(name), begin(isEnabled() ? now() : 0) {}
+        ~Zone() { end(); }
+        // Closes the zone early, for phases that do not map onto a scope
+        void end()
+        {
+            if (begin)
+                record(name, begin, now());
+            begin = 0;
+        }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+        const char* name;
+        uint64_t begin;
+    };
+}
+
+#if PENDULUM_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_BEGIN(zone, name) Trace::Zone zone(name)
+#define TRACE_END(zone) zone.end()
+#define TRACE_THREAD(name) Trace::setThreadName(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_BEGIN(zone, name) ((void)0)
+#define TRACE_END(zone) ((void)0)
+#define TRACE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,442 @@
+#include "Trail.h"
+#include "Checkpoint.h"
+#include <cmath>
+#include <algorithm>
+
+static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+static uint8_t bitWidth(uint32_t v)
+{
+    uint8_t bits = 0;
+    while (v)
+    {
+        bits++;
+        v >>= 1;
+    }
+    return bits;
+}
+
+static int16_t quantize(float v)
+{
+    long q = std::lround(v);
+    return (int16_t)std::max(-32767L, std::min(32767L, q));
+}
+
+TrailHistory::TrailHistory()
+{
+    setMaxSamples(LevelReach);
+}
+
+float TrailHistory::gridStep(float range)
+{
+    // Coarsest power-of-two multiple of the 16-bit grid that stays within MaxError
+    float step = std::max(range, 1e-3f) / 32767.0f;
+    while (step * 2.0f <= 2.0f * MaxError)
+        step *= 2.0f;
+    return step;
+}
+
+void TrailHistory::push(float x, float y, float ox, float oy, float range)
+{
+    lastOx = ox;
+    lastOy = oy;
+    lastRange = range;
+    float step = gridStep(range);
+
+    uint64_t sample = count++;
+    for (auto& level : levels)
+    {
+        if (sample % level.stride != 0)
+            break;
+        level.append(sample / level.stride, x, y, ox, oy, step);
+    }
+}
+
+void TrailHistory::clear()
+{
+    for (auto& level : levels)
+    {
+        level.head = 0;
+        level.sealed = 0;
+        level.openPoints.clear();
+    }
+    count = 0;
+}
+
+void TrailHistory::setMaxSamples(size_t samples)
+{
+    maxSamples = std::max<size_t>(samples, 2);
+
+    int wanted = 1;
+    uint64_t reach = LevelReach;
+    while (reach < maxSamples && wanted < MaxLevels)
+    {
+        reach *= Decimation;
+        wanted++;
+    }
+
+    if ((int)levels.size() > wanted)
+        levels.resize(wanted);
+    while ((int)levels.size() < wanted)
+        addLevel();
+}
+
+size_t TrailHistory::memoryBytes() const
+{
+    size_t bytes = sizeof(*this);
+    for (const auto& level : levels)
+    {
+        bytes += level.blocks.capacity() * sizeof(Block);
+        bytes += level.firstEntry.capacity() * sizeof(uint64_t);
+        bytes += level.openPoints.capacity() * sizeof(int16_t);
+    }
+    return bytes;
+}
+
+void TrailHistory::addLevel()
+{
+    Level level;
+    level.blocks.resize(BlockCount);
+    level.firstEntry.resize(BlockCount);
+    level.openPoints.reserve(BlockPoints * 2);
+    if (!levels.empty())
+        level.stride = levels.back().stride * Decimation;
+
+    // Seed the new level from the one below so the history it covers is not lost
+    if (!levels.empty() && !levels.back().empty())
+    {
+        int below = (int)levels.size() - 1;
+        const Level& src = levels[below];
+        uint64_t oldest = src.oldestEntry() * src.stride;
+        uint64_t newest = src.newestEntry() * src.stride;
+        oldest += (level.stride - oldest % level.stride) % level.stride;
+
+        DecodeCache cache;
+        float step = gridStep(lastRange);
+        for (uint64_t s = oldest; s <= newest; s += level.stride)
+        {
+            std::pair<float, float> p = fetch(below, s, cache);
+            level.append(s / level.stride, p.first, p.second, lastOx, lastOy, step);
+        }
+    }
+    levels.push_back(std::move(level));
+}
+
+uint64_t TrailHistory::Level::oldestEntry() const
+{
+    if (sealed > 0)
+        return firstEntry[(head + BlockCount - sealed) % BlockCount];
+    return openFirst;
+}
+
+uint64_t TrailHistory::Level::newestEntry() const
+{
+    if (!openPoints.empty())
+        return openFirst + openPoints.size() / 2 - 1;
+    size_t last = (head + BlockCount - 1) % BlockCount;
+    return firstEntry[last] + blocks[last].count - 1;
+}
+
+void TrailHistory::Level::append(uint64_t entry, float x, float y, float ox, float oy, float step)
+{
+    if (openPoints.empty())
+    {
+        open.ox = ox;
+        open.oy = oy;
+        open.step = step;
+        openFirst = entry;
+        openMaxX = 0;
+        openMaxY = 0;
+    }
+
+    int16_t qx = quantize((x - open.ox) / open.step);
+    int16_t qy = quantize((y - open.oy) / open.step);
+
+    size_t points = openPoints.size() / 2;
+    if (points > 0)
+    {
+        uint32_t mx = std::max(openMaxX, zigzag(qx - openPoints[points * 2 - 2]));
+        uint32_t my = std::max(openMaxY, zigzag(qy - openPoints[points * 2 - 1]));
+        size_t bits = points * (size_t)(bitWidth(mx) + bitWidth(my));
+        if (points + 1 > BlockPoints || bits > sizeof(open.payload) * 8)
+        {
+            seal();
+            append(entry, x, y, ox, oy, step);
+            return;
+        }
+        openMaxX = mx;
+        openMaxY = my;
+    }
+    openPoints.push_back(qx);
+    openPoints.push_back(qy);
+}
+
+void TrailHistory::Level::seal()
+{
+    Block& block = blocks[head];
+    block = open;
+    block.count = (uint8_t)(openPoints.size() / 2);
+    block.x0 = openPoints[0];
+    block.y0 = openPoints[1];
+    block.bitsX = bitWidth(openMaxX);
+    block.bitsY = bitWidth(openMaxY);
+
+    uint64_t acc = 0;
+    int accBits = 0;
+    size_t out = 0;
+    for (size_t i = 1; i < block.count; ++i)
+    {
+        acc |= (uint64_t)zigzag(openPoints[i * 2] - openPoints[i * 2 - 2]) << accBits;
+        accBits += block.bitsX;
+        acc |= (uint64_t)zigzag(openPoints[i * 2 + 1] - openPoints[i * 2 - 1]) << accBits;
+        accBits += block.bitsY;
+        while (accBits >= 8)
+        {
+            block.payload[out++] = (uint8_t)acc;
+            acc >>= 8;
+            accBits -= 8;
+        }
+    }
+    if (accBits > 0)
+        block.payload[out++] = (uint8_t)acc;
+
+    firstEntry[head] = openFirst;
+    head = (head + 1) % BlockCount;
+    if (sealed < BlockCount)
+        ++sealed;
+    openPoints.clear();
+}
+
+void TrailHistory::decode(const Block& block, float* xy)
+{
+    int32_t qx = block.x0, qy = block.y0;
+    const uint32_t maskX = (1u << block.bitsX) - 1, maskY = (1u << block.bitsY) - 1;
+    uint64_t acc = 0;
+    int accBits = 0;
+    size_t in = 0;
+
+    xy[0] = block.ox + qx * block.step;
+    xy[1] = block.oy + qy * block.step;
+    for (size_t i = 1; i < block.count; ++i)
+    {
+        while (accBits < 48 && in < sizeof(block.payload))
+        {
+            acc |= (uint64_t)block.payload[in++] << accBits;
+            accBits += 8;
+        }
+        qx += unzigzag((uint32_t)acc & maskX);
+        acc >>= block.bitsX;
+        accBits -= block.bitsX;
+        qy += unzigzag((uint32_t)acc & maskY);
+        acc >>= block.bitsY;
+        accBits -= block.bitsY;
+
+        xy[i * 2] = block.ox + qx * block.step;
+        xy[i * 2 + 1] = block.oy + qy * block.step;
+    }
+}
+
+bool TrailHistory::holds(int level, uint64_t sample) const
+{
+    const Level& l = levels[level];
+    if (l.empty() || sample >= count || sample % l.stride != 0)
+        return false;
+    uint64_t entry = sample / l.stride;
+    return entry >= l.oldestEntry() && entry <= l.newestEntry();
+}
+
+std::pair<float, float> TrailHistory::fetch(int level, uint64_t sample, DecodeCache& cache) const
+{
+    const Level& l = levels[level];
+    uint64_t entry = sample / l.stride;
+
+    if (!l.openPoints.empty() && entry >= l.openFirst)
+    {
+        size_t i = (size_t)(entry - l.openFirst);
+        return { l.open.ox + l.openPoints[i * 2] * l.open.step,
+                 l.open.oy + l.openPoints[i * 2 + 1] * l.open.step };
+    }
+
+    // Sealed blocks are ordered by first entry from oldest to newest
+    size_t lo = 0, hi = l.sealed;
+    const size_t base = l.head + BlockCount - l.sealed;
+    while (hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (l.firstEntry[(base + mid) % BlockCount] <= entry)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    size_t slot = (base + lo) % BlockCount;
+    if (cache.first != l.firstEntry[slot])
+    {
+        decode(l.blocks[slot], cache.xy);
+        cache.first = l.firstEntry[slot];
+    }
+    size_t i = (size_t)(entry - cache.first);
+    return { cache.xy[i * 2], cache.xy[i * 2 + 1] };
+}
+
+size_t TrailHistory::collect(float pixelSize, std::vector<std::pair<float, float>>& out) const
+{
+    out.clear();
+    if (count == 0)
+        return 0;
+
+    DecodeCache caches[MaxLevels];
+    const uint64_t newest = count - 1;
+    const uint64_t reach = std::min<uint64_t>(maxSamples, count);
+    const int top = (int)levels.size() - 1;
+
+    int k = 0;
+    uint64_t s = newest;
+    std::pair<float, float> prev = fetch(0, s, caches[0]);
+    std::pair<float, float> pending = prev;
+    bool hasPending = false;
+    out.push_back(prev);
+
+    while (true)
+    {
+        if (s < levels[k].stride)
+            break;
+        s -= levels[k].stride;
+        s -= s % levels[k].stride;
+
+        // Fall back to a coarser level once the finer one runs out of history
+        while (k < top && !holds(k, s))
+        {
+            k++;
+            s -= s % levels[k].stride;
+        }
+        if (!holds(k, s) || newest - s >= reach)
+            break;
+
+        std::pair<float, float> p = fetch(k, s, caches[k]);
+        float d = std::max(std::fabs(p.first - prev.first), std::fabs(p.second - prev.second));
+        prev = p;
+
+        std::pair<float, float>& last = out.back();
+        if (std::max(std::fabs(p.first - last.first), std::fabs(p.second - last.second)) >= pixelSize)
+        {
+            out.push_back(p);
+            hasPending = false;
+        }
+        else
+        {
+            pending = p;
+            hasPending = true;
+        }
+
+        // Pick the level matching the on-screen density of the segments
+        if (d < pixelSize * 0.5f && k < top)
+            k++;
+        else if (d > pixelSize * 4.0f && k > 0)
+            k--;
+    }
+
+    if (hasPending)
+        out.push_back(pending);
+    return out.size();
+}
+
+void TrailHistory::save(Checkpoint::Writer& out) const
+{
+    out.pod<uint64_t>(levels.size());
+    for (const Level& level : levels)
+    {
+        out.array(level.blocks);
+        out.array(level.firstEntry);
+        out.pod<uint64_t>(level.head);
+        out.pod<uint64_t>(level.sealed);
+        out.pod(level.stride);
+        out.pod(level.open);
+        out.array(level.openPoints);
+        out.pod(level.openFirst);
+        out.pod(level.openMaxX);
+        out.pod(level.openMaxY);
+    }
+    out.pod(count);
+    out.pod<uint64_t>(maxSamples);
+    out.pod(lastOx);
+    out.pod(lastOy);
+    out.pod(lastRange);
+}
+
+bool TrailHistory::load(Checkpoint::Reader& in)
+{
+    uint64_t levelCount = 0;
+    if (!in.pod(levelCount) || levelCount > (uint64_t)MaxLevels)
+        return false;
+    levels.resize((size_t)levelCount);
+    for (Level& level : levels)
+    {
+        uint64_t head = 0, sealed = 0;
+        in.array(level.blocks);
+        in.array(level.firstEntry);
+        in.pod(head);
+        in.pod(sealed);
+        in.pod(level.stride);
+        in.pod(level.open);
+        in.array(level.openPoints);
+        in.pod(level.openFirst);
+        in.pod(level.openMaxX);
+        in.pod(level.openMaxY);
+        level.head = (size_t)head;
+        level.sealed = (size_t)sealed;
+        // Appending must not reallocate once a run is under way
+        level.openPoints.reserve(BlockPoints * 2);
+        if (level.blocks.size() != BlockCount || level.firstEntry.size() != BlockCount)
+            return false;
+    }
+    uint64_t samples = 0;
+    in.pod(count);
+    in.pod(samples);
+    in.pod(lastOx);
+    in.pod(lastOy);
+    in.pod(lastRange);
+    maxSamples = (size_t)samples;
+    return in.ok() && valid();
+}
+
+bool TrailHistory::valid() const
+{
+    // Scene files carry no checksum, so everything push, fetch and decode
+    // index with is checked against the shape they expect
+    const uint8_t MaxBits = 17;
+    uint64_t stride = 1;
+    for (size_t k = 0; k < levels.size(); ++k, stride *= Decimation)
+    {
+        const Level& l = levels[k];
+        if (l.stride != stride || l.head >= BlockCount || l.sealed > BlockCount ||
+            l.openPoints.size() > BlockPoints * 2 || l.openPoints.size() % 2 != 0 ||
+            bitWidth(l.openMaxX) > MaxBits || bitWidth(l.openMaxY) > MaxBits)
+            return false;
+        // Sealed blocks, oldest first, each starting where the last ended
+        uint64_t next = 0;
+        for (size_t i = 0; i < l.sealed; ++i)
+        {
+            size_t slot = (l.head + BlockCount - l.sealed + i) % BlockCount;
+            const Block& b = l.blocks[slot];
+            if (b.count == 0 || b.count > BlockPoints || b.bitsX > MaxBits || b.bitsY > MaxBits ||
+                (size_t)(b.count - 1) * (b.bitsX + b.bitsY) > sizeof(b.payload) * 8 ||
+                (i > 0 && l.firstEntry[slot] != next))
+                return false;
+            next = l.firstEntry[slot] + b.count;
+        }
+        if (!l.openPoints.empty() && l.sealed > 0 && l.openFirst != next)
+            return false;
+        // Nothing newer than the samples pushed; the finest level holds the newest
+        if (l.empty())
+        {
+            if (k == 0 && count > 0)
+                return false;
+            continue;
+        }
+        const uint64_t newest = l.newestEntry();
+        if (count == 0 || newest > (count - 1) / stride || (k == 0 && newest != count - 1))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace Checkpoint
+{
+    class Writer;
+    class Reader;
+}
+
+// Trail history stored as a pyramid in time: level 0 keeps every sample,
+// and every coarser level keeps one of each Decimation samples of the level
+// below. Each level is a fixed ring, so memory stays bounded no matter how
+// long the trail is.
+//
+// Points are quantized relative to the pivot on a 16-bit grid spanning the
+// pendulum's reach, coarsened as far as MaxError allows, and stored as
+// bit-packed deltas in fixed-size blocks.
+class TrailHistory
+{
+public:
+    static const uint64_t Decimation = 4;
+    static const int MaxLevels = 12;
+    static const size_t BlockCount = 32;
+    static const size_t BlockPoints = 128;
+    // Half a pixel on a 2160 line display with the [-1, 1] projection
+    static constexpr float MaxError = 1.0f / 2160.0f;
+
+    struct Block
+    {
+        float ox, oy;
+        float step;
+        int16_t x0, y0;
+        uint8_t bitsX, bitsY;
+        uint8_t count;
+        uint8_t pad;
+        uint8_t payload[108];
+    };
+
+    // Points a block holds at worst, with 17-bit deltas on both axes, and so
+    // the fewest entries a level reaches back over
+    static const size_t MinBlockPoints = 1 + sizeof(Block::payload) * 8 / 34;
+    static const size_t LevelReach = BlockCount * MinBlockPoints;
+
+    TrailHistory();
+
+    // ox, oy is the pivot and range the farthest the bob can get from it.
+    void push(float x, float y, float ox, float oy, float range);
+    void clear();
+    // Number of most recent samples the trail reaches back over.
+    void setMaxSamples(size_t samples);
+    size_t getMaxSamples() const { return maxSamples; }
+    uint64_t sampleCount() const { return count; }
+    int levelCount() const { return (int)levels.size(); }
+    size_t memoryBytes() const;
+
+    // Collects the trail from newest to oldest into out, moving to coarser
+    // levels where consecutive points are closer than pixelSize and back to
+    // finer ones where they are far apart. Returns the number of points.
+    size_t collect(float pixelSize, std::vector<std::pair<float, float>>& out) const;
+
+    // Exact copy of every level for checkpoints; load replaces the whole history.
+    void save(Checkpoint::Writer& out) const;
+    bool load(Checkpoint::Reader& in);
+
+private:
+    struct Level
+    {
+        std::vector<Block> blocks;
+        std::vector<uint64_t> firstEntry;
+        size_t head = 0;
+        size_t sealed = 0;
+        uint64_t stride = 1;
+
+        // Block being filled, kept as plain quantized points until sealed
+        Block open = {};
+        std::vector<int16_t> openPoints;
+        uint64_t openFirst = 0;
+        uint32_t openMaxX = 0, openMaxY = 0;
+
+        bool empty() const { return sealed == 0 && openPoints.empty(); }
+        uint64_t oldestEntry() const;
+        uint64_t newestEntry() const;
+        void append(uint64_t entry, float x, float y, float ox, float oy, float step);
+        void seal();
+    };
+
+    struct DecodeCache
+    {
+        uint64_t first = UINT64_MAX;
+        float xy[BlockPoints * 2];
+    };
+
+    // Whether a loaded history is one push and collect can index safely
+    bool valid() const;
+    bool holds(int level, uint64_t sample) const;
+    std::pair<float, float> fetch(int level, uint64_t sample, DecodeCache& cache) const;
+    void addLevel();
+    static float gridStep(float range);
+    static void decode(const Block& block, float* xy);
+
+    std::vector<Level> levels;
+    uint64_t count = 0;
+    size_t maxSamples = 0;
+    float lastOx = 0.0f, lastOy = 0.0f, lastRange = 1.0f;
+};
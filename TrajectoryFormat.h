@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+
+// On-disk layout of recorded trajectories. A file is a header, one
+// PendulumInfo per recorded pendulum, a stream of chunks and an index footer.
+// A chunk payload holds sampleCount doubles of time followed by, for each of
+// its pendulums, channelCount columns of sampleCount floats.
+namespace Trajectory
+{
+    const uint32_t Version = 1;
+    const uint32_t ChunkMagic = 0x4B4E4843; // "CHNK"
+
+    enum Channel : uint32_t
+    {
+        Theta1 = 0, Theta2, Omega1, Omega2, X1, Y1, X2, Y2, ChannelCount
+    };
+    // Angles and angular velocities are always stored, bob positions optionally
+    const uint32_t StateChannels = 4;
+
+    enum Codec : uint32_t
+    {
+        Raw = 0, ShuffledLz = 1
+    };
+
+    // PendulumInfo::type of elastic pendulums
+    const uint32_t ElasticType = 4;
+
+    // One pendulum at one instant, in channel order. Single pendulums leave
+    // the second arm at zero length. Elastic ones have no second angle and
+    // keep their rod length and its rate of change in theta2 and omega2.
+    struct Sample
+    {
+        float theta1, theta2;
+        float omega1, omega2;
+        float x1, y1;
+        float x2, y2;
+    };
+
+    struct PendulumInfo
+    {
+        uint32_t type;
+        float m1, m2;
+        float L1, L2;
+        float px, py;
+    };
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint32_t pendulumCount;
+        uint32_t channelCount;
+        uint32_t laneCount;
+        uint32_t chunkSamples;
+        uint32_t decimation;
+        uint32_t flags;
+    };
+
+    struct ChunkHeader
+    {
+        uint32_t magic;
+        uint32_t lane;
+        uint32_t firstPendulum;
+        uint32_t pendulumCount;
+        uint32_t sampleCount;
+        uint32_t codec;
+        uint64_t rawBytes;
+        uint64_t storedBytes;
+        uint64_t sequence;
+        double t0, t1;
+    };
+
+    struct IndexEntry
+    {
+        double t0, t1;
+        uint64_t offset;
+        uint32_t lane;
+        uint32_t sampleCount;
+    };
+
+    struct Footer
+    {
+        uint64_t indexOffset;
+        uint64_t chunkCount;
+        uint64_t droppedChunks;
+        char magic[8];
+    };
+
+    inline const char* fileMagic() { return "PENDREC"; }
+    inline const char* footerMagic() { return "PENDIDX"; }
+}